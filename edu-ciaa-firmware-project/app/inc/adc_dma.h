@@ -0,0 +1,266 @@
+/*
+ * @brief Background ADC0/ADC1 acquisition in burst mode through the GPDMA
+ *
+ * The ADC runs in burst mode over a set of channels, converting them in
+ * ascending order over and over, and the GPDMA moves every result from the
+ * global data register into a ring of sample blocks, one linked descriptor
+ * per block. The CPU takes no interrupt per sample, only one per block.
+ * Each word moved is the whole data register, which carries the channel
+ * number next to the result, so a block never needs to be realigned.
+ *
+ * Two views are lock-free for a single reader:
+ *   - AdcDma_Latest() returns the calibrated value of a channel from the
+ *     last scan of the last completed block.
+ *   - AdcDma_ReadBlock() copies out the oldest completed block, calibrated
+ *     and laid out scan by scan. A reader that falls behind the ring loses
+ *     the oldest blocks, counted, never a mix of old and new samples.
+ *
+ * Calibration is a per channel offset in counts and gain in 16.16 fixed
+ * point, applied when values are read, so the block interrupt stays short.
+ *
+ * AdcDma_InitTriggered() samples one channel per edge of a hardware start
+ * signal instead, a PWM output for instance, with the same block ring.
+ * A block hook sees every completed block from the DMA interrupt, for
+ * checks that cannot wait for the reader.
+ *
+ * Buffers and descriptors are owned by the caller, in RAM4 (__DMA_BUF):
+ *
+ *   static uint32_t adcBuf[ADC_DMA_BUF_WORDS(2, 32, 3)] __DMA_BUF;
+ *   static DMA_TransferDescriptor_t adcDesc[2] __DMA_BUF;
+ */
+
+#ifndef __ADC_DMA_H_
+#define __ADC_DMA_H_
+
+#include "chip.h"
+#include "task_sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup ADC_DMA APP: Burst mode ADC acquisition
+ * @{
+ */
+
+/** Channels of an ADC */
+#define ADC_DMA_CHANNELS        8
+
+/** Fraction bits of the calibration gain */
+#define ADC_DMA_GAIN_SHIFT      16
+
+/** Calibration gain of 1 */
+#define ADC_DMA_GAIN_ONE        (1L << ADC_DMA_GAIN_SHIFT)
+
+/** Words of a buffer of @a nblocks blocks of @a scans scans over @a nch channels */
+#define ADC_DMA_BUF_WORDS(nblocks, scans, nch)  ((nblocks) * (scans) * (nch))
+
+/** Largest block, the GPDMA transfer size */
+#define ADC_DMA_MAX_BLOCK_WORDS 4095
+
+/**
+ * @brief Channel calibration, value = ((raw - offset) * gain) >> ADC_DMA_GAIN_SHIFT
+ */
+typedef struct {
+   int32_t gain;               /*!< Units per count, 16.16 fixed point */
+   int16_t offset;             /*!< Counts read at zero */
+} ADC_DMA_CAL_T;
+
+/**
+ * @brief Acquisition statistics
+ */
+typedef struct {
+   uint32_t blocks;            /*!< Blocks completed */
+   uint32_t read;              /*!< Blocks copied out */
+   uint32_t dropped;           /*!< Blocks the reader was lapped on */
+   uint32_t overruns;          /*!< Published scans with a result overwritten before the DMA took it */
+   uint32_t dmaErrors;         /*!< GPDMA error interrupts */
+} ADC_DMA_STATS_T;
+
+typedef struct ADC_DMA ADC_DMA_T;
+
+/**
+ * @brief Block hook, called from the DMA interrupt
+ * @param pAdc     : Acquisition state
+ * @param block    : Completed block, blockWords raw data register words
+ * @param ctx      : Context given to AdcDma_SetHook()
+ */
+typedef void (*ADC_DMA_HOOK_T)(ADC_DMA_T *pAdc, const uint32_t *block, void *ctx);
+
+/**
+ * @brief Acquisition state
+ */
+struct ADC_DMA {
+   LPC_ADC_T *pADC;            /*!< ADC0 or ADC1 */
+   uint8_t ch;                 /*!< GPDMA channel */
+   uint8_t nch;                /*!< Channels sampled */
+   uint8_t chanMask;           /*!< Channels sampled, bit n for channel n */
+   uint8_t index[ADC_DMA_CHANNELS]; /*!< Position of each channel in a scan */
+   uint32_t *buf;              /*!< Block ring, nblocks * blockWords words */
+   DMA_TransferDescriptor_t *desc; /*!< Descriptor ring, nblocks entries */
+   uint32_t nblocks;           /*!< Blocks in the ring, at least 2 */
+   uint32_t scans;             /*!< Scans per block */
+   uint32_t blockWords;        /*!< Words per block, scans * nch */
+   volatile uint32_t doneBlocks; /*!< Blocks completed, updated by the DMA interrupt */
+   uint32_t readBlocks;        /*!< Blocks consumed by AdcDma_ReadBlock() */
+   volatile uint16_t latest[ADC_DMA_CHANNELS]; /*!< Raw result of each channel in the last published scan */
+   ADC_DMA_CAL_T cal[ADC_DMA_CHANNELS]; /*!< Calibration of each channel */
+   ADC_DMA_HOOK_T hook;        /*!< Called on each block, may be NULL */
+   void *hookCtx;              /*!< Hook context */
+   SCHED_TASK_T *task;         /*!< Task posted on each block, may be NULL */
+   uint16_t sig;               /*!< Signal posted, the argument is the block count */
+   ADC_DMA_STATS_T stats;      /*!< Running statistics */
+};
+
+/**
+ * @brief  Start sampling a set of channels
+ * @param  pAdc        : Acquisition state
+ * @param  pADC        : LPC_ADC0 or LPC_ADC1
+ * @param  chanMask    : Channels to sample, bit n for channel n
+ * @param  scanHz      : Scans per second, the ADC converts scanHz times the channel count
+ * @param  buf         : Block ring, ADC_DMA_BUF_WORDS(nblocks, scans, channels) words
+ * @param  desc        : Descriptor ring, nblocks entries
+ * @param  nblocks     : Blocks in the ring, at least 2
+ * @param  scans       : Scans per block
+ * @return SUCCESS, or ERROR when the rate or the sizes are out of range or no GPDMA channel is free
+ * @note   Burst mode rates are set by the ADC clock divider: the rate
+ *         reached is the nearest one at or below the one asked, up to
+ *         400 kHz conversions. Calibration starts as raw counts.
+ */
+Status AdcDma_Init(ADC_DMA_T *pAdc, LPC_ADC_T *pADC, uint8_t chanMask, uint32_t scanHz,
+                   uint32_t *buf, DMA_TransferDescriptor_t *desc, uint32_t nblocks, uint32_t scans);
+
+/**
+ * @brief  Start sampling one channel on each edge of a start signal
+ * @param  pAdc        : Acquisition state
+ * @param  pADC        : LPC_ADC0 or LPC_ADC1
+ * @param  chan        : Channel, 0 to 7
+ * @param  start       : Start signal, ADC_START_ON_CTOUT15 to ADC_START_ON_MCOA2
+ * @param  edge        : Edge of the start signal that starts a conversion
+ * @param  buf         : Block ring, ADC_DMA_BUF_WORDS(nblocks, scans, 1) words
+ * @param  desc        : Descriptor ring, nblocks entries
+ * @param  nblocks     : Blocks in the ring, at least 2
+ * @param  scans       : Samples per block
+ * @return SUCCESS, or ERROR when the sizes are out of range or no GPDMA channel is free
+ * @note   Conversions run at the fastest ADC clock, 11 clocks at 4.5 MHz,
+ *         so edges must come at least 2.5 us apart.
+ */
+Status AdcDma_InitTriggered(ADC_DMA_T *pAdc, LPC_ADC_T *pADC, uint8_t chan, ADC_START_MODE_T start,
+                            ADC_EDGE_CFG_T edge, uint32_t *buf, DMA_TransferDescriptor_t *desc,
+                            uint32_t nblocks, uint32_t scans);
+
+/**
+ * @brief  Set the calibration of a channel
+ * @param  pAdc        : Acquisition state
+ * @param  chan        : Channel, 0 to 7
+ * @param  offset      : Counts read at zero
+ * @param  gain        : Units per count, 16.16 fixed point (ADC_DMA_GAIN_ONE for counts)
+ * @return Nothing
+ * @note   Not to be called while the channel is being read.
+ */
+void AdcDma_SetCal(ADC_DMA_T *pAdc, uint8_t chan, int16_t offset, int32_t gain);
+
+/**
+ * @brief  Post an event to a task on each completed block
+ * @param  pAdc        : Acquisition state
+ * @param  task        : Task, NULL for none
+ * @param  sig         : Signal, the argument is the low bits of the block count
+ * @return Nothing
+ */
+void AdcDma_SetTask(ADC_DMA_T *pAdc, SCHED_TASK_T *task, uint16_t sig);
+
+/**
+ * @brief  Set a function to run on each completed block
+ * @param  pAdc        : Acquisition state
+ * @param  hook        : Called from the DMA interrupt, NULL for none
+ * @param  ctx         : Context passed to @a hook
+ * @return Nothing
+ * @note   The hook runs before the block is published to the reader, and
+ *         should be short: the next block is already filling.
+ */
+void AdcDma_SetHook(ADC_DMA_T *pAdc, ADC_DMA_HOOK_T hook, void *ctx);
+
+/**
+ * @brief  Apply a channel's calibration to a raw result
+ * @param  pAdc        : Acquisition state
+ * @param  chan        : Channel, 0 to 7
+ * @param  raw         : 10 bit result
+ * @return Calibrated value
+ */
+STATIC INLINE int32_t AdcDma_Calibrate(const ADC_DMA_T *pAdc, uint8_t chan, uint16_t raw)
+{
+   const ADC_DMA_CAL_T *cal = &pAdc->cal[chan];
+
+   return (int32_t) (((int64_t) ((int32_t) raw - cal->offset) * cal->gain) >> ADC_DMA_GAIN_SHIFT);
+}
+
+/**
+ * @brief  Return the last raw result of a channel
+ * @param  pAdc        : Acquisition state
+ * @param  chan        : Channel, 0 to 7
+ * @return 10 bit result, 0 until the first block completes
+ */
+STATIC INLINE uint16_t AdcDma_LatestRaw(const ADC_DMA_T *pAdc, uint8_t chan)
+{
+   return pAdc->latest[chan];
+}
+
+/**
+ * @brief  Return the last calibrated value of a channel
+ * @param  pAdc        : Acquisition state
+ * @param  chan        : Channel, 0 to 7
+ * @return Calibrated value, at most one block old
+ */
+STATIC INLINE int32_t AdcDma_Latest(const ADC_DMA_T *pAdc, uint8_t chan)
+{
+   return AdcDma_Calibrate(pAdc, chan, pAdc->latest[chan]);
+}
+
+/**
+ * @brief  Return the number of completed blocks not read yet
+ * @param  pAdc        : Acquisition state
+ * @return Blocks AdcDma_ReadBlock() can return, lapped ones included
+ */
+STATIC INLINE uint32_t AdcDma_BlocksReady(const ADC_DMA_T *pAdc)
+{
+   return pAdc->doneBlocks - pAdc->readBlocks;
+}
+
+/**
+ * @brief  Copy out the oldest completed block, calibrated
+ * @param  pAdc        : Acquisition state
+ * @param  out         : Destination, scans * channels values, scan by scan,
+ *                       channels in ascending order within a scan
+ * @return Scans copied, 0 when no block is ready or the DMA overwrote the
+ *         block while it was copied
+ * @note   Single reader. Blocks the reader was lapped on are skipped and
+ *         counted in dropped.
+ */
+uint32_t AdcDma_ReadBlock(ADC_DMA_T *pAdc, int32_t *out);
+
+/**
+ * @brief  Stop sampling and free the GPDMA channel
+ * @param  pAdc        : Acquisition state
+ * @return Nothing
+ */
+void AdcDma_Stop(ADC_DMA_T *pAdc);
+
+/**
+ * @brief  Return the acquisition statistics
+ * @param  pAdc        : Acquisition state
+ * @return Pointer to the running statistics
+ */
+STATIC INLINE const ADC_DMA_STATS_T *AdcDma_GetStats(const ADC_DMA_T *pAdc)
+{
+   return &pAdc->stats;
+}
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADC_DMA_H_ */
@@ -0,0 +1,117 @@
+/*
+ * @brief Boot phase timestamps
+ *
+ * The reset handler zeroes the DWT cycle counter before anything else,
+ * then Boot_Mark() stamps the end of each start-up phase: pin muxing and
+ * clock set up in SystemInit(), the copy of the .data banks and the clear
+ * of the .bss banks in the startup code, then main() up to outputs that
+ * hold the motors off, board set up and the control loop started. The
+ * stamps live in a NOINIT bank, so the startup code does not wipe the
+ * ones it took itself.
+ *
+ * The core runs from the 12 MHz IRC or crystal until the clock set up
+ * switches it to the PLL. Times up to BOOT_MARK_CLOCK are counted at
+ * 12 MHz, which overstates the last tens of microseconds of that phase,
+ * run faster: the times are an upper bound, as a boot budget should be.
+ *
+ * Boot_FormatLine() dumps them, one line per phase.
+ */
+
+#ifndef __BOOTTIME_H_
+#define __BOOTTIME_H_
+
+#include "lpc_types.h"
+#include "cycles.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup BOOTTIME APP: Boot phase timestamps
+ * @{
+ */
+
+/** Set to 0 to compile the stamps out */
+#ifndef BOOT_TIME_ENABLE
+#define BOOT_TIME_ENABLE        1
+#endif
+
+/** Longest line written by Boot_FormatLine(), including the line end */
+#define BOOT_LINE_MAX           40
+
+/**
+ * @brief Start-up phases, each stamped when it ends
+ */
+typedef enum {
+   BOOT_MARK_MUX = 0,          /*!< Board pin muxing */
+   BOOT_MARK_CLOCK,            /*!< Crystal, PLL and base clocks */
+   BOOT_MARK_DATA,             /*!< .data and .ramfunc banks copied */
+   BOOT_MARK_BSS,              /*!< .bss banks cleared */
+   BOOT_MARK_MAIN,             /*!< Entry to main() */
+   BOOT_MARK_SAFE,             /*!< Motor outputs held off */
+   BOOT_MARK_BOARD,            /*!< Board and time base set up */
+   BOOT_MARK_READY,            /*!< Control loop running */
+   BOOT_MARK_COUNT
+} BOOT_MARK_T;
+
+/** Lines produced by Boot_FormatLine() */
+#define BOOT_LINES              BOOT_MARK_COUNT
+
+#if BOOT_TIME_ENABLE && defined(CORE_M4)
+
+extern uint32_t bootStamps[BOOT_MARK_COUNT];
+
+/**
+ * @brief  Start counting cycles from 0
+ * @return Nothing
+ * @note   Called first thing by the reset handler.
+ */
+STATIC INLINE void Boot_Start(void)
+{
+   Cycles_Init();
+   DWT->CYCCNT = 0;
+}
+
+/**
+ * @brief  Stamp the end of a start-up phase
+ * @param  mark        : Phase that just ended
+ * @return Nothing
+ */
+STATIC INLINE void Boot_Mark(BOOT_MARK_T mark)
+{
+   bootStamps[mark] = DWT->CYCCNT;
+}
+
+#else
+
+STATIC INLINE void Boot_Start(void) {}
+STATIC INLINE void Boot_Mark(BOOT_MARK_T mark) {}
+
+#endif
+
+/**
+ * @brief  Return the time from reset to the end of a phase
+ * @param  mark        : Phase
+ * @return Microseconds, 0 when the stamps are compiled out
+ * @note   Needs SystemCoreClockUpdate().
+ */
+uint32_t Boot_GetUs(BOOT_MARK_T mark);
+
+/**
+ * @brief  Format the stamp of one phase as a text line
+ * @param  line        : 0 to BOOT_LINES - 1, a BOOT_MARK_T
+ * @param  buf         : Output, at least BOOT_LINE_MAX bytes
+ * @return Line length, 0 when the stamps are compiled out
+ * @note   The line is "BT:phase,cycles,us\r\n", both counted from reset.
+ */
+int Boot_FormatLine(uint32_t line, char *buf);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BOOTTIME_H_ */
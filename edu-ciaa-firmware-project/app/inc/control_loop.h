@@ -0,0 +1,141 @@
+/*
+ * @brief Fixed-rate control loop scheduler on the RI timer
+ *
+ * The RI timer interrupts at a base rate (1 kHz by default). Each control
+ * task runs at an integer divisor of that rate, for example a 1 kHz
+ * current loop and a 100 Hz velocity loop. Slower tasks with the same
+ * period are staggered across ticks so they do not all land on one tick.
+ *
+ * Scheduling is not preemptive. Every task due in a tick runs to
+ * completion inside the one RI timer interrupt, shortest period first, so
+ * the tightest loops see the least jitter, but a slow task is never
+ * interrupted by a faster one. To keep every deadline, each task declares
+ * its worst case execution time when it is registered, and the sum of all
+ * of them must fit in CTRL_LOOP_BUDGET_PCT percent of the base period.
+ *
+ * Every tick is timed with the DWT cycle counter. Stats record the tick
+ * to tick jitter, ticks whose tasks were still running when the next one
+ * fell due, and each task's execution and response time. A run longer
+ * than the declared execution time is counted against the task, and so is
+ * a response longer than the task's own period.
+ */
+
+#ifndef __CONTROL_LOOP_H_
+#define __CONTROL_LOOP_H_
+
+#include "chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup CONTROL_LOOP APP: Fixed-rate control loop scheduler
+ * @{
+ */
+
+/** Base tick rate in Hz */
+#ifndef CTRL_LOOP_BASE_HZ
+#define CTRL_LOOP_BASE_HZ       1000
+#endif
+
+/** Share of the base period that registered execution times may take, in percent */
+#ifndef CTRL_LOOP_BUDGET_PCT
+#define CTRL_LOOP_BUDGET_PCT    80
+#endif
+
+/** Maximum number of control tasks */
+#define CTRL_LOOP_MAX_TASKS     8
+
+/** RI timer interrupt priority, above the DMA and the link UART */
+#define CTRL_LOOP_IRQ_PRIO      1
+
+/**
+ * @brief Control task, called from the RI timer interrupt
+ * @param ctx      : Context given to CtrlLoop_AddTask()
+ */
+typedef void (*CTRL_TASK_FN_T)(void *ctx);
+
+/**
+ * @brief Per task statistics, times in core cycles
+ */
+typedef struct {
+   uint32_t runs;              /*!< Times the task ran */
+   uint32_t overBudget;        /*!< Runs longer than the declared execution time */
+   uint32_t overruns;          /*!< Runs that finished later than one period after the tick */
+   uint32_t lastCycles;        /*!< Execution time of the last run */
+   uint32_t maxCycles;         /*!< Longest execution time */
+   uint32_t maxResponse;       /*!< Longest time from tick entry to task end */
+} CTRL_TASK_STATS_T;
+
+/**
+ * @brief Scheduler statistics, times in core cycles
+ */
+typedef struct {
+   uint32_t ticks;             /*!< Base ticks handled */
+   uint32_t lateTicks;         /*!< Ticks that fell due while the previous one was still running */
+   int32_t jitterLast;         /*!< Last tick interval minus the nominal period */
+   int32_t jitterMin;          /*!< Smallest tick interval error */
+   int32_t jitterMax;          /*!< Largest tick interval error */
+   uint32_t maxTickCycles;     /*!< Longest time spent in one tick */
+} CTRL_LOOP_STATS_T;
+
+/**
+ * @brief  Initialize the RI timer for the control loop
+ * @param  baseHz      : Base tick rate in Hz
+ * @return Nothing
+ * @note   The timer does not run until CtrlLoop_Start() is called.
+ */
+void CtrlLoop_Init(uint32_t baseHz);
+
+/**
+ * @brief  Register a control task
+ * @param  fn          : Task function
+ * @param  ctx         : Opaque pointer passed to @a fn
+ * @param  rateHz      : Task rate, must divide the base rate
+ * @param  wcetUs      : Worst case execution time of @a fn in microseconds
+ * @return Task id, or -1 when the table is full, @a rateHz is invalid or
+ *         @a wcetUs does not fit in what is left of the tick budget
+ * @note   May be called while the loop is running.
+ */
+int CtrlLoop_AddTask(CTRL_TASK_FN_T fn, void *ctx, uint32_t rateHz, uint32_t wcetUs);
+
+/**
+ * @brief  Start ticking
+ * @return Nothing
+ */
+void CtrlLoop_Start(void);
+
+/**
+ * @brief  Stop ticking, registered tasks are kept
+ * @return Nothing
+ */
+void CtrlLoop_Stop(void);
+
+/**
+ * @brief  Return scheduler statistics
+ * @return Pointer to the statistics block
+ */
+const CTRL_LOOP_STATS_T *CtrlLoop_GetStats(void);
+
+/**
+ * @brief  Return statistics for one task
+ * @param  id          : Task id returned by CtrlLoop_AddTask()
+ * @return Pointer to the statistics block, NULL for an invalid id
+ */
+const CTRL_TASK_STATS_T *CtrlLoop_GetTaskStats(int id);
+
+/**
+ * @brief  Clear scheduler and task statistics
+ * @return Nothing
+ */
+void CtrlLoop_ResetStats(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CONTROL_LOOP_H_ */
@@ -0,0 +1,80 @@
+/*
+ * @brief Memory bank placement of code and data
+ *
+ * ciaa_lpc4337.ld gives each SRAM bank its own .data, .bss, .noinit and
+ * .ramfunc input sections, named after the bank as in LPCXpresso:
+ *
+ *   RAM   RamLoc32      0x10000000  main data, heap and stack (the default)
+ *   RAM2  RamLoc40      0x10080000  code copied to RAM, see __RAMFUNC()
+ *   RAM3  RamAHB32      0x20000000  reserved for the M0APP image (m0app.h)
+ *   RAM4  RamAHB16      0x20008000  DMA buffers and the inter-core mailboxes
+ *   RAM5  RamAHB_ETB16  0x2000C000  event trace ring (evtrace.h)
+ *
+ * The startup code copies every .data and .ramfunc bank from flash and
+ * clears every .bss bank before main(), through the section tables the
+ * linker script builds. .noinit banks are left alone.
+ *
+ * Code placed with __RAMFUNC() runs from zero wait state SRAM on the M4
+ * I-code bus: it never misses in the flash accelerator, so its timing does
+ * not depend on which flash lines the code run before it left behind. The
+ * RAM banks are out of branch range of the flash, so calls from flash go
+ * through a long call. What it calls in turn should be in RAM, or inline.
+ *
+ * Keeping DMA buffers in the AHB banks leaves the local banks, which hold
+ * the stack and the RAM code, to the core: the GPDMA and the M4 then use
+ * different AHB matrix slaves and do not stall each other.
+ *
+ * Host builds (tools/) get empty macros.
+ */
+
+#ifndef __CR_SECTION_MACROS_H_
+#define __CR_SECTION_MACROS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup SECTION_MACROS APP: Memory bank placement
+ * @{
+ */
+
+#if defined(__arm__)
+
+#define __SECTION(type, bank)   __attribute__ ((section("." #type ".$" #bank)))
+
+/** Initialized data in @a bank */
+#define __DATA(bank)            __SECTION(data, bank)
+
+/** Zeroed data in @a bank */
+#define __BSS(bank)             __SECTION(bss, bank)
+
+/** Data in @a bank that the startup code neither copies nor clears */
+#define __NOINIT(bank)          __SECTION(noinit, bank)
+
+/** Function copied to @a bank at startup and run from there */
+#define __RAMFUNC(bank)         __attribute__ ((long_call, noinline, section(".ramfunc.$" #bank)))
+
+#else
+
+#define __DATA(bank)
+#define __BSS(bank)
+#define __NOINIT(bank)
+#define __RAMFUNC(bank)
+
+#endif
+
+/** Function on the control path: ISRs, control tasks and what they call */
+#define __HOT_FUNC              __RAMFUNC(RAM2)
+
+/** Zeroed buffer or descriptor accessed by the GPDMA, word aligned */
+#define __DMA_BUF               __BSS(RAM4) __attribute__ ((aligned(4)))
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CR_SECTION_MACROS_H_ */
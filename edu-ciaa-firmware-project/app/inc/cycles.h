@@ -0,0 +1,60 @@
+/*
+ * @brief Cortex-M4 DWT cycle counter helpers
+ *
+ * Thin wrappers over DWT->CYCCNT used to time command handling and
+ * control code in CPU cycles. When built for the host (no CORE_M4) the
+ * counter reads as zero so modules using it stay host-compilable.
+ */
+
+#ifndef __CYCLES_H_
+#define __CYCLES_H_
+
+#include "lpc_types.h"
+
+#if defined(CORE_M4)
+#include "chip.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup CYCLES APP: DWT cycle counter
+ * @{
+ */
+
+/**
+ * @brief  Enable the DWT cycle counter
+ * @return Nothing
+ * @note   Safe to call more than once, the counter is not reset.
+ */
+STATIC INLINE void Cycles_Init(void)
+{
+#if defined(CORE_M4)
+   CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+   DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+/**
+ * @brief  Read the free running cycle counter
+ * @return Current core cycle count (wraps at 2^32)
+ */
+STATIC INLINE uint32_t Cycles_Now(void)
+{
+#if defined(CORE_M4)
+   return DWT->CYCCNT;
+#else
+   return 0;
+#endif
+}
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CYCLES_H_ */
@@ -0,0 +1,68 @@
+/*
+ * @brief GPDMA channel allocation and interrupt dispatch
+ *
+ * The GPDMA has a single interrupt for all eight channels. Drivers that
+ * use DMA allocate a channel here together with a completion handler and
+ * DMA_IRQHandler() routes terminal count and error interrupts to it.
+ */
+
+#ifndef __DMA_H_
+#define __DMA_H_
+
+#include "chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup DMA APP: GPDMA channel manager
+ * @{
+ */
+
+/** Returned by Dma_AllocChannel() when every channel is in use */
+#define DMA_CH_NONE         0xFF
+
+/** GPDMA interrupt priority */
+#define DMA_IRQ_PRIO        2
+
+/**
+ * @brief Channel interrupt handler
+ * @param ch       : Channel that interrupted
+ * @param error    : true on a DMA error, false on terminal count
+ * @param ctx      : Context given to Dma_AllocChannel()
+ */
+typedef void (*DMA_HANDLER_T)(uint8_t ch, bool error, void *ctx);
+
+/**
+ * @brief  Initialize the GPDMA controller and enable its interrupt
+ * @return Nothing
+ * @note   Only the first call has any effect, so every DMA user may call
+ *         it from its own init function.
+ */
+void Dma_Init(void);
+
+/**
+ * @brief  Allocate a channel and register its interrupt handler
+ * @param  conn        : Peripheral connection (GPDMA_CONN_*), used for bookkeeping only
+ * @param  handler     : Called from DMA_IRQHandler(), may be NULL
+ * @param  ctx         : Opaque pointer passed to @a handler
+ * @return Channel number, or DMA_CH_NONE if no channel is free
+ */
+uint8_t Dma_AllocChannel(uint32_t conn, DMA_HANDLER_T handler, void *ctx);
+
+/**
+ * @brief  Stop a channel and return it to the free pool
+ * @param  ch          : Channel number returned by Dma_AllocChannel()
+ * @return Nothing
+ */
+void Dma_FreeChannel(uint8_t ch);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DMA_H_ */
@@ -0,0 +1,96 @@
+/*
+ * @brief Closed-loop wheel speed and heading control
+ *
+ * A control loop task runs three float PIDs at DRIVE_RATE_HZ. Two wheel
+ * loops turn a speed setpoint into a motor command from the measured
+ * encoder velocity, with the open loop command as feed-forward. A heading
+ * loop compares the distance each wheel has travelled with the distance
+ * the setpoints asked for and trims the two wheel setpoints in opposite
+ * directions, so a straight run stays straight when one motor is weaker.
+ *
+ * Speeds use the link range, -255..255 for -DRIVE_MAX_RPS..DRIVE_MAX_RPS.
+ * With both setpoints at zero the task lets the wheels coast and clears
+ * the controllers.
+ */
+
+#ifndef __DRIVE_H_
+#define __DRIVE_H_
+
+#include "chip.h"
+#include "control_loop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup DRIVE APP: Wheel speed and heading control
+ * @{
+ */
+
+/** Control rate in Hz, must divide CTRL_LOOP_BASE_HZ */
+#ifndef DRIVE_RATE_HZ
+#define DRIVE_RATE_HZ           1000
+#endif
+
+/** Worst case time of one control step in microseconds, claimed from the control loop tick */
+#ifndef DRIVE_WCET_US
+#define DRIVE_WCET_US           50
+#endif
+
+/** Wheel speed for a setpoint of 255, in revolutions per second */
+#ifndef DRIVE_MAX_RPS
+#define DRIVE_MAX_RPS           3.0f
+#endif
+
+/* Wheel loop gains, motor command (-255..255) per rev/s of error */
+#define DRIVE_WHEEL_KP          40.0f
+#define DRIVE_WHEEL_KI          400.0f
+#define DRIVE_WHEEL_KD          0.0f
+#define DRIVE_WHEEL_KFF         (255.0f / DRIVE_MAX_RPS)
+
+/* Heading loop gains, rev/s of trim per revolution of wheel difference */
+#define DRIVE_HEADING_KP        4.0f
+#define DRIVE_HEADING_KI        1.0f
+#define DRIVE_HEADING_KD        0.05f
+#define DRIVE_HEADING_MAX_RPS   0.5f
+
+/** Derivative filter cut-off of all loops */
+#define DRIVE_D_FILTER_HZ       50.0f
+
+/**
+ * @brief  Set up the controllers and register the control task
+ * @return SUCCESS, or ERROR when the task cannot be registered
+ * @note   Call after Encoder_Init(), Motor_Init() and CtrlLoop_Init().
+ */
+Status Drive_Init(void);
+
+/**
+ * @brief  Set both wheel speed setpoints
+ * @param  left        : Left speed, -255..255
+ * @param  right       : Right speed, -255..255
+ * @return Nothing
+ * @note   Both setpoints are taken by the next control tick together.
+ */
+void Drive_SetSpeed(int16_t left, int16_t right);
+
+/**
+ * @brief  Set both setpoints to zero and let the wheels coast at once
+ * @return Nothing
+ */
+void Drive_Stop(void);
+
+/**
+ * @brief  Return the control task statistics
+ * @return Pointer to the statistics block, NULL before Drive_Init()
+ */
+const CTRL_TASK_STATS_T *Drive_GetTaskStats(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DRIVE_H_ */
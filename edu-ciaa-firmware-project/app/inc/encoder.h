@@ -0,0 +1,144 @@
+/*
+ * @brief Wheel encoders
+ *
+ * The left wheel uses the QEI block. Position is counted in hardware in
+ * 4x mode, and the QEI velocity timer captures the pulse count of each
+ * velocity period. Index, direction change and phase error interrupts
+ * are counted.
+ *
+ * The right wheel uses a timer capture input, because the chip has only
+ * one QEI. Phase A is routed through the GIMA to a timer capture channel
+ * that timestamps every rising edge. The capture interrupt reads phase B
+ * for the direction and turns the edge to edge period into a velocity,
+ * which resolves slow wheel speeds well. A match interrupt reports zero
+ * speed once no edge arrives for ENCODER_STALL_US.
+ *
+ * Velocities are in counts per second of each encoder's own decoding
+ * (4x for the QEI, 1x for the capture channel). Encoder_GetRPM() converts
+ * both to the same unit.
+ */
+
+#ifndef __ENCODER_H_
+#define __ENCODER_H_
+
+#include "chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup ENCODER APP: Wheel encoders
+ * @{
+ */
+
+/** Encoder lines (pulses per phase) per wheel revolution */
+#ifndef ENCODER_LINES
+#define ENCODER_LINES           360
+#endif
+
+/** QEI velocity measurement period in microseconds */
+#define ENCODER_VEL_PERIOD_US   10000
+
+/** Capture channel: report zero speed after this long without an edge */
+#define ENCODER_STALL_US        100000
+
+/** Encoder interrupt priority, below the control loop */
+#define ENCODER_IRQ_PRIO        2
+
+/* QEI pins: PA_3 PHA, PA_2 PHB, PA_1 IDX, all on function 1 */
+#define ENCODER_QEI_PORT        0xA
+#define ENCODER_QEI_PHA_PIN     3
+#define ENCODER_QEI_PHB_PIN     2
+#define ENCODER_QEI_IDX_PIN     1
+#define ENCODER_QEI_FUNC        SCU_MODE_FUNC1
+
+/* Capture channel: phase A on P5_0 (T1_CAP0), phase B read on P6_5 (GPIO3[4]) */
+#define ENCODER_CAP_TIMER       LPC_TIMER1
+#define ENCODER_CAP_IRQn        TIMER1_IRQn
+#define ENCODER_CAP_IRQHandler  TIMER1_IRQHandler
+#define ENCODER_CAP_TIMER_NUM   1
+#define ENCODER_CAP_CLK         CLK_MX_TIMER1
+#define ENCODER_CAP_CH          0
+#define ENCODER_CAP_GIMA_SEL    0
+#define ENCODER_CAP_A_PORT      0x5
+#define ENCODER_CAP_A_PIN       0
+#define ENCODER_CAP_A_FUNC      SCU_MODE_FUNC5
+#define ENCODER_CAP_B_PORT      0x6
+#define ENCODER_CAP_B_PIN       5
+#define ENCODER_CAP_B_FUNC      SCU_MODE_FUNC0
+#define ENCODER_CAP_B_GPIO_PORT 3
+#define ENCODER_CAP_B_GPIO_PIN  4
+
+/**
+ * @brief Encoder channels
+ */
+typedef enum {
+   ENCODER_LEFT = 0,           /*!< QEI */
+   ENCODER_RIGHT,              /*!< Timer capture */
+   ENCODER_COUNT
+} ENCODER_ID_T;
+
+/**
+ * @brief Encoder state snapshot
+ */
+typedef struct {
+   int32_t position;           /*!< Counts since the last reset */
+   int32_t velocity;           /*!< Counts per second, negative in reverse */
+   uint32_t countsPerRev;      /*!< Counts per revolution for this channel */
+   uint32_t indexCount;        /*!< Index pulses (QEI only) */
+   int32_t indexPosition;      /*!< Position latched at the last index pulse (QEI only) */
+   uint32_t dirChanges;        /*!< Direction reversals */
+   uint32_t errors;            /*!< Phase errors (QEI only) */
+} ENCODER_STATE_T;
+
+/**
+ * @brief  Configure both encoder channels and enable their interrupts
+ * @return Nothing
+ */
+void Encoder_Init(void);
+
+/**
+ * @brief  Take a consistent snapshot of one encoder
+ * @param  id          : Encoder channel
+ * @param  pState      : Filled with the current state
+ * @return Nothing
+ */
+void Encoder_Read(ENCODER_ID_T id, ENCODER_STATE_T *pState);
+
+/**
+ * @brief  Return the position of one encoder
+ * @param  id          : Encoder channel
+ * @return Counts since the last reset
+ */
+int32_t Encoder_GetPosition(ENCODER_ID_T id);
+
+/**
+ * @brief  Return the velocity of one encoder
+ * @param  id          : Encoder channel
+ * @return Counts per second, negative in reverse
+ */
+int32_t Encoder_GetVelocity(ENCODER_ID_T id);
+
+/**
+ * @brief  Return the wheel speed of one encoder
+ * @param  id          : Encoder channel
+ * @return Revolutions per minute, negative in reverse
+ */
+int32_t Encoder_GetRPM(ENCODER_ID_T id);
+
+/**
+ * @brief  Zero the position of one encoder
+ * @param  id          : Encoder channel
+ * @return Nothing
+ */
+void Encoder_ResetPosition(ENCODER_ID_T id);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ENCODER_H_ */
@@ -0,0 +1,194 @@
+/*
+ * @brief Post-mortem event trace
+ *
+ * EVTRACE(id, arg) appends a compact record (DWT cycle count, event,
+ * 16 bit argument and the active exception number) to a ring kept in the
+ * 16 KB RamAHB_ETB16 block. The ring lives in a NOLOAD section: the startup
+ * code neither copies nor clears it, so its contents survive a warm reset
+ * (reset button, watchdog, debugger reset) and are only lost on power off.
+ * A debugger that enables the Embedded Trace Buffer uses the same RAM.
+ *
+ * Recording stops, and the ring is kept, when the ring is frozen: on a
+ * motor abort, on a hard fault, on EvTrace_Freeze() and, unless
+ * EVTRACE_HOLD_ON_RESET is 0, when a valid ring is found at start-up.
+ * EvTrace_FormatLine() dumps the ring as text lines and EvTrace_Arm()
+ * clears it and starts recording again. tools/evtrace_decode.py turns a
+ * dump into a Chrome trace (chrome://tracing, ui.perfetto.dev).
+ *
+ * Events are listed once in EVTRACE_EVENTS(), the decoder reads that list
+ * from this file. Records may be written from any context, each one is
+ * written with interrupts masked for a few cycles.
+ */
+
+#ifndef __EVTRACE_H_
+#define __EVTRACE_H_
+
+#include "lpc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup EVTRACE APP: Post-mortem event trace
+ * @{
+ */
+
+/** Set to 0 to compile the trace points out */
+#ifndef EVTRACE_ENABLE
+#define EVTRACE_ENABLE          1
+#endif
+
+/** Set to 0 to keep a ring found at start-up only when it was frozen */
+#ifndef EVTRACE_HOLD_ON_RESET
+#define EVTRACE_HOLD_ON_RESET   1
+#endif
+
+/** Bytes taken in RamAHB_ETB16, header included */
+#ifndef EVTRACE_SIZE
+#define EVTRACE_SIZE            0x4000
+#endif
+
+/** Records dumped per text line */
+#define EVTRACE_PER_LINE        4
+
+/** Longest line written by EvTrace_FormatLine(), including the line end */
+#define EVTRACE_LINE_MAX        96
+
+/**
+ * Event list: X(identifier, "name", 'phase'), with the Chrome trace phase
+ * 'B' (begin), 'E' (end), 'i' (instant) or 'C' (counter, signed argument)
+ */
+#define EVTRACE_EVENTS(X)                         \
+   X(BOOT,            "boot",          'i')       \
+   X(ARM,             "arm",           'i')       \
+   X(HARD_FAULT,      "hard_fault",    'i')       \
+   X(HARD_FAULT_UFSR, "usage_fault",   'i')       \
+   X(MOTOR_ABORT,     "motor_abort",   'i')       \
+   X(CMD,             "cmd",           'i')       \
+   X(CTRL_LATE,       "ctrl_late",     'i')       \
+   X(DEEP_SLEEP,      "deep_sleep",    'i')       \
+   X(CTRL_BEGIN,      "ctrl_tick",     'B')       \
+   X(CTRL_END,        "ctrl_tick",     'E')       \
+   X(DRIVE_BEGIN,     "drive",         'B')       \
+   X(DRIVE_END,       "drive",         'E')       \
+   X(MOTOR_LEFT,      "motor_left",    'C')       \
+   X(MOTOR_RIGHT,     "motor_right",   'C')       \
+   X(LINK_IRQ_BEGIN,  "link_irq",      'B')       \
+   X(LINK_IRQ_END,    "link_irq",      'E')       \
+   X(DMA_IRQ_BEGIN,   "dma_irq",       'B')       \
+   X(DMA_IRQ_END,     "dma_irq",       'E')       \
+   X(QEI_IRQ_BEGIN,   "qei_irq",       'B')       \
+   X(QEI_IRQ_END,     "qei_irq",       'E')       \
+   X(ENC_CAP_BEGIN,   "enc_cap_irq",   'B')       \
+   X(ENC_CAP_END,     "enc_cap_irq",   'E')
+
+/**
+ * @brief Event identifiers
+ */
+typedef enum {
+#define EVTRACE_ENUM(id, name, ph) EVTRACE_ID_##id,
+   EVTRACE_EVENTS(EVTRACE_ENUM)
+#undef EVTRACE_ENUM
+   EVTRACE_COUNT
+} EVTRACE_ID_T;
+
+/**
+ * @brief One trace record
+ */
+typedef struct {
+   uint32_t cycles;            /*!< DWT cycle counter */
+   uint16_t arg;               /*!< Event argument */
+   uint8_t id;                 /*!< EVTRACE_ID_T */
+   uint8_t ctx;                /*!< Exception number from IPSR, 0 for thread mode */
+} EVTRACE_REC_T;
+
+/**
+ * @brief Ring header, at the start of the ring
+ */
+typedef struct {
+   uint32_t magic;             /*!< EVTRACE_MAGIC while the ring is valid */
+   uint32_t records;           /*!< Ring capacity */
+   uint32_t head;              /*!< Next slot written */
+   uint32_t total;             /*!< Records written since the ring was armed */
+   uint32_t boots;             /*!< Warm resets since power on */
+   uint32_t flags;             /*!< EVTRACE_FLAG_xxx */
+} EVTRACE_HDR_T;
+
+/** Header flag: recording stopped, the ring is kept */
+#define EVTRACE_FLAG_FROZEN     (1 << 0)
+
+/** Ring capacity */
+#define EVTRACE_RECORDS         ((EVTRACE_SIZE - sizeof(EVTRACE_HDR_T)) / sizeof(EVTRACE_REC_T))
+
+/** Lines produced by EvTrace_FormatLine(): a summary, then the records */
+#define EVTRACE_LINES           (1 + (EVTRACE_RECORDS + EVTRACE_PER_LINE - 1) / EVTRACE_PER_LINE)
+
+#if EVTRACE_ENABLE
+
+/** Record event @a id with argument @a arg */
+#define EVTRACE(id, arg)        EvTrace_Record(EVTRACE_ID_##id, (uint16_t) (arg))
+
+#else
+
+#define EVTRACE(id, arg)
+
+#endif
+
+/**
+ * @brief  Validate the ring left by the previous run and start recording
+ * @return Nothing
+ * @note   Call once, early. A ring that survived a reset is kept frozen
+ *         (see EVTRACE_HOLD_ON_RESET), otherwise recording starts with a
+ *         boot event whose argument is the warm reset count.
+ */
+void EvTrace_Init(void);
+
+/**
+ * @brief  Append one record
+ * @param  id          : Event
+ * @param  arg         : Event argument
+ * @return Nothing
+ * @note   Normally called through EVTRACE(). Dropped while frozen.
+ */
+void EvTrace_Record(EVTRACE_ID_T id, uint16_t arg);
+
+/**
+ * @brief  Stop recording and keep the ring, including across a warm reset
+ * @return Nothing
+ */
+void EvTrace_Freeze(void);
+
+/**
+ * @brief  Clear the ring and start recording
+ * @return Nothing
+ */
+void EvTrace_Arm(void);
+
+/**
+ * @brief  Return whether recording is stopped
+ * @return true when frozen or compiled out
+ */
+bool EvTrace_IsFrozen(void);
+
+/**
+ * @brief  Format one line of the ring, oldest records first
+ * @param  line        : 0 for the summary, 1 to EVTRACE_LINES - 1 for records
+ * @param  buf         : Output, at least EVTRACE_LINE_MAX bytes
+ * @return Line length, 0 past the last record
+ * @note   The summary is "TR:boots,clock_hz,total,records,flags\r\n", each
+ *         record line is "TR:n:rec,rec,...\r\n" where n counts records
+ *         from the oldest one and each record is 16 hex digits: cycles
+ *         (8), exception number (2), event (2), argument (4). Freeze the
+ *         ring first so the lines belong to the same snapshot.
+ */
+int EvTrace_FormatLine(uint32_t line, char *buf);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EVTRACE_H_ */
@@ -0,0 +1,297 @@
+/*
+ * @brief Interrupt driven I2C master with a transaction queue
+ *
+ * Device drivers queue register reads and writes on a bus, and the I2C
+ * interrupt runs them: the CPU only handles each byte's state change, it
+ * never waits on the bus. A transaction sends its register address and
+ * data, then reads after a repeated start. When another transaction is
+ * queued as one ends, it follows after a repeated start, not a stop and a
+ * start, so a batch of reads holds the bus until it is done.
+ *
+ * As a transaction ends its callback runs and its task (task_sched.h) gets
+ * the completion event, both from the interrupt, after the bus has moved
+ * on.
+ *
+ * Failures are counted by class. A transaction that fails, NAK, lost
+ * arbitration, bus error or timeout, is tried again up to its retries
+ * count, after a backoff doubling on each attempt; the bus waits for it,
+ * so a batch keeps its order. Every attempt has a time budget: a device
+ * that stretches SCL forever or holds SDA low never interrupts, so
+ * I2cBus_Service() catches the overrun, resets the controller and, on
+ * I2C1, whose pins have a GPIO function, clocks SCL by hand until the
+ * device lets go of SDA and sends a stop. The I2C0 pins are I2C only:
+ * there the controller reset is all the recovery there is. Callbacks of
+ * transactions that timed out run from I2cBus_Service().
+ *
+ * Periodic reads, an IMU at 400 Hz or a battery gauge at 1 Hz, are polls:
+ * I2cBus_PollRun() queues each poll whose period elapsed. Call it and
+ * I2cBus_Service() from a cooperative task (task_sched.h) or the main
+ * loop, waking at I2cBus_PollNext(), never from the control loop or
+ * another interrupt: the recovery busy-waits for about 100 us, which
+ * would hold up every control task behind it.
+ *
+ * I2C1 is on P2_3/P2_4, the same pins as USART3, the link UART by
+ * default (link.h). I2cBus_Init() refuses I2C1 while LINK_UART is
+ * USART3, use I2C0 or move the link to another UART.
+ *
+ * Transactions, polls and buffers are owned by the caller and must stay
+ * valid while queued.
+ */
+
+#ifndef __I2C_BUS_H_
+#define __I2C_BUS_H_
+
+#include "chip.h"
+#include "task_sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup I2C_BUS APP: Interrupt driven I2C master
+ * @{
+ */
+
+/** I2C interrupt priority, a late interrupt only stretches SCL */
+#ifndef I2C_BUS_IRQ_PRIO
+#define I2C_BUS_IRQ_PRIO        3
+#endif
+
+/** Default time budget of an attempt, in microseconds */
+#ifndef I2C_BUS_TIMEOUT_US
+#define I2C_BUS_TIMEOUT_US      1000
+#endif
+
+/** Wait before the first retry, doubled on each further one, in microseconds */
+#ifndef I2C_BUS_BACKOFF_US
+#define I2C_BUS_BACKOFF_US      100
+#endif
+
+/** Longest wait between retries, in microseconds */
+#ifndef I2C_BUS_BACKOFF_MAX_US
+#define I2C_BUS_BACKOFF_MAX_US  2000
+#endif
+
+/** SCL pulses tried to free SDA, a device stuck mid byte lets go within 9 */
+#define I2C_BUS_RECOVER_CLOCKS  9
+
+/** Standard, Fast and Fast-mode Plus (I2C0 only) rates */
+#define I2C_BUS_100K            100000
+#define I2C_BUS_400K            400000
+#define I2C_BUS_1M              1000000
+
+/**
+ * @brief Transaction status
+ */
+typedef enum {
+   I2C_BUS_QUEUED = 0,         /*!< Waiting for the bus */
+   I2C_BUS_BUSY,               /*!< Running */
+   I2C_BUS_DONE,               /*!< Completed */
+   I2C_BUS_NAK,                /*!< The device did not acknowledge its address or a byte */
+   I2C_BUS_ERROR,              /*!< Bus error or arbitration lost */
+   I2C_BUS_TIMEOUT,            /*!< The time budget ran out */
+} I2C_BUS_STATUS_T;
+
+typedef struct I2C_BUS_XFER I2C_BUS_XFER_T;
+
+/**
+ * @brief Transaction completion callback, called from the I2C interrupt
+ * @param pXfer    : Transaction that ended, status set
+ */
+typedef void (*I2C_BUS_CB_T)(I2C_BUS_XFER_T *pXfer);
+
+/**
+ * @brief Transaction, owned by the caller
+ */
+struct I2C_BUS_XFER {
+   I2C_BUS_XFER_T *next;       /*!< Next transaction of a submitted list, then the queue link, NULL once retired */
+   uint8_t addr;               /*!< 7 bit device address */
+   uint8_t regLen;             /*!< Register address bytes sent first, 0 to 2 */
+   uint16_t reg;               /*!< Register address, sent MSB first */
+   const uint8_t *tx;          /*!< Bytes written after the register address */
+   uint16_t txLen;             /*!< Bytes in tx */
+   uint16_t rxLen;             /*!< Bytes read after a repeated start, 0 for none */
+   uint8_t *rx;                /*!< Bytes read */
+   uint32_t timeoutUs;         /*!< Time budget of an attempt, 0 for I2C_BUS_TIMEOUT_US */
+   uint8_t retries;            /*!< Attempts after a failed one, 0 for none */
+   uint8_t attempts;           /*!< Attempts made, set by the driver */
+   volatile uint8_t status;    /*!< I2C_BUS_STATUS_T */
+   I2C_BUS_CB_T cb;            /*!< Completion callback, may be NULL */
+   void *ctx;                  /*!< Callback context */
+   SCHED_TASK_T *task;         /*!< Task posted on completion, may be NULL */
+   uint16_t sig;               /*!< Signal posted, the argument is the status */
+};
+
+/**
+ * @brief Periodic transaction
+ */
+typedef struct I2C_BUS_POLL {
+   struct I2C_BUS_POLL *next;  /*!< Poll list link */
+   I2C_BUS_XFER_T *xfer;       /*!< Transaction queued every period */
+   uint32_t periodUs;          /*!< Period in microseconds */
+   uint64_t due;               /*!< Systime_Now() value of the next run */
+   uint32_t overruns;          /*!< Periods skipped, the transaction was still queued */
+} I2C_BUS_POLL_T;
+
+/**
+ * @brief Bus statistics
+ */
+typedef struct {
+   uint32_t xfers;             /*!< Transactions completed */
+   uint32_t bytes;             /*!< Bytes written and read, address bytes excluded */
+   uint32_t restarts;          /*!< Transactions chained with a repeated start */
+   uint32_t addrNaks;          /*!< Attempts whose address was not acknowledged */
+   uint32_t dataNaks;          /*!< Attempts with a data byte not acknowledged */
+   uint32_t arbLost;           /*!< Attempts that lost arbitration */
+   uint32_t busErrors;         /*!< Attempts ended by a misplaced start or stop */
+   uint32_t timeouts;          /*!< Attempts past their time budget */
+   uint32_t retries;           /*!< Attempts made again after a failure */
+   uint32_t failed;            /*!< Transactions that failed with no retry left */
+   uint32_t recoveries;        /*!< Controller resets after a timeout */
+   uint32_t stuck;             /*!< Recoveries that left SDA or SCL low */
+   uint32_t rejected;          /*!< Submissions refused as invalid */
+} I2C_BUS_STATS_T;
+
+/**
+ * @brief Bus state
+ */
+typedef struct {
+   LPC_I2C_T *pI2C;            /*!< I2C0 or I2C1 */
+   I2C_ID_T id;                /*!< Controller id */
+   uint32_t rateHz;            /*!< SCL rate */
+   I2C_BUS_XFER_T *head;       /*!< Running transaction, then the queue */
+   I2C_BUS_XFER_T *tail;       /*!< Last queued transaction */
+   I2C_BUS_POLL_T *polls;      /*!< Periodic transactions */
+   uint16_t txPos;             /*!< Register and data bytes sent */
+   uint16_t rxPos;             /*!< Bytes read */
+   bool reading;               /*!< Past the repeated start of the read */
+   bool busy;                  /*!< A transaction runs, or waits for a retry */
+   bool held;                  /*!< The head waits for its retry or recovery */
+   uint64_t deadline;          /*!< Systime_Now() value ending the running attempt */
+   uint64_t retryAt;           /*!< Systime_Now() value of the next retry, while held */
+   I2C_BUS_STATS_T stats;      /*!< Running statistics */
+} I2C_BUS_T;
+
+/**
+ * @brief  Set up a bus with its pins and interrupt
+ * @param  pBus        : Bus state
+ * @param  id          : I2C0 or I2C1
+ * @param  rateHz      : SCL rate, up to I2C_BUS_400K, or I2C_BUS_1M on I2C0
+ * @return SUCCESS, or ERROR for a rate the bus does not support, or for
+ *         I2C1 while its pins carry the link UART
+ */
+Status I2cBus_Init(I2C_BUS_T *pBus, I2C_ID_T id, uint32_t rateHz);
+
+/**
+ * @brief  Queue a list of transactions
+ * @param  pBus        : Bus state
+ * @param  pXfer       : First transaction, the others linked through next, NULL terminated
+ * @return SUCCESS, or ERROR when a transaction of the list is invalid: nothing is queued then
+ * @note   The list runs in order after the transactions already queued.
+ *         Each transaction's attempt count is reset. Safe to call from interrupts and completion callbacks.
+ */
+Status I2cBus_Submit(I2C_BUS_T *pBus, I2C_BUS_XFER_T *pXfer);
+
+/**
+ * @brief  Fill in a register read
+ * @param  pXfer       : Transaction, the other fields are left alone
+ * @param  addr        : 7 bit device address
+ * @param  reg         : 8 bit register address
+ * @param  rx          : Destination
+ * @param  len         : Bytes to read
+ * @return Nothing
+ */
+STATIC INLINE void I2cBus_SetupRead(I2C_BUS_XFER_T *pXfer, uint8_t addr, uint8_t reg,
+                                    uint8_t *rx, uint16_t len)
+{
+   pXfer->addr = addr;
+   pXfer->regLen = 1;
+   pXfer->reg = reg;
+   pXfer->tx = NULL;
+   pXfer->txLen = 0;
+   pXfer->rx = rx;
+   pXfer->rxLen = len;
+}
+
+/**
+ * @brief  Fill in a register write
+ * @param  pXfer       : Transaction, the other fields are left alone
+ * @param  addr        : 7 bit device address
+ * @param  reg         : 8 bit register address
+ * @param  tx          : Bytes written from the register on
+ * @param  len         : Bytes to write
+ * @return Nothing
+ */
+STATIC INLINE void I2cBus_SetupWrite(I2C_BUS_XFER_T *pXfer, uint8_t addr, uint8_t reg,
+                                     const uint8_t *tx, uint16_t len)
+{
+   pXfer->addr = addr;
+   pXfer->regLen = 1;
+   pXfer->reg = reg;
+   pXfer->tx = tx;
+   pXfer->txLen = len;
+   pXfer->rx = NULL;
+   pXfer->rxLen = 0;
+}
+
+/**
+ * @brief  Return whether the bus has nothing running or queued
+ * @param  pBus        : Bus state
+ * @return true when idle
+ */
+bool I2cBus_IsIdle(I2C_BUS_T *pBus);
+
+/**
+ * @brief  Enforce time budgets and start retries whose backoff elapsed
+ * @param  pBus        : Bus state
+ * @param  nowUs       : Current Systime_Now()
+ * @return Nothing
+ * @note   Call it from a cooperative task or the main loop, at
+ *         I2cBus_PollNext() at the latest: timeouts are caught and retries
+ *         started only from here. It may spend about 100 us recovering a
+ *         stuck bus, with the bus interrupt masked but not the others, so
+ *         it must not run from an interrupt or a control loop task.
+ */
+void I2cBus_Service(I2C_BUS_T *pBus, uint64_t nowUs);
+
+/**
+ * @brief  Add a periodic transaction
+ * @param  pBus        : Bus state
+ * @param  pPoll       : Poll, owned by the caller
+ * @param  pXfer       : Transaction queued every period
+ * @param  periodUs    : Period in microseconds
+ * @param  nowUs       : Current Systime_Now(), the first run is one period later
+ * @return Nothing
+ * @note   Not to be called concurrently with I2cBus_PollRun().
+ */
+void I2cBus_PollAdd(I2C_BUS_T *pBus, I2C_BUS_POLL_T *pPoll, I2C_BUS_XFER_T *pXfer,
+                    uint32_t periodUs, uint64_t nowUs);
+
+/**
+ * @brief  Queue every poll whose period elapsed
+ * @param  pBus        : Bus state
+ * @param  nowUs       : Current Systime_Now()
+ * @return Nothing
+ * @note   A poll whose last transaction is still queued skips a period.
+ *         Runs that fell more than a period behind are dropped, not
+ *         queued in a burst.
+ */
+void I2cBus_PollRun(I2C_BUS_T *pBus, uint64_t nowUs);
+
+/**
+ * @brief  Return when I2cBus_PollRun() or I2cBus_Service() next has work
+ * @param  pBus        : Bus state
+ * @return Systime_Now() value of the earliest due poll, retry or time
+ *         budget end, SYSTIME_FOREVER for none
+ */
+uint64_t I2cBus_PollNext(I2C_BUS_T *pBus);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __I2C_BUS_H_ */
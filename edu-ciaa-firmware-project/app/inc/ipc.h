@@ -0,0 +1,166 @@
+/*
+ * @brief Inter-core mailboxes between the Cortex-M4 and the Cortex-M0APP
+ *
+ * Two lock-free SPSC rings (spsc_ring.h) of fixed size messages, one per
+ * direction, live in a NOLOAD section at the start of RamAHB16 that both
+ * images place at the same address (section .ipc_shared in the linker
+ * script). Neither core ever masks the other: each ring has one producer
+ * core and one consumer core, and the ring indexes are published with
+ * release stores.
+ *
+ * After writing a message the sender executes SEV. The TXEV line of each
+ * core is wired to an interrupt on the other one (M0APP_IRQn on the M4),
+ * whose handler calls the receive notify. Bulk senders leave
+ * IPC_TX_RESERVE slots free for replies, and a receiver that frees a slot
+ * of a ring that was that full signals back, so the sender's transmit
+ * notify can retry. Notifies may be coalesced, the receiver drains the ring.
+ *
+ * The same file builds for either core: CORE_M4 selects the M4 side,
+ * anything else the M0APP side.
+ */
+
+#ifndef __IPC_H_
+#define __IPC_H_
+
+#include "chip.h"
+#include "spsc_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup IPC APP: Inter-core mailboxes
+ * @{
+ */
+
+/** Messages per direction, power of 2 */
+#ifndef IPC_QUEUE_LEN
+#define IPC_QUEUE_LEN           16
+#endif
+
+/** Slots bulk senders leave free, see Ipc_TxFree() */
+#define IPC_TX_RESERVE          2
+
+/** Payload bytes in a message, a whole message takes 64 bytes */
+#define IPC_MSG_DATA_MAX        60
+
+/** Interrupt raised by the other core's SEV */
+#ifndef IPC_IRQn
+#if defined(CORE_M4)
+#define IPC_IRQn                M0APP_IRQn
+#define IPC_IRQHandler          M0APP_IRQHandler
+#else
+#define IPC_IRQn                M0_M4CORE_IRQn
+#define IPC_IRQHandler          M4_IRQHandler
+#endif
+#endif
+
+/** Value of IPC_SHARED_T.magic once the M4 has set the rings up */
+#define IPC_MAGIC               0x49504331UL
+
+/**
+ * @brief Message types
+ */
+typedef enum {
+   IPC_MSG_CMD = 0,            /*!< M0 to M4: command, arg is IPC_ARG(PROTO_CMD_ID_T, seq), data the int16_t params */
+   IPC_MSG_STATUS,             /*!< M4 to M0: result of a command, arg is IPC_ARG(PROTO_STATUS_T, seq of the command) */
+   IPC_MSG_TEXT,               /*!< M4 to M0: bytes to send on the link as they are */
+   IPC_MSG_TELEMETRY,          /*!< M4 to M0: telemetry record, data holds the int16_t values */
+} IPC_MSG_TYPE_T;
+
+/** Pack a command id or status with a command sequence number into arg */
+#define IPC_ARG(val, seq)       ((uint16_t) (((uint16_t) (seq) << 8) | ((val) & 0xFF)))
+
+/** Command id or status from an IPC_ARG() */
+#define IPC_ARG_VAL(arg)        ((uint8_t) ((arg) & 0xFF))
+
+/** Sequence number from an IPC_ARG() */
+#define IPC_ARG_SEQ(arg)        ((uint8_t) ((arg) >> 8))
+
+/**
+ * @brief Mailbox message
+ */
+typedef struct {
+   uint8_t type;               /*!< IPC_MSG_TYPE_T */
+   uint8_t len;                /*!< Bytes used in data */
+   uint16_t arg;               /*!< Type specific */
+   uint8_t data[IPC_MSG_DATA_MAX] __attribute__((aligned(4)));
+} IPC_MSG_T;
+
+/**
+ * @brief Shared block, at the same address in both images
+ */
+typedef struct {
+   volatile uint32_t magic;    /*!< IPC_MAGIC once the rings are set up */
+   volatile uint32_t m0Ready;  /*!< Set by the M0 when it serves its end */
+   SPSC_RING_T toM0;           /*!< Produced by the M4 */
+   SPSC_RING_T toM4;           /*!< Produced by the M0 */
+   IPC_MSG_T toM0Buf[IPC_QUEUE_LEN];
+   IPC_MSG_T toM4Buf[IPC_QUEUE_LEN];
+} IPC_SHARED_T;
+
+/**
+ * @brief  Set up this core's end of the mailboxes
+ * @return Nothing
+ * @note   The M4 clears the rings and must run it before starting the M0.
+ *         The M0 waits for them, then reports itself ready.
+ */
+void Ipc_Init(void);
+
+/**
+ * @brief  Return whether the other core serves its end
+ * @return true once both cores ran Ipc_Init()
+ */
+bool Ipc_PeerReady(void);
+
+/**
+ * @brief  Set the functions called from the inter-core interrupt
+ * @param  rxNotify    : Called when messages may be waiting, may be NULL
+ * @param  txNotify    : Called when room may have been freed, may be NULL
+ * @return Nothing
+ * @note   Both run from interrupt context, they should only post an event.
+ */
+void Ipc_SetNotify(void (*rxNotify)(void), void (*txNotify)(void));
+
+/**
+ * @brief  Send a message to the other core and signal it
+ * @param  type        : IPC_MSG_TYPE_T
+ * @param  arg         : Type specific argument
+ * @param  data        : Payload, may be NULL when @a len is 0
+ * @param  len         : Payload bytes, at most IPC_MSG_DATA_MAX
+ * @return true when queued, false when the mailbox is full
+ * @note   One producer per direction: callers on a core must not run concurrently.
+ */
+bool Ipc_Send(uint8_t type, uint16_t arg, const void *data, uint32_t len);
+
+/**
+ * @brief  Return the number of messages Ipc_Send() can queue now
+ * @return Free slots towards the other core
+ * @note   Bulk data should only be sent while more than IPC_TX_RESERVE
+ *         slots are free, the transmit notify runs when room comes back.
+ */
+uint32_t Ipc_TxFree(void);
+
+/**
+ * @brief  Take the oldest message from the other core
+ * @param  msg         : Destination
+ * @return true when a message was copied out, false when none is waiting
+ * @note   One consumer per direction: callers on a core must not run concurrently.
+ */
+bool Ipc_Recv(IPC_MSG_T *msg);
+
+/**
+ * @brief  Return whether messages from the other core are waiting
+ * @return true when Ipc_Recv() has work
+ */
+bool Ipc_RxPending(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IPC_H_ */
@@ -0,0 +1,109 @@
+/*
+ * @brief Interrupt occupancy tracer
+ *
+ * Opt-in, built only with IRQ_TRACE_ENABLE set to 1. IrqTrace_Init()
+ * copies the vector table to RAM, points VTOR at the copy, and replaces
+ * SysTick and every peripheral vector with one trampoline. The trampoline
+ * finds the vector number in IPSR, time stamps the entry with the DWT
+ * cycle counter, calls the original handler and time stamps the exit.
+ *
+ * Each vector has its own statistics entry, written only by that vector's
+ * trampoline (an interrupt never preempts itself), so no lock is needed on
+ * the write side. Readers copy an entry under its sequence counter and
+ * retry when an update slipped in. Cycles spent in interrupts that preempt
+ * a handler are charged to the preempting handler only, so per vector
+ * times add up to the total time spent in interrupts.
+ *
+ * IrqTrace_Snapshot() latches the change since the previous snapshot,
+ * IrqTrace_FormatLine() turns it into text lines with the CPU load of each
+ * vector. Snapshots must be taken less than 2^32 cycles apart (21 s at
+ * 204 MHz).
+ */
+
+#ifndef __IRQ_TRACE_H_
+#define __IRQ_TRACE_H_
+
+#include "lpc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup IRQ_TRACE APP: Interrupt occupancy tracer
+ * @{
+ */
+
+/** Set to 1 to build the tracer */
+#ifndef IRQ_TRACE_ENABLE
+#define IRQ_TRACE_ENABLE        0
+#endif
+
+/** Vector table entries, 16 core exceptions and 53 peripheral interrupts */
+#define IRQ_TRACE_VECTORS       (16 + 53)
+
+/** First traced vector, SysTick */
+#define IRQ_TRACE_FIRST         15
+
+/** Deepest interrupt nesting tracked, one more than the priority levels in use */
+#define IRQ_TRACE_MAX_DEPTH     9
+
+/** Lines produced by IrqTrace_FormatLine(): a summary, then one per vector */
+#define IRQ_TRACE_LINES         (1 + IRQ_TRACE_VECTORS - IRQ_TRACE_FIRST)
+
+/** Longest line written by IrqTrace_FormatLine(), including the line end */
+#define IRQ_TRACE_LINE_MAX      80
+
+/**
+ * @brief Per vector statistics, times in core cycles
+ */
+typedef struct {
+   uint32_t seq;               /*!< Odd while the entry is being updated */
+   uint32_t count;             /*!< Times the handler ran */
+   uint32_t cycles;            /*!< Cycles spent in the handler itself (wraps) */
+   uint32_t maxCycles;         /*!< Longest single run, nested interrupts excluded */
+   uint32_t preempts;          /*!< Runs that preempted another handler */
+   uint8_t maxDepth;           /*!< Deepest nesting level seen, 1 when nothing was preempted */
+} IRQ_TRACE_STATS_T;
+
+/**
+ * @brief  Move the vector table to RAM and route every traced vector through the trampoline
+ * @return Nothing
+ * @note   Call after all handlers are linked in, before enabling interrupts
+ *         that must be traced. Does nothing without IRQ_TRACE_ENABLE.
+ */
+void IrqTrace_Init(void);
+
+/**
+ * @brief  Copy the statistics of one vector
+ * @param  vector      : Exception number, IRQn + 16
+ * @param  pStats      : Filled with a consistent copy
+ * @return Nothing
+ */
+void IrqTrace_Read(uint32_t vector, IRQ_TRACE_STATS_T *pStats);
+
+/**
+ * @brief  Latch the change of every vector since the previous snapshot
+ * @return Cycles covered by the snapshot
+ */
+uint32_t IrqTrace_Snapshot(void);
+
+/**
+ * @brief  Format one line of the last snapshot
+ * @param  line        : 0 for the summary, 1 to IRQ_TRACE_LINES - 1 for vectors
+ * @param  buf         : Output, at least IRQ_TRACE_LINE_MAX bytes
+ * @return Line length, 0 for a vector that did not run in the snapshot
+ * @note   The summary is "IQ:window,cycles,load\r\n", each vector line is
+ *         "IQ:irq,count,load,max,depth,preempts\r\n" with load in parts
+ *         per million of the window and irq -1 for SysTick.
+ */
+int IrqTrace_FormatLine(uint32_t line, char *buf);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IRQ_TRACE_H_ */
@@ -0,0 +1,171 @@
+/*
+ * @brief Serial command link to the ESP32
+ *
+ * Owns the link UART, its receive/transmit ring buffers and the protocol
+ * parser. Received bytes are streamed into a circular buffer by the GPDMA
+ * (uart_dma.h), or queued by the UART interrupt when LINK_USE_DMA is 0,
+ * and decoded in place from Link_Poll(). Responses and telemetry are sent
+ * the same way, as whole DMA buffers. The link speaks either the ASCII S..E protocol
+ * (protocol.h) or the binary COBS/CRC framing (proto_bin.h), selected
+ * once at startup. Both feed the same command handler table.
+ */
+
+#ifndef __LINK_H_
+#define __LINK_H_
+
+#include "chip.h"
+#include "protocol.h"
+#include "proto_bin.h"
+#include "uart_dma.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup LINK APP: ESP32 serial link
+ * @{
+ */
+
+/** UART connected to the ESP32 */
+#ifndef LINK_UART
+#define LINK_UART           LPC_USART3
+#define LINK_IRQn           USART3_IRQn
+#define LINK_IRQHandler     UART3_IRQHandler
+#define LINK_RX_DMA_CONN    GPDMA_CONN_UART3_Rx
+#define LINK_TX_DMA_CONN    GPDMA_CONN_UART3_Tx
+#endif
+
+/** Move data through the GPDMA instead of per-character UART interrupts */
+#ifndef LINK_USE_DMA
+#define LINK_USE_DMA        1
+#endif
+
+/** Link baud rate, must match the ESP32 side */
+#ifndef LINK_BAUDRATE
+#define LINK_BAUDRATE       115200
+#endif
+
+/**
+ * @brief Link framing modes
+ */
+typedef enum {
+   LINK_MODE_ASCII = 0,        /*!< S<CMD>:<PARAMS>E text frames */
+   LINK_MODE_BINARY,           /*!< COBS frames with CRC-16 and sequence numbers */
+} LINK_MODE_T;
+
+/** Framing used when the application does not pick one */
+#ifndef LINK_DEFAULT_MODE
+#define LINK_DEFAULT_MODE   LINK_MODE_ASCII
+#endif
+
+/**
+ * @brief Binary mode link statistics
+ */
+typedef struct {
+   uint32_t crcErrors;         /*!< Frames NAKed for a bad CRC */
+   uint32_t framingErrors;     /*!< Malformed or oversized frames */
+   uint32_t duplicates;        /*!< Repeated sequence numbers, re-acknowledged only */
+   uint32_t lost;              /*!< Commands missing from the sequence */
+   uint32_t resyncs;           /*!< Sequence numbers that went backwards, sender restarted */
+} LINK_BIN_STATS_T;
+
+/** Receive buffer size in bytes, must be a power of 2 */
+#define LINK_RX_RB_SIZE     256
+
+/** Transmit buffer size in bytes, must be a power of 2 */
+#define LINK_TX_RB_SIZE     256
+
+/**
+ * @brief  Initialize the link UART and command parser
+ * @param  mode        : Framing used on the link
+ * @param  handlers    : Command handler table, PROTO_CMD_COUNT entries
+ * @param  ctx         : Opaque pointer passed to every handler
+ * @return Nothing
+ */
+void Link_Init(LINK_MODE_T mode, const PROTO_HANDLER_T *handlers, void *ctx);
+
+/**
+ * @brief  Decode pending bytes, dispatch commands and send responses
+ * @return Number of frames completed during this call
+ */
+int Link_Poll(void);
+
+/**
+ * @brief  Return whether received bytes are waiting for Link_Poll()
+ * @return true when Link_Poll() has work
+ * @note   Safe with interrupts masked, for the check before sleeping.
+ */
+bool Link_RxPending(void);
+
+/**
+ * @brief  Set the functions called when the link has work
+ * @param  rxNotify    : Called when received bytes are waiting for Link_Poll(), may be NULL
+ * @param  txNotify    : Called when transmit space was freed, may be NULL
+ * @return Nothing
+ * @note   Both run from interrupt context, they should only post an event.
+ *         Calls may be spurious or coalesced, check Link_RxPending() or retry the send.
+ */
+void Link_SetNotify(void (*rxNotify)(void), void (*txNotify)(void));
+
+/**
+ * @brief  Queue bytes for transmission on the link (non-blocking)
+ * @param  data        : Bytes to send
+ * @param  bytes       : Number of bytes
+ * @return Number of bytes queued. With LINK_USE_DMA the buffer is queued
+ *         whole or not at all and 0 means the transmit queue is full,
+ *         otherwise it may be less than @a bytes when the ring buffer fills.
+ */
+int Link_Send(const void *data, int bytes);
+
+/**
+ * @brief  Queue a NUL terminated string for transmission
+ * @param  str         : String to send
+ * @return Number of bytes queued
+ */
+int Link_SendStr(const char *str);
+
+/**
+ * @brief  Send a telemetry record in the current framing
+ * @param  values      : Values to report
+ * @param  count       : Number of values, at most PROTO_BIN_MAX_PAYLOAD / 2
+ * @return Number of bytes queued
+ * @note   ASCII mode sends "TM:v0,v1,...\r\n", binary mode a
+ *         PROTO_BIN_MSG_TM frame.
+ */
+int Link_SendTelemetry(const int16_t *values, int count);
+
+/**
+ * @brief  Return parser statistics for the link
+ * @return Pointer to the statistics block
+ */
+const PROTO_STATS_T *Link_GetStats(void);
+
+/**
+ * @brief  Return binary framing statistics
+ * @return Pointer to the statistics block
+ */
+const LINK_BIN_STATS_T *Link_GetBinStats(void);
+
+#if LINK_USE_DMA
+/**
+ * @brief  Return DMA receive statistics (overruns, idle flushes)
+ * @return Pointer to the statistics block
+ */
+const UART_DMA_RX_STATS_T *Link_GetRxStats(void);
+
+/**
+ * @brief  Return DMA transmit statistics (queue depth, rejected writes)
+ * @return Pointer to the statistics block
+ */
+const UART_DMA_TX_STATS_T *Link_GetTxStats(void);
+#endif
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LINK_H_ */
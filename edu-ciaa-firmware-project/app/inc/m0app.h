@@ -0,0 +1,69 @@
+/*
+ * @brief Cortex-M0APP coprocessor boot
+ *
+ * The M0APP image is built and flashed on its own, at the start of flash
+ * bank B, linked to run from RamAHB32: the M4 image leaves both alone.
+ * M0App_Boot() holds the M0 in reset, checks the image's vector table,
+ * copies it to RamAHB32, maps it at the M0's address 0 and releases the
+ * reset, then waits for the M0 to report through the mailboxes (ipc.h)
+ * that it took over its end. Code runs from RAM with no flash wait states
+ * there, and the M0 never competes with the M4 for flash bank A.
+ */
+
+#ifndef __M0APP_H_
+#define __M0APP_H_
+
+#include "lpc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup M0APP APP: Cortex-M0APP coprocessor boot
+ * @{
+ */
+
+/** Image as flashed, start of flash bank B */
+#ifndef M0APP_IMAGE_FLASH
+#define M0APP_IMAGE_FLASH       0x1B000000UL
+#endif
+
+/** Image as run, RamAHB32, 4 KB aligned as M0APPMEMMAP requires */
+#ifndef M0APP_IMAGE_RAM
+#define M0APP_IMAGE_RAM         0x20000000UL
+#endif
+
+/** Bytes copied, code, data and stack of the M0 all fit in RamAHB32 */
+#ifndef M0APP_IMAGE_SIZE
+#define M0APP_IMAGE_SIZE        0x8000UL
+#endif
+
+/** How long the M0 gets to report ready, in microseconds */
+#ifndef M0APP_BOOT_TIMEOUT_US
+#define M0APP_BOOT_TIMEOUT_US   100000
+#endif
+
+/**
+ * @brief  Load and start the M0APP image, set up the mailboxes
+ * @return true when the M0 runs and serves the mailboxes, false when no
+ *         valid image was found or it never reported ready. The M0 is
+ *         left in reset on failure.
+ * @note   Needs Systime_Init() for the timeout.
+ */
+bool M0App_Boot(void);
+
+/**
+ * @brief  Hold the M0APP in reset
+ * @return Nothing
+ */
+void M0App_Stop(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __M0APP_H_ */
@@ -0,0 +1,52 @@
+/*
+ * @brief Flash versus SRAM execution benchmark
+ *
+ * Runs the same kernel, a fixed point biquad cascade over a short block of
+ * samples, once linked in flash and once copied to RamLoc40 with
+ * __HOT_FUNC (cr_section_macros.h), and records both in the exec_flash and
+ * exec_ram probes (prof.h). Before every run other flash code is run to
+ * throw the kernel out of the flash accelerator line buffers, the way an
+ * interrupt finds them after the main loop ran: exec_flash then shows the
+ * wait states a cold ISR pays, exec_ram what it costs from SRAM. Results
+ * come out with the PF dump.
+ */
+
+#ifndef __MEMBENCH_H_
+#define __MEMBENCH_H_
+
+#include "lpc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup MEMBENCH APP: Flash versus SRAM execution benchmark
+ * @{
+ */
+
+/** Runs of each variant */
+#ifndef MEMBENCH_RUNS
+#define MEMBENCH_RUNS           64
+#endif
+
+/** Samples filtered per run */
+#define MEMBENCH_BLOCK          32
+
+/**
+ * @brief  Time the kernel from flash and from SRAM
+ * @return Nothing
+ * @note   Needs Prof_Init(). Runs with interrupts enabled: start it before
+ *         the control loop so that nothing preempts the runs. Does nothing
+ *         when PROF_ENABLE is 0.
+ */
+void MemBench_Run(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MEMBENCH_H_ */
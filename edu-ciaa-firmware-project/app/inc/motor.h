@@ -0,0 +1,250 @@
+/*
+ * @brief Dual H-bridge (L298N) motor driver
+ *
+ * Each wheel uses one SCT PWM output on the bridge enable input (ENA/ENB)
+ * and two GPIOs on the direction inputs (IN1/IN2, IN3/IN4). Speeds are
+ * signed, -255..255. The sign selects the direction and the magnitude
+ * selects the duty cycle.
+ *
+ * Motor_Init() computes a table of match values for every magnitude, so
+ * Motor_Set() needs only a clamp and a table lookup. Both duty cycles are
+ * written to the match reload registers with reloading held off, then the
+ * reload is released. The SCT copies both values at the same period limit,
+ * so the two wheels always change on the same PWM edge and a wheel never
+ * runs one period with a half written value.
+ *
+ * The direction GPIOs change immediately. A reversal therefore runs the
+ * old duty cycle in the new direction for at most one PWM period.
+ *
+ * The enable PWM can come from the SCT (MOTOR_BACKEND_SCT) or from the
+ * motor control PWM (MOTOR_BACKEND_MCPWM), which leaves the SCT free for
+ * other jobs. The MCPWM backend runs both wheels in AC mode, so they share
+ * the channel 0 counter and period, and holds the match transfer while it
+ * writes both values. It can run center aligned, which lowers current
+ * ripple and EMI at the same switching rate, insert dead time on the
+ * complementary MCOB outputs, and it watches the MCABORT input: a low level
+ * forces the outputs passive in hardware, the interrupt lets both wheels
+ * coast, and the motors stay off until Motor_ClearAbort().
+ *
+ * Motor_Trip() is the software counterpart for either backend, used by the
+ * current limit: both wheels coast and Motor_Set() keeps them at zero
+ * until Motor_ClearTrip().
+ *
+ * Either backend can also give the ADCs a start edge once per PWM period,
+ * at a set point of it, on an internal output that needs no pin: CTOUT_15
+ * from the SCT, MCOA2 from the MCPWM. ADCs started with MOTOR_ADC_START and
+ * MOTOR_ADC_EDGE then sample in step with the switching (motor_current.h).
+ */
+
+#ifndef __MOTOR_H_
+#define __MOTOR_H_
+
+#include "chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup MOTOR APP: Dual H-bridge motor driver
+ * @{
+ */
+
+/** Default PWM frequency in Hz */
+#ifndef MOTOR_PWM_HZ
+#define MOTOR_PWM_HZ            20000
+#endif
+
+/** Highest PWM frequency accepted by Motor_Init() */
+#define MOTOR_PWM_MAX_HZ        20000
+
+/** Largest speed magnitude */
+#define MOTOR_SPEED_MAX         255
+
+/** PWM backends */
+#define MOTOR_BACKEND_SCT       0
+#define MOTOR_BACKEND_MCPWM     1
+
+/** PWM backend used for the enable inputs */
+#ifndef MOTOR_BACKEND
+#define MOTOR_BACKEND           MOTOR_BACKEND_SCT
+#endif
+
+#if MOTOR_BACKEND == MOTOR_BACKEND_MCPWM
+
+/** MCPWM: 1 for center aligned, 0 for edge aligned PWM */
+#ifndef MOTOR_MCPWM_CENTER
+#define MOTOR_MCPWM_CENTER      1
+#endif
+
+/** MCPWM: dead time between MCOA and MCOB in nanoseconds, 0 disables it */
+#ifndef MOTOR_MCPWM_DEADTIME_NS
+#define MOTOR_MCPWM_DEADTIME_NS 0
+#endif
+
+/** MCPWM abort interrupt priority, above everything else */
+#define MOTOR_IRQ_PRIO          0
+
+/* MCPWM outputs: ENA on P4_0 (MCOA0), ENB on P5_5 (MCOA1), MCABORT on P9_0 */
+#define MOTOR_ENA_PORT          0x4
+#define MOTOR_ENA_PIN           0
+#define MOTOR_ENA_FUNC          SCU_MODE_FUNC1
+#define MOTOR_ENB_PORT          0x5
+#define MOTOR_ENB_PIN           5
+#define MOTOR_ENB_FUNC          SCU_MODE_FUNC1
+#define MOTOR_ABORT_PORT        0x9
+#define MOTOR_ABORT_PIN         0
+#define MOTOR_ABORT_FUNC        SCU_MODE_FUNC1
+
+/* ADC start: MCOA2 rises as the shared counter passes the channel 2 match */
+#define MOTOR_ADC_START         ADC_START_ON_MCOA2
+#define MOTOR_ADC_EDGE          ADC_TRIGGERMODE_RISING
+
+#else
+
+/* SCT outputs: ENA on P4_1 (CTOUT_1, T_FIL1), ENB on P4_2 (CTOUT_0, T_FIL2) */
+#define MOTOR_ENA_PORT          0x4
+#define MOTOR_ENA_PIN           1
+#define MOTOR_ENA_FUNC          SCU_MODE_FUNC1
+#define MOTOR_ENA_CTOUT         1
+#define MOTOR_ENB_PORT          0x4
+#define MOTOR_ENB_PIN           2
+#define MOTOR_ENB_FUNC          SCU_MODE_FUNC1
+#define MOTOR_ENB_CTOUT         0
+
+/* ADC start: CTOUT_15 is set at the period limit and falls at its match */
+#define MOTOR_ADC_START         ADC_START_ON_CTOUT15
+#define MOTOR_ADC_EDGE          ADC_TRIGGERMODE_FALLING
+
+#endif /* MOTOR_BACKEND */
+
+/* Direction inputs: IN1 on P6_7 (GPIO5[15]), IN2 on P6_8 (GPIO5[16]),
+   IN3 on P6_9 (GPIO3[5]), IN4 on P6_10 (GPIO3[6]) */
+#define MOTOR_IN1_PORT          0x6
+#define MOTOR_IN1_PIN           7
+#define MOTOR_IN1_FUNC          SCU_MODE_FUNC4
+#define MOTOR_IN1_GPIO_PORT     5
+#define MOTOR_IN1_GPIO_PIN      15
+#define MOTOR_IN2_PORT          0x6
+#define MOTOR_IN2_PIN           8
+#define MOTOR_IN2_FUNC          SCU_MODE_FUNC4
+#define MOTOR_IN2_GPIO_PORT     5
+#define MOTOR_IN2_GPIO_PIN      16
+#define MOTOR_IN3_PORT          0x6
+#define MOTOR_IN3_PIN           9
+#define MOTOR_IN3_FUNC          SCU_MODE_FUNC0
+#define MOTOR_IN3_GPIO_PORT     3
+#define MOTOR_IN3_GPIO_PIN      5
+#define MOTOR_IN4_PORT          0x6
+#define MOTOR_IN4_PIN           10
+#define MOTOR_IN4_FUNC          SCU_MODE_FUNC0
+#define MOTOR_IN4_GPIO_PORT     3
+#define MOTOR_IN4_GPIO_PIN      6
+
+/**
+ * @brief  Hold both bridges off, before anything else is set up
+ * @return Nothing
+ * @note   The pins come out of reset pulled up, which enables the bridges:
+ *         call it first thing in main(). Only touches the motor pins and
+ *         the GPIO clock, Motor_Init() takes the pins over.
+ */
+void Motor_Safe(void);
+
+/**
+ * @brief  Configure the PWM and the direction pins, motors stopped
+ * @param  freqHz      : PWM frequency, 1 to MOTOR_PWM_MAX_HZ
+ * @return SUCCESS, or ERROR for an out of range frequency
+ * @note   May be called again to change the frequency.
+ */
+Status Motor_Init(uint32_t freqHz);
+
+/**
+ * @brief  Set both wheel speeds on the same PWM edge
+ * @param  left        : Left speed, -255..255, clamped
+ * @param  right       : Right speed, -255..255, clamped
+ * @return Nothing
+ * @note   Safe to call from an interrupt.
+ */
+void Motor_Set(int32_t left, int32_t right);
+
+/**
+ * @brief  Let both wheels coast
+ * @return Nothing
+ */
+void Motor_Stop(void);
+
+/**
+ * @brief  Let both wheels coast and hold them off
+ * @return Nothing
+ * @note   Until Motor_ClearTrip(), Motor_Set() drives both wheels at zero
+ *         with the direction inputs low and Motor_Brake() does nothing.
+ *         Safe to call from an interrupt.
+ */
+void Motor_Trip(void);
+
+/**
+ * @brief  Release the hold of Motor_Trip(), both wheels still coasting
+ * @return Nothing
+ */
+void Motor_ClearTrip(void);
+
+/**
+ * @brief  Return whether Motor_Trip() holds the motors off
+ * @return true until Motor_ClearTrip()
+ */
+bool Motor_IsTripped(void);
+
+/**
+ * @brief  Short both motors through the bridge to brake them
+ * @return Nothing
+ */
+void Motor_Brake(void);
+
+/**
+ * @brief  Give the ADCs a start edge once per PWM period
+ * @param  permille    : Point of the period the edge falls on, 1 to 999,
+ *                       0 to turn the trigger off
+ * @return Nothing
+ * @note   Takes effect at the next Motor_Init(). The point counts from the
+ *         period limit reload for the SCT and edge aligned MCPWM. Center
+ *         aligned, the edge comes on the way up: the pulses are centered
+ *         on the counter top, which a value close to 1000 samples.
+ */
+void Motor_SetAdcTrigger(uint32_t permille);
+
+/**
+ * @brief  Return the PWM period in timer ticks
+ * @return Ticks per PWM period
+ */
+uint32_t Motor_GetTicksPerCycle(void);
+
+#if MOTOR_BACKEND == MOTOR_BACKEND_MCPWM
+
+/**
+ * @brief  Return whether the MCABORT input shut the motors off
+ * @return true until Motor_ClearAbort() succeeds
+ */
+bool Motor_IsAborted(void);
+
+/**
+ * @brief  Re-enable the motors after an abort, both wheels coasting
+ * @return SUCCESS, or ERROR while the MCABORT input is still asserted
+ */
+Status Motor_ClearAbort(void);
+
+/**
+ * @brief  Return the number of aborts since Motor_Init()
+ * @return Abort count
+ */
+uint32_t Motor_GetAbortCount(void);
+
+#endif
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MOTOR_H_ */
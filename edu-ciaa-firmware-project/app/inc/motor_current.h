@@ -0,0 +1,177 @@
+/*
+ * @brief Motor current sampling in step with the PWM
+ *
+ * The L298N sense outputs of both bridges, through their shunts, go to
+ * CH1 and CH2. ADC0 samples the left shunt and ADC1 the right one, both
+ * started by the same PWM edge (Motor_SetAdcTrigger()), so each PWM period
+ * gives one sample per wheel taken at the same point of the switching
+ * cycle, away from the switching edges. The GPDMA moves the samples into
+ * ping-pong blocks of MOTOR_CUR_BLOCK periods (adc_dma.h): the CPU only
+ * runs once per block.
+ *
+ * Each block yields the wheel's mean and peak current, what current mode
+ * control and stall detection need. The 10-bit ADCs have no comparators,
+ * so limits are checked on every block from the DMA interrupt instead:
+ *   - trip: a sample at or above the trip level stops both motors and
+ *     holds them off (Motor_Trip()) until MotorCur_ClearTrip().
+ *   - stall: a mean at or above the stall level for MOTOR_CUR_STALL_BLOCKS
+ *     blocks in a row, cleared once the mean falls below 7/8 of it.
+ * Either posts an event to the task set with MotorCur_SetTask(). Levels
+ * are in raw counts, 0 turns a check off.
+ *
+ * The raw sample blocks stay readable with AdcDma_ReadBlock() on
+ * MotorCur_GetAdc().
+ */
+
+#ifndef __MOTOR_CURRENT_H_
+#define __MOTOR_CURRENT_H_
+
+#include "chip.h"
+#include "adc_dma.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup MOTOR_CURRENT APP: Motor current sampling
+ * @{
+ */
+
+/** ADC0 channel of the left shunt, CH1 on the EDU-CIAA */
+#ifndef MOTOR_CUR_LEFT_CHAN
+#define MOTOR_CUR_LEFT_CHAN     1
+#endif
+
+/** ADC1 channel of the right shunt, CH2 on the EDU-CIAA */
+#ifndef MOTOR_CUR_RIGHT_CHAN
+#define MOTOR_CUR_RIGHT_CHAN    2
+#endif
+
+/** Sample point in thousandths of the PWM period, see Motor_SetAdcTrigger() */
+#ifndef MOTOR_CUR_TRIGGER_PERMILLE
+#define MOTOR_CUR_TRIGGER_PERMILLE 500
+#endif
+
+/** PWM periods per block, 1 ms at the default 20 kHz */
+#ifndef MOTOR_CUR_BLOCK
+#define MOTOR_CUR_BLOCK         20
+#endif
+
+/** Blocks in a row over the stall level before a stall is reported */
+#ifndef MOTOR_CUR_STALL_BLOCKS
+#define MOTOR_CUR_STALL_BLOCKS  50
+#endif
+
+/**
+ * @brief Wheels
+ */
+typedef enum {
+   MOTOR_CUR_LEFT = 0,
+   MOTOR_CUR_RIGHT,
+   MOTOR_CUR_WHEELS,
+} MOTOR_CUR_WHEEL_T;
+
+/**
+ * @brief Events, posted with the wheel in the high byte of the argument
+ */
+typedef enum {
+   MOTOR_CUR_EVT_TRIP = 0,     /*!< A sample reached the trip level, the motors were stopped */
+   MOTOR_CUR_EVT_STALL,        /*!< The mean stayed over the stall level */
+   MOTOR_CUR_EVT_STALL_CLEAR,  /*!< The mean fell back under the stall level */
+} MOTOR_CUR_EVT_T;
+
+/**
+ * @brief Per wheel statistics
+ */
+typedef struct {
+   uint32_t blocks;            /*!< Blocks checked */
+   uint32_t trips;             /*!< Trips */
+   uint32_t stalls;            /*!< Stalls reported */
+   uint16_t maxPeak;           /*!< Highest sample seen */
+} MOTOR_CUR_STATS_T;
+
+/**
+ * @brief  Start sampling both shunts
+ * @return SUCCESS, or ERROR when no GPDMA channel is free
+ * @note   Sets the PWM trigger: call it before Motor_Init(), which starts
+ *         the PWM, and therefore the sampling.
+ */
+Status MotorCur_Init(void);
+
+/**
+ * @brief  Set the limits of a wheel
+ * @param  wheel       : Wheel
+ * @param  stallLevel  : Block mean reported as a stall, raw counts, 0 for none
+ * @param  tripLevel   : Sample that stops the motors, raw counts, 0 for none
+ * @return Nothing
+ */
+void MotorCur_SetLimits(MOTOR_CUR_WHEEL_T wheel, uint16_t stallLevel, uint16_t tripLevel);
+
+/**
+ * @brief  Post limit events to a task
+ * @param  task        : Task, NULL for none
+ * @param  sig         : Signal, the argument is (wheel << 8) | MOTOR_CUR_EVT_T
+ * @return Nothing
+ */
+void MotorCur_SetTask(SCHED_TASK_T *task, uint16_t sig);
+
+/**
+ * @brief  Return the mean current of the last block
+ * @param  wheel       : Wheel
+ * @return Raw counts, at most one block old
+ */
+uint16_t MotorCur_Mean(MOTOR_CUR_WHEEL_T wheel);
+
+/**
+ * @brief  Return the highest sample of the last block
+ * @param  wheel       : Wheel
+ * @return Raw counts
+ */
+uint16_t MotorCur_Peak(MOTOR_CUR_WHEEL_T wheel);
+
+/**
+ * @brief  Return whether a wheel is stalled
+ * @param  wheel       : Wheel
+ * @return true from the stall event to its clear event
+ */
+bool MotorCur_IsStalled(MOTOR_CUR_WHEEL_T wheel);
+
+/**
+ * @brief  Return whether a wheel tripped
+ * @param  wheel       : Wheel
+ * @return true until MotorCur_ClearTrip()
+ */
+bool MotorCur_IsTripped(MOTOR_CUR_WHEEL_T wheel);
+
+/**
+ * @brief  Re-arm the trip of a wheel
+ * @param  wheel       : Wheel
+ * @return Nothing
+ * @note   The motors are released once no wheel is tripped any more, and
+ *         stay coasting until the next Motor_Set().
+ */
+void MotorCur_ClearTrip(MOTOR_CUR_WHEEL_T wheel);
+
+/**
+ * @brief  Return the acquisition of a wheel, for its raw blocks and statistics
+ * @param  wheel       : Wheel
+ * @return Acquisition state
+ */
+ADC_DMA_T *MotorCur_GetAdc(MOTOR_CUR_WHEEL_T wheel);
+
+/**
+ * @brief  Return the statistics of a wheel
+ * @param  wheel       : Wheel
+ * @return Pointer to the running statistics
+ */
+const MOTOR_CUR_STATS_T *MotorCur_GetStats(MOTOR_CUR_WHEEL_T wheel);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MOTOR_CURRENT_H_ */
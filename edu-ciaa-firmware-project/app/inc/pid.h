@@ -0,0 +1,152 @@
+/*
+ * @brief PID controller with feed-forward, float and Q15 versions
+ *
+ * output = kp * e + integral(ki * e) + kd * d(-measured)/dt + kff * setpoint
+ *
+ * The derivative acts on the measurement rather than the error, so
+ * setpoint steps do not kick the output, and it passes through a first
+ * order low-pass filter. The integrator is clamped to the output range
+ * and stops integrating while the output is saturated in the direction of
+ * the error (conditional integration anti-windup). The output is clamped
+ * to [outMin, outMax].
+ *
+ * Both versions take the same PID_CFG_T, with gains in output units per
+ * input unit and seconds. The float version (PID_F32_T) runs on the FPU.
+ * The Q15 version (PID_Q15_T) takes and returns int16 values. Its gains
+ * are stored as Q15 fractions times a shared power of two, its integral
+ * and derivative terms are 32-bit, and kp * e + kff * setpoint is one dual
+ * 16-bit multiply-accumulate (SMLAD). Saturating adds keep the 32-bit sums
+ * from wrapping.
+ *
+ * Host-compilable, it only depends on lpc_types.h. Without CORE_M4 the
+ * DSP intrinsics are replaced by plain C.
+ */
+
+#ifndef __PID_H_
+#define __PID_H_
+
+#include "lpc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup PID APP: PID controller
+ * @{
+ */
+
+/** Largest gain magnitude the Q15 version accepts, after scaling by the rate */
+#define PID_Q15_MAX_GAIN        8192.0f
+
+/**
+ * @brief PID configuration, shared by both versions
+ */
+typedef struct {
+   float kp;                   /*!< Proportional gain */
+   float ki;                   /*!< Integral gain, per second */
+   float kd;                   /*!< Derivative gain, seconds */
+   float kff;                  /*!< Setpoint feed-forward gain */
+   float dFilterHz;            /*!< Derivative low-pass cut-off, 0 for no filter */
+   float outMin;               /*!< Lowest output */
+   float outMax;               /*!< Highest output */
+   float rateHz;               /*!< Update rate */
+} PID_CFG_T;
+
+/**
+ * @brief Float PID state
+ */
+typedef struct {
+   float kp;                   /*!< Proportional gain */
+   float ki;                   /*!< Integral gain per update */
+   float kd;                   /*!< Derivative gain times the rate */
+   float kff;                  /*!< Feed-forward gain */
+   float alpha;                /*!< Derivative filter coefficient */
+   float outMin;               /*!< Lowest output */
+   float outMax;               /*!< Highest output */
+   float integ;                /*!< Integral term */
+   float dFilt;                /*!< Filtered derivative term */
+   float prevMeas;             /*!< Previous measurement */
+   bool primed;                /*!< prevMeas is valid */
+} PID_F32_T;
+
+/**
+ * @brief Q15 PID state
+ *
+ * Terms are kept in output units times 2^(15 - shift).
+ */
+typedef struct {
+   uint32_t gainsPF;           /*!< kp (low half) and kff (high half), packed for SMLAD */
+   int16_t ki;                 /*!< Integral gain per update */
+   int16_t kd;                 /*!< Derivative gain times the rate */
+   int16_t alpha;              /*!< Derivative filter coefficient, Q15 */
+   uint8_t shift;              /*!< Gain scale, gains are Q15 times 2^shift */
+   int16_t outMin;             /*!< Lowest output */
+   int16_t outMax;             /*!< Highest output */
+   int32_t integMin;           /*!< outMin in term units */
+   int32_t integMax;           /*!< outMax in term units */
+   int32_t integ;              /*!< Integral term */
+   int32_t dFilt;              /*!< Filtered derivative term */
+   int16_t prevMeas;           /*!< Previous measurement */
+   bool primed;                /*!< prevMeas is valid */
+} PID_Q15_T;
+
+/**
+ * @brief  Set up a float PID from its configuration
+ * @param  pPid        : PID state
+ * @param  pCfg        : Configuration
+ * @return SUCCESS, or ERROR for a zero rate or an empty output range
+ * @note   Also resets the state.
+ */
+Status Pid_F32_Init(PID_F32_T *pPid, const PID_CFG_T *pCfg);
+
+/**
+ * @brief  Clear the integrator and the derivative history
+ * @param  pPid        : PID state
+ * @return Nothing
+ */
+void Pid_F32_Reset(PID_F32_T *pPid);
+
+/**
+ * @brief  Run one update
+ * @param  pPid        : PID state
+ * @param  setpoint    : Desired value
+ * @param  measured    : Measured value
+ * @return Controller output, within [outMin, outMax]
+ */
+float Pid_F32_Update(PID_F32_T *pPid, float setpoint, float measured);
+
+/**
+ * @brief  Set up a Q15 PID from its configuration
+ * @param  pPid        : PID state
+ * @param  pCfg        : Configuration, outMin and outMax must fit in int16_t
+ * @return SUCCESS, or ERROR for a zero rate, an invalid output range, or a
+ *         gain (ki / rate, kd * rate included) above PID_Q15_MAX_GAIN
+ * @note   Also resets the state. Uses float, call it outside the control path.
+ */
+Status Pid_Q15_Init(PID_Q15_T *pPid, const PID_CFG_T *pCfg);
+
+/**
+ * @brief  Clear the integrator and the derivative history
+ * @param  pPid        : PID state
+ * @return Nothing
+ */
+void Pid_Q15_Reset(PID_Q15_T *pPid);
+
+/**
+ * @brief  Run one update
+ * @param  pPid        : PID state
+ * @param  setpoint    : Desired value
+ * @param  measured    : Measured value
+ * @return Controller output, within [outMin, outMax]
+ */
+int16_t Pid_Q15_Update(PID_Q15_T *pPid, int16_t setpoint, int16_t measured);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PID_H_ */
@@ -0,0 +1,147 @@
+/*
+ * @brief Cycle counter profiling probes
+ *
+ * PROF_BEGIN(name) and PROF_END(name) bracket a piece of code in one
+ * block and record its duration in core cycles from the DWT cycle counter
+ * (4.9 ns per cycle at 204 MHz, no hardware timer used). Each probe keeps
+ * a count, min, max and sum, and a histogram with one bin per power of
+ * two: bin n counts durations from 2^(n-1) to 2^n - 1 cycles, the last
+ * bin also takes everything longer. The cost of reading the counter
+ * twice is measured by Prof_Init() and subtracted.
+ *
+ * Probes are listed once in PROF_PROBES(). Building with PROF_ENABLE set
+ * to 0 turns both macros into nothing and drops the tables.
+ *
+ * A probe must only be recorded from one execution context (main loop or
+ * one interrupt priority), the statistics are not updated atomically.
+ */
+
+#ifndef __PROF_H_
+#define __PROF_H_
+
+#include "lpc_types.h"
+#include "cycles.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup PROF APP: Cycle counter profiling
+ * @{
+ */
+
+/** Set to 0 to compile the probes out */
+#ifndef PROF_ENABLE
+#define PROF_ENABLE             1
+#endif
+
+/** Histogram bins, the last one holds durations of 2^(PROF_HIST_BINS - 2) cycles and up */
+#define PROF_HIST_BINS          20
+
+/** Longest line written by Prof_FormatLine(), including the line end */
+#define PROF_LINE_MAX           128
+
+/**
+ * Probe list: X(identifier, "name")
+ */
+#define PROF_PROBES(X)                     \
+   X(LINK_POLL,   "link_poll")             \
+   X(LINK_IRQ,    "link_irq")              \
+   X(DMA_IRQ,     "dma_irq")               \
+   X(QEI_IRQ,     "qei_irq")               \
+   X(ENC_CAP_IRQ, "enc_cap_irq")           \
+   X(DRIVE,       "drive")                 \
+   X(EXEC_FLASH,  "exec_flash")            \
+   X(EXEC_RAM,    "exec_ram")
+
+/**
+ * @brief Probe identifiers
+ */
+typedef enum {
+#define PROF_ENUM(id, name) PROF_ID_##id,
+   PROF_PROBES(PROF_ENUM)
+#undef PROF_ENUM
+   PROF_COUNT
+} PROF_ID_T;
+
+/**
+ * @brief Per probe statistics, in core cycles
+ */
+typedef struct {
+   uint32_t count;             /*!< Recorded durations */
+   uint32_t min;               /*!< Shortest duration */
+   uint32_t max;               /*!< Longest duration */
+   uint64_t sum;               /*!< Sum of all durations */
+   uint32_t hist[PROF_HIST_BINS]; /*!< Log2 histogram */
+} PROF_STATS_T;
+
+#if PROF_ENABLE
+
+/** Start timing probe @a id, in the same block as the matching PROF_END() */
+#define PROF_BEGIN(id)          uint32_t profStart_##id = Cycles_Now()
+
+/** Stop timing probe @a id and record the duration */
+#define PROF_END(id)            Prof_Record(PROF_ID_##id, Cycles_Now() - profStart_##id)
+
+#else
+
+#define PROF_BEGIN(id)
+#define PROF_END(id)
+
+#endif
+
+/**
+ * @brief  Start the cycle counter, measure the probe overhead and clear all probes
+ * @return Nothing
+ */
+void Prof_Init(void);
+
+/**
+ * @brief  Clear all probes
+ * @return Nothing
+ */
+void Prof_Reset(void);
+
+/**
+ * @brief  Add one duration to a probe
+ * @param  id          : Probe
+ * @param  cycles      : Duration in core cycles, probe overhead included
+ * @return Nothing
+ * @note   Normally called through PROF_END().
+ */
+void Prof_Record(PROF_ID_T id, uint32_t cycles);
+
+/**
+ * @brief  Return the statistics of a probe
+ * @param  id          : Probe
+ * @return Pointer to the statistics, NULL when profiling is compiled out
+ */
+const PROF_STATS_T *Prof_Get(PROF_ID_T id);
+
+/**
+ * @brief  Return the name of a probe
+ * @param  id          : Probe
+ * @return Name from PROF_PROBES()
+ */
+const char *Prof_GetName(PROF_ID_T id);
+
+/**
+ * @brief  Format the statistics of a probe as one text line
+ * @param  id          : Probe
+ * @param  buf         : Output, at least PROF_LINE_MAX bytes
+ * @return Line length, 0 when profiling is compiled out
+ * @note   The line is "PF:name,count,min,mean,max,first:bin,bin,...\r\n",
+ *         where first is the index of the first non-empty histogram bin
+ *         and the bins run up to the last non-empty one.
+ */
+int Prof_FormatLine(PROF_ID_T id, char *buf);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PROF_H_ */
@@ -0,0 +1,162 @@
+/*
+ * @brief Binary framing for the ESP32 link (COBS + CRC-16)
+ *
+ * Raw frame, before COBS encoding:
+ *
+ *   | seq (1) | type (1) | payload (0..PROTO_BIN_MAX_PAYLOAD) | crc16 (2, LE) |
+ *
+ * The CRC is CRC-16/CCITT-FALSE over seq, type and payload. The raw frame
+ * is COBS encoded and terminated with a single 0x00 delimiter, so a
+ * receiver resynchronizes on the next zero after any corruption. All
+ * multi-byte payload fields are little endian.
+ *
+ * This file and proto_bin.c only depend on lpc_types.h and build
+ * unchanged on the host, where they serve as the ESP32/PC side codec.
+ */
+
+#ifndef __PROTO_BIN_H_
+#define __PROTO_BIN_H_
+
+#include "lpc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup PROTO_BIN APP: Binary link framing
+ * @{
+ */
+
+/** Largest payload carried by a single frame */
+#define PROTO_BIN_MAX_PAYLOAD   16
+
+/** Raw frame size: seq, type, payload and CRC */
+#define PROTO_BIN_MAX_RAW       (2 + PROTO_BIN_MAX_PAYLOAD + 2)
+
+/** Worst case encoded size: COBS overhead plus delimiter */
+#define PROTO_BIN_MAX_ENCODED   (PROTO_BIN_MAX_RAW + 2)
+
+/**
+ * @brief Message types
+ */
+typedef enum {
+   PROTO_BIN_MSG_MV  = 0x01,  /*!< int16 left, int16 right */
+   PROTO_BIN_MSG_ST  = 0x02,  /*!< No payload */
+   PROTO_BIN_MSG_GT  = 0x03,  /*!< No payload */
+   PROTO_BIN_MSG_ACK = 0x80,  /*!< Command with this seq executed */
+   PROTO_BIN_MSG_NAK = 0x81,  /*!< uint8 reason, see PROTO_BIN_NAK_T */
+   PROTO_BIN_MSG_TM  = 0x83,  /*!< Telemetry, list of int16 values */
+} PROTO_BIN_MSG_T;
+
+/**
+ * @brief NAK reasons
+ */
+typedef enum {
+   PROTO_BIN_NAK_CRC = 1,     /*!< CRC mismatch, seq may be unreliable */
+   PROTO_BIN_NAK_CMD,         /*!< Unknown message type */
+   PROTO_BIN_NAK_PARAMS,      /*!< Bad payload length or value */
+} PROTO_BIN_NAK_T;
+
+/**
+ * @brief Decoded frame, payload points into the decoder buffer
+ */
+typedef struct {
+   uint8_t seq;               /*!< Sequence number */
+   uint8_t type;              /*!< Message type, PROTO_BIN_MSG_T */
+   uint8_t len;               /*!< Payload length */
+   const uint8_t *payload;    /*!< Payload, valid until the next decoded byte */
+} PROTO_BIN_FRAME_T;
+
+/**
+ * @brief Decode result
+ */
+typedef enum {
+   PROTO_BIN_NONE = 0,        /*!< Frame not complete yet */
+   PROTO_BIN_FRAME,           /*!< Valid frame available */
+   PROTO_BIN_ERR_CRC,         /*!< Complete frame with a bad CRC */
+   PROTO_BIN_ERR_FRAME,       /*!< Malformed COBS data or oversized frame */
+} PROTO_BIN_RES_T;
+
+/**
+ * @brief Streaming decoder state
+ */
+typedef struct {
+   uint8_t buf[PROTO_BIN_MAX_RAW];  /*!< Decoded raw frame */
+   uint8_t len;               /*!< Bytes decoded so far */
+   uint8_t code;              /*!< Bytes left in the current COBS block */
+   bool zeroPending;          /*!< Previous block ended with an implied zero */
+   bool discard;              /*!< Frame is bad, skip until delimiter */
+} PROTO_BIN_RX_T;
+
+/**
+ * @brief  Compute CRC-16/CCITT-FALSE
+ * @param  crc         : Initial value, 0xFFFF for a new computation
+ * @param  data        : Data to process
+ * @param  len         : Number of bytes
+ * @return Updated CRC
+ */
+uint16_t ProtoBin_CRC16(uint16_t crc, const void *data, int len);
+
+/**
+ * @brief  Build and COBS encode a frame
+ * @param  seq         : Sequence number
+ * @param  type        : Message type
+ * @param  payload     : Payload bytes, may be NULL when @a len is 0
+ * @param  len         : Payload length, at most PROTO_BIN_MAX_PAYLOAD
+ * @param  out         : Output buffer, PROTO_BIN_MAX_ENCODED bytes is always enough
+ * @param  outSize     : Size of @a out
+ * @return Encoded length including the 0x00 delimiter, 0 on error
+ */
+int ProtoBin_Encode(uint8_t seq, uint8_t type, const void *payload, int len,
+                   uint8_t *out, int outSize);
+
+/**
+ * @brief  Reset a streaming decoder
+ * @param  pRx         : Decoder state
+ * @return Nothing
+ */
+void ProtoBin_RxInit(PROTO_BIN_RX_T *pRx);
+
+/**
+ * @brief  Feed one received byte to the decoder
+ * @param  pRx         : Decoder state
+ * @param  ch          : Received byte
+ * @param  pFrame      : Filled in when PROTO_BIN_FRAME is returned. For
+ *                       PROTO_BIN_ERR_CRC only seq and type are set.
+ * @return Decode result
+ * @note   COBS is undone on the fly into the decoder buffer, the CRC is
+ *         checked when the delimiter arrives.
+ */
+PROTO_BIN_RES_T ProtoBin_DecodeByte(PROTO_BIN_RX_T *pRx, uint8_t ch, PROTO_BIN_FRAME_T *pFrame);
+
+/**
+ * @brief  Read a little endian int16 from a payload
+ * @param  p           : Pointer to the first byte
+ * @return Decoded value
+ */
+STATIC INLINE int16_t ProtoBin_GetI16(const uint8_t *p)
+{
+   return (int16_t) (p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief  Write a little endian int16 into a payload
+ * @param  p           : Pointer to the first byte
+ * @param  v           : Value to store
+ * @return Nothing
+ */
+STATIC INLINE void ProtoBin_PutI16(uint8_t *p, int16_t v)
+{
+   p[0] = (uint8_t) v;
+   p[1] = (uint8_t) ((uint16_t) v >> 8);
+}
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PROTO_BIN_H_ */
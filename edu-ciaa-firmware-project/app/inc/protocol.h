@@ -0,0 +1,179 @@
+/*
+ * @brief ESP32 command protocol parser (S<CMD>:<PARAMS>E framing)
+ *
+ * Frames are decoded one byte at a time by a state machine. Parameters
+ * are accumulated as they arrive, so no frame buffer, sscanf/strtol or
+ * heap is involved. Completed frames are handed to a per-command
+ * handler table as a typed PROTO_CMD_T.
+ */
+
+#ifndef __PROTOCOL_H_
+#define __PROTOCOL_H_
+
+#include "lpc_types.h"
+#include "ring_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup PROTOCOL APP: ESP32 command protocol
+ * @{
+ */
+
+/** Frame start character */
+#define PROTO_CHAR_START     'S'
+/** Frame end character */
+#define PROTO_CHAR_END       'E'
+/** Command / parameter separator */
+#define PROTO_CHAR_SEP       ':'
+/** Parameter list separator */
+#define PROTO_CHAR_PARAM_SEP ','
+
+/** Maximum number of parameters in a single command */
+#define PROTO_MAX_PARAMS     4
+
+/** Longest accepted frame, longer frames are dropped as corrupted */
+#define PROTO_MAX_FRAME_LEN  32
+
+/**
+ * @brief Command identifiers, indexes into the handler table
+ */
+typedef enum {
+   PROTO_CMD_MV = 0,       /*!< Move: left,right speed in -255..255 */
+   PROTO_CMD_ST,           /*!< Stop both motors */
+   PROTO_CMD_GT,           /*!< Get telemetry */
+   PROTO_CMD_PF,           /*!< Dump profiling probes */
+   PROTO_CMD_IQ,           /*!< Dump interrupt load */
+   PROTO_CMD_TR,           /*!< Freeze and dump the event trace */
+   PROTO_CMD_TA,           /*!< Clear the event trace and record again */
+   PROTO_CMD_BT,           /*!< Dump the boot phase times */
+   PROTO_CMD_COUNT
+} PROTO_CMD_ID_T;
+
+/**
+ * @brief Decoded command
+ */
+typedef struct {
+   PROTO_CMD_ID_T id;                  /*!< Command identifier */
+   uint8_t nparams;                    /*!< Number of valid entries in params */
+   int16_t params[PROTO_MAX_PARAMS];   /*!< Parameters, already range checked */
+} PROTO_CMD_T;
+
+/**
+ * @brief Result of feeding bytes to the parser
+ */
+typedef enum {
+   PROTO_STATUS_NONE = 0,      /*!< No frame completed yet */
+   PROTO_STATUS_OK,            /*!< Frame decoded and handler succeeded */
+   PROTO_STATUS_ERR_CMD,       /*!< Unknown command (ERR:INVALID_COMMAND) */
+   PROTO_STATUS_ERR_PARAMS,    /*!< Bad parameters (ERR:INVALID_PARAMS) */
+} PROTO_STATUS_T;
+
+/**
+ * @brief Command handler, returns PROTO_STATUS_OK or an error status
+ */
+typedef PROTO_STATUS_T (*PROTO_HANDLER_T)(const PROTO_CMD_T *cmd, void *ctx);
+
+/**
+ * @brief Parser statistics
+ */
+typedef struct {
+   uint32_t frames;            /*!< Frames dispatched successfully */
+   uint32_t cmdErrors;         /*!< Frames with an unknown command */
+   uint32_t paramErrors;       /*!< Frames with invalid parameters */
+   uint32_t dropped;           /*!< Corrupted/truncated frames discarded */
+   uint32_t lastCycles;        /*!< Cycles from end of frame to handler return */
+   uint32_t maxCycles;         /*!< Worst case of lastCycles */
+} PROTO_STATS_T;
+
+/**
+ * @brief Parser state, one per input stream
+ */
+typedef struct {
+   uint8_t state;              /*!< Internal state machine state */
+   uint8_t len;                /*!< Bytes consumed in the current frame */
+   uint8_t cmdIdx;             /*!< Matched command, PROTO_CMD_COUNT if unknown */
+   bool neg;                   /*!< Current parameter is negative */
+   bool badParams;             /*!< Parameter error seen, report at frame end */
+   uint8_t ndigits;            /*!< Digits in the current parameter */
+   char code0;                 /*!< First command letter */
+   int32_t acc;                /*!< Current parameter accumulator */
+   PROTO_CMD_T cmd;            /*!< Command being decoded */
+   const PROTO_HANDLER_T *handlers; /*!< Handler table, PROTO_CMD_COUNT entries */
+   void *ctx;                  /*!< Context passed to handlers */
+   PROTO_STATS_T stats;        /*!< Running statistics */
+} PROTO_PARSER_T;
+
+/**
+ * @brief  Initialize a parser
+ * @param  pParser     : Pointer to parser state
+ * @param  handlers    : Handler table with PROTO_CMD_COUNT entries, NULL entries are allowed
+ * @param  ctx         : Opaque pointer passed to every handler
+ * @return Nothing
+ */
+void Proto_Init(PROTO_PARSER_T *pParser, const PROTO_HANDLER_T *handlers, void *ctx);
+
+/**
+ * @brief  Reset the parser to wait for a new frame
+ * @param  pParser     : Pointer to parser state
+ * @return Nothing
+ * @note   Statistics are preserved.
+ */
+void Proto_Reset(PROTO_PARSER_T *pParser);
+
+/**
+ * @brief  Feed a single byte to the parser
+ * @param  pParser     : Pointer to parser state
+ * @param  ch          : Received byte
+ * @return PROTO_STATUS_NONE while a frame is incomplete or was silently
+ *         dropped, otherwise the status of the completed frame
+ * @note   The matching handler is called from inside this function when
+ *         a valid frame terminator is received.
+ */
+PROTO_STATUS_T Proto_ParseByte(PROTO_PARSER_T *pParser, uint8_t ch);
+
+/**
+ * @brief  Validate a decoded command and run its handler
+ * @param  pParser     : Pointer to parser state holding the handler table
+ * @param  cmd         : Command to dispatch
+ * @return Status of the command
+ * @note   Used by the ASCII parser on frame completion and by other
+ *         framings (see proto_bin.h) that decode into a PROTO_CMD_T, so
+ *         range checks, handlers and statistics are shared.
+ */
+PROTO_STATUS_T Proto_Dispatch(PROTO_PARSER_T *pParser, const PROTO_CMD_T *cmd);
+
+/**
+ * @brief  Consume bytes in place from a receive ring buffer
+ * @param  pParser     : Pointer to parser state
+ * @param  pRB         : Byte ring buffer filled by Chip_UART_RXIntHandlerRB()
+ * @return Status of the first completed frame, or PROTO_STATUS_NONE when
+ *         the ring buffer was drained without completing one
+ * @note   Bytes are read directly from the ring buffer storage and the
+ *         tail is advanced afterwards, so no copy is made. Only the
+ *         tail index is written, which makes this safe against the UART
+ *         receive interrupt without masking it. Call again until it
+ *         returns PROTO_STATUS_NONE to process back-to-back frames.
+ */
+PROTO_STATUS_T Proto_ProcessRB(PROTO_PARSER_T *pParser, RINGBUFF_T *pRB);
+
+/**
+ * @brief  Return parser statistics
+ * @param  pParser     : Pointer to parser state
+ * @return Pointer to the statistics block
+ */
+STATIC INLINE const PROTO_STATS_T *Proto_GetStats(const PROTO_PARSER_T *pParser)
+{
+   return &pParser->stats;
+}
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PROTOCOL_H_ */
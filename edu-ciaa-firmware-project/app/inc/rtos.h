@@ -0,0 +1,295 @@
+/*
+ * @brief Minimal preemptive kernel
+ *
+ * Fixed priority preemptive threads, round robin within a priority on the
+ * tick. Priority 0 is the highest, as for the NVIC. Ready threads sit in
+ * one FIFO per priority with a bit per non-empty FIFO, so picking the next
+ * thread is one count-trailing-zeros whatever the thread count. Mutexes
+ * hand ownership to the highest priority waiter and use priority
+ * inheritance, transitively through chains of blocked owners. Queues copy
+ * fixed size items and can be fed from interrupt handlers.
+ *
+ * Threads, stacks, mutexes and queues are all owned by the caller.
+ *
+ * The Cortex-M4 port (rtos_port_cm4.c) switches context in PendSV. The
+ * FPU registers are only saved for threads that used the FPU, from the
+ * EXC_RETURN frame type, and lazy stacking defers the hardware part until
+ * the handler touches the FPU itself. Kernel critical sections mask
+ * interrupts with BASEPRI, at and below RTOS_SYSCALL_PRIO only: the motor
+ * abort and the control loop interrupts are never delayed by the kernel,
+ * and may not call it.
+ *
+ * Without CORE_M4 the POSIX port (rtos_port_posix.c) runs each thread on a
+ * pthread, one at a time, so application code can be tested on the host.
+ * There, preemption happens when the running thread next calls the
+ * kernel, and threads that are not kernel threads act as interrupts.
+ */
+
+#ifndef __RTOS_H_
+#define __RTOS_H_
+
+#include "lpc_types.h"
+
+#if !defined(CORE_M4)
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup RTOS APP: Preemptive kernel
+ * @{
+ */
+
+/** Run the application on kernel threads instead of the main loop */
+#ifndef RTOS_ENABLE
+#define RTOS_ENABLE             0
+#endif
+
+/** Number of thread priorities, the idle thread takes the lowest */
+#define RTOS_PRIOS              32
+
+/** Tick rate, timeouts and sleeps count in ticks */
+#ifndef RTOS_TICK_HZ
+#define RTOS_TICK_HZ            1000
+#endif
+
+/** Highest interrupt priority (lowest number) allowed to call the FromIsr functions */
+#ifndef RTOS_SYSCALL_PRIO
+#define RTOS_SYSCALL_PRIO       2
+#endif
+
+/** Idle thread stack, in words */
+#ifndef RTOS_IDLE_STACK_WORDS
+#define RTOS_IDLE_STACK_WORDS   128
+#endif
+
+/** Timeout that never expires */
+#define RTOS_FOREVER            0xFFFFFFFFUL
+
+/** Timeout for calls that must not block */
+#define RTOS_NO_WAIT            0
+
+/**
+ * @brief Kernel call results
+ */
+typedef enum {
+   RTOS_OK = 0,                /*!< Done */
+   RTOS_TIMEOUT,               /*!< Not done within the timeout, or at once for RTOS_NO_WAIT */
+   RTOS_ERR_ISR,               /*!< Blocking call from an interrupt handler */
+   RTOS_ERR_OWNER,             /*!< Mutex released by a thread that does not own it */
+} RTOS_STATUS_T;
+
+/**
+ * @brief Thread states
+ */
+typedef enum {
+   RTOS_STATE_READY = 0,       /*!< Running or on a ready list */
+   RTOS_STATE_BLOCKED,         /*!< Waiting on a list, a timeout, or both */
+   RTOS_STATE_DEAD,            /*!< Returned from its function */
+} RTOS_STATE_T;
+
+typedef struct RTOS_THREAD RTOS_THREAD_T;
+typedef struct RTOS_MUTEX RTOS_MUTEX_T;
+
+/**
+ * @brief List of threads, ordered by priority for wait lists
+ */
+typedef struct {
+   RTOS_THREAD_T *head;        /*!< First thread, its prev is the last one */
+} RTOS_LIST_T;
+
+/**
+ * @brief Thread, owned by the caller
+ */
+struct RTOS_THREAD {
+   uint32_t *sp;               /*!< Saved stack pointer, first member: the port relies on it */
+   RTOS_THREAD_T *next;        /*!< Ready or wait list links */
+   RTOS_THREAD_T *prev;
+   RTOS_LIST_T *list;          /*!< List the thread is on, NULL if none */
+   RTOS_THREAD_T *delayNext;   /*!< Timeout list link */
+   uint32_t wake;              /*!< Tick the timeout expires at */
+   uint8_t prio;               /*!< Effective priority, raised by inheritance */
+   uint8_t basePrio;           /*!< Priority given at creation */
+   uint8_t state;              /*!< RTOS_STATE_T */
+   uint8_t result;             /*!< RTOS_STATUS_T of the last wait */
+   bool delayed;               /*!< On the timeout list */
+   RTOS_MUTEX_T *blockedOn;    /*!< Mutex being waited for, NULL if none */
+   RTOS_MUTEX_T *held;         /*!< Mutexes owned, most recent first */
+   const char *name;           /*!< For debugging */
+   uint32_t *stack;            /*!< Stack base */
+   uint32_t stackWords;        /*!< Stack size in words */
+#if !defined(CORE_M4)
+   pthread_t hostThread;       /*!< POSIX port: thread running this one */
+   pthread_cond_t hostRun;     /*!< POSIX port: signalled when it becomes current */
+   void (*hostFn)(void *);
+   void *hostArg;
+#endif
+};
+
+/**
+ * @brief Mutex with priority inheritance, recursive
+ */
+struct RTOS_MUTEX {
+   RTOS_THREAD_T *owner;       /*!< NULL when free */
+   RTOS_LIST_T waiters;        /*!< Threads blocked on it, highest priority first */
+   uint32_t count;             /*!< Recursive lock count */
+   RTOS_MUTEX_T *nextHeld;     /*!< Owner's held list link */
+};
+
+/**
+ * @brief Queue of fixed size items
+ */
+typedef struct {
+   uint8_t *data;              /*!< Storage, len * itemSize bytes */
+   uint32_t itemSize;          /*!< Item size in bytes */
+   uint32_t len;               /*!< Capacity in items */
+   uint32_t head;              /*!< Index of the oldest item */
+   uint32_t count;             /*!< Items stored */
+   RTOS_LIST_T recvWaiters;    /*!< Threads waiting for an item */
+   RTOS_LIST_T sendWaiters;    /*!< Threads waiting for room */
+} RTOS_QUEUE_T;
+
+/** Running thread, read by the port's context switch */
+extern RTOS_THREAD_T *volatile rtosCurrent;
+
+/**
+ * @brief  Reset the kernel and create the idle thread
+ * @return Nothing
+ */
+void Rtos_Init(void);
+
+/**
+ * @brief  Create a thread, ready to run
+ * @param  pThread     : Thread
+ * @param  name        : Name, for debugging
+ * @param  fn          : Thread function, the thread ends when it returns
+ * @param  arg         : Passed to @a fn
+ * @param  stack       : Stack, 8-byte aligned
+ * @param  stackWords  : Stack size in words, at least 64
+ * @param  prio        : Priority, 0 (highest) to RTOS_PRIOS - 2
+ * @return Nothing
+ * @note   Threads may be created before or after Rtos_Start().
+ */
+void Rtos_ThreadCreate(RTOS_THREAD_T *pThread, const char *name, void (*fn)(void *), void *arg,
+                      uint32_t *stack, uint32_t stackWords, uint8_t prio);
+
+/**
+ * @brief  Start the tick and run the highest priority thread
+ * @return Does not return
+ */
+void Rtos_Start(void);
+
+/**
+ * @brief  Return the running thread
+ * @return Thread, NULL before Rtos_Start()
+ */
+STATIC INLINE RTOS_THREAD_T *Rtos_Self(void)
+{
+   return rtosCurrent;
+}
+
+/**
+ * @brief  Return the number of ticks since Rtos_Start()
+ * @return Ticks, wrapping
+ */
+uint32_t Rtos_TickCount(void);
+
+/**
+ * @brief  Let the other ready threads of the same priority run
+ * @return Nothing
+ */
+void Rtos_Yield(void);
+
+/**
+ * @brief  Block the running thread for a number of ticks
+ * @param  ticks       : Ticks, 0 yields
+ * @return Nothing
+ */
+void Rtos_Sleep(uint32_t ticks);
+
+/**
+ * @brief  Advance the tick: expire timeouts and rotate the running priority
+ * @return Nothing
+ * @note   Called by the port's tick interrupt.
+ */
+void Rtos_Tick(void);
+
+/**
+ * @brief  Set up a free mutex
+ * @param  pMutex      : Mutex
+ * @return Nothing
+ */
+void Rtos_MutexInit(RTOS_MUTEX_T *pMutex);
+
+/**
+ * @brief  Lock a mutex, waiting up to a timeout
+ * @param  pMutex      : Mutex
+ * @param  timeout     : Ticks, RTOS_NO_WAIT or RTOS_FOREVER
+ * @return RTOS_OK, RTOS_TIMEOUT or RTOS_ERR_ISR
+ * @note   While waiting, the owner runs at least at the caller's priority.
+ */
+RTOS_STATUS_T Rtos_MutexLock(RTOS_MUTEX_T *pMutex, uint32_t timeout);
+
+/**
+ * @brief  Unlock a mutex, handing it to the highest priority waiter
+ * @param  pMutex      : Mutex, owned by the caller
+ * @return RTOS_OK, RTOS_ERR_OWNER or RTOS_ERR_ISR
+ */
+RTOS_STATUS_T Rtos_MutexUnlock(RTOS_MUTEX_T *pMutex);
+
+/**
+ * @brief  Set up an empty queue
+ * @param  pQueue      : Queue
+ * @param  buffer      : Storage, @a len * @a itemSize bytes
+ * @param  itemSize    : Item size in bytes
+ * @param  len         : Capacity in items
+ * @return Nothing
+ */
+void Rtos_QueueInit(RTOS_QUEUE_T *pQueue, void *buffer, uint32_t itemSize, uint32_t len);
+
+/**
+ * @brief  Copy an item in, waiting up to a timeout for room
+ * @param  pQueue      : Queue
+ * @param  item        : Item
+ * @param  timeout     : Ticks, RTOS_NO_WAIT or RTOS_FOREVER
+ * @return RTOS_OK, RTOS_TIMEOUT or RTOS_ERR_ISR
+ */
+RTOS_STATUS_T Rtos_QueueSend(RTOS_QUEUE_T *pQueue, const void *item, uint32_t timeout);
+
+/**
+ * @brief  Copy an item out, waiting up to a timeout for one
+ * @param  pQueue      : Queue
+ * @param  item        : Destination
+ * @param  timeout     : Ticks, RTOS_NO_WAIT or RTOS_FOREVER
+ * @return RTOS_OK, RTOS_TIMEOUT or RTOS_ERR_ISR
+ */
+RTOS_STATUS_T Rtos_QueueRecv(RTOS_QUEUE_T *pQueue, void *item, uint32_t timeout);
+
+/**
+ * @brief  Copy an item in from an interrupt handler
+ * @param  pQueue      : Queue
+ * @param  item        : Item
+ * @return true when queued, false when the queue is full
+ * @note   Only from interrupts at RTOS_SYSCALL_PRIO or lower priority. A
+ *         woken thread of higher priority runs when the handler returns.
+ */
+bool Rtos_QueueSendFromIsr(RTOS_QUEUE_T *pQueue, const void *item);
+
+/**
+ * @brief  Return the number of stack words a thread never used
+ * @param  pThread     : Thread
+ * @return Untouched words at the bottom of the stack
+ */
+uint32_t Rtos_StackFree(const RTOS_THREAD_T *pThread);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RTOS_H_ */
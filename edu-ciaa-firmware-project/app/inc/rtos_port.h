@@ -0,0 +1,95 @@
+/*
+ * @brief Minimal preemptive kernel, port layer
+ *
+ * What the kernel (rtos.c) needs from a port, and what a port calls back.
+ * The Cortex-M4 port is rtos_port_cm4.c, the POSIX host port is
+ * rtos_port_posix.c. Only the kernel and the ports include this file.
+ */
+
+#ifndef __RTOS_PORT_H_
+#define __RTOS_PORT_H_
+
+#include "rtos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup RTOS_PORT APP: Preemptive kernel port layer
+ * @ingroup RTOS
+ * @{
+ */
+
+/** Value filling unused stack, for Rtos_StackFree() */
+#define RTOS_STACK_FILL         0xA5A5A5A5UL
+
+/**
+ * @brief  Enter a kernel critical section
+ * @return Key for Rtos_PortUnlock(), sections nest
+ */
+uint32_t Rtos_PortLock(void);
+
+/**
+ * @brief  Leave a kernel critical section
+ * @param  key         : Value returned by the matching Rtos_PortLock()
+ * @return Nothing
+ * @note   A switch requested inside the section happens here, once the
+ *         outermost section is left in thread context.
+ */
+void Rtos_PortUnlock(uint32_t key);
+
+/**
+ * @brief  Request a context switch, done by Rtos_SwitchContext() later
+ * @return Nothing
+ */
+void Rtos_PortPendSwitch(void);
+
+/**
+ * @brief  Return whether the caller is an interrupt handler
+ * @return true in interrupt context
+ */
+bool Rtos_PortInIsr(void);
+
+/**
+ * @brief  Prepare a new thread so that the first switch to it calls @a fn
+ * @param  pThread     : Thread, with stack and stackWords set
+ * @param  fn          : Thread function
+ * @param  arg         : Passed to @a fn
+ * @return Nothing
+ */
+void Rtos_PortInitThread(RTOS_THREAD_T *pThread, void (*fn)(void *), void *arg);
+
+/**
+ * @brief  Start the tick and switch to rtosCurrent
+ * @return Does not return
+ */
+void Rtos_PortStart(void);
+
+/**
+ * @brief  Idle thread body, wait for the next interrupt
+ * @return Nothing
+ */
+void Rtos_PortIdle(void);
+
+/**
+ * @brief  Pick the thread to run next into rtosCurrent
+ * @return Nothing
+ * @note   Called by the port with kernel interrupts masked.
+ */
+void Rtos_SwitchContext(void);
+
+/**
+ * @brief  End the running thread, reached when its function returns
+ * @return Does not return
+ */
+void Rtos_ThreadExit(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RTOS_PORT_H_ */
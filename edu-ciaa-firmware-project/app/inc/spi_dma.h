@@ -0,0 +1,166 @@
+/*
+ * @brief GPDMA backed SPI master transaction queue on SSP0/SSP1
+ *
+ * Transfers are queued on a bus and run back to back, each one over a
+ * pair of GPDMA channels: the transmit channel feeds the SSP FIFO and the
+ * receive channel empties it, so the CPU never moves a frame. Each
+ * transfer names its device, which carries the chip select GPIO, the bit
+ * rate, the clock mode (CPOL/CPHA) and the frame width: devices with
+ * different settings share the bus, the SSP is only reprogrammed when the
+ * device changes.
+ *
+ * The receive channel's terminal count ends a transfer, as the last frame
+ * received is also the last one clocked out. The chip select is released,
+ * the next transfer is started, then the transfer's callback runs and its
+ * task (task_sched.h) gets the completion event, both from the DMA
+ * interrupt.
+ * A transfer flagged SPI_DMA_HOLD_CS keeps the chip select asserted into
+ * the next one when that is queued for the same device, for command then
+ * data phases: submit both together.
+ *
+ * Transfers, devices and buffers are owned by the caller and must stay
+ * valid until the transfer completes. Buffers may be in any SRAM bank,
+ * __DMA_BUF (cr_section_macros.h) keeps them off the core's local banks.
+ */
+
+#ifndef __SPI_DMA_H_
+#define __SPI_DMA_H_
+
+#include "chip.h"
+#include "task_sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup SPI_DMA APP: GPDMA SPI master
+ * @{
+ */
+
+/** Longest transfer in frames (GPDMA transfer size) */
+#define SPI_DMA_MAX_FRAMES      4095
+
+/** Transfer flag: keep the chip select asserted into the next transfer of the same device */
+#define SPI_DMA_HOLD_CS         (1 << 0)
+
+/**
+ * @brief SPI device on a bus
+ */
+typedef struct {
+   uint8_t csPort;             /*!< SCU port of the chip select pin */
+   uint8_t csPin;              /*!< SCU pin of the chip select pin */
+   uint16_t csFunc;            /*!< SCU function that makes it a GPIO */
+   uint8_t csGpioPort;         /*!< GPIO port of the chip select, active low */
+   uint8_t csGpioPin;          /*!< GPIO pin of the chip select */
+   uint8_t bits;               /*!< Frame width, 4 to 16 */
+   CHIP_SSP_CLOCK_MODE_T mode; /*!< SSP_CLOCK_MODE0 to SSP_CLOCK_MODE3 */
+   uint32_t bitRate;           /*!< SCK rate in Hz */
+} SPI_DMA_DEV_T;
+
+/**
+ * @brief Transfer status
+ */
+typedef enum {
+   SPI_DMA_QUEUED = 0,         /*!< Waiting for the bus */
+   SPI_DMA_BUSY,               /*!< Running */
+   SPI_DMA_DONE,               /*!< Completed */
+   SPI_DMA_ERROR,              /*!< Stopped by a GPDMA error */
+} SPI_DMA_STATUS_T;
+
+typedef struct SPI_DMA_XFER SPI_DMA_XFER_T;
+
+/**
+ * @brief Transfer completion callback, called from the DMA interrupt
+ * @param pXfer    : Transfer that completed, status set
+ */
+typedef void (*SPI_DMA_CB_T)(SPI_DMA_XFER_T *pXfer);
+
+/**
+ * @brief Transfer, owned by the caller
+ */
+struct SPI_DMA_XFER {
+   SPI_DMA_XFER_T *next;       /*!< Next transfer of a submitted list, then the queue link, NULL once retired */
+   const SPI_DMA_DEV_T *dev;   /*!< Device addressed */
+   const void *tx;             /*!< Frames to send, NULL to send the bus fill value */
+   void *rx;                   /*!< Frames received, NULL to discard them */
+   uint16_t frames;            /*!< Frames, 1 to SPI_DMA_MAX_FRAMES, bytes or halfwords by width */
+   uint8_t flags;              /*!< SPI_DMA_HOLD_CS */
+   volatile uint8_t status;    /*!< SPI_DMA_STATUS_T */
+   SPI_DMA_CB_T cb;            /*!< Completion callback, may be NULL */
+   void *ctx;                  /*!< Callback context */
+   SCHED_TASK_T *task;         /*!< Task posted on completion, may be NULL */
+   uint16_t sig;               /*!< Signal posted, the argument is the status */
+};
+
+/**
+ * @brief Bus statistics
+ */
+typedef struct {
+   uint32_t xfers;             /*!< Transfers completed */
+   uint32_t frames;            /*!< Frames exchanged */
+   uint32_t reconfigs;         /*!< SSP format or rate changes */
+   uint32_t rejected;          /*!< Submissions refused as invalid */
+   uint32_t dmaErrors;         /*!< Transfers stopped by a GPDMA error */
+} SPI_DMA_STATS_T;
+
+/**
+ * @brief Bus state
+ */
+typedef struct {
+   LPC_SSP_T *pSSP;            /*!< SSP0 or SSP1 */
+   uint8_t txCh;               /*!< GPDMA channel feeding the transmit FIFO */
+   uint8_t rxCh;               /*!< GPDMA channel emptying the receive FIFO */
+   uint32_t txConn;            /*!< GPDMA_CONN_SSPn_Tx */
+   uint32_t rxConn;            /*!< GPDMA_CONN_SSPn_Rx */
+   SPI_DMA_XFER_T *head;       /*!< Running transfer, then the queue */
+   SPI_DMA_XFER_T *tail;       /*!< Last queued transfer */
+   const SPI_DMA_DEV_T *config; /*!< Device the SSP is set up for */
+   bool busy;                  /*!< A transfer is running */
+   uint16_t fill;              /*!< Sent when a transfer has no tx buffer, 0xFFFF by default */
+   uint16_t sink;              /*!< Receives the frames of transfers with no rx buffer */
+   SPI_DMA_STATS_T stats;      /*!< Running statistics */
+} SPI_DMA_BUS_T;
+
+/**
+ * @brief  Set up an SSP as SPI master with its pins and two GPDMA channels
+ * @param  pBus        : Bus state
+ * @param  pSSP        : LPC_SSP0 or LPC_SSP1
+ * @return SUCCESS, or ERROR when two DMA channels are not available
+ */
+Status SpiDma_Init(SPI_DMA_BUS_T *pBus, LPC_SSP_T *pSSP);
+
+/**
+ * @brief  Set up the chip select of a device, released
+ * @param  dev         : Device
+ * @return Nothing
+ * @note   Call once per device before its first transfer.
+ */
+void SpiDma_InitDevice(const SPI_DMA_DEV_T *dev);
+
+/**
+ * @brief  Queue a list of transfers
+ * @param  pBus        : Bus state
+ * @param  pXfer       : First transfer, the others linked through next, NULL terminated
+ * @return SUCCESS, or ERROR when a transfer of the list is invalid: nothing is queued then
+ * @note   The list runs in order, after the transfers already queued, and
+ *         no other submission can come between its transfers. Safe to call
+ *         from interrupts and completion callbacks.
+ */
+Status SpiDma_Submit(SPI_DMA_BUS_T *pBus, SPI_DMA_XFER_T *pXfer);
+
+/**
+ * @brief  Return whether the bus has nothing running or queued
+ * @param  pBus        : Bus state
+ * @return true when idle
+ */
+bool SpiDma_IsIdle(SPI_DMA_BUS_T *pBus);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPI_DMA_H_ */
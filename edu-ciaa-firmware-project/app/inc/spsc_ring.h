@@ -0,0 +1,234 @@
+/*
+ * @brief Lock-free single producer / single consumer ring buffer
+ *
+ * A variant of RINGBUFF_T (ring_buffer.h) that one interrupt handler and
+ * the main loop, or the two cores, can share without masking interrupts.
+ * The producer only writes head and the consumer only writes tail. Both
+ * indexes run freely and are published with release stores and read with
+ * acquire loads, so item data is visible before the index that covers it.
+ *
+ * Besides the copying Insert/Pop calls, Reserve/Commit and Peek/Release
+ * expose contiguous spans of the storage, so a DMA transfer or a parser
+ * can work on the items in place. SpscRing_Insert8/16/32() and the matching
+ * Pop functions are typed versions for 1, 2 and 4 byte items that avoid
+ * memcpy().
+ *
+ * Host-compilable, it only depends on lpc_types.h and GCC atomics.
+ */
+
+#ifndef __SPSC_RING_H_
+#define __SPSC_RING_H_
+
+#include "lpc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup SPSC_RING APP: Lock-free SPSC ring buffer
+ * @{
+ */
+
+/**
+ * @brief SPSC ring buffer structure
+ */
+typedef struct {
+   uint8_t *data;              /*!< Item storage, count * itemSz bytes */
+   uint32_t count;             /*!< Capacity in items, power of 2 */
+   uint32_t itemSz;            /*!< Item size in bytes */
+   uint32_t head;              /*!< Items inserted (free running), written by the producer only */
+   uint32_t tail;              /*!< Items removed (free running), written by the consumer only */
+} SPSC_RING_T;
+
+/* Index accessors with the ordering each side needs */
+#define SPSC_LOAD_ACQ(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SPSC_STORE_REL(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/**
+ * @brief  Initialize an SPSC ring buffer
+ * @param  pRing       : Ring buffer to initialize
+ * @param  buffer      : Item storage, aligned for @a itemSize
+ * @param  itemSize    : Size of one item in bytes
+ * @param  count       : Capacity in items, must be a power of 2 and at least 2
+ * @return true on success, false when @a count is not a power of 2
+ * @note   The power of 2 requirement is checked here, unlike RingBuffer_Init().
+ */
+bool SpscRing_Init(SPSC_RING_T *pRing, void *buffer, uint32_t itemSize, uint32_t count);
+
+/**
+ * @brief  Return the number of items waiting for the consumer
+ * @param  pRing       : Ring buffer
+ * @return Item count
+ */
+STATIC INLINE uint32_t SpscRing_GetCount(SPSC_RING_T *pRing)
+{
+   return SPSC_LOAD_ACQ(&pRing->head) - SPSC_LOAD_ACQ(&pRing->tail);
+}
+
+/**
+ * @brief  Return the number of free item slots
+ * @param  pRing       : Ring buffer
+ * @return Free slots
+ */
+STATIC INLINE uint32_t SpscRing_GetFree(SPSC_RING_T *pRing)
+{
+   return pRing->count - SpscRing_GetCount(pRing);
+}
+
+/**
+ * @brief  Return true when the ring buffer is empty
+ * @param  pRing       : Ring buffer
+ * @return true if empty
+ */
+STATIC INLINE bool SpscRing_IsEmpty(SPSC_RING_T *pRing)
+{
+   return SpscRing_GetCount(pRing) == 0;
+}
+
+/**
+ * @brief  Return true when the ring buffer is full
+ * @param  pRing       : Ring buffer
+ * @return true if full
+ */
+STATIC INLINE bool SpscRing_IsFull(SPSC_RING_T *pRing)
+{
+   return SpscRing_GetCount(pRing) == pRing->count;
+}
+
+/**
+ * @brief  Producer: get a contiguous span of free slots
+ * @param  pRing       : Ring buffer
+ * @param  span        : Set to the first free slot
+ * @return Number of contiguous free items, 0 when full
+ * @note   The span stops at the end of the storage. Fill it, then call
+ *         SpscRing_Commit() with the number of items written.
+ */
+STATIC INLINE uint32_t SpscRing_Reserve(SPSC_RING_T *pRing, void **span)
+{
+   uint32_t head = pRing->head;
+   uint32_t used = head - SPSC_LOAD_ACQ(&pRing->tail);
+   uint32_t idx = head & (pRing->count - 1);
+   uint32_t toEnd = pRing->count - idx;
+   uint32_t room = pRing->count - used;
+
+   *span = &pRing->data[idx * pRing->itemSz];
+
+   return (room < toEnd) ? room : toEnd;
+}
+
+/**
+ * @brief  Producer: publish items written into a reserved span
+ * @param  pRing       : Ring buffer
+ * @param  items       : Number of items written, at most the reserved count
+ * @return Nothing
+ */
+STATIC INLINE void SpscRing_Commit(SPSC_RING_T *pRing, uint32_t items)
+{
+   SPSC_STORE_REL(&pRing->head, pRing->head + items);
+}
+
+/**
+ * @brief  Consumer: get a contiguous span of pending items
+ * @param  pRing       : Ring buffer
+ * @param  span        : Set to the oldest pending item
+ * @return Number of contiguous pending items, 0 when empty
+ * @note   Call again after SpscRing_Release() to get the wrapped part.
+ */
+STATIC INLINE uint32_t SpscRing_Peek(SPSC_RING_T *pRing, const void **span)
+{
+   uint32_t tail = pRing->tail;
+   uint32_t used = SPSC_LOAD_ACQ(&pRing->head) - tail;
+   uint32_t idx = tail & (pRing->count - 1);
+   uint32_t toEnd = pRing->count - idx;
+
+   *span = &pRing->data[idx * pRing->itemSz];
+
+   return (used < toEnd) ? used : toEnd;
+}
+
+/**
+ * @brief  Consumer: free items returned by SpscRing_Peek()
+ * @param  pRing       : Ring buffer
+ * @param  items       : Number of items consumed
+ * @return Nothing
+ */
+STATIC INLINE void SpscRing_Release(SPSC_RING_T *pRing, uint32_t items)
+{
+   SPSC_STORE_REL(&pRing->tail, pRing->tail + items);
+}
+
+/**
+ * @brief  Producer: copy one item in
+ * @param  pRing       : Ring buffer
+ * @param  data        : Item to insert
+ * @return 1 when inserted, 0 when the ring buffer is full
+ */
+int SpscRing_Insert(SPSC_RING_T *pRing, const void *data);
+
+/**
+ * @brief  Producer: copy several items in
+ * @param  pRing       : Ring buffer
+ * @param  data        : Items to insert
+ * @param  num         : Number of items
+ * @return Number of items inserted
+ */
+int SpscRing_InsertMult(SPSC_RING_T *pRing, const void *data, int num);
+
+/**
+ * @brief  Consumer: copy one item out
+ * @param  pRing       : Ring buffer
+ * @param  data        : Destination
+ * @return 1 when an item was removed, 0 when the ring buffer is empty
+ */
+int SpscRing_Pop(SPSC_RING_T *pRing, void *data);
+
+/**
+ * @brief  Consumer: copy several items out
+ * @param  pRing       : Ring buffer
+ * @param  data        : Destination
+ * @param  num         : Maximum number of items
+ * @return Number of items removed
+ */
+int SpscRing_PopMult(SPSC_RING_T *pRing, void *data, int num);
+
+/* Typed single item Insert/Pop for fixed item sizes, no memcpy() */
+#define SPSC_RING_TYPED(suffix, type)                                          \
+   STATIC INLINE int SpscRing_Insert##suffix(SPSC_RING_T *pRing, type v)      \
+   {                                                                           \
+       uint32_t head = pRing->head;                                            \
+       if (head - SPSC_LOAD_ACQ(&pRing->tail) >= pRing->count) {               \
+           return 0;                                                           \
+       }                                                                       \
+       ((type *) pRing->data)[head & (pRing->count - 1)] = v;                  \
+       SPSC_STORE_REL(&pRing->head, head + 1);                                 \
+       return 1;                                                               \
+   }                                                                           \
+   STATIC INLINE int SpscRing_Pop##suffix(SPSC_RING_T *pRing, type *pv)       \
+   {                                                                           \
+       uint32_t tail = pRing->tail;                                            \
+       if (SPSC_LOAD_ACQ(&pRing->head) == tail) {                              \
+           return 0;                                                           \
+       }                                                                       \
+       *pv = ((const type *) pRing->data)[tail & (pRing->count - 1)];          \
+       SPSC_STORE_REL(&pRing->tail, tail + 1);                                 \
+       return 1;                                                               \
+   }
+
+/** SpscRing_Insert8()/SpscRing_Pop8(), for rings of 1 byte items */
+SPSC_RING_TYPED(8, uint8_t)
+
+/** SpscRing_Insert16()/SpscRing_Pop16(), for rings of 2 byte items */
+SPSC_RING_TYPED(16, uint16_t)
+
+/** SpscRing_Insert32()/SpscRing_Pop32(), for rings of 4 byte items */
+SPSC_RING_TYPED(32, uint32_t)
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPSC_RING_H_ */
@@ -0,0 +1,135 @@
+/*
+ * @brief Software timers on a hierarchical timing wheel
+ *
+ * Timers count in SWTIMER_TICK_US ticks on a wheel of SWTIMER_LEVELS
+ * levels of 64 slots. Level 0 holds timers due within 64 ticks, one slot
+ * per tick; level n holds timers due within 64^(n+1) ticks, one slot per
+ * 64^n ticks, and a slot is moved down a level when the wheel reaches it.
+ * Farther timers wait in the top level and are moved again until due.
+ * Starting and stopping a timer is O(1): timers are intrusive list nodes,
+ * owned by the caller, so any number can run at once without allocation.
+ * Each level keeps a bitmap of its non-empty slots, so
+ * Swtimer_NextDeadline() is found without a scan and Swtimer_Run() jumps
+ * over empty stretches after a long sleep.
+ *
+ * Times are absolute, 64 bits, and never wrap. Periodic timers are
+ * re-armed from their previous expiry, so they do not drift; runs missed
+ * while the caller was late are skipped, not run in a burst. Callbacks
+ * run from Swtimer_Run(), in the caller's context, and may start or stop
+ * any timer including their own. The module is not interrupt safe: use
+ * it from the main loop only.
+ *
+ * Host-compilable, it only depends on lpc_types.h.
+ */
+
+#ifndef __SWTIMER_H_
+#define __SWTIMER_H_
+
+#include "lpc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup SWTIMER APP: Software timers
+ * @{
+ */
+
+/** Tick length in microseconds */
+#ifndef SWTIMER_TICK_US
+#define SWTIMER_TICK_US         1000
+#endif
+
+/** Wheel levels, the range before timers are moved down again is 64^levels ticks */
+#define SWTIMER_LEVELS          5
+
+/** Swtimer_NextDeadline() result when no timer is running */
+#define SWTIMER_NEVER           UINT64_MAX
+
+/**
+ * @brief Expiry callback
+ * @param ctx      : Context given to Swtimer_Setup()
+ */
+typedef void (*SWTIMER_FN_T)(void *ctx);
+
+/**
+ * @brief Software timer, owned by the caller
+ */
+typedef struct SWTIMER {
+   struct SWTIMER *next;       /*!< Next timer in the same slot */
+   struct SWTIMER **pprev;     /*!< Link pointing at this timer, NULL when stopped */
+   uint64_t expires;           /*!< Tick the timer is due at */
+   uint32_t period;            /*!< Ticks between runs, 0 for one-shot */
+   uint8_t level;              /*!< Wheel position, kept to update the slot bitmap */
+   uint8_t slot;
+   SWTIMER_FN_T fn;            /*!< Expiry callback */
+   void *ctx;                  /*!< Callback context */
+} SWTIMER_T;
+
+/**
+ * @brief  Empty the wheel and set its time
+ * @param  nowUs       : Current time, microseconds
+ * @return Nothing
+ */
+void Swtimer_Init(uint64_t nowUs);
+
+/**
+ * @brief  Prepare a timer, stopped
+ * @param  pTimer      : Timer
+ * @param  fn          : Expiry callback
+ * @param  ctx         : Opaque pointer passed to @a fn
+ * @return Nothing
+ */
+void Swtimer_Setup(SWTIMER_T *pTimer, SWTIMER_FN_T fn, void *ctx);
+
+/**
+ * @brief  Start or restart a timer
+ * @param  pTimer      : Timer, set up with Swtimer_Setup()
+ * @param  delayTicks  : Ticks from the last Swtimer_Run() to the first run, 0 or 1 for the next tick
+ * @param  periodTicks : Ticks between later runs, 0 for one-shot
+ * @return Nothing
+ */
+void Swtimer_Start(SWTIMER_T *pTimer, uint64_t delayTicks, uint32_t periodTicks);
+
+/**
+ * @brief  Stop a timer
+ * @param  pTimer      : Timer
+ * @return Nothing
+ * @note   Does nothing when the timer is not running.
+ */
+void Swtimer_Stop(SWTIMER_T *pTimer);
+
+/**
+ * @brief  Return whether a timer is running
+ * @param  pTimer      : Timer
+ * @return true until a one-shot timer fires or the timer is stopped
+ */
+STATIC INLINE bool Swtimer_IsActive(const SWTIMER_T *pTimer)
+{
+   return pTimer->pprev != NULL;
+}
+
+/**
+ * @brief  Advance the wheel to the current time and run the due callbacks
+ * @param  nowUs       : Current time, microseconds, never going back
+ * @return Number of callbacks run
+ */
+uint32_t Swtimer_Run(uint64_t nowUs);
+
+/**
+ * @brief  Return when Swtimer_Run() next has work
+ * @return Time in microseconds, SWTIMER_NEVER when no timer is running
+ * @note   May be earlier than the next expiry: far timers are moved down a
+ *         level at 64^n tick boundaries and the wheel wakes for that.
+ */
+uint64_t Swtimer_NextDeadline(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SWTIMER_H_ */
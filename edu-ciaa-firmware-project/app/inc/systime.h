@@ -0,0 +1,112 @@
+/*
+ * @brief Tickless time base and idle
+ *
+ * Time is kept in microseconds in 64 bits, from a free running 32-bit
+ * timer at 1 MHz extended by a wrap count (one interrupt every 71.6
+ * minutes). There is no periodic tick: Systime_Idle() programs a second
+ * match register for the next deadline and sleeps until it, or until any
+ * other interrupt, so an idle rover wakes only when something is due.
+ *
+ * When deep sleep is allowed and the deadline is at least
+ * SYSTIME_DEEP_SLEEP_MIN_US away, Systime_Idle() stops the timer, drops
+ * the core to the IRC, enters deep sleep with the alarm timer (1024 Hz,
+ * RTC oscillator) routed through the event router as the wake-up source,
+ * then restarts the PLL and adds the alarm timer's count to the time base.
+ * Deep sleep gates every peripheral clock: UART bytes, encoder edges and
+ * control ticks are lost while in it, so only allow it while parked.
+ */
+
+#ifndef __SYSTIME_H_
+#define __SYSTIME_H_
+
+#include "chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup SYSTIME APP: Tickless time base
+ * @{
+ */
+
+/* Free running timer, TIMER1 belongs to the encoder */
+#define SYSTIME_TIMER           LPC_TIMER2
+#define SYSTIME_IRQn            TIMER2_IRQn
+#define SYSTIME_IRQHandler      TIMER2_IRQHandler
+#define SYSTIME_CLK             CLK_MX_TIMER2
+
+/** Match register counting wraps, fires when the counter rolls over to 0 */
+#define SYSTIME_WRAP_MATCH      0
+
+/** Match register waking Systime_Idle() */
+#define SYSTIME_WAKE_MATCH      1
+
+/** Time base interrupt priority, it has no work beyond waking the core */
+#define SYSTIME_IRQ_PRIO        3
+
+/** Shortest idle spent in deep sleep, PLL relock and clock switching take about 0.5 ms */
+#ifndef SYSTIME_DEEP_SLEEP_MIN_US
+#define SYSTIME_DEEP_SLEEP_MIN_US 20000
+#endif
+
+/** Deadline that never comes */
+#define SYSTIME_FOREVER         UINT64_MAX
+
+/**
+ * @brief Idle statistics
+ */
+typedef struct {
+   uint32_t sleeps;            /*!< Calls to Systime_Idle() that slept */
+   uint32_t deepSleeps;        /*!< Of which in deep sleep */
+   uint64_t sleepUs;           /*!< Time spent asleep */
+   uint64_t deepSleepUs;       /*!< Time spent in deep sleep */
+} SYSTIME_STATS_T;
+
+/**
+ * @brief  Start the time base at zero
+ * @return Nothing
+ * @note   Also starts the RTC oscillator for the alarm timer. Deep sleep
+ *         is only used once the oscillator is seen running.
+ */
+void Systime_Init(void);
+
+/**
+ * @brief  Read the time base
+ * @return Microseconds since Systime_Init(), time in deep sleep included
+ * @note   Safe from any context.
+ */
+uint64_t Systime_Now(void);
+
+/**
+ * @brief  Sleep until a deadline or the next interrupt
+ * @param  deadline    : Systime_Now() value to wake at, SYSTIME_FOREVER for none
+ * @return Nothing
+ * @note   Call with interrupts masked (PRIMASK set) after checking for
+ *         pending work: an interrupt still wakes the core, and runs once
+ *         the caller unmasks interrupts, so no wake-up is lost between the
+ *         check and the sleep. Returns at once when the deadline passed.
+ */
+void Systime_Idle(uint64_t deadline);
+
+/**
+ * @brief  Allow or forbid deep sleep in Systime_Idle()
+ * @param  allow       : true to allow
+ * @return Nothing
+ */
+void Systime_AllowDeepSleep(bool allow);
+
+/**
+ * @brief  Return idle statistics
+ * @return Pointer to the statistics block
+ */
+const SYSTIME_STATS_T *Systime_GetStats(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SYSTIME_H_ */
@@ -0,0 +1,201 @@
+/*
+ * @brief Cooperative run-to-completion task scheduler
+ *
+ * Tasks are event handlers with a per-task event queue. Drivers and
+ * interrupt handlers post an event when an operation completes instead
+ * of the caller busy-waiting for it, and Sched_Run(), from the main loop,
+ * hands each event to its task. The highest priority task with a pending
+ * event always goes first, so a slow job that has to wait on a peripheral
+ * never holds up the command path: it returns to the scheduler while it
+ * waits, and resumes when the completion event arrives.
+ *
+ * Task bodies are stackless continuations (protothreads): SCHED_AWAIT()
+ * records where the task stopped and returns, and the next event resumes
+ * it at that line. Local variables do not survive an await, keep state in
+ * the task context or in statics. A switch statement cannot span an await.
+ *
+ * Tasks, queues and events are all owned by the caller, nothing is
+ * allocated. Priority 0 is the highest, as for the NVIC.
+ */
+
+#ifndef __TASK_SCHED_H_
+#define __TASK_SCHED_H_
+
+#include "chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup SCHED APP: Cooperative task scheduler
+ * @{
+ */
+
+/** Number of task priorities */
+#define SCHED_PRIOS             8
+
+/* Signals every task may receive, application signals start at SCHED_SIG_USER */
+#define SCHED_SIG_START         0   /*!< First event, posted by Sched_Start() */
+#define SCHED_SIG_YIELD         1   /*!< Posted by SCHED_YIELD() to resume the task */
+#define SCHED_SIG_USER          16
+
+/* Task function results */
+#define SCHED_WAITING           0   /*!< Stopped at an await, resumes on the next event */
+#define SCHED_ENDED             1   /*!< Reached SCHED_END(), restarts on the next event */
+
+/**
+ * @brief Event, passed by value through the task queue
+ */
+typedef struct {
+   uint16_t sig;               /*!< Signal, what happened */
+   uint16_t arg;               /*!< Signal specific argument */
+} SCHED_EVT_T;
+
+typedef struct SCHED_TASK SCHED_TASK_T;
+
+/**
+ * @brief Task body
+ * @param pTask    : Task being run
+ * @param pEvt     : Event that resumed it
+ * @return SCHED_WAITING or SCHED_ENDED, from the SCHED_* macros
+ */
+typedef uint8_t (*SCHED_FN_T)(SCHED_TASK_T *pTask, const SCHED_EVT_T *pEvt);
+
+/**
+ * @brief Task, owned by the caller
+ */
+struct SCHED_TASK {
+   SCHED_TASK_T *next;         /*!< Next ready task of the same priority */
+   SCHED_FN_T fn;              /*!< Task body */
+   void *ctx;                  /*!< Task context */
+   SCHED_EVT_T *queue;         /*!< Event queue storage */
+   uint8_t qmask;              /*!< Queue size - 1, the size is a power of 2 */
+   volatile uint8_t head;      /*!< Events posted (free running) */
+   uint8_t tail;               /*!< Events run (free running) */
+   uint8_t prio;               /*!< Priority, 0 is the highest */
+   bool ready;                 /*!< Queued on the ready list */
+   uint16_t lc;                /*!< Continuation, line of the last await, 0 at start */
+   uint32_t dropped;           /*!< Events lost to a full queue */
+};
+
+/**
+ * @brief  Start a task body, use before any other SCHED_* macro
+ * @param  pTask       : Task
+ */
+#define SCHED_BEGIN(pTask)      switch ((pTask)->lc) { case 0:
+
+/**
+ * @brief  Wait until a condition holds, it is checked again on every event
+ * @param  pTask       : Task
+ * @param  cond        : Condition
+ */
+#define SCHED_AWAIT(pTask, cond)                                               \
+   do {                                                                        \
+       (pTask)->lc = __LINE__;                                                 \
+   case __LINE__:                                                              \
+       if (!(cond)) {                                                          \
+           return SCHED_WAITING;                                               \
+       }                                                                       \
+   } while (0)
+
+/**
+ * @brief  Wait for an event with the given signal, others are ignored
+ * @param  pTask       : Task
+ * @param  pEvt        : Event parameter of the task body
+ * @param  signal      : Signal to wait for
+ */
+#define SCHED_AWAIT_SIG(pTask, pEvt, signal)                                   \
+   do {                                                                        \
+       (pTask)->lc = __LINE__;                                                 \
+       return SCHED_WAITING;                                                   \
+   case __LINE__:                                                              \
+       if ((pEvt)->sig != (signal)) {                                          \
+           return SCHED_WAITING;                                               \
+       }                                                                       \
+   } while (0)
+
+/**
+ * @brief  Let higher priority tasks run, then carry on
+ * @param  pTask       : Task
+ * @note   Events already queued for the task are run before it resumes.
+ */
+#define SCHED_YIELD(pTask)                                                     \
+   do {                                                                        \
+       (pTask)->lc = __LINE__;                                                 \
+       Sched_Post((pTask), SCHED_SIG_YIELD, 0);                                \
+       return SCHED_WAITING;                                                   \
+   case __LINE__:;                                                             \
+   } while (0)
+
+/**
+ * @brief  End a task body, the next event starts it from the top
+ * @param  pTask       : Task
+ */
+#define SCHED_END(pTask)        } (pTask)->lc = 0; return SCHED_ENDED
+
+/**
+ * @brief  Reset the scheduler, no task ready
+ * @return Nothing
+ */
+void Sched_Init(void);
+
+/**
+ * @brief  Set up a task, no event pending
+ * @param  pTask       : Task
+ * @param  fn          : Task body
+ * @param  ctx         : Context, left in pTask->ctx
+ * @param  prio        : Priority, 0 (highest) to SCHED_PRIOS - 1
+ * @param  queue       : Event queue storage, @a qsize entries
+ * @param  qsize       : Queue size, power of 2, 2 to 128
+ * @return Nothing
+ */
+void Sched_TaskInit(SCHED_TASK_T *pTask, SCHED_FN_T fn, void *ctx, uint8_t prio,
+                   SCHED_EVT_T *queue, uint32_t qsize);
+
+/**
+ * @brief  Post an event to a task
+ * @param  pTask       : Task
+ * @param  sig         : Signal
+ * @param  arg         : Signal argument
+ * @return true when queued, false when the queue was full
+ * @note   Safe from interrupt handlers. A full queue drops the event and
+ *         counts it in pTask->dropped, so completion events should be
+ *         treated as hints and the task should check the driver state.
+ */
+bool Sched_Post(SCHED_TASK_T *pTask, uint16_t sig, uint16_t arg);
+
+/**
+ * @brief  Post SCHED_SIG_START to a task
+ * @param  pTask       : Task
+ * @return true when queued
+ */
+STATIC INLINE bool Sched_Start(SCHED_TASK_T *pTask)
+{
+   return Sched_Post(pTask, SCHED_SIG_START, 0);
+}
+
+/**
+ * @brief  Run pending events, highest priority first, until none is left
+ * @return Number of events run
+ * @note   Main loop only. Priorities are checked again after every event,
+ *         so an event posted by an interrupt handler meanwhile goes ahead
+ *         of lower priority ones already queued.
+ */
+uint32_t Sched_Run(void);
+
+/**
+ * @brief  Return whether no event is pending
+ * @return true when Sched_Run() has nothing to do
+ * @note   Check it with interrupts masked right before sleeping.
+ */
+bool Sched_IsIdle(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TASK_SCHED_H_ */
@@ -0,0 +1,268 @@
+/*
+ * @brief GPDMA backed UART receive and transmit
+ *
+ * The receiver streams bytes into a circular buffer through a ring of
+ * linked GPDMA descriptors, one per block, so the CPU never copies
+ * individual characters. Each finished block raises a DMA terminal count
+ * interrupt. The UART character time-out interrupt publishes a partly
+ * filled block once the line goes idle, so short frames reach the
+ * consumer without waiting for the block to fill.
+ *
+ * The consumer reads data in place with UartDma_RxPeek() and
+ * UartDma_RxRelease(). If it falls a whole buffer behind, the oldest
+ * data is skipped and counted as an overrun instead of being silently
+ * mixed with new data.
+ *
+ * The transmitter queues whole buffers. Each one becomes a GPDMA
+ * descriptor, and every buffer queued while the channel is idle is sent
+ * as one linked chain. Completion callbacks run from the DMA interrupt in
+ * queue order. A full queue is reported to the caller instead of
+ * blocking, so the caller decides whether to drop or retry.
+ */
+
+#ifndef __UART_DMA_H_
+#define __UART_DMA_H_
+
+#include "chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup UART_DMA APP: GPDMA UART driver
+ * @{
+ */
+
+/**
+ * @brief Receive statistics
+ */
+typedef struct {
+   uint32_t bytes;             /*!< Bytes handed to the consumer */
+   uint32_t blocks;            /*!< Completed DMA blocks */
+   uint32_t idleFlushes;       /*!< Partial blocks published on character time-out */
+   uint32_t hwOverruns;        /*!< UART FIFO overruns (LSR OE) */
+   uint32_t lineErrors;        /*!< Parity, framing and break errors */
+   uint32_t swOverruns;        /*!< Times the consumer was lapped by the DMA */
+   uint32_t lostBytes;         /*!< Bytes discarded because of swOverruns */
+   uint32_t dmaErrors;         /*!< GPDMA error interrupts */
+   uint32_t rdaStalls;         /*!< FIFO still above the trigger level after the drain wait */
+} UART_DMA_RX_STATS_T;
+
+/**
+ * @brief Receiver state
+ */
+typedef struct {
+   LPC_USART_T *pUART;         /*!< UART being received */
+   uint8_t ch;                 /*!< GPDMA channel */
+   uint8_t *buf;               /*!< Circular buffer, nblocks * blockSize bytes */
+   uint32_t size;              /*!< Buffer size, power of 2 */
+   uint32_t blockSize;         /*!< Bytes per descriptor */
+   uint32_t nblocks;           /*!< Number of descriptors */
+   DMA_TransferDescriptor_t *desc; /*!< Descriptor ring, nblocks entries */
+   volatile uint32_t doneBlocks; /*!< Blocks completed, updated by the DMA interrupt */
+   uint32_t tail;              /*!< Bytes consumed since start (free running) */
+   void (*notify)(void);       /*!< Optional, called from interrupt context when data is published */
+   UART_DMA_RX_STATS_T stats;  /*!< Running statistics */
+} UART_DMA_RX_T;
+
+/** Transmit queue depth, must be a power of 2 */
+#define UART_DMA_TX_SLOTS       8
+
+/** Largest buffer accepted by one transmit request (GPDMA transfer size) */
+#define UART_DMA_TX_MAX_LEN     4095
+
+/**
+ * @brief Transmit completion callback, called from the DMA interrupt
+ * @param ctx      : Context given when the buffer was queued
+ */
+typedef void (*UART_DMA_TX_CB_T)(void *ctx);
+
+/**
+ * @brief Transmit statistics
+ */
+typedef struct {
+   uint32_t frames;            /*!< Buffers sent */
+   uint32_t bytes;             /*!< Bytes sent */
+   uint32_t chains;            /*!< Descriptor chains started */
+   uint32_t rejected;          /*!< Requests refused because the queue or pool was full */
+   uint32_t maxQueued;         /*!< Highest number of buffers waiting at once */
+   uint32_t dmaErrors;         /*!< GPDMA error interrupts */
+} UART_DMA_TX_STATS_T;
+
+/**
+ * @brief One queued transmit buffer
+ */
+typedef struct {
+   const uint8_t *data;        /*!< Bytes to send */
+   uint16_t len;               /*!< Number of bytes */
+   uint16_t poolLen;           /*!< Pool bytes to release on completion, 0 for caller buffers */
+   UART_DMA_TX_CB_T cb;        /*!< Completion callback, may be NULL */
+   void *ctx;                  /*!< Callback context */
+   volatile bool ready;        /*!< Set once the request may be handed to the DMA */
+} UART_DMA_TX_REQ_T;
+
+/**
+ * @brief Transmitter state
+ */
+typedef struct {
+   LPC_USART_T *pUART;         /*!< UART being transmitted on */
+   uint8_t ch;                 /*!< GPDMA channel */
+   uint32_t conn;              /*!< GPDMA_CONN_UARTn_Tx connection */
+   UART_DMA_TX_REQ_T req[UART_DMA_TX_SLOTS]; /*!< Request queue */
+   DMA_TransferDescriptor_t desc[UART_DMA_TX_SLOTS]; /*!< One descriptor per request */
+   uint32_t queued;            /*!< Requests queued (free running) */
+   uint32_t issued;            /*!< Requests handed to the DMA (free running) */
+   uint32_t done;              /*!< Requests completed (free running) */
+   uint8_t *pool;              /*!< Copy pool for UartDma_TxWrite(), may be NULL */
+   uint32_t poolSize;          /*!< Pool size, power of 2 */
+   uint32_t poolHead;          /*!< Pool bytes allocated (free running) */
+   uint32_t poolTail;          /*!< Pool bytes released (free running) */
+   bool busy;                  /*!< A descriptor chain is running */
+   void (*notify)(void);       /*!< Optional, called from interrupt context when requests complete */
+   UART_DMA_TX_STATS_T stats;  /*!< Running statistics */
+} UART_DMA_TX_T;
+
+/**
+ * @brief  Start DMA reception on a UART
+ * @param  pRx         : Receiver state
+ * @param  pUART       : UART, already initialized and with its baud rate set
+ * @param  conn        : GPDMA_CONN_UARTn_Rx connection matching @a pUART
+ * @param  buf         : Circular buffer of @a nblocks * @a blockSize bytes
+ * @param  desc        : Array of @a nblocks descriptors, must stay valid while running
+ * @param  nblocks     : Number of blocks, at least 2
+ * @param  blockSize   : Bytes per block, at most 4095
+ * @return SUCCESS, or ERROR when no DMA channel is available
+ * @note   The total buffer size must be a power of 2. The caller's UART
+ *         interrupt handler must call UartDma_RxUARTHandler().
+ */
+Status UartDma_RxInit(UART_DMA_RX_T *pRx, LPC_USART_T *pUART, uint32_t conn, uint8_t *buf,
+                     DMA_TransferDescriptor_t *desc, uint32_t nblocks, uint32_t blockSize);
+
+/**
+ * @brief  Receive part of a UART interrupt handler
+ * @param  pRx         : Receiver state
+ * @return Nothing
+ * @note   Handles character time-out and line status interrupts only,
+ *         the data itself is moved by the DMA.
+ */
+void UartDma_RxUARTHandler(UART_DMA_RX_T *pRx);
+
+/**
+ * @brief  Return the number of bytes waiting for the consumer
+ * @param  pRx         : Receiver state
+ * @return Bytes available
+ */
+uint32_t UartDma_RxAvailable(UART_DMA_RX_T *pRx);
+
+/**
+ * @brief  Get a contiguous span of received data, without copying
+ * @param  pRx         : Receiver state
+ * @param  data        : Set to the first unread byte
+ * @return Length of the span, 0 if nothing is pending
+ * @note   The span stops at the end of the circular buffer, call again
+ *         after UartDma_RxRelease() to get the wrapped part.
+ */
+uint32_t UartDma_RxPeek(UART_DMA_RX_T *pRx, const uint8_t **data);
+
+/**
+ * @brief  Mark bytes returned by UartDma_RxPeek() as consumed
+ * @param  pRx         : Receiver state
+ * @param  bytes       : Number of bytes consumed
+ * @return Nothing
+ */
+void UartDma_RxRelease(UART_DMA_RX_T *pRx, uint32_t bytes);
+
+/**
+ * @brief  Copy received data out of the circular buffer
+ * @param  pRx         : Receiver state
+ * @param  data        : Destination
+ * @param  bytes       : Maximum bytes to copy
+ * @return Number of bytes copied
+ */
+uint32_t UartDma_RxRead(UART_DMA_RX_T *pRx, void *data, uint32_t bytes);
+
+/**
+ * @brief  Set up DMA transmission on a UART
+ * @param  pTx         : Transmitter state
+ * @param  pUART       : UART, already initialized and with its baud rate set
+ * @param  conn        : GPDMA_CONN_UARTn_Tx connection matching @a pUART
+ * @param  pool        : Buffer used by UartDma_TxWrite() copies, NULL if only
+ *                       UartDma_TxSend() is used
+ * @param  poolSize    : Pool size in bytes, power of 2
+ * @return SUCCESS, or ERROR when no DMA channel is available
+ */
+Status UartDma_TxInit(UART_DMA_TX_T *pTx, LPC_USART_T *pUART, uint32_t conn, uint8_t *pool,
+                     uint32_t poolSize);
+
+/**
+ * @brief  Queue a buffer for transmission without copying it
+ * @param  pTx         : Transmitter state
+ * @param  data        : Bytes to send, must stay valid until @a cb runs
+ * @param  len         : Number of bytes, 1 to UART_DMA_TX_MAX_LEN
+ * @param  cb          : Completion callback, may be NULL
+ * @param  ctx         : Passed to @a cb
+ * @return SUCCESS, or ERROR when the queue is full or @a len is out of range
+ * @note   Safe to call from interrupt handlers.
+ */
+Status UartDma_TxSend(UART_DMA_TX_T *pTx, const void *data, uint32_t len,
+                     UART_DMA_TX_CB_T cb, void *ctx);
+
+/**
+ * @brief  Copy a buffer into the pool and queue it for transmission
+ * @param  pTx         : Transmitter state
+ * @param  data        : Bytes to send
+ * @param  len         : Number of bytes
+ * @return @a len when queued, 0 when the queue or pool is full
+ * @note   The buffer is queued whole or not at all. Safe to call from
+ *         interrupt handlers.
+ */
+uint32_t UartDma_TxWrite(UART_DMA_TX_T *pTx, const void *data, uint32_t len);
+
+/**
+ * @brief  Return the number of pool bytes free for UartDma_TxWrite()
+ * @param  pTx         : Transmitter state
+ * @return Free bytes, 0 when no request slot is free either
+ * @note   A write of this many bytes may still fail when the free space
+ *         wraps around the end of the pool.
+ */
+uint32_t UartDma_TxFree(UART_DMA_TX_T *pTx);
+
+/**
+ * @brief  Return the number of buffers queued or in flight
+ * @param  pTx         : Transmitter state
+ * @return Buffers not yet completed
+ */
+STATIC INLINE uint32_t UartDma_TxPending(const UART_DMA_TX_T *pTx)
+{
+   return pTx->queued - pTx->done;
+}
+
+/**
+ * @brief  Return transmit statistics
+ * @param  pTx         : Transmitter state
+ * @return Pointer to the statistics block
+ */
+STATIC INLINE const UART_DMA_TX_STATS_T *UartDma_TxGetStats(const UART_DMA_TX_T *pTx)
+{
+   return &pTx->stats;
+}
+
+/**
+ * @brief  Return receive statistics
+ * @param  pRx         : Receiver state
+ * @return Pointer to the statistics block
+ */
+STATIC INLINE const UART_DMA_RX_STATS_T *UartDma_RxGetStats(const UART_DMA_RX_T *pRx)
+{
+   return &pRx->stats;
+}
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UART_DMA_H_ */
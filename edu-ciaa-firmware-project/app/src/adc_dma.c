@@ -0,0 +1,246 @@
+/*
+ * @brief Background ADC0/ADC1 acquisition in burst mode through the GPDMA
+ */
+
+#include <string.h>
+#include "board.h"
+#include "adc_dma.h"
+#include "dma.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Channel number field of a data register word */
+#define ADC_DMA_DR_CHN(w)       (((w) >> 24) & 0x7)
+
+/* Channel select field of the control register */
+#define ADC_DMA_CR_SEL_MASK     0xFF
+
+/* Burst size fields of a channel control word */
+#define ADC_DMA_BSIZE_MASK      (GPDMA_DMACCxControl_SBSize(7) | GPDMA_DMACCxControl_DBSize(7))
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Terminal count of a block: publish its last scan as the latest values */
+static void AdcDma_DMAHandler(uint8_t ch, bool error, void *ctx)
+{
+   ADC_DMA_T *pAdc = (ADC_DMA_T *) ctx;
+   const uint32_t *block, *scan;
+   uint32_t k, w, overrun = 0;
+
+   if (error) {
+       pAdc->stats.dmaErrors++;
+       return;
+   }
+
+   block = &pAdc->buf[(pAdc->doneBlocks % pAdc->nblocks) * pAdc->blockWords];
+   if (pAdc->hook != NULL) {
+       pAdc->hook(pAdc, block, pAdc->hookCtx);
+   }
+
+   scan = &block[pAdc->blockWords - pAdc->nch];
+   for (k = 0; k < pAdc->nch; k++) {
+       w = scan[k];
+       pAdc->latest[ADC_DMA_DR_CHN(w)] = ADC_DR_RESULT(w);
+       overrun |= ADC_DR_OVERRUN(w);
+   }
+   pAdc->stats.overruns += overrun;
+
+   pAdc->doneBlocks++;
+   pAdc->stats.blocks++;
+
+   if (pAdc->task != NULL) {
+       Sched_Post(pAdc->task, pAdc->sig, (uint16_t) pAdc->doneBlocks);
+   }
+}
+
+/* Power the ADC with a channel set and start the descriptor ring, the caller then sets the start mode */
+static Status AdcDma_Setup(ADC_DMA_T *pAdc, LPC_ADC_T *pADC, uint8_t chanMask, ADC_CLOCK_SETUP_T *setup,
+                           uint32_t *buf, DMA_TransferDescriptor_t *desc, uint32_t nblocks, uint32_t scans)
+{
+   uint32_t conn = (pADC == LPC_ADC0) ? GPDMA_CONN_ADC_0 : GPDMA_CONN_ADC_1;
+   DMA_TransferDescriptor_t first;
+   uint32_t i, nch = 0;
+
+   memset(pAdc, 0, sizeof(*pAdc));
+   for (i = 0; i < ADC_DMA_CHANNELS; i++) {
+       pAdc->index[i] = nch;
+       pAdc->cal[i].gain = ADC_DMA_GAIN_ONE;
+       if ((chanMask & (1 << i)) != 0) {
+           nch++;
+       }
+   }
+
+   if (nch == 0 || nblocks < 2 || scans == 0 || scans * nch > ADC_DMA_MAX_BLOCK_WORDS) {
+       return ERROR;
+   }
+
+   pAdc->pADC = pADC;
+   pAdc->nch = nch;
+   pAdc->chanMask = chanMask;
+   pAdc->buf = buf;
+   pAdc->desc = desc;
+   pAdc->nblocks = nblocks;
+   pAdc->scans = scans;
+   pAdc->blockWords = scans * nch;
+
+   Dma_Init();
+   pAdc->ch = Dma_AllocChannel(conn, AdcDma_DMAHandler, pAdc);
+   if (pAdc->ch == DMA_CH_NONE) {
+       return ERROR;
+   }
+
+   Board_ADC_Init();
+   Chip_ADC_Init(pADC, setup);
+   pADC->CR = (pADC->CR & ~ADC_DMA_CR_SEL_MASK) | chanMask;
+
+   /* Descriptor ring, one word per request: each request is one conversion */
+   for (i = 0; i < nblocks; i++) {
+       Chip_GPDMA_PrepareDescriptor(LPC_GPDMA, &desc[i], conn, (uint32_t) &buf[i * pAdc->blockWords],
+                                    pAdc->blockWords, GPDMA_TRANSFERTYPE_P2M_CONTROLLER_DMA,
+                                    &desc[(i + 1) % nblocks]);
+       desc[i].ctrl &= ~ADC_DMA_BSIZE_MASK;
+       desc[i].ctrl |= GPDMA_DMACCxControl_SBSize(GPDMA_BSIZE_1) |
+                       GPDMA_DMACCxControl_DBSize(GPDMA_BSIZE_1) | GPDMA_DMACCxControl_I;
+   }
+
+   /* Chip_GPDMA_SGTransfer() takes the connection, not the peripheral
+      address, from the first descriptor */
+   first = desc[0];
+   first.src = conn;
+
+   if (Chip_GPDMA_SGTransfer(LPC_GPDMA, pAdc->ch, &first,
+                             GPDMA_TRANSFERTYPE_P2M_CONTROLLER_DMA) != SUCCESS) {
+       Dma_FreeChannel(pAdc->ch);
+       pAdc->ch = DMA_CH_NONE;
+       return ERROR;
+   }
+
+   /* The global done flag raises the DMA request, the ADC interrupt itself stays off */
+   Chip_ADC_Int_SetGlobalCmd(pADC, ENABLE);
+
+   return SUCCESS;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Start sampling a set of channels */
+Status AdcDma_Init(ADC_DMA_T *pAdc, LPC_ADC_T *pADC, uint8_t chanMask, uint32_t scanHz,
+                   uint32_t *buf, DMA_TransferDescriptor_t *desc, uint32_t nblocks, uint32_t scans)
+{
+   ADC_CLOCK_SETUP_T setup;
+   uint32_t nch = 0, i;
+
+   for (i = 0; i < ADC_DMA_CHANNELS; i++) {
+       nch += (chanMask >> i) & 1;
+   }
+   if (nch == 0 || scanHz == 0 || scanHz > ADC_MAX_SAMPLE_RATE / nch ||
+       AdcDma_Setup(pAdc, pADC, chanMask, &setup, buf, desc, nblocks, scans) != SUCCESS) {
+       return ERROR;
+   }
+
+   setup.burstMode = true;
+   Chip_ADC_SetSampleRate(pADC, &setup, scanHz * nch);
+   Chip_ADC_SetBurstCmd(pADC, ENABLE);
+
+   return SUCCESS;
+}
+
+/* Start sampling one channel on each edge of a start signal */
+Status AdcDma_InitTriggered(ADC_DMA_T *pAdc, LPC_ADC_T *pADC, uint8_t chan, ADC_START_MODE_T start,
+                            ADC_EDGE_CFG_T edge, uint32_t *buf, DMA_TransferDescriptor_t *desc,
+                            uint32_t nblocks, uint32_t scans)
+{
+   ADC_CLOCK_SETUP_T setup;
+
+   if (chan >= ADC_DMA_CHANNELS || start < ADC_START_ON_CTOUT15 ||
+       AdcDma_Setup(pAdc, pADC, 1 << chan, &setup, buf, desc, nblocks, scans) != SUCCESS) {
+       return ERROR;
+   }
+
+   /* Chip_ADC_Init() left the fastest conversion clock, one conversion per edge */
+   Chip_ADC_SetStartMode(pADC, start, edge);
+
+   return SUCCESS;
+}
+
+/* Set the calibration of a channel */
+void AdcDma_SetCal(ADC_DMA_T *pAdc, uint8_t chan, int16_t offset, int32_t gain)
+{
+   pAdc->cal[chan].offset = offset;
+   pAdc->cal[chan].gain = gain;
+}
+
+/* Set a function to run on each completed block */
+void AdcDma_SetHook(ADC_DMA_T *pAdc, ADC_DMA_HOOK_T hook, void *ctx)
+{
+   pAdc->hookCtx = ctx;
+   pAdc->hook = hook;
+}
+
+/* Post an event to a task on each completed block */
+void AdcDma_SetTask(ADC_DMA_T *pAdc, SCHED_TASK_T *task, uint16_t sig)
+{
+   pAdc->sig = sig;
+   pAdc->task = task;
+}
+
+/* Copy out the oldest completed block, calibrated */
+uint32_t AdcDma_ReadBlock(ADC_DMA_T *pAdc, int32_t *out)
+{
+   const uint32_t *block;
+   uint32_t done = pAdc->doneBlocks;
+   uint32_t i, w, chan, scan;
+
+   if (done == pAdc->readBlocks) {
+       return 0;
+   }
+
+   /* The DMA fills the block after the last completed one: everything older than nblocks - 1 is gone */
+   if (done - pAdc->readBlocks > pAdc->nblocks - 1) {
+       pAdc->stats.dropped += done - pAdc->readBlocks - (pAdc->nblocks - 1);
+       pAdc->readBlocks = done - (pAdc->nblocks - 1);
+   }
+
+   block = &pAdc->buf[(pAdc->readBlocks % pAdc->nblocks) * pAdc->blockWords];
+   /* Words are placed by their channel number: a conversion lost to an overrun leaves one value unwritten, the others stay in place */
+   for (i = 0, scan = 0; i < pAdc->blockWords && scan < pAdc->blockWords; i++) {
+       w = block[i];
+       chan = ADC_DMA_DR_CHN(w);
+       out[scan + pAdc->index[chan]] = AdcDma_Calibrate(pAdc, chan, ADC_DR_RESULT(w));
+       if (pAdc->index[chan] == pAdc->nch - 1) {
+           scan += pAdc->nch;
+       }
+   }
+
+   /* Lapped while copying: the copy mixes two passes of the DMA */
+   pAdc->readBlocks++;
+   if (pAdc->doneBlocks - (pAdc->readBlocks - 1) > pAdc->nblocks - 1) {
+       pAdc->stats.dropped++;
+       return 0;
+   }
+   pAdc->stats.read++;
+
+   return pAdc->scans;
+}
+
+/* Stop sampling and free the GPDMA channel */
+void AdcDma_Stop(ADC_DMA_T *pAdc)
+{
+   Chip_ADC_SetBurstCmd(pAdc->pADC, DISABLE);
+   Chip_ADC_Int_SetGlobalCmd(pAdc->pADC, DISABLE);
+   if (pAdc->ch != DMA_CH_NONE) {
+       Dma_FreeChannel(pAdc->ch);
+       pAdc->ch = DMA_CH_NONE;
+   }
+   Chip_ADC_DeInit(pAdc->pADC);
+}
@@ -0,0 +1,109 @@
+/*
+ * @brief Boot phase timestamps
+ */
+
+#include <string.h>
+#include "boottime.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+#if BOOT_TIME_ENABLE && defined(CORE_M4)
+
+static const char *const markNames[BOOT_MARK_COUNT] = {
+   [BOOT_MARK_MUX] = "mux",
+   [BOOT_MARK_CLOCK] = "clock",
+   [BOOT_MARK_DATA] = "data",
+   [BOOT_MARK_BSS] = "bss",
+   [BOOT_MARK_MAIN] = "main",
+   [BOOT_MARK_SAFE] = "safe",
+   [BOOT_MARK_BOARD] = "board",
+   [BOOT_MARK_READY] = "ready",
+};
+
+/* Core clock before the PLL, IRC and crystal alike */
+#define BOOT_CLKIN_MHZ          12
+
+#endif
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+#if BOOT_TIME_ENABLE && defined(CORE_M4)
+/* Written before the .bss banks are cleared */
+uint32_t bootStamps[BOOT_MARK_COUNT] __NOINIT(RAM2);
+#endif
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+#if BOOT_TIME_ENABLE && defined(CORE_M4)
+
+/* Append an unsigned decimal number */
+static int Boot_FormatU32(char *out, uint32_t u)
+{
+   char tmp[10];
+   int n = 0, len = 0;
+
+   do {
+       tmp[n++] = (char) ('0' + (u % 10));
+       u /= 10;
+   } while (u != 0);
+   while (n > 0) {
+       out[len++] = tmp[--n];
+   }
+
+   return len;
+}
+
+#endif
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Return the time from reset to the end of a phase */
+uint32_t Boot_GetUs(BOOT_MARK_T mark)
+{
+#if BOOT_TIME_ENABLE && defined(CORE_M4)
+   uint32_t slow = bootStamps[BOOT_MARK_CLOCK];
+
+   if (mark <= BOOT_MARK_CLOCK) {
+       return bootStamps[mark] / BOOT_CLKIN_MHZ;
+   }
+   return slow / BOOT_CLKIN_MHZ + (bootStamps[mark] - slow) / (SystemCoreClock / 1000000);
+#else
+   return 0;
+#endif
+}
+
+/* Format the stamp of one phase as a text line */
+int Boot_FormatLine(uint32_t line, char *buf)
+{
+#if BOOT_TIME_ENABLE && defined(CORE_M4)
+   int len;
+
+   if (line >= BOOT_MARK_COUNT) {
+       return 0;
+   }
+
+   len = strlen(markNames[line]);
+   memcpy(buf, "BT:", 3);
+   memcpy(&buf[3], markNames[line], len);
+   len += 3;
+   buf[len++] = ',';
+   len += Boot_FormatU32(&buf[len], bootStamps[line]);
+   buf[len++] = ',';
+   len += Boot_FormatU32(&buf[len], Boot_GetUs((BOOT_MARK_T) line));
+   buf[len++] = '\r';
+   buf[len++] = '\n';
+
+   return len;
+#else
+   return 0;
+#endif
+}
@@ -0,0 +1,249 @@
+/*
+ * @brief Fixed-rate control loop scheduler on the RI timer
+ */
+
+#include "control_loop.h"
+#include "cycles.h"
+#include "evtrace.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+typedef struct {
+   CTRL_TASK_FN_T fn;
+   void *ctx;
+   uint32_t period;            /* Base ticks between runs */
+   uint32_t countdown;         /* Base ticks until the next run */
+   uint32_t periodCycles;      /* Deadline in core cycles */
+   uint32_t wcetCycles;        /* Declared execution time in core cycles */
+   CTRL_TASK_STATS_T stats;
+} CTRL_TASK_T;
+
+static CTRL_TASK_T tasks[CTRL_LOOP_MAX_TASKS];
+static uint8_t order[CTRL_LOOP_MAX_TASKS];     /* Task ids, shortest period first */
+static volatile uint8_t numTasks;
+
+static CTRL_LOOP_STATS_T loopStats;
+static uint32_t baseRate;
+static uint32_t tickCycles;                    /* Nominal tick period in core cycles */
+static uint32_t budgetCycles;                  /* Tick cycles not yet claimed by a task */
+static uint32_t lastEntry;
+static bool haveEntry;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Record the interval since the previous tick */
+__HOT_FUNC static void CtrlLoop_Jitter(uint32_t entry)
+{
+   int32_t jitter;
+
+   if (haveEntry) {
+       jitter = (int32_t) (entry - lastEntry - tickCycles);
+       loopStats.jitterLast = jitter;
+       if (jitter < loopStats.jitterMin) {
+           loopStats.jitterMin = jitter;
+       }
+       if (jitter > loopStats.jitterMax) {
+           loopStats.jitterMax = jitter;
+       }
+   }
+   lastEntry = entry;
+   haveEntry = true;
+}
+
+/* Run one task and account for its time */
+__HOT_FUNC static void CtrlLoop_Run(CTRL_TASK_T *pTask, uint32_t entry)
+{
+   uint32_t start = Cycles_Now();
+   uint32_t end, response;
+
+   pTask->fn(pTask->ctx);
+
+   end = Cycles_Now();
+   response = end - entry;
+   pTask->stats.runs++;
+   pTask->stats.lastCycles = end - start;
+   if (pTask->stats.lastCycles > pTask->stats.maxCycles) {
+       pTask->stats.maxCycles = pTask->stats.lastCycles;
+   }
+   if (pTask->stats.lastCycles > pTask->wcetCycles) {
+       pTask->stats.overBudget++;
+   }
+   if (response > pTask->stats.maxResponse) {
+       pTask->stats.maxResponse = response;
+   }
+   if (response > pTask->periodCycles) {
+       pTask->stats.overruns++;
+   }
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* RI timer interrupt: run every task that is due, fastest first */
+__HOT_FUNC void RIT_IRQHandler(void)
+{
+   uint32_t entry = Cycles_Now();
+   uint32_t cycles;
+   uint8_t i, n = numTasks;
+   CTRL_TASK_T *pTask;
+
+   Chip_RIT_ClearInt(LPC_RITIMER);
+   EVTRACE(CTRL_BEGIN, loopStats.ticks);
+   CtrlLoop_Jitter(entry);
+   loopStats.ticks++;
+
+   for (i = 0; i < n; i++) {
+       pTask = &tasks[order[i]];
+       if (--pTask->countdown == 0) {
+           pTask->countdown = pTask->period;
+           CtrlLoop_Run(pTask, entry);
+       }
+   }
+
+   cycles = Cycles_Now() - entry;
+   if (cycles > loopStats.maxTickCycles) {
+       loopStats.maxTickCycles = cycles;
+   }
+
+   /* The next compare match already happened: this tick ran too long */
+   if (Chip_RIT_GetIntStatus(LPC_RITIMER) == SET) {
+       loopStats.lateTicks++;
+       EVTRACE(CTRL_LATE, loopStats.lateTicks);
+   }
+   EVTRACE(CTRL_END, 0);
+}
+
+/* Initialize the RI timer for the control loop */
+void CtrlLoop_Init(uint32_t baseHz)
+{
+   baseRate = baseHz;
+   tickCycles = SystemCoreClock / baseHz;
+   budgetCycles = (uint32_t) ((uint64_t) tickCycles * CTRL_LOOP_BUDGET_PCT / 100);
+   numTasks = 0;
+   CtrlLoop_ResetStats();
+   Cycles_Init();
+
+   Chip_RIT_Init(LPC_RITIMER);
+   Chip_RIT_Disable(LPC_RITIMER);
+
+   /* Chip_RIT_SetTimerInterval() only takes whole milliseconds, set the
+      compare value directly so sub-millisecond base periods work too */
+   Chip_RIT_SetCOMPVAL(LPC_RITIMER, Chip_Clock_GetRate(CLK_MX_RITIMER) / baseHz - 1);
+   Chip_RIT_EnableCTRL(LPC_RITIMER, RIT_CTRL_ENCLR);
+   Chip_RIT_ClearInt(LPC_RITIMER);
+
+   NVIC_SetPriority(RITIMER_IRQn, CTRL_LOOP_IRQ_PRIO);
+}
+
+/* Register a control task */
+int CtrlLoop_AddTask(CTRL_TASK_FN_T fn, void *ctx, uint32_t rateHz, uint32_t wcetUs)
+{
+   CTRL_TASK_T *pTask;
+   uint32_t period, wcet, same = 0;
+   uint8_t id = numTasks, i, pos;
+
+   if (fn == NULL || rateHz == 0 || rateHz > baseRate || (baseRate % rateHz) != 0 ||
+       id >= CTRL_LOOP_MAX_TASKS) {
+       return -1;
+   }
+   period = baseRate / rateHz;
+
+   /* Tasks are not preempted, so every task may land on the same tick as
+      all the others: their execution times must add up to less than one */
+   wcet = (uint32_t) ((uint64_t) SystemCoreClock * wcetUs / 1000000);
+   if (wcet == 0 || wcet > budgetCycles) {
+       return -1;
+   }
+   budgetCycles -= wcet;
+
+   /* Stagger tasks sharing a period so their runs land on different ticks */
+   for (i = 0; i < id; i++) {
+       if (tasks[i].period == period) {
+           same++;
+       }
+   }
+
+   pTask = &tasks[id];
+   pTask->fn = fn;
+   pTask->ctx = ctx;
+   pTask->period = period;
+   pTask->countdown = (same % period) + 1;
+   pTask->periodCycles = tickCycles * period;
+   pTask->wcetCycles = wcet;
+
+   NVIC_DisableIRQ(RITIMER_IRQn);
+
+   /* Shortest period first: insert after every task with a shorter or equal period */
+   pos = id;
+   while (pos > 0 && tasks[order[pos - 1]].period > period) {
+       order[pos] = order[pos - 1];
+       pos--;
+   }
+   order[pos] = id;
+   numTasks = id + 1;
+
+   if (LPC_RITIMER->CTRL & RIT_CTRL_TEN) {
+       NVIC_EnableIRQ(RITIMER_IRQn);
+   }
+
+   return id;
+}
+
+/* Start ticking */
+void CtrlLoop_Start(void)
+{
+   haveEntry = false;
+   LPC_RITIMER->COUNTER = 0;
+   Chip_RIT_ClearInt(LPC_RITIMER);
+   NVIC_ClearPendingIRQ(RITIMER_IRQn);
+   NVIC_EnableIRQ(RITIMER_IRQn);
+   Chip_RIT_Enable(LPC_RITIMER);
+}
+
+/* Stop ticking, registered tasks are kept */
+void CtrlLoop_Stop(void)
+{
+   Chip_RIT_Disable(LPC_RITIMER);
+   NVIC_DisableIRQ(RITIMER_IRQn);
+}
+
+/* Return scheduler statistics */
+const CTRL_LOOP_STATS_T *CtrlLoop_GetStats(void)
+{
+   return &loopStats;
+}
+
+/* Return statistics for one task */
+const CTRL_TASK_STATS_T *CtrlLoop_GetTaskStats(int id)
+{
+   if (id < 0 || id >= numTasks) {
+       return NULL;
+   }
+
+   return &tasks[id].stats;
+}
+
+/* Clear scheduler and task statistics */
+void CtrlLoop_ResetStats(void)
+{
+   CTRL_LOOP_STATS_T zero = {0};
+   CTRL_TASK_STATS_T zeroTask = {0};
+   uint8_t i;
+
+   loopStats = zero;
+   loopStats.jitterMin = INT32_MAX;
+   loopStats.jitterMax = INT32_MIN;
+   for (i = 0; i < CTRL_LOOP_MAX_TASKS; i++) {
+       tasks[i].stats = zeroTask;
+   }
+}
@@ -0,0 +1,100 @@
+/*
+ * @brief GPDMA channel allocation and interrupt dispatch
+ */
+
+#include "dma.h"
+#include "prof.h"
+#include "evtrace.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+typedef struct {
+   DMA_HANDLER_T handler;
+   void *ctx;
+   bool used;
+} DMA_SLOT_T;
+
+static DMA_SLOT_T dmaSlots[GPDMA_NUMBER_CHANNELS];
+static bool dmaReady;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* GPDMA interrupt: route each pending channel to its owner */
+__HOT_FUNC void DMA_IRQHandler(void)
+{
+   uint32_t tc, err;
+   uint8_t ch;
+
+   PROF_BEGIN(DMA_IRQ);
+   tc = LPC_GPDMA->INTTCSTAT;
+   err = LPC_GPDMA->INTERRSTAT;
+   EVTRACE(DMA_IRQ_BEGIN, tc | (err << 8));
+   LPC_GPDMA->INTTCCLEAR = tc;
+   LPC_GPDMA->INTERRCLR = err;
+
+   for (ch = 0; ch < GPDMA_NUMBER_CHANNELS; ch++) {
+       uint32_t bit = 1UL << ch;
+
+       if (((tc | err) & bit) != 0 && dmaSlots[ch].handler != NULL) {
+           dmaSlots[ch].handler(ch, (err & bit) != 0, dmaSlots[ch].ctx);
+       }
+   }
+
+   EVTRACE(DMA_IRQ_END, 0);
+   PROF_END(DMA_IRQ);
+}
+
+/* Initialize the GPDMA controller and enable its interrupt */
+void Dma_Init(void)
+{
+   if (dmaReady) {
+       return;
+   }
+   dmaReady = true;
+
+   Chip_GPDMA_Init(LPC_GPDMA);
+   NVIC_SetPriority(DMA_IRQn, DMA_IRQ_PRIO);
+   NVIC_EnableIRQ(DMA_IRQn);
+}
+
+/* Allocate a channel and register its interrupt handler */
+uint8_t Dma_AllocChannel(uint32_t conn, DMA_HANDLER_T handler, void *ctx)
+{
+   uint8_t ch = Chip_GPDMA_GetFreeChannel(LPC_GPDMA, conn);
+
+   /* Chip_GPDMA_GetFreeChannel() also returns 0 when nothing is free */
+   if (dmaSlots[ch].used) {
+       return DMA_CH_NONE;
+   }
+
+   dmaSlots[ch].handler = handler;
+   dmaSlots[ch].ctx = ctx;
+   dmaSlots[ch].used = true;
+
+   return ch;
+}
+
+/* Stop a channel and return it to the free pool */
+void Dma_FreeChannel(uint8_t ch)
+{
+   if (ch >= GPDMA_NUMBER_CHANNELS) {
+       return;
+   }
+
+   Chip_GPDMA_Stop(LPC_GPDMA, ch);
+   dmaSlots[ch].handler = NULL;
+   dmaSlots[ch].used = false;
+}
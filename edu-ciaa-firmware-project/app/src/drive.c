@@ -0,0 +1,147 @@
+/*
+ * @brief Closed-loop wheel speed and heading control
+ */
+
+#include "drive.h"
+#include "encoder.h"
+#include "motor.h"
+#include "pid.h"
+#include "prof.h"
+#include "evtrace.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Both setpoints in one word so the control task never sees half an update */
+#define DRIVE_PACK(l, r)        (((uint32_t) (uint16_t) (l)) | ((uint32_t) (uint16_t) (r) << 16))
+#define DRIVE_LEFT(w)           ((int16_t) ((w) & 0xFFFF))
+#define DRIVE_RIGHT(w)          ((int16_t) ((w) >> 16))
+
+static volatile uint32_t setpoints;
+
+static PID_F32_T wheelPid[ENCODER_COUNT];
+static PID_F32_T headingPid;
+static float headingRef;        /* Wheel difference asked for since the last stop, revolutions */
+static int32_t startPos[ENCODER_COUNT];
+static float invCpr[ENCODER_COUNT];
+static bool running;
+static int taskId = -1;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Wheel travel since the last stop, in revolutions */
+STATIC INLINE float Drive_Travel(ENCODER_ID_T id)
+{
+   return (float) (Encoder_GetPosition(id) - startPos[id]) * invCpr[id];
+}
+
+/* Control task: heading trim, then both wheel loops */
+__HOT_FUNC static void Drive_Task(void *ctx)
+{
+   uint32_t sp;
+   float spLeft, spRight, trim, uLeft, uRight;
+
+   PROF_BEGIN(DRIVE);
+   EVTRACE(DRIVE_BEGIN, 0);
+   sp = setpoints;
+
+   /* A current trip holds the motors off: start over once it is cleared */
+   if (sp == 0 || Motor_IsTripped()) {
+       if (running) {
+           running = false;
+           Motor_Stop();
+       }
+       EVTRACE(DRIVE_END, 0);
+       PROF_END(DRIVE);
+       return;
+   }
+
+   if (!running) {
+       running = true;
+       headingRef = 0.0f;
+       startPos[ENCODER_LEFT] = Encoder_GetPosition(ENCODER_LEFT);
+       startPos[ENCODER_RIGHT] = Encoder_GetPosition(ENCODER_RIGHT);
+       Pid_F32_Reset(&wheelPid[ENCODER_LEFT]);
+       Pid_F32_Reset(&wheelPid[ENCODER_RIGHT]);
+       Pid_F32_Reset(&headingPid);
+   }
+
+   spLeft = DRIVE_LEFT(sp) * (DRIVE_MAX_RPS / 255.0f);
+   spRight = DRIVE_RIGHT(sp) * (DRIVE_MAX_RPS / 255.0f);
+
+   headingRef += (spLeft - spRight) * (1.0f / DRIVE_RATE_HZ);
+   trim = Pid_F32_Update(&headingPid, headingRef,
+                         Drive_Travel(ENCODER_LEFT) - Drive_Travel(ENCODER_RIGHT));
+
+   uLeft = Pid_F32_Update(&wheelPid[ENCODER_LEFT], spLeft + trim,
+                          Encoder_GetVelocity(ENCODER_LEFT) * invCpr[ENCODER_LEFT]);
+   uRight = Pid_F32_Update(&wheelPid[ENCODER_RIGHT], spRight - trim,
+                           Encoder_GetVelocity(ENCODER_RIGHT) * invCpr[ENCODER_RIGHT]);
+
+   Motor_Set((int32_t) uLeft, (int32_t) uRight);
+   EVTRACE(DRIVE_END, 0);
+   PROF_END(DRIVE);
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Set up the controllers and register the control task */
+Status Drive_Init(void)
+{
+   PID_CFG_T wheel = {
+       .kp = DRIVE_WHEEL_KP, .ki = DRIVE_WHEEL_KI, .kd = DRIVE_WHEEL_KD, .kff = DRIVE_WHEEL_KFF,
+       .dFilterHz = DRIVE_D_FILTER_HZ, .outMin = -MOTOR_SPEED_MAX, .outMax = MOTOR_SPEED_MAX,
+       .rateHz = DRIVE_RATE_HZ,
+   };
+   PID_CFG_T heading = {
+       .kp = DRIVE_HEADING_KP, .ki = DRIVE_HEADING_KI, .kd = DRIVE_HEADING_KD, .kff = 0.0f,
+       .dFilterHz = DRIVE_D_FILTER_HZ, .outMin = -DRIVE_HEADING_MAX_RPS,
+       .outMax = DRIVE_HEADING_MAX_RPS, .rateHz = DRIVE_RATE_HZ,
+   };
+   ENCODER_STATE_T state;
+   uint8_t id;
+
+   for (id = 0; id < ENCODER_COUNT; id++) {
+       Encoder_Read((ENCODER_ID_T) id, &state);
+       invCpr[id] = 1.0f / state.countsPerRev;
+       Pid_F32_Init(&wheelPid[id], &wheel);
+   }
+   Pid_F32_Init(&headingPid, &heading);
+
+   setpoints = 0;
+   running = false;
+   taskId = CtrlLoop_AddTask(Drive_Task, NULL, DRIVE_RATE_HZ, DRIVE_WCET_US);
+
+   return (taskId < 0) ? ERROR : SUCCESS;
+}
+
+/* Set both wheel speed setpoints */
+void Drive_SetSpeed(int16_t left, int16_t right)
+{
+   left = MIN(MAX(left, -MOTOR_SPEED_MAX), MOTOR_SPEED_MAX);
+   right = MIN(MAX(right, -MOTOR_SPEED_MAX), MOTOR_SPEED_MAX);
+   setpoints = DRIVE_PACK(left, right);
+}
+
+/* Set both setpoints to zero and let the wheels coast at once */
+void Drive_Stop(void)
+{
+   setpoints = 0;
+   Motor_Stop();
+}
+
+/* Return the control task statistics */
+const CTRL_TASK_STATS_T *Drive_GetTaskStats(void)
+{
+   return CtrlLoop_GetTaskStats(taskId);
+}
@@ -0,0 +1,240 @@
+/*
+ * @brief Wheel encoders
+ */
+
+#include "encoder.h"
+#include "prof.h"
+#include "evtrace.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Counter rate of the capture timer, 1 tick per microsecond */
+#define ENCODER_CAP_HZ          1000000
+
+/* Match register used for the stall time-out */
+#define ENCODER_CAP_STALL_MATCH 0
+
+/* QEI channel, position and index count come straight from the hardware */
+static volatile int32_t qeiVelocity;
+static volatile int32_t qeiIndexPosition;
+static volatile uint32_t qeiDirChanges;
+static volatile uint32_t qeiErrors;
+static int32_t qeiOffset;
+
+/* Capture channel */
+static volatile int32_t capPosition;
+static volatile int32_t capVelocity;
+static volatile uint32_t capDirChanges;
+static uint32_t capLast;
+static bool capHaveEdge;
+static bool capReverse;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Set up the QEI in 4x mode with the velocity timer running */
+static void Encoder_InitQEI(void)
+{
+   Chip_SCU_PinMuxSet(ENCODER_QEI_PORT, ENCODER_QEI_PHA_PIN,
+                      SCU_MODE_INACT | SCU_MODE_INBUFF_EN | ENCODER_QEI_FUNC);
+   Chip_SCU_PinMuxSet(ENCODER_QEI_PORT, ENCODER_QEI_PHB_PIN,
+                      SCU_MODE_INACT | SCU_MODE_INBUFF_EN | ENCODER_QEI_FUNC);
+   Chip_SCU_PinMuxSet(ENCODER_QEI_PORT, ENCODER_QEI_IDX_PIN,
+                      SCU_MODE_INACT | SCU_MODE_INBUFF_EN | ENCODER_QEI_FUNC);
+
+   Chip_QEI_Init(LPC_QEI);
+   Chip_QEI_SetConfig(LPC_QEI, QEI_CONF_CAPMODE);
+   /* Reject glitches shorter than about 1 us at the QEI clock */
+   Chip_QEI_SetFilters(LPC_QEI, 200, 200, 200);
+   Chip_QEI_SetVelocityPeriod(LPC_QEI, ENCODER_VEL_PERIOD_US);
+
+   Chip_QEI_ClearIntStatus(LPC_QEI, QEI_INT_BITMASK);
+   Chip_QEI_IntEnable(LPC_QEI, QEI_INT_TIM | QEI_INT_INX | QEI_INT_DIR | QEI_INT_ERR);
+   NVIC_SetPriority(QEI_IRQn, ENCODER_IRQ_PRIO);
+   NVIC_EnableIRQ(QEI_IRQn);
+}
+
+/* Set up a timer capture on phase A and a GPIO input on phase B */
+static void Encoder_InitCapture(void)
+{
+   Chip_SCU_PinMuxSet(ENCODER_CAP_A_PORT, ENCODER_CAP_A_PIN,
+                      SCU_MODE_INACT | SCU_MODE_INBUFF_EN | ENCODER_CAP_A_FUNC);
+   Chip_SCU_PinMuxSet(ENCODER_CAP_B_PORT, ENCODER_CAP_B_PIN,
+                      SCU_MODE_INACT | SCU_MODE_INBUFF_EN | ENCODER_CAP_B_FUNC);
+   Chip_GPIO_SetPinDIRInput(LPC_GPIO_PORT, ENCODER_CAP_B_GPIO_PORT, ENCODER_CAP_B_GPIO_PIN);
+
+   /* Capture inputs reach the timers through the GIMA, synchronized to the timer clock */
+   LPC_GIMA->CAP0_IN[ENCODER_CAP_TIMER_NUM][ENCODER_CAP_CH] = (ENCODER_CAP_GIMA_SEL << 4) | (1 << 2);
+
+   Chip_TIMER_Init(ENCODER_CAP_TIMER);
+   Chip_TIMER_Reset(ENCODER_CAP_TIMER);
+   Chip_TIMER_PrescaleSet(ENCODER_CAP_TIMER,
+                          Chip_Clock_GetRate(ENCODER_CAP_CLK) / ENCODER_CAP_HZ - 1);
+   Chip_TIMER_CaptureRisingEdgeEnable(ENCODER_CAP_TIMER, ENCODER_CAP_CH);
+   Chip_TIMER_CaptureEnableInt(ENCODER_CAP_TIMER, ENCODER_CAP_CH);
+   Chip_TIMER_MatchEnableInt(ENCODER_CAP_TIMER, ENCODER_CAP_STALL_MATCH);
+   Chip_TIMER_SetMatch(ENCODER_CAP_TIMER, ENCODER_CAP_STALL_MATCH, ENCODER_STALL_US);
+   Chip_TIMER_Enable(ENCODER_CAP_TIMER);
+
+   NVIC_SetPriority(ENCODER_CAP_IRQn, ENCODER_IRQ_PRIO);
+   NVIC_EnableIRQ(ENCODER_CAP_IRQn);
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* QEI interrupt: velocity period end, index, direction change, phase error */
+__HOT_FUNC void QEI_IRQHandler(void)
+{
+   uint32_t status;
+   int32_t vel;
+
+   PROF_BEGIN(QEI_IRQ);
+   EVTRACE(QEI_IRQ_BEGIN, 0);
+
+   status = Chip_QEI_GetIntStatus(LPC_QEI);
+   Chip_QEI_ClearIntStatus(LPC_QEI, status);
+
+   if (status & QEI_INT_TIM) {
+       vel = (int32_t) (Chip_QEI_GetVelocityCapture(LPC_QEI) * (1000000 / ENCODER_VEL_PERIOD_US));
+       qeiVelocity = Chip_QEI_GetDirection(LPC_QEI) ? -vel : vel;
+   }
+   if (status & QEI_INT_INX) {
+       qeiIndexPosition = (int32_t) Chip_QEI_GetPosition(LPC_QEI) - qeiOffset;
+   }
+   if (status & QEI_INT_DIR) {
+       qeiDirChanges++;
+   }
+   if (status & QEI_INT_ERR) {
+       qeiErrors++;
+   }
+
+   EVTRACE(QEI_IRQ_END, status);
+   PROF_END(QEI_IRQ);
+}
+
+/* Capture timer interrupt: one call per phase A rising edge, plus the stall time-out */
+__HOT_FUNC void ENCODER_CAP_IRQHandler(void)
+{
+   uint32_t cap, period;
+   bool reverse;
+
+   PROF_BEGIN(ENC_CAP_IRQ);
+   EVTRACE(ENC_CAP_BEGIN, 0);
+
+   if (Chip_TIMER_MatchPending(ENCODER_CAP_TIMER, ENCODER_CAP_STALL_MATCH)) {
+       Chip_TIMER_ClearMatch(ENCODER_CAP_TIMER, ENCODER_CAP_STALL_MATCH);
+       capVelocity = 0;
+       capHaveEdge = false;
+   }
+
+   if (Chip_TIMER_CapturePending(ENCODER_CAP_TIMER, ENCODER_CAP_CH)) {
+       Chip_TIMER_ClearCapture(ENCODER_CAP_TIMER, ENCODER_CAP_CH);
+       cap = Chip_TIMER_ReadCapture(ENCODER_CAP_TIMER, ENCODER_CAP_CH);
+
+       /* A rising while B is low means forward */
+       reverse = Chip_GPIO_GetPinState(LPC_GPIO_PORT, ENCODER_CAP_B_GPIO_PORT,
+                                       ENCODER_CAP_B_GPIO_PIN);
+       if (reverse != capReverse) {
+           capReverse = reverse;
+           capDirChanges++;
+           capHaveEdge = false;
+       }
+       capPosition += reverse ? -1 : 1;
+
+       /* The first edge after a stop or reversal only starts the period */
+       if (capHaveEdge) {
+           period = cap - capLast;
+           capVelocity = (int32_t) (ENCODER_CAP_HZ / MAX(period, 1));
+           if (reverse) {
+               capVelocity = -capVelocity;
+           }
+       }
+       capLast = cap;
+       capHaveEdge = true;
+
+       Chip_TIMER_SetMatch(ENCODER_CAP_TIMER, ENCODER_CAP_STALL_MATCH, cap + ENCODER_STALL_US);
+   }
+
+   EVTRACE(ENC_CAP_END, capPosition);
+   PROF_END(ENC_CAP_IRQ);
+}
+
+/* Configure both encoder channels and enable their interrupts */
+void Encoder_Init(void)
+{
+   Encoder_InitQEI();
+   Encoder_InitCapture();
+}
+
+/* Take a consistent snapshot of one encoder */
+void Encoder_Read(ENCODER_ID_T id, ENCODER_STATE_T *pState)
+{
+   uint32_t primask = __get_PRIMASK();
+
+   __disable_irq();
+   if (id == ENCODER_LEFT) {
+       pState->position = (int32_t) Chip_QEI_GetPosition(LPC_QEI) - qeiOffset;
+       pState->velocity = qeiVelocity;
+       pState->countsPerRev = 4 * ENCODER_LINES;
+       pState->indexCount = Chip_QEI_GetIndexCount(LPC_QEI);
+       pState->indexPosition = qeiIndexPosition;
+       pState->dirChanges = qeiDirChanges;
+       pState->errors = qeiErrors;
+   }
+   else {
+       pState->position = capPosition;
+       pState->velocity = capVelocity;
+       pState->countsPerRev = ENCODER_LINES;
+       pState->indexCount = 0;
+       pState->indexPosition = 0;
+       pState->dirChanges = capDirChanges;
+       pState->errors = 0;
+   }
+   __set_PRIMASK(primask);
+}
+
+/* Return the position of one encoder */
+__HOT_FUNC int32_t Encoder_GetPosition(ENCODER_ID_T id)
+{
+   if (id == ENCODER_LEFT) {
+       return (int32_t) Chip_QEI_GetPosition(LPC_QEI) - qeiOffset;
+   }
+
+   return capPosition;
+}
+
+/* Return the velocity of one encoder */
+__HOT_FUNC int32_t Encoder_GetVelocity(ENCODER_ID_T id)
+{
+   return (id == ENCODER_LEFT) ? qeiVelocity : capVelocity;
+}
+
+/* Return the wheel speed of one encoder */
+int32_t Encoder_GetRPM(ENCODER_ID_T id)
+{
+   int32_t cpr = (id == ENCODER_LEFT) ? 4 * ENCODER_LINES : ENCODER_LINES;
+
+   return (Encoder_GetVelocity(id) * 60) / cpr;
+}
+
+/* Zero the position of one encoder */
+void Encoder_ResetPosition(ENCODER_ID_T id)
+{
+   if (id == ENCODER_LEFT) {
+       /* Keep the hardware counter running so the index position stays valid */
+       qeiOffset = (int32_t) Chip_QEI_GetPosition(LPC_QEI);
+   }
+   else {
+       capPosition = 0;
+   }
+}
@@ -0,0 +1,231 @@
+/*
+ * @brief Post-mortem event trace
+ */
+
+#include <string.h>
+#include "chip.h"
+#include "cycles.h"
+#include "evtrace.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+#if EVTRACE_ENABLE
+
+#define EVTRACE_MAGIC           0x45565452      /* "EVTR" */
+
+typedef struct {
+   EVTRACE_HDR_T hdr;
+   EVTRACE_REC_T rec[EVTRACE_RECORDS];
+} EVTRACE_BUF_T;
+
+/* NOLOAD: neither copied nor cleared by the startup code */
+static EVTRACE_BUF_T ring __attribute__ ((section(".noinit.$RamAHB_ETB16")));
+
+#endif
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+#if EVTRACE_ENABLE
+
+/* Append an unsigned decimal number */
+static int EvTrace_FormatU32(char *out, uint32_t u)
+{
+   char tmp[10];
+   int n = 0, len = 0;
+
+   do {
+       tmp[n++] = (char) ('0' + (u % 10));
+       u /= 10;
+   } while (u != 0);
+   while (n > 0) {
+       out[len++] = tmp[--n];
+   }
+
+   return len;
+}
+
+/* Append a fixed width hexadecimal number */
+static int EvTrace_FormatHex(char *out, uint32_t u, int digits)
+{
+   static const char hex[] = "0123456789abcdef";
+   int i;
+
+   for (i = digits - 1; i >= 0; i--) {
+       out[i] = hex[u & 0xF];
+       u >>= 4;
+   }
+
+   return digits;
+}
+
+/* Empty the ring and clear the frozen flag */
+static void EvTrace_Clear(void)
+{
+   ring.hdr.head = 0;
+   ring.hdr.total = 0;
+   ring.hdr.flags = 0;
+}
+
+#endif
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Validate the ring left by the previous run and start recording */
+void EvTrace_Init(void)
+{
+#if EVTRACE_ENABLE
+   Cycles_Init();
+
+   if (ring.hdr.magic == EVTRACE_MAGIC && ring.hdr.records == EVTRACE_RECORDS &&
+       ring.hdr.head < EVTRACE_RECORDS) {
+       ring.hdr.boots++;
+       if (EVTRACE_HOLD_ON_RESET && ring.hdr.total != 0) {
+           ring.hdr.flags |= EVTRACE_FLAG_FROZEN;
+       }
+       if ((ring.hdr.flags & EVTRACE_FLAG_FROZEN) != 0) {
+           return;
+       }
+   }
+   else {
+       /* Power on: the RAM holds garbage */
+       ring.hdr.magic = EVTRACE_MAGIC;
+       ring.hdr.records = EVTRACE_RECORDS;
+       ring.hdr.boots = 0;
+   }
+
+   EvTrace_Clear();
+   EVTRACE(BOOT, ring.hdr.boots);
+#endif
+}
+
+/* Append one record */
+__HOT_FUNC void EvTrace_Record(EVTRACE_ID_T id, uint16_t arg)
+{
+#if EVTRACE_ENABLE
+   uint32_t primask = __get_PRIMASK();
+   EVTRACE_REC_T *p;
+   uint32_t head;
+
+   __disable_irq();
+   if ((ring.hdr.flags & EVTRACE_FLAG_FROZEN) == 0) {
+       head = ring.hdr.head;
+       p = &ring.rec[head];
+       p->cycles = Cycles_Now();
+       p->arg = arg;
+       p->id = (uint8_t) id;
+       p->ctx = (uint8_t) __get_IPSR();
+       ring.hdr.head = (head + 1 == EVTRACE_RECORDS) ? 0 : head + 1;
+       ring.hdr.total++;
+   }
+   __set_PRIMASK(primask);
+#endif
+}
+
+/* Stop recording and keep the ring */
+void EvTrace_Freeze(void)
+{
+#if EVTRACE_ENABLE
+   ring.hdr.flags |= EVTRACE_FLAG_FROZEN;
+#endif
+}
+
+/* Clear the ring and start recording */
+void EvTrace_Arm(void)
+{
+#if EVTRACE_ENABLE
+   uint32_t primask = __get_PRIMASK();
+
+   __disable_irq();
+   EvTrace_Clear();
+   __set_PRIMASK(primask);
+   EVTRACE(ARM, ring.hdr.boots);
+#endif
+}
+
+/* Return whether recording is stopped */
+bool EvTrace_IsFrozen(void)
+{
+#if EVTRACE_ENABLE
+   return (ring.hdr.flags & EVTRACE_FLAG_FROZEN) != 0;
+#else
+   return true;
+#endif
+}
+
+/* Format one line of the ring, oldest records first */
+int EvTrace_FormatLine(uint32_t line, char *buf)
+{
+#if EVTRACE_ENABLE
+   uint32_t count = MIN(ring.hdr.total, EVTRACE_RECORDS);
+   uint32_t oldest = (ring.hdr.total > EVTRACE_RECORDS) ? ring.hdr.head : 0;
+   uint32_t n, idx, i;
+   const EVTRACE_REC_T *p;
+   int len = 3;
+
+   memcpy(buf, "TR:", 3);
+   if (line == 0) {
+       len += EvTrace_FormatU32(&buf[len], ring.hdr.boots);
+       buf[len++] = ',';
+       len += EvTrace_FormatU32(&buf[len], SystemCoreClock);
+       buf[len++] = ',';
+       len += EvTrace_FormatU32(&buf[len], ring.hdr.total);
+       buf[len++] = ',';
+       len += EvTrace_FormatU32(&buf[len], EVTRACE_RECORDS);
+       buf[len++] = ',';
+       len += EvTrace_FormatU32(&buf[len], ring.hdr.flags);
+   }
+   else {
+       n = (line - 1) * EVTRACE_PER_LINE;
+       if (n >= count) {
+           return 0;
+       }
+       len += EvTrace_FormatU32(&buf[len], n);
+       buf[len++] = ':';
+       for (i = 0; i < EVTRACE_PER_LINE && n + i < count; i++) {
+           idx = oldest + n + i;
+           p = &ring.rec[(idx >= EVTRACE_RECORDS) ? idx - EVTRACE_RECORDS : idx];
+           if (i != 0) {
+               buf[len++] = ',';
+           }
+           len += EvTrace_FormatHex(&buf[len], p->cycles, 8);
+           len += EvTrace_FormatHex(&buf[len], p->ctx, 2);
+           len += EvTrace_FormatHex(&buf[len], p->id, 2);
+           len += EvTrace_FormatHex(&buf[len], p->arg, 4);
+       }
+   }
+   buf[len++] = '\r';
+   buf[len++] = '\n';
+
+   return len;
+#else
+   return 0;
+#endif
+}
+
+#if EVTRACE_ENABLE
+
+/* Hard fault: keep the events that led to it, then stop like the default handler */
+void HardFault_Handler(void)
+{
+   uint32_t cfsr = SCB->CFSR;
+
+   /* MemManage and BusFault status, then UsageFault status */
+   EVTRACE(HARD_FAULT, cfsr);
+   EVTRACE(HARD_FAULT_UFSR, cfsr >> 16);
+   EvTrace_Freeze();
+   while (1) {
+   }
+}
+
+#endif
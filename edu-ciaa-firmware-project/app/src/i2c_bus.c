@@ -0,0 +1,564 @@
+/*
+ * @brief Interrupt driven I2C master with a transaction queue
+ */
+
+#include <string.h>
+#include "board.h"
+#include "i2c_bus.h"
+#include "link.h"
+#include "systime.h"
+#include "cycles.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* I2C1 pins as GPIO for the recovery, P2_4 SCL and P2_3 SDA, also the USART3 pins */
+#define I2C_BUS_I2C1_SCL_PORT   0x2
+#define I2C_BUS_I2C1_SCL_PIN    4
+#define I2C_BUS_I2C1_SCL_GPIO   5, 4
+#define I2C_BUS_I2C1_SDA_PORT   0x2
+#define I2C_BUS_I2C1_SDA_PIN    3
+#define I2C_BUS_I2C1_SDA_GPIO   5, 3
+#define I2C_BUS_I2C1_GPIO_FUNC  SCU_MODE_FUNC4
+
+/* Longest SCL stretch waited for during the recovery, in microseconds */
+#define I2C_BUS_STRETCH_US      100
+
+/* Bus of each controller, for the interrupt handlers */
+static I2C_BUS_T *buses[I2C_NUM_INTERFACE];
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Mask interrupts, returns the previous mask for I2cBus_Unlock() */
+STATIC INLINE uint32_t I2cBus_Lock(void)
+{
+   uint32_t primask = __get_PRIMASK();
+
+   __disable_irq();
+
+   return primask;
+}
+
+/* Restore the interrupt mask saved by I2cBus_Lock() */
+STATIC INLINE void I2cBus_Unlock(uint32_t primask)
+{
+   __set_PRIMASK(primask);
+}
+
+/* Register address and data bytes written before the read */
+STATIC INLINE uint32_t I2cBus_WriteLen(const I2C_BUS_XFER_T *pXfer)
+{
+   return pXfer->regLen + pXfer->txLen;
+}
+
+/* Byte of the write part at pos, the register address first */
+STATIC INLINE uint8_t I2cBus_WriteByte(const I2C_BUS_XFER_T *pXfer, uint32_t pos)
+{
+   if (pos < pXfer->regLen) {
+       return (uint8_t) (pXfer->reg >> (8 * (pXfer->regLen - 1 - pos)));
+   }
+   return pXfer->tx[pos - pXfer->regLen];
+}
+
+/* Make the head of the queue the running transaction, a new attempt of it */
+static void I2cBus_Load(I2C_BUS_T *pBus)
+{
+   I2C_BUS_XFER_T *pXfer = pBus->head;
+
+   pBus->txPos = 0;
+   pBus->rxPos = 0;
+   pBus->reading = false;
+   pBus->busy = true;
+   pBus->held = false;
+   pBus->deadline = Systime_Now() + ((pXfer->timeoutUs != 0) ? pXfer->timeoutUs : I2C_BUS_TIMEOUT_US);
+   pXfer->attempts++;
+   pXfer->status = I2C_BUS_BUSY;
+}
+
+/* End the running attempt, returns the condition to put on the bus next */
+static uint32_t I2cBus_Retire(I2C_BUS_T *pBus, I2C_BUS_STATUS_T status, I2C_BUS_XFER_T **pDone)
+{
+   I2C_BUS_XFER_T *pXfer = pBus->head;
+   uint32_t backoff;
+
+   if (status == I2C_BUS_DONE) {
+       pBus->stats.xfers++;
+       pBus->stats.bytes += I2cBus_WriteLen(pXfer) + pXfer->rxLen;
+   }
+   else if (pXfer->attempts <= pXfer->retries) {
+       /* Hold the bus for this transaction until I2cBus_Service() starts it again */
+       backoff = I2C_BUS_BACKOFF_US << (pXfer->attempts - 1);
+       if (pXfer->attempts > 16 || backoff > I2C_BUS_BACKOFF_MAX_US) {
+           backoff = I2C_BUS_BACKOFF_MAX_US;
+       }
+       /* Still BUSY to the caller: it stays queued */
+       pBus->held = true;
+       pBus->retryAt = Systime_Now() + backoff;
+       pBus->stats.retries++;
+       return I2C_CON_STO;
+   }
+   else {
+       pBus->stats.failed++;
+   }
+
+   pBus->head = pXfer->next;
+   if (pBus->head == NULL) {
+       pBus->tail = NULL;
+   }
+
+   /* A stale queue link would splice the rest of the queue into a resubmission */
+   pXfer->next = NULL;
+   pXfer->status = status;
+   *pDone = pXfer;
+
+   if (pBus->head == NULL) {
+       pBus->busy = false;
+       return I2C_CON_STO;
+   }
+
+   I2cBus_Load(pBus);
+   if (status == I2C_BUS_DONE) {
+       /* Keep the bus: the next transaction follows after a repeated start */
+       pBus->stats.restarts++;
+       return I2C_CON_STA;
+   }
+
+   /* Free the bus after a failure, the controller sends the start once it is idle */
+   return I2C_CON_STO | I2C_CON_STA;
+}
+
+/* Hand a finished transaction back: callback, then completion event */
+static void I2cBus_Complete(I2C_BUS_XFER_T *pDone)
+{
+   /* The transaction belongs to the caller again from here */
+   if (pDone != NULL) {
+       if (pDone->cb != NULL) {
+           pDone->cb(pDone);
+       }
+       if (pDone->task != NULL) {
+           Sched_Post(pDone->task, pDone->sig, pDone->status);
+       }
+   }
+}
+
+/* Run one state change of the controller */
+static void I2cBus_Handler(I2C_BUS_T *pBus)
+{
+   LPC_I2C_T *pI2C = pBus->pI2C;
+   I2C_BUS_XFER_T *pXfer, *pDone = NULL;
+   uint32_t primask, set = 0, clr = I2C_CON_SI;
+
+   primask = I2cBus_Lock();
+   pXfer = pBus->head;
+
+   if (!pBus->busy || pBus->held || pXfer == NULL) {
+       /* Nothing of ours on the bus */
+       pI2C->CONSET = I2C_CON_STO;
+       pI2C->CONCLR = I2C_CON_SI | I2C_CON_STA | I2C_CON_AA;
+       I2cBus_Unlock(primask);
+       return;
+   }
+
+   switch (Chip_I2CM_GetCurState(pI2C)) {
+   case 0x08:      /* Start sent */
+   case 0x10:      /* Repeated start sent */
+       if (!pBus->reading && (I2cBus_WriteLen(pXfer) != 0 || pXfer->rxLen == 0)) {
+           pI2C->DAT = pXfer->addr << 1;
+       }
+       else {
+           pBus->reading = true;
+           pI2C->DAT = (pXfer->addr << 1) | 1;
+       }
+       clr |= I2C_CON_STA;
+       break;
+
+   case 0x18:      /* SLA+W acknowledged */
+   case 0x28:      /* Data byte acknowledged */
+       if (pBus->txPos < I2cBus_WriteLen(pXfer)) {
+           pI2C->DAT = I2cBus_WriteByte(pXfer, pBus->txPos++);
+       }
+       else if (pXfer->rxLen != 0) {
+           pBus->reading = true;
+           set = I2C_CON_STA;
+       }
+       else {
+           set = I2cBus_Retire(pBus, I2C_BUS_DONE, &pDone);
+       }
+       break;
+
+   case 0x20:      /* SLA+W not acknowledged */
+   case 0x48:      /* SLA+R not acknowledged */
+       pBus->stats.addrNaks++;
+       set = I2cBus_Retire(pBus, I2C_BUS_NAK, &pDone);
+       break;
+
+   case 0x30:      /* Data byte not acknowledged */
+       pBus->stats.dataNaks++;
+       set = I2cBus_Retire(pBus, I2C_BUS_NAK, &pDone);
+       break;
+
+   case 0x38:      /* Arbitration lost, the controller already let go of the bus */
+       pBus->stats.arbLost++;
+       set = I2cBus_Retire(pBus, I2C_BUS_ERROR, &pDone) & ~I2C_CON_STO;
+       break;
+
+   case 0x40:      /* SLA+R acknowledged, acknowledge all but the last byte */
+       if (pXfer->rxLen > 1) {
+           set = I2C_CON_AA;
+       }
+       else {
+           clr |= I2C_CON_AA;
+       }
+       break;
+
+   case 0x50:      /* Byte received, acknowledged */
+       pXfer->rx[pBus->rxPos++] = (uint8_t) pI2C->DAT;
+       if (pXfer->rxLen - pBus->rxPos > 1) {
+           set = I2C_CON_AA;
+       }
+       else {
+           clr |= I2C_CON_AA;
+       }
+       break;
+
+   case 0x58:      /* Last byte received, not acknowledged */
+       pXfer->rx[pBus->rxPos++] = (uint8_t) pI2C->DAT;
+       set = I2cBus_Retire(pBus, I2C_BUS_DONE, &pDone);
+       break;
+
+   case 0xF8:      /* No state change */
+       clr = 0;
+       break;
+
+   default:        /* Bus error: the stop resets the controller without a stop on the bus */
+       pBus->stats.busErrors++;
+       set = I2cBus_Retire(pBus, I2C_BUS_ERROR, &pDone) | I2C_CON_STO;
+       break;
+   }
+
+   if (pDone != NULL || pBus->held) {
+       clr |= I2C_CON_AA;
+   }
+   clr &= ~set;
+   pI2C->CONSET = set;
+   pI2C->CONCLR = clr;
+   I2cBus_Unlock(primask);
+
+   I2cBus_Complete(pDone);
+}
+
+/* Busy wait, the recovery runs far below the timer resolution */
+static void I2cBus_Delay(uint32_t us)
+{
+   uint32_t start = Cycles_Now();
+   uint32_t cycles = us * (SystemCoreClock / 1000000);
+
+   while (Cycles_Now() - start < cycles) {}
+}
+
+/* Release an open drain line and wait for it to rise, false if something holds it low */
+static bool I2cBus_Release(uint8_t port, uint8_t pin, uint32_t waitUs)
+{
+   Chip_GPIO_SetPinDIRInput(LPC_GPIO_PORT, port, pin);
+   for (;;) {
+       if (Chip_GPIO_GetPinState(LPC_GPIO_PORT, port, pin)) {
+           return true;
+       }
+       if (waitUs == 0) {
+           return false;
+       }
+       I2cBus_Delay(1);
+       waitUs--;
+   }
+}
+
+/* Pull an open drain line low */
+STATIC INLINE void I2cBus_Drive(uint8_t port, uint8_t pin)
+{
+   Chip_GPIO_SetPinOutLow(LPC_GPIO_PORT, port, pin);
+   Chip_GPIO_SetPinDIROutput(LPC_GPIO_PORT, port, pin);
+}
+
+/* Clock the I2C1 lines by hand until SDA is released, then send a stop, returns true when the bus is free */
+static bool I2cBus_Unstick(I2C_BUS_T *pBus)
+{
+   uint32_t half = (500000 + pBus->rateHz - 1) / pBus->rateHz;
+   uint32_t i;
+   bool free;
+
+   Chip_SCU_PinMuxSet(I2C_BUS_I2C1_SCL_PORT, I2C_BUS_I2C1_SCL_PIN,
+                      SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | I2C_BUS_I2C1_GPIO_FUNC);
+   Chip_SCU_PinMuxSet(I2C_BUS_I2C1_SDA_PORT, I2C_BUS_I2C1_SDA_PIN,
+                      SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | I2C_BUS_I2C1_GPIO_FUNC);
+   I2cBus_Release(I2C_BUS_I2C1_SDA_GPIO, 0);
+
+   /* A device stuck mid read holds SDA for its next bit: clock until it lets go */
+   free = I2cBus_Release(I2C_BUS_I2C1_SCL_GPIO, I2C_BUS_STRETCH_US);
+   for (i = 0; free && i < I2C_BUS_RECOVER_CLOCKS &&
+        !Chip_GPIO_GetPinState(LPC_GPIO_PORT, I2C_BUS_I2C1_SDA_GPIO); i++) {
+       I2cBus_Drive(I2C_BUS_I2C1_SCL_GPIO);
+       I2cBus_Delay(half);
+       free = I2cBus_Release(I2C_BUS_I2C1_SCL_GPIO, I2C_BUS_STRETCH_US);
+       I2cBus_Delay(half);
+   }
+
+   /* Stop: SDA rises while SCL is high */
+   if (free) {
+       I2cBus_Drive(I2C_BUS_I2C1_SCL_GPIO);
+       I2cBus_Delay(half);
+       I2cBus_Drive(I2C_BUS_I2C1_SDA_GPIO);
+       I2cBus_Delay(half);
+       free = I2cBus_Release(I2C_BUS_I2C1_SCL_GPIO, I2C_BUS_STRETCH_US);
+       I2cBus_Delay(half);
+       free = I2cBus_Release(I2C_BUS_I2C1_SDA_GPIO, half) && free;
+   }
+
+   Board_I2C_Init(I2C1);
+
+   return free;
+}
+
+/* Reset the controller after a timeout and free the bus, with the bus interrupt masked */
+static void I2cBus_Recover(I2C_BUS_T *pBus)
+{
+   IRQn_Type irq = (pBus->id == I2C0) ? I2C0_IRQn : I2C1_IRQn;
+   bool free = true;
+
+   NVIC_DisableIRQ(irq);
+   pBus->pI2C->CONCLR = I2C_CON_I2EN | I2C_CON_STA | I2C_CON_SI | I2C_CON_AA;
+
+   if (pBus->id == I2C1) {
+       free = I2cBus_Unstick(pBus);
+   }
+
+   pBus->pI2C->CONSET = I2C_CON_I2EN;
+   pBus->stats.recoveries++;
+   if (!free) {
+       pBus->stats.stuck++;
+   }
+   NVIC_ClearPendingIRQ(irq);
+   NVIC_EnableIRQ(irq);
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Set up a bus with its pins and interrupt */
+Status I2cBus_Init(I2C_BUS_T *pBus, I2C_ID_T id, uint32_t rateHz)
+{
+   IRQn_Type irq = (id == I2C0) ? I2C0_IRQn : I2C1_IRQn;
+
+   /* Only the I2C0 pads have the Fast-mode Plus drivers */
+   if (rateHz == 0 || rateHz > I2C_BUS_1M || (id != I2C0 && rateHz > I2C_BUS_400K)) {
+       return ERROR;
+   }
+
+   /* I2C1 and USART3 share P2_3/P2_4: muxing them to I2C1 would cut the link */
+   if (id == I2C1 && LINK_UART == LPC_USART3) {
+       return ERROR;
+   }
+
+   memset(pBus, 0, sizeof(*pBus));
+   pBus->pI2C = (id == I2C0) ? LPC_I2C0 : LPC_I2C1;
+   pBus->id = id;
+   pBus->rateHz = rateHz;
+   Cycles_Init();
+
+   Board_I2C_Init(id);
+   if (rateHz > I2C_BUS_400K) {
+       Board_I2C_EnableFastPlus(id);
+   }
+   Chip_I2CM_Init(pBus->pI2C);
+   Chip_I2CM_SetBusSpeed(pBus->pI2C, rateHz);
+   pBus->pI2C->CONSET = I2C_CON_I2EN;
+
+   buses[id] = pBus;
+   NVIC_SetPriority(irq, I2C_BUS_IRQ_PRIO);
+   NVIC_ClearPendingIRQ(irq);
+   NVIC_EnableIRQ(irq);
+
+   return SUCCESS;
+}
+
+/* Queue a list of transactions */
+Status I2cBus_Submit(I2C_BUS_T *pBus, I2C_BUS_XFER_T *pXfer)
+{
+   I2C_BUS_XFER_T *last = NULL, *p;
+   uint32_t primask;
+
+   for (p = pXfer; p != NULL; p = p->next) {
+       if (p->addr > 0x7F || p->regLen > 2 || (p->txLen != 0 && p->tx == NULL) ||
+           (p->rxLen != 0 && p->rx == NULL)) {
+           pBus->stats.rejected++;
+           return ERROR;
+       }
+       p->status = I2C_BUS_QUEUED;
+       p->attempts = 0;
+       last = p;
+   }
+   if (last == NULL) {
+       return ERROR;
+   }
+
+   primask = I2cBus_Lock();
+   if (pBus->tail != NULL) {
+       pBus->tail->next = pXfer;
+   }
+   else {
+       pBus->head = pXfer;
+   }
+   pBus->tail = last;
+   if (!pBus->busy) {
+       I2cBus_Load(pBus);
+       pBus->pI2C->CONCLR = I2C_CON_SI | I2C_CON_STO | I2C_CON_AA;
+       pBus->pI2C->CONSET = I2C_CON_STA;
+   }
+   I2cBus_Unlock(primask);
+
+   return SUCCESS;
+}
+
+/* Return whether the bus has nothing running or queued */
+bool I2cBus_IsIdle(I2C_BUS_T *pBus)
+{
+   return pBus->head == NULL;
+}
+
+/* Enforce time budgets and start retries whose backoff elapsed */
+void I2cBus_Service(I2C_BUS_T *pBus, uint64_t nowUs)
+{
+   I2C_BUS_XFER_T *pDone = NULL;
+   uint32_t primask, set;
+
+   primask = I2cBus_Lock();
+   if (!pBus->busy || pBus->head == NULL) {
+       I2cBus_Unlock(primask);
+       return;
+   }
+
+   if (pBus->held) {
+       /* Backoff elapsed: try the head again from a start */
+       if (nowUs >= pBus->retryAt) {
+           I2cBus_Load(pBus);
+           pBus->pI2C->CONCLR = I2C_CON_SI | I2C_CON_STO | I2C_CON_AA;
+           pBus->pI2C->CONSET = I2C_CON_STA;
+       }
+       I2cBus_Unlock(primask);
+       return;
+   }
+
+   if (nowUs < pBus->deadline) {
+       I2cBus_Unlock(primask);
+       return;
+   }
+
+   /* Keep the interrupt and Submit() off the head while the bus is reset */
+   pBus->held = true;
+   pBus->retryAt = SYSTIME_FOREVER;
+   I2cBus_Unlock(primask);
+
+   I2cBus_Recover(pBus);
+
+   primask = I2cBus_Lock();
+   pBus->stats.timeouts++;
+   pBus->held = false;
+   set = I2cBus_Retire(pBus, I2C_BUS_TIMEOUT, &pDone);
+
+   /* The controller was reset, there is nothing to stop */
+   if ((set & I2C_CON_STA) != 0) {
+       pBus->pI2C->CONCLR = I2C_CON_SI | I2C_CON_STO | I2C_CON_AA;
+       pBus->pI2C->CONSET = I2C_CON_STA;
+   }
+   I2cBus_Unlock(primask);
+
+   I2cBus_Complete(pDone);
+}
+
+/* Add a periodic transaction */
+void I2cBus_PollAdd(I2C_BUS_T *pBus, I2C_BUS_POLL_T *pPoll, I2C_BUS_XFER_T *pXfer,
+                    uint32_t periodUs, uint64_t nowUs)
+{
+   pPoll->xfer = pXfer;
+   pPoll->periodUs = periodUs;
+   pPoll->due = nowUs + periodUs;
+   pPoll->overruns = 0;
+   pXfer->next = NULL;
+   pXfer->status = I2C_BUS_DONE;
+
+   pPoll->next = pBus->polls;
+   pBus->polls = pPoll;
+}
+
+/* Queue every poll whose period elapsed */
+void I2cBus_PollRun(I2C_BUS_T *pBus, uint64_t nowUs)
+{
+   I2C_BUS_POLL_T *pPoll;
+   I2C_BUS_XFER_T *pXfer;
+
+   for (pPoll = pBus->polls; pPoll != NULL; pPoll = pPoll->next) {
+       if (nowUs < pPoll->due) {
+           continue;
+       }
+
+       pXfer = pPoll->xfer;
+       if (pXfer->status == I2C_BUS_QUEUED || pXfer->status == I2C_BUS_BUSY) {
+           pPoll->overruns++;
+       }
+       else {
+           I2cBus_Submit(pBus, pXfer);
+       }
+
+       pPoll->due += pPoll->periodUs;
+       if (pPoll->due <= nowUs) {
+           pPoll->due = nowUs + pPoll->periodUs;
+       }
+   }
+}
+
+/* Return when I2cBus_PollRun() next has work */
+uint64_t I2cBus_PollNext(I2C_BUS_T *pBus)
+{
+   I2C_BUS_POLL_T *pPoll;
+   uint64_t next = SYSTIME_FOREVER;
+
+   for (pPoll = pBus->polls; pPoll != NULL; pPoll = pPoll->next) {
+       if (pPoll->due < next) {
+           next = pPoll->due;
+       }
+   }
+
+   if (pBus->busy) {
+       if (pBus->held && pBus->retryAt < next) {
+           next = pBus->retryAt;
+       }
+       else if (!pBus->held && pBus->deadline < next) {
+           next = pBus->deadline;
+       }
+   }
+
+   return next;
+}
+
+/* I2C0 state change */
+void I2C0_IRQHandler(void)
+{
+   if (buses[I2C0] != NULL) {
+       I2cBus_Handler(buses[I2C0]);
+   }
+}
+
+/* I2C1 state change */
+void I2C1_IRQHandler(void)
+{
+   if (buses[I2C1] != NULL) {
+       I2cBus_Handler(buses[I2C1]);
+   }
+}
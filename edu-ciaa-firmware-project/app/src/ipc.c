@@ -0,0 +1,165 @@
+/*
+ * @brief Inter-core mailboxes between the Cortex-M4 and the Cortex-M0APP
+ */
+
+#include <string.h>
+#include "ipc.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Lowest priority on both cores, the M0 has 2 priority bits */
+#define IPC_IRQ_PRIO            3
+
+/* Placed first in RamAHB16 by the linker script, never initialized by the startup code */
+static IPC_SHARED_T ipcShared __attribute__ ((section(".ipc_shared")));
+
+/* This core's ends */
+#if defined(CORE_M4)
+#define IPC_TX_RING             (&ipcShared.toM0)
+#define IPC_RX_RING             (&ipcShared.toM4)
+#else
+#define IPC_TX_RING             (&ipcShared.toM4)
+#define IPC_RX_RING             (&ipcShared.toM0)
+#endif
+
+static void (*rxNotifyFn)(void), (*txNotifyFn)(void);
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Raise the inter-core interrupt on the other core, once the writes are visible */
+STATIC INLINE void Ipc_Signal(void)
+{
+   __DSB();
+   __SEV();
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Inter-core interrupt: the other core sent or freed room */
+void IPC_IRQHandler(void)
+{
+#if defined(CORE_M4)
+   Chip_CREG_ClearM0AppEvent();
+#else
+   Chip_CREG_ClearM4Event();
+#endif
+
+   if (rxNotifyFn != NULL && Ipc_RxPending()) {
+       rxNotifyFn();
+   }
+   if (txNotifyFn != NULL) {
+       txNotifyFn();
+   }
+}
+
+/* Set up this core's end of the mailboxes */
+void Ipc_Init(void)
+{
+#if defined(CORE_M4)
+   /* The M0 is held in reset, nobody else touches the block */
+   ipcShared.magic = 0;
+   ipcShared.m0Ready = 0;
+   SpscRing_Init(&ipcShared.toM0, ipcShared.toM0Buf, sizeof(IPC_MSG_T), IPC_QUEUE_LEN);
+   SpscRing_Init(&ipcShared.toM4, ipcShared.toM4Buf, sizeof(IPC_MSG_T), IPC_QUEUE_LEN);
+   __DMB();
+   ipcShared.magic = IPC_MAGIC;
+   Chip_CREG_ClearM0AppEvent();
+#else
+   while (ipcShared.magic != IPC_MAGIC) {}
+   __DMB();
+   Chip_CREG_ClearM4Event();
+#endif
+   NVIC_ClearPendingIRQ(IPC_IRQn);
+   NVIC_SetPriority(IPC_IRQn, IPC_IRQ_PRIO);
+   NVIC_EnableIRQ(IPC_IRQn);
+
+#if !defined(CORE_M4)
+   ipcShared.m0Ready = 1;
+   Ipc_Signal();
+#endif
+}
+
+/* Return whether the other core serves its end */
+bool Ipc_PeerReady(void)
+{
+#if defined(CORE_M4)
+   return ipcShared.m0Ready != 0;
+#else
+   return ipcShared.magic == IPC_MAGIC;
+#endif
+}
+
+/* Set the functions called from the inter-core interrupt */
+void Ipc_SetNotify(void (*rxNotify)(void), void (*txNotify)(void))
+{
+   rxNotifyFn = rxNotify;
+   txNotifyFn = txNotify;
+}
+
+/* Send a message to the other core and signal it */
+bool Ipc_Send(uint8_t type, uint16_t arg, const void *data, uint32_t len)
+{
+   IPC_MSG_T *msg;
+
+   if (len > IPC_MSG_DATA_MAX || SpscRing_Reserve(IPC_TX_RING, (void **) &msg) == 0) {
+       return false;
+   }
+
+   /* Written in place, the ring slot is the message */
+   msg->type = type;
+   msg->len = (uint8_t) len;
+   msg->arg = arg;
+   if (len != 0) {
+       memcpy(msg->data, data, len);
+   }
+   SpscRing_Commit(IPC_TX_RING, 1);
+   Ipc_Signal();
+
+   return true;
+}
+
+/* Return the number of messages Ipc_Send() can queue now */
+uint32_t Ipc_TxFree(void)
+{
+   return SpscRing_GetFree(IPC_TX_RING);
+}
+
+/* Take the oldest message from the other core */
+bool Ipc_Recv(IPC_MSG_T *msg)
+{
+   const IPC_MSG_T *slot;
+   bool wasLow = SpscRing_GetFree(IPC_RX_RING) <= IPC_TX_RESERVE;
+
+   if (SpscRing_Peek(IPC_RX_RING, (const void **) &slot) == 0) {
+       return false;
+   }
+
+   msg->type = slot->type;
+   msg->len = slot->len;
+   msg->arg = slot->arg;
+   memcpy(msg->data, slot->data, MIN(slot->len, IPC_MSG_DATA_MAX));
+   SpscRing_Release(IPC_RX_RING, 1);
+
+   /* A bulk sender may be waiting for room */
+   if (wasLow) {
+       Ipc_Signal();
+   }
+
+   return true;
+}
+
+/* Return whether messages from the other core are waiting */
+bool Ipc_RxPending(void)
+{
+   return !SpscRing_IsEmpty(IPC_RX_RING);
+}
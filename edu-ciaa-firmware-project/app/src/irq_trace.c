@@ -0,0 +1,231 @@
+/*
+ * @brief Interrupt occupancy tracer
+ */
+
+#include <string.h>
+#include "chip.h"
+#include "cycles.h"
+#include "irq_trace.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+#if IRQ_TRACE_ENABLE
+
+typedef void (*IRQ_TRACE_HANDLER_T)(void);
+
+/* VTOR needs the table aligned to its size rounded up to a power of two */
+static IRQ_TRACE_HANDLER_T ramVectors[IRQ_TRACE_VECTORS] __attribute__ ((aligned(512)));
+static IRQ_TRACE_HANDLER_T handlers[IRQ_TRACE_VECTORS];
+static IRQ_TRACE_STATS_T stats[IRQ_TRACE_VECTORS];
+
+/* Nesting: depth of the running handler and the cycles its children took */
+static volatile uint32_t depth;
+static uint32_t nested[IRQ_TRACE_MAX_DEPTH + 1];
+
+/* Last snapshot */
+static uint32_t snapStart, snapWindow, snapCycles;
+static uint32_t prevCount[IRQ_TRACE_VECTORS], prevCycles[IRQ_TRACE_VECTORS];
+static IRQ_TRACE_STATS_T snap[IRQ_TRACE_VECTORS];
+
+#endif
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+#if IRQ_TRACE_ENABLE
+
+/* Common entry of every traced vector */
+static void IrqTrace_Trampoline(void)
+{
+   uint32_t vec = __get_IPSR() & 0x1FF;
+   uint32_t level = depth + 1;
+   IRQ_TRACE_STATS_T *p = &stats[vec];
+   uint32_t start, total, self;
+
+   /* A handler that preempts this one restores depth before returning */
+   depth = level;
+   nested[level] = 0;
+
+   start = Cycles_Now();
+   handlers[vec]();
+   total = Cycles_Now() - start;
+
+   self = total - nested[level];
+   depth = level - 1;
+   if (level > 1) {
+       nested[level - 1] += total;
+   }
+
+   p->seq++;
+   __DMB();
+   p->count++;
+   p->cycles += self;
+   if (self > p->maxCycles) {
+       p->maxCycles = self;
+   }
+   if (level > 1) {
+       p->preempts++;
+   }
+   if (level > p->maxDepth) {
+       p->maxDepth = (uint8_t) level;
+   }
+   __DMB();
+   p->seq++;
+}
+
+/* Append an unsigned decimal number */
+static int IrqTrace_FormatU32(char *out, uint32_t u)
+{
+   char tmp[10];
+   int n = 0, len = 0;
+
+   do {
+       tmp[n++] = (char) ('0' + (u % 10));
+       u /= 10;
+   } while (u != 0);
+   while (n > 0) {
+       out[len++] = tmp[--n];
+   }
+
+   return len;
+}
+
+/* Cycles as parts per million of the snapshot window */
+STATIC INLINE uint32_t IrqTrace_Ppm(uint32_t cycles)
+{
+   return (snapWindow == 0) ? 0 : (uint32_t) (((uint64_t) cycles * 1000000) / snapWindow);
+}
+
+#endif
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Move the vector table to RAM and route every traced vector through the trampoline */
+void IrqTrace_Init(void)
+{
+#if IRQ_TRACE_ENABLE
+   const IRQ_TRACE_HANDLER_T *rom = (const IRQ_TRACE_HANDLER_T *) SCB->VTOR;
+   uint32_t primask = __get_PRIMASK();
+   uint32_t i;
+
+   Cycles_Init();
+   memset(stats, 0, sizeof(stats));
+   depth = 0;
+
+   __disable_irq();
+   for (i = 0; i < IRQ_TRACE_VECTORS; i++) {
+       handlers[i] = rom[i];
+       ramVectors[i] = (i >= IRQ_TRACE_FIRST) ? IrqTrace_Trampoline : rom[i];
+   }
+   SCB->VTOR = (uint32_t) ramVectors;
+   __DSB();
+   __ISB();
+   __set_PRIMASK(primask);
+
+   snapStart = Cycles_Now();
+#endif
+}
+
+/* Copy the statistics of one vector */
+void IrqTrace_Read(uint32_t vector, IRQ_TRACE_STATS_T *pStats)
+{
+#if IRQ_TRACE_ENABLE
+   uint32_t seq;
+
+   do {
+       seq = stats[vector].seq;
+       __DMB();
+       *pStats = stats[vector];
+       __DMB();
+   } while ((seq & 1) != 0 || seq != stats[vector].seq);
+#else
+   memset(pStats, 0, sizeof(*pStats));
+#endif
+}
+
+/* Latch the change of every vector since the previous snapshot */
+uint32_t IrqTrace_Snapshot(void)
+{
+#if IRQ_TRACE_ENABLE
+   IRQ_TRACE_STATS_T s;
+   uint32_t now = Cycles_Now();
+   uint32_t i;
+
+   snapWindow = now - snapStart;
+   snapStart = now;
+   snapCycles = 0;
+
+   for (i = IRQ_TRACE_FIRST; i < IRQ_TRACE_VECTORS; i++) {
+       IrqTrace_Read(i, &s);
+       snap[i] = s;
+       snap[i].count = s.count - prevCount[i];
+       snap[i].cycles = s.cycles - prevCycles[i];
+       prevCount[i] = s.count;
+       prevCycles[i] = s.cycles;
+       snapCycles += snap[i].cycles;
+   }
+
+   return snapWindow;
+#else
+   return 0;
+#endif
+}
+
+/* Format one line of the last snapshot */
+int IrqTrace_FormatLine(uint32_t line, char *buf)
+{
+#if IRQ_TRACE_ENABLE
+   const IRQ_TRACE_STATS_T *p;
+   uint32_t vec = IRQ_TRACE_FIRST + line - 1;
+   int len = 3;
+
+   memcpy(buf, "IQ:", 3);
+   if (line == 0) {
+       memcpy(&buf[len], "window,", 7);
+       len += 7;
+       len += IrqTrace_FormatU32(&buf[len], snapWindow);
+       buf[len++] = ',';
+       len += IrqTrace_FormatU32(&buf[len], IrqTrace_Ppm(snapCycles));
+   }
+   else {
+       if (line >= IRQ_TRACE_LINES || snap[vec].count == 0) {
+           return 0;
+       }
+       p = &snap[vec];
+
+       /* IRQ number, SysTick is -1 */
+       if (vec < 16) {
+           buf[len++] = '-';
+           len += IrqTrace_FormatU32(&buf[len], 16 - vec);
+       }
+       else {
+           len += IrqTrace_FormatU32(&buf[len], vec - 16);
+       }
+       buf[len++] = ',';
+       len += IrqTrace_FormatU32(&buf[len], p->count);
+       buf[len++] = ',';
+       len += IrqTrace_FormatU32(&buf[len], IrqTrace_Ppm(p->cycles));
+       buf[len++] = ',';
+       len += IrqTrace_FormatU32(&buf[len], p->maxCycles);
+       buf[len++] = ',';
+       len += IrqTrace_FormatU32(&buf[len], p->maxDepth);
+       buf[len++] = ',';
+       len += IrqTrace_FormatU32(&buf[len], p->preempts);
+   }
+   buf[len++] = '\r';
+   buf[len++] = '\n';
+
+   return len;
+#else
+   return 0;
+#endif
+}
@@ -0,0 +1,433 @@
+/*
+ * @brief Serial command link to the ESP32
+ */
+
+#include <string.h>
+#include "board.h"
+#include "link.h"
+#include "prof.h"
+#include "evtrace.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Link UART interrupt priority, below the control loop timers */
+#define LINK_IRQ_PRIO       3
+
+static uint8_t rxBuff[LINK_RX_RB_SIZE] __DMA_BUF;
+static uint8_t txBuff[LINK_TX_RB_SIZE] __DMA_BUF;
+
+#if LINK_USE_DMA
+/* DMA receive, rxBuff is split into LINK_RX_DMA_BLOCKS descriptor blocks */
+#define LINK_RX_DMA_BLOCKS  4
+static UART_DMA_RX_T rxDma;
+static DMA_TransferDescriptor_t rxDesc[LINK_RX_DMA_BLOCKS] __DMA_BUF;
+
+/* DMA transmit, txBuff is the copy pool */
+static UART_DMA_TX_T txDma;
+#else
+static RINGBUFF_T rxRing, txRing;
+static void (*rxNotifyFn)(void), (*txNotifyFn)(void);
+#endif
+
+static LINK_MODE_T linkMode;
+static PROTO_PARSER_T parser;
+
+/* Binary mode state */
+static PROTO_BIN_RX_T binRx;
+static LINK_BIN_STATS_T binStats;
+static bool binHaveSeq;
+static uint8_t binLastSeq;
+static PROTO_STATUS_T binLastStatus;
+static uint8_t binTxSeq;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Send the ASCII response for a completed frame */
+static void Link_Respond(PROTO_STATUS_T status)
+{
+   switch (status) {
+   case PROTO_STATUS_OK:
+       Link_SendStr("ACK\r\n");
+       break;
+
+   case PROTO_STATUS_ERR_CMD:
+       Link_SendStr("ERR:INVALID_COMMAND\r\n");
+       break;
+
+   case PROTO_STATUS_ERR_PARAMS:
+       Link_SendStr("ERR:INVALID_PARAMS\r\n");
+       break;
+
+   default:
+       break;
+   }
+}
+
+/* Bytes that can be queued for transmission right now */
+static uint32_t Link_TxFree(void)
+{
+#if LINK_USE_DMA
+   return UartDma_TxFree(&txDma);
+#else
+   return RingBuffer_GetFree(&txRing);
+#endif
+}
+
+/* Encode and queue a binary frame */
+static int Link_SendFrame(uint8_t seq, uint8_t type, const void *payload, int len)
+{
+   uint8_t enc[PROTO_BIN_MAX_ENCODED];
+   int encLen = ProtoBin_Encode(seq, type, payload, len, enc, sizeof(enc));
+
+   /* Frames are queued whole or not at all so the receiver never sees a partial one */
+   if (encLen == 0 || Link_TxFree() < (uint32_t) encLen) {
+       return 0;
+   }
+
+   return Link_Send(enc, encLen);
+}
+
+/* Send the binary ACK/NAK for the command with sequence number seq */
+static void Link_RespondBin(uint8_t seq, PROTO_STATUS_T status)
+{
+   uint8_t reason;
+
+   if (status == PROTO_STATUS_OK) {
+       Link_SendFrame(seq, PROTO_BIN_MSG_ACK, NULL, 0);
+       return;
+   }
+
+   reason = (status == PROTO_STATUS_ERR_CMD) ? PROTO_BIN_NAK_CMD : PROTO_BIN_NAK_PARAMS;
+   Link_SendFrame(seq, PROTO_BIN_MSG_NAK, &reason, 1);
+}
+
+/* Translate a binary frame into a command and dispatch it */
+static PROTO_STATUS_T Link_DispatchBin(const PROTO_BIN_FRAME_T *pFrame)
+{
+   PROTO_CMD_T cmd;
+
+   cmd.nparams = 0;
+   switch (pFrame->type) {
+   case PROTO_BIN_MSG_MV:
+       if (pFrame->len != 4) {
+           return PROTO_STATUS_ERR_PARAMS;
+       }
+       cmd.id = PROTO_CMD_MV;
+       cmd.params[0] = ProtoBin_GetI16(&pFrame->payload[0]);
+       cmd.params[1] = ProtoBin_GetI16(&pFrame->payload[2]);
+       cmd.nparams = 2;
+       break;
+
+   case PROTO_BIN_MSG_ST:
+       cmd.id = PROTO_CMD_ST;
+       break;
+
+   case PROTO_BIN_MSG_GT:
+       cmd.id = PROTO_CMD_GT;
+       break;
+
+   default:
+       return PROTO_STATUS_ERR_CMD;
+   }
+
+   if (cmd.nparams == 0 && pFrame->len != 0) {
+       return PROTO_STATUS_ERR_PARAMS;
+   }
+
+   return Proto_Dispatch(&parser, &cmd);
+}
+
+/* Handle a decoded binary frame: sequence tracking, dispatch, ACK/NAK */
+static void Link_HandleBin(const PROTO_BIN_FRAME_T *pFrame)
+{
+   int8_t gap;
+
+   if (binHaveSeq) {
+       /* Retransmission of a command we already ran: answer again, don't rerun it */
+       if (pFrame->seq == binLastSeq) {
+           binStats.duplicates++;
+           Link_RespondBin(pFrame->seq, binLastStatus);
+           return;
+       }
+       /* Only a forward gap means lost commands, a step back (sender restart) resynchronizes */
+       gap = (int8_t) (pFrame->seq - binLastSeq);
+       if (gap > 0) {
+           binStats.lost += (uint32_t) (gap - 1);
+       }
+       else {
+           binStats.resyncs++;
+       }
+   }
+
+   binLastStatus = Link_DispatchBin(pFrame);
+   binLastSeq = pFrame->seq;
+   binHaveSeq = true;
+
+   Link_RespondBin(pFrame->seq, binLastStatus);
+}
+
+/* Feed one received byte to the active framing, returns 1 on a completed frame */
+static int Link_RxByte(uint8_t ch)
+{
+   PROTO_BIN_FRAME_T frame;
+   PROTO_STATUS_T status;
+   uint8_t nak;
+
+   if (linkMode == LINK_MODE_ASCII) {
+       status = Proto_ParseByte(&parser, ch);
+       if (status == PROTO_STATUS_NONE) {
+           return 0;
+       }
+       Link_Respond(status);
+       return 1;
+   }
+
+   switch (ProtoBin_DecodeByte(&binRx, ch, &frame)) {
+   case PROTO_BIN_FRAME:
+       Link_HandleBin(&frame);
+       return 1;
+
+   case PROTO_BIN_ERR_CRC:
+       binStats.crcErrors++;
+       nak = PROTO_BIN_NAK_CRC;
+       Link_SendFrame(frame.seq, PROTO_BIN_MSG_NAK, &nak, 1);
+       break;
+
+   case PROTO_BIN_ERR_FRAME:
+       binStats.framingErrors++;
+       break;
+
+   default:
+       break;
+   }
+
+   return 0;
+}
+
+/* Get the next contiguous span of received bytes, read in place */
+static uint32_t Link_RxPeek(const uint8_t **data)
+{
+#if LINK_USE_DMA
+   return UartDma_RxPeek(&rxDma, data);
+#else
+   uint32_t head = RB_VHEAD(&rxRing);
+   uint32_t idx = rxRing.tail & (LINK_RX_RB_SIZE - 1);
+
+   *data = &rxBuff[idx];
+
+   return MIN(head - rxRing.tail, LINK_RX_RB_SIZE - idx);
+#endif
+}
+
+/* Release bytes returned by Link_RxPeek() */
+static void Link_RxRelease(uint32_t bytes)
+{
+#if LINK_USE_DMA
+   UartDma_RxRelease(&rxDma, bytes);
+#else
+   RB_VTAIL(&rxRing) = rxRing.tail + bytes;
+#endif
+}
+
+/* Format a signed value in decimal, returns the number of characters */
+static int Link_FormatInt(char *out, int v)
+{
+   char tmp[6];
+   int n = 0, len = 0;
+   unsigned int u = (v < 0) ? (unsigned int) -v : (unsigned int) v;
+
+   if (v < 0) {
+       out[len++] = '-';
+   }
+   do {
+       tmp[n++] = (char) ('0' + (u % 10));
+       u /= 10;
+   } while (u != 0);
+   while (n > 0) {
+       out[len++] = tmp[--n];
+   }
+
+   return len;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Link UART interrupt handler */
+void LINK_IRQHandler(void)
+{
+   PROF_BEGIN(LINK_IRQ);
+   EVTRACE(LINK_IRQ_BEGIN, 0);
+
+#if LINK_USE_DMA
+   /* Data is moved by the DMA, only time-outs and line errors arrive here */
+   UartDma_RxUARTHandler(&rxDma);
+#else
+   Chip_UART_IRQRBHandler(LINK_UART, &rxRing, &txRing);
+   if (rxNotifyFn != NULL && !RingBuffer_IsEmpty(&rxRing)) {
+       rxNotifyFn();
+   }
+   if (txNotifyFn != NULL) {
+       txNotifyFn();
+   }
+#endif
+
+   EVTRACE(LINK_IRQ_END, 0);
+   PROF_END(LINK_IRQ);
+}
+
+/* Initialize the link UART and command parser */
+void Link_Init(LINK_MODE_T mode, const PROTO_HANDLER_T *handlers, void *ctx)
+{
+   LINK_BIN_STATS_T zero = {0};
+
+   linkMode = mode;
+   Proto_Init(&parser, handlers, ctx);
+   ProtoBin_RxInit(&binRx);
+   binStats = zero;
+   binHaveSeq = false;
+   binTxSeq = 0;
+
+#if !LINK_USE_DMA
+   RingBuffer_Init(&rxRing, rxBuff, 1, LINK_RX_RB_SIZE);
+   RingBuffer_Init(&txRing, txBuff, 1, LINK_TX_RB_SIZE);
+#endif
+
+   Board_UART_Init(LINK_UART);
+   Chip_UART_Init(LINK_UART);
+   Chip_UART_SetBaudFDR(LINK_UART, LINK_BAUDRATE);
+   Chip_UART_ConfigData(LINK_UART, UART_LCR_WLEN8 | UART_LCR_SBS_1BIT | UART_LCR_PARITY_DIS);
+   Chip_UART_TXEnable(LINK_UART);
+
+#if LINK_USE_DMA
+   UartDma_RxInit(&rxDma, LINK_UART, LINK_RX_DMA_CONN, rxBuff, rxDesc, LINK_RX_DMA_BLOCKS,
+                  LINK_RX_RB_SIZE / LINK_RX_DMA_BLOCKS);
+   UartDma_TxInit(&txDma, LINK_UART, LINK_TX_DMA_CONN, txBuff, LINK_TX_RB_SIZE);
+#else
+   Chip_UART_SetupFIFOS(LINK_UART, UART_FCR_FIFO_EN | UART_FCR_TRG_LEV2);
+   Chip_UART_IntEnable(LINK_UART, UART_IER_RBRINT | UART_IER_RLSINT);
+#endif
+   NVIC_SetPriority(LINK_IRQn, LINK_IRQ_PRIO);
+   NVIC_EnableIRQ(LINK_IRQn);
+}
+
+/* Decode pending bytes, dispatch commands and send responses */
+int Link_Poll(void)
+{
+   const uint8_t *data;
+   uint32_t len, i;
+   int frames = 0;
+
+   while ((len = Link_RxPeek(&data)) != 0) {
+       for (i = 0; i < len; i++) {
+           frames += Link_RxByte(data[i]);
+       }
+       Link_RxRelease(len);
+   }
+
+   return frames;
+}
+
+/* Return whether received bytes are waiting for Link_Poll() */
+bool Link_RxPending(void)
+{
+#if LINK_USE_DMA
+   return UartDma_RxAvailable(&rxDma) != 0;
+#else
+   return RB_VHEAD(&rxRing) != rxRing.tail;
+#endif
+}
+
+/* Set the functions called when the link has work */
+void Link_SetNotify(void (*rxNotify)(void), void (*txNotify)(void))
+{
+#if LINK_USE_DMA
+   rxDma.notify = rxNotify;
+   txDma.notify = txNotify;
+#else
+   rxNotifyFn = rxNotify;
+   txNotifyFn = txNotify;
+#endif
+}
+
+/* Queue bytes for transmission on the link (non-blocking) */
+int Link_Send(const void *data, int bytes)
+{
+#if LINK_USE_DMA
+   return (int) UartDma_TxWrite(&txDma, data, bytes);
+#else
+   return (int) Chip_UART_SendRB(LINK_UART, &txRing, data, bytes);
+#endif
+}
+
+/* Queue a NUL terminated string for transmission */
+int Link_SendStr(const char *str)
+{
+   return Link_Send(str, strlen(str));
+}
+
+/* Send a telemetry record in the current framing */
+int Link_SendTelemetry(const int16_t *values, int count)
+{
+   uint8_t payload[PROTO_BIN_MAX_PAYLOAD];
+   char text[4 + (PROTO_BIN_MAX_PAYLOAD / 2) * 7 + 2];
+   int i, len;
+
+   count = MIN(count, PROTO_BIN_MAX_PAYLOAD / 2);
+
+   if (linkMode == LINK_MODE_BINARY) {
+       for (i = 0; i < count; i++) {
+           ProtoBin_PutI16(&payload[2 * i], values[i]);
+       }
+       return Link_SendFrame(binTxSeq++, PROTO_BIN_MSG_TM, payload, 2 * count);
+   }
+
+   memcpy(text, "TM:", 3);
+   len = 3;
+   for (i = 0; i < count; i++) {
+       if (i > 0) {
+           text[len++] = ',';
+       }
+       len += Link_FormatInt(&text[len], values[i]);
+   }
+   text[len++] = '\r';
+   text[len++] = '\n';
+
+   return Link_Send(text, len);
+}
+
+/* Return parser statistics for the link */
+const PROTO_STATS_T *Link_GetStats(void)
+{
+   return Proto_GetStats(&parser);
+}
+
+/* Return binary framing statistics */
+const LINK_BIN_STATS_T *Link_GetBinStats(void)
+{
+   return &binStats;
+}
+
+#if LINK_USE_DMA
+/* Return DMA receive statistics */
+const UART_DMA_RX_STATS_T *Link_GetRxStats(void)
+{
+   return UartDma_RxGetStats(&rxDma);
+}
+
+/* Return DMA transmit statistics */
+const UART_DMA_TX_STATS_T *Link_GetTxStats(void)
+{
+   return UartDma_TxGetStats(&txDma);
+}
+#endif
@@ -0,0 +1,72 @@
+/*
+ * @brief Cortex-M0APP coprocessor boot
+ */
+
+#include <string.h>
+#include "chip.h"
+#include "m0app.h"
+#include "ipc.h"
+#include "systime.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* An erased bank reads 0xFF: look for a stack and a Thumb reset vector inside the RAM copy */
+static bool M0App_ImageValid(void)
+{
+   const uint32_t *vectors = (const uint32_t *) M0APP_IMAGE_FLASH;
+   uint32_t sp = vectors[0];
+   uint32_t reset = vectors[1];
+
+   return sp > M0APP_IMAGE_RAM && sp <= M0APP_IMAGE_RAM + M0APP_IMAGE_SIZE && (sp & 3) == 0 &&
+          (reset & 1) != 0 && reset > M0APP_IMAGE_RAM && reset < M0APP_IMAGE_RAM + M0APP_IMAGE_SIZE;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Hold the M0APP in reset */
+void M0App_Stop(void)
+{
+   /* Unlike the peripherals, the M0 reset does not clear itself */
+   Chip_RGU_TriggerReset(RGU_M0APP_RST);
+   while (!Chip_RGU_InReset(RGU_M0APP_RST)) {}
+}
+
+/* Load and start the M0APP image, set up the mailboxes */
+bool M0App_Boot(void)
+{
+   uint64_t deadline;
+
+   M0App_Stop();
+   if (!M0App_ImageValid()) {
+       return false;
+   }
+
+   Chip_Clock_Enable(CLK_M4_M0APP);
+   memcpy((void *) M0APP_IMAGE_RAM, (const void *) M0APP_IMAGE_FLASH, M0APP_IMAGE_SIZE);
+   Ipc_Init();
+   Chip_CREG_SetM0AppMemMap(M0APP_IMAGE_RAM);
+   __DSB();
+   Chip_RGU_ClearReset(RGU_M0APP_RST);
+
+   deadline = Systime_Now() + M0APP_BOOT_TIMEOUT_US;
+   while (!Ipc_PeerReady()) {
+       if (Systime_Now() >= deadline) {
+           M0App_Stop();
+           return false;
+       }
+   }
+
+   return true;
+}
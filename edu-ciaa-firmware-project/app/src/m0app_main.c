@@ -0,0 +1,131 @@
+/*
+ * @brief Cortex-M0APP side of the comms offload
+ *
+ * Entry point of the M0APP image that M0App_Boot() starts. The M0 owns the
+ * link UART and the protocol parser, and forwards every decoded command to
+ * the M4 through the mailboxes (ipc.h). The M4 runs the handler and
+ * answers with its status, after any telemetry or dump text it produced,
+ * which the M0 sends on the link in order. The M4 only ever sees whole
+ * commands, never UART interrupts.
+ *
+ * The M4 build compiles this file to nothing. The M0APP image is built
+ * with CORE_M0 and LPC43XX_CORE_M0APP, the LPCOpen M0APP startup code and a
+ * linker script running from RamAHB32 (see m0app.h), from this file and
+ * link.c, protocol.c, proto_bin.c, uart_dma.c, spsc_ring.c and ipc.c, with
+ * LINK_USE_DMA 0 so that the GPDMA stays with the M4. The M0 has no DWT:
+ * PROF_ENABLE and EVTRACE_ENABLE are 0 there, and cycles.h must read
+ * SysTick instead.
+ */
+
+#if defined(CORE_M0)
+
+#include "link.h"
+#include "ipc.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Polls of the mailbox before a command counts as lost, well above the M4's worst case */
+#define M0APP_STATUS_SPINS      2000000
+
+/* Sequence number of the last command forwarded to the M4 */
+static uint8_t m0app_seq;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Put M4 output on the link, waiting for room: the M0 has nothing else to do */
+static void m0app_output(const IPC_MSG_T *msg)
+{
+   switch (msg->type) {
+   case IPC_MSG_TEXT:
+       while (Link_Send(msg->data, msg->len) == 0) {}
+       break;
+
+   case IPC_MSG_TELEMETRY:
+       while (Link_SendTelemetry((const int16_t *) msg->data, msg->arg) == 0) {}
+       break;
+
+   default:
+       break;
+   }
+}
+
+/* Run a command on the M4, the link answers with the status returned here */
+static PROTO_STATUS_T m0app_forward(const PROTO_CMD_T *cmd, void *ctx)
+{
+   IPC_MSG_T msg;
+   uint32_t spins;
+   uint8_t seq = ++m0app_seq;
+
+   for (spins = 0; !Ipc_Send(IPC_MSG_CMD, IPC_ARG(cmd->id, seq), cmd->params,
+                             cmd->nparams * sizeof(int16_t));
+        spins++) {
+       if (spins == M0APP_STATUS_SPINS) {
+           return PROTO_STATUS_ERR_CMD;
+       }
+   }
+
+   for (spins = 0; spins < M0APP_STATUS_SPINS; spins++) {
+       if (Ipc_Recv(&msg)) {
+           if (msg.type != IPC_MSG_STATUS) {
+               m0app_output(&msg);
+           }
+           /* A status for an older command arrived after it timed out, drop it */
+           else if (IPC_ARG_SEQ(msg.arg) == seq) {
+               return (PROTO_STATUS_T) IPC_ARG_VAL(msg.arg);
+           }
+       }
+   }
+
+   return PROTO_STATUS_ERR_CMD;
+}
+
+static const PROTO_HANDLER_T m0app_handlers[PROTO_CMD_COUNT] = {
+   [PROTO_CMD_MV] = m0app_forward,
+   [PROTO_CMD_ST] = m0app_forward,
+   [PROTO_CMD_GT] = m0app_forward,
+   [PROTO_CMD_PF] = m0app_forward,
+   [PROTO_CMD_IQ] = m0app_forward,
+   [PROTO_CMD_TR] = m0app_forward,
+   [PROTO_CMD_TA] = m0app_forward,
+   [PROTO_CMD_BT] = m0app_forward,
+};
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Clocks and pins are set up by the M4 before it starts this core */
+int main(void)
+{
+   IPC_MSG_T msg;
+
+   SystemCoreClockUpdate();
+   Ipc_Init();
+   Link_Init(LINK_DEFAULT_MODE, m0app_handlers, NULL);
+
+   while (1) {
+       Link_Poll();
+
+       /* Dump lines sent by the M4 outside of a command */
+       while (Ipc_Recv(&msg)) {
+           m0app_output(&msg);
+       }
+
+       /* The UART and the M4's SEV both interrupt this core */
+       __disable_irq();
+       if (!Link_RxPending() && !Ipc_RxPending()) {
+           __WFI();
+       }
+       __enable_irq();
+   }
+}
+
+#endif /* defined(CORE_M0) */
@@ -1,27 +1,458 @@
+#include <string.h>
 #include "board.h"
+#include "link.h"
+#include "control_loop.h"
+#include "encoder.h"
+#include "motor.h"
+#include "drive.h"
+#include "prof.h"
+#include "irq_trace.h"
+#include "evtrace.h"
+#include "systime.h"
+#include "swtimer.h"
+#include "task_sched.h"
+#include "rtos.h"
+#include "ipc.h"
+#include "m0app.h"
+#include "membench.h"
+#include "boottime.h"
 
-#define TICKRATE_HZ (1000)
+#define MS_TO_TICKS(ms) ((uint64_t) (ms) * 1000 / SWTIMER_TICK_US)
 
-static volatile uint32_t tick_ct = 0;
+#define BLINK_MS (100)
+#define BLINK_PARKED_MS (1000)
 
-void SysTick_Handler(void) {
-   tick_ct++;
+/* Stopped this long, the control loop is stopped too and the CPU only wakes for the link */
+#define PARK_DELAY_MS (2000)
+
+/* Deep sleep while parked: lowest drain, but link bytes sent while asleep are lost */
+#ifndef PARK_DEEP_SLEEP
+#define PARK_DEEP_SLEEP 0
+#endif
+
+/* Hand the link to the M0APP core when an image is flashed, the M4 keeps the control loops */
+#ifndef M0APP_COMMS
+#define M0APP_COMMS 0
+#endif
+
+/* Last speeds requested by the ESP32 */
+static int16_t speed_left, speed_right;
+
+static bool parked;
+static SWTIMER_T blink_timer, park_timer;
+
+/* The M0APP runs the link, commands and output go through the mailboxes */
+static bool comms_remote;
+
+/* Send bytes on the link, here or through the M0APP, whole or not at all in the latter case */
+static int comms_send(const char *buf, int len) {
+   int i, n;
+
+   if (!comms_remote) {
+       return Link_Send(buf, len);
+   }
+
+   /* Leave room for command status and telemetry */
+   if (Ipc_TxFree() < (uint32_t) (len + IPC_MSG_DATA_MAX - 1) / IPC_MSG_DATA_MAX + IPC_TX_RESERVE) {
+       return 0;
+   }
+   for (i = 0; i < len; i += n) {
+       n = MIN(len - i, IPC_MSG_DATA_MAX);
+       Ipc_Send(IPC_MSG_TEXT, 0, &buf[i], n);
+   }
+   return len;
+}
+
+/* Text dump in progress: line formatter, next line and line count */
+typedef int (*dump_line_t)(uint32_t line, char *buf);
+static dump_line_t dump_line;
+static uint32_t dump_next, dump_lines;
+
+/* Task signals */
+#define SIG_LINK_RX (SCHED_SIG_USER + 0)
+#define SIG_LINK_TX (SCHED_SIG_USER + 1)
+#define SIG_DUMP (SCHED_SIG_USER + 2)
+
+/* Commands go first, dumps only use the link when it is otherwise idle */
+#define LINK_TASK_PRIO 0
+#define DUMP_TASK_PRIO 4
+
+static SCHED_TASK_T link_task;
+static SCHED_EVT_T link_queue[4];
+
+#if RTOS_ENABLE
+/* Kernel threads: the main loop, and the dumps below it */
+#define COMMS_THREAD_PRIO 1
+#define LOG_THREAD_PRIO 2
+#define THREAD_STACK_WORDS 512
+
+static RTOS_THREAD_T comms_thread, log_thread;
+static uint32_t comms_stack[THREAD_STACK_WORDS] __attribute__((aligned(8)));
+static uint32_t log_stack[THREAD_STACK_WORDS] __attribute__((aligned(8)));
+
+/* Wake-ups, the item carries nothing */
+static RTOS_QUEUE_T comms_wake, log_wake;
+static uint8_t comms_wake_buf[4], log_wake_buf[4];
+
+/* Held around link polls and sends, neither the link nor the mailboxes are reentrant */
+static RTOS_MUTEX_T link_mutex;
+#else
+static SCHED_TASK_T dump_task;
+static SCHED_EVT_T dump_queue[4];
+#endif
+
+static void dump_start(dump_line_t fn, uint32_t lines) {
+#if RTOS_ENABLE
+   uint8_t evt = 0;
+#endif
+
+   dump_line = fn;
+   dump_lines = lines;
+   dump_next = 0;
+#if RTOS_ENABLE
+   Rtos_QueueSend(&log_wake, &evt, RTOS_NO_WAIT);
+#else
+   Sched_Post(&dump_task, SIG_DUMP, 0);
+#endif
+}
+
+static void blink_expired(void *ctx) {
+   Board_LED_Toggle(LED_3);
+}
+
+/* Still for PARK_DELAY_MS: stop the control loop, the CPU only wakes for the link and the LED */
+static void park_expired(void *ctx) {
+   parked = true;
+   CtrlLoop_Stop();
+   Systime_AllowDeepSleep(PARK_DEEP_SLEEP);
+   Swtimer_Start(&blink_timer, MS_TO_TICKS(BLINK_PARKED_MS), MS_TO_TICKS(BLINK_PARKED_MS));
+}
+
+/* Arm the park timer when the rover stops, restart the control loop on the first move */
+static void park_update(void) {
+   if (speed_left != 0 || speed_right != 0) {
+       Swtimer_Stop(&park_timer);
+       if (parked) {
+           parked = false;
+           Systime_AllowDeepSleep(false);
+           CtrlLoop_Start();
+           Swtimer_Start(&blink_timer, MS_TO_TICKS(BLINK_MS), MS_TO_TICKS(BLINK_MS));
+       }
+   }
+   else if (!parked && !Swtimer_IsActive(&park_timer)) {
+       Swtimer_Start(&park_timer, MS_TO_TICKS(PARK_DELAY_MS), 0);
+   }
+}
+
+static PROTO_STATUS_T cmd_move(const PROTO_CMD_T *cmd, void *ctx) {
+   speed_left = cmd->params[0];
+   speed_right = cmd->params[1];
+   park_update();
+   Drive_SetSpeed(speed_left, speed_right);
+   return PROTO_STATUS_OK;
+}
+
+static PROTO_STATUS_T cmd_stop(const PROTO_CMD_T *cmd, void *ctx) {
+   speed_left = 0;
+   speed_right = 0;
+   park_update();
+   Drive_Stop();
+   return PROTO_STATUS_OK;
+}
+
+static PROTO_STATUS_T cmd_telemetry(const PROTO_CMD_T *cmd, void *ctx) {
+   int16_t tm[4] = {speed_left, speed_right,
+                    (int16_t) Encoder_GetRPM(ENCODER_LEFT), (int16_t) Encoder_GetRPM(ENCODER_RIGHT)};
+
+   if (comms_remote) {
+       Ipc_Send(IPC_MSG_TELEMETRY, 4, tm, sizeof(tm));
+   }
+   else {
+       Link_SendTelemetry(tm, 4);
+   }
+   return PROTO_STATUS_OK;
+}
+
+static int prof_line(uint32_t line, char *buf) {
+   return Prof_FormatLine((PROF_ID_T) line, buf);
+}
+
+static PROTO_STATUS_T cmd_profile(const PROTO_CMD_T *cmd, void *ctx) {
+   dump_start(prof_line, PROF_COUNT);
+   return PROTO_STATUS_OK;
+}
+
+static PROTO_STATUS_T cmd_boot_time(const PROTO_CMD_T *cmd, void *ctx) {
+#if BOOT_TIME_ENABLE
+   dump_start(Boot_FormatLine, BOOT_LINES);
+   return PROTO_STATUS_OK;
+#else
+   return PROTO_STATUS_ERR_CMD;
+#endif
+}
+
+static PROTO_STATUS_T cmd_irq_load(const PROTO_CMD_T *cmd, void *ctx) {
+#if IRQ_TRACE_ENABLE
+   IrqTrace_Snapshot();
+   dump_start(IrqTrace_FormatLine, IRQ_TRACE_LINES);
+   return PROTO_STATUS_OK;
+#else
+   return PROTO_STATUS_ERR_CMD;
+#endif
 }
 
-void delay(uint32_t tk) {
-   uint32_t end = tick_ct + tk;
-   while(tick_ct < end)
-       __WFI();
+static PROTO_STATUS_T cmd_trace_dump(const PROTO_CMD_T *cmd, void *ctx) {
+#if EVTRACE_ENABLE
+   EvTrace_Freeze();
+   dump_start(EvTrace_FormatLine, EVTRACE_LINES);
+   return PROTO_STATUS_OK;
+#else
+   return PROTO_STATUS_ERR_CMD;
+#endif
+}
+
+static PROTO_STATUS_T cmd_trace_arm(const PROTO_CMD_T *cmd, void *ctx) {
+#if EVTRACE_ENABLE
+   /* A trace dump still in progress would mix two runs, drop it */
+   if (dump_line == EvTrace_FormatLine && dump_next < dump_lines) {
+       dump_lines = 0;
+   }
+   EvTrace_Arm();
+   return PROTO_STATUS_OK;
+#else
+   return PROTO_STATUS_ERR_CMD;
+#endif
+}
+
+static const PROTO_HANDLER_T cmd_handlers[PROTO_CMD_COUNT] = {
+   [PROTO_CMD_MV] = cmd_move,
+   [PROTO_CMD_ST] = cmd_stop,
+   [PROTO_CMD_GT] = cmd_telemetry,
+   [PROTO_CMD_PF] = cmd_profile,
+   [PROTO_CMD_IQ] = cmd_irq_load,
+   [PROTO_CMD_TR] = cmd_trace_dump,
+   [PROTO_CMD_TA] = cmd_trace_arm,
+   [PROTO_CMD_BT] = cmd_boot_time,
+};
+
+/* Run the commands decoded by the M0APP, each answered with its status */
+static void ipc_poll(void) {
+   IPC_MSG_T msg;
+   PROTO_CMD_T cmd;
+   PROTO_STATUS_T status;
+
+   while (Ipc_Recv(&msg)) {
+       if (msg.type != IPC_MSG_CMD) {
+           continue;
+       }
+       cmd.id = (PROTO_CMD_ID_T) IPC_ARG_VAL(msg.arg);
+       cmd.nparams = MIN(msg.len / sizeof(int16_t), PROTO_MAX_PARAMS);
+       memcpy(cmd.params, msg.data, cmd.nparams * sizeof(int16_t));
+       if (cmd.id < PROTO_CMD_COUNT && cmd_handlers[cmd.id] != NULL) {
+           status = cmd_handlers[cmd.id](&cmd, NULL);
+       }
+       else {
+           status = PROTO_STATUS_ERR_CMD;
+       }
+       Ipc_Send(IPC_MSG_STATUS, IPC_ARG(status, IPC_ARG_SEQ(msg.arg)), NULL, 0);
+   }
+}
+
+/* Decode received bytes and run the commands, posted by the link receive interrupt */
+static uint8_t link_task_fn(SCHED_TASK_T *pTask, const SCHED_EVT_T *pEvt) {
+   PROF_BEGIN(LINK_POLL);
+   if (comms_remote) {
+       ipc_poll();
+   }
+   else {
+       Link_Poll();
+   }
+   PROF_END(LINK_POLL);
+   return SCHED_WAITING;
+}
+
+#if !RTOS_ENABLE
+/* Send the dump one line at a time, waiting for transmit space instead of polling for it */
+static uint8_t dump_task_fn(SCHED_TASK_T *pTask, const SCHED_EVT_T *pEvt) {
+   char line[MAX(MAX(PROF_LINE_MAX, IRQ_TRACE_LINE_MAX), MAX(EVTRACE_LINE_MAX, BOOT_LINE_MAX))];
+   int len;
+
+   SCHED_BEGIN(pTask);
+   while (1) {
+       SCHED_AWAIT(pTask, dump_next < dump_lines);
+
+       /* A new dump may start while this one waits, format the line again on every try */
+       len = dump_line(dump_next, line);
+       if (len == 0 || comms_send(line, len) == len) {
+           dump_next++;
+           SCHED_YIELD(pTask);
+       }
+       else {
+           SCHED_AWAIT_SIG(pTask, pEvt, SIG_LINK_TX);
+       }
+   }
+   SCHED_END(pTask);
+}
+#endif
+
+static void link_rx_notify(void) {
+#if RTOS_ENABLE
+   uint8_t evt = 0;
+
+   Sched_Post(&link_task, SIG_LINK_RX, 0);
+   Rtos_QueueSendFromIsr(&comms_wake, &evt);
+#else
+   Sched_Post(&link_task, SIG_LINK_RX, 0);
+#endif
+}
+
+static void link_tx_notify(void) {
+   if (dump_next < dump_lines) {
+#if RTOS_ENABLE
+       uint8_t evt = 0;
+
+       Rtos_QueueSendFromIsr(&log_wake, &evt);
+#else
+       Sched_Post(&dump_task, SIG_LINK_TX, 0);
+#endif
+   }
+}
+
+#if RTOS_ENABLE
+/* The main loop as a thread: commands and software timers, blocking instead of sleeping */
+static void comms_thread_fn(void *arg) {
+   uint64_t wake, now;
+   uint32_t ticks;
+   uint8_t evt;
+
+   while (1) {
+       Rtos_MutexLock(&link_mutex, RTOS_FOREVER);
+       Sched_Run();
+       Rtos_MutexUnlock(&link_mutex);
+       Swtimer_Run(Systime_Now());
+
+       /* Wait for the receive interrupt, or until the next software timer */
+       wake = Swtimer_NextDeadline();
+       now = Systime_Now();
+       ticks = (wake <= now) ? RTOS_NO_WAIT :
+               (uint32_t) MIN((wake - now) / (1000000 / RTOS_TICK_HZ) + 1, RTOS_FOREVER);
+       if (Sched_IsIdle()) {
+           Rtos_QueueRecv(&comms_wake, &evt, ticks);
+       }
+   }
+}
+
+/* Send the dumps one line at a time, whenever the comms thread leaves the CPU */
+static void log_thread_fn(void *arg) {
+   char line[MAX(MAX(PROF_LINE_MAX, IRQ_TRACE_LINE_MAX), MAX(EVTRACE_LINE_MAX, BOOT_LINE_MAX))];
+   int len;
+   bool sent;
+   uint8_t evt;
+
+   while (1) {
+       /* A dump started, or transmit space freed up */
+       Rtos_QueueRecv(&log_wake, &evt, RTOS_FOREVER);
+       do {
+           /* The comms thread may start or drop a dump between two lines */
+           Rtos_MutexLock(&link_mutex, RTOS_FOREVER);
+           sent = false;
+           if (dump_next < dump_lines) {
+               len = dump_line(dump_next, line);
+               if (len == 0 || comms_send(line, len) == len) {
+                   dump_next++;
+                   sent = true;
+               }
+           }
+           Rtos_MutexUnlock(&link_mutex);
+       } while (sent);
+   }
+}
+#endif
+
+void delay(uint32_t ms) {
+   uint64_t end = Systime_Now() + (uint64_t) ms * 1000;
+
+   while (Systime_Now() < end) {
+       __disable_irq();
+       Systime_Idle(end);
+       __enable_irq();
+   }
 }
 
 int main(void) {
+#if !RTOS_ENABLE
+   uint64_t wake;
+#endif
+
+   Boot_Mark(BOOT_MARK_MAIN);
+   Motor_Safe();
+   Boot_Mark(BOOT_MARK_SAFE);
    SystemCoreClockUpdate();
+   EvTrace_Init();
    Board_Init();
-   SysTick_Config(SystemCoreClock / TICKRATE_HZ);
+   IrqTrace_Init();
+   Systime_Init();
+   Boot_Mark(BOOT_MARK_BOARD);
+   Prof_Init();
+   MemBench_Run();
+#if M0APP_COMMS
+   comms_remote = M0App_Boot();
+#endif
+   if (!comms_remote) {
+       Link_Init(LINK_DEFAULT_MODE, cmd_handlers, NULL);
+   }
+   Encoder_Init();
+   Motor_Init(MOTOR_PWM_HZ);
+   CtrlLoop_Init(CTRL_LOOP_BASE_HZ);
+   Drive_Init();
+   CtrlLoop_Start();
+   Boot_Mark(BOOT_MARK_READY);
 
+   Sched_Init();
+   Sched_TaskInit(&link_task, link_task_fn, NULL, LINK_TASK_PRIO, link_queue, 4);
+   if (comms_remote) {
+       Ipc_SetNotify(link_rx_notify, link_tx_notify);
+   }
+   else {
+       Link_SetNotify(link_rx_notify, link_tx_notify);
+   }
+   Sched_Start(&link_task);
+#if !RTOS_ENABLE
+   Sched_TaskInit(&dump_task, dump_task_fn, NULL, DUMP_TASK_PRIO, dump_queue, 4);
+   Sched_Start(&dump_task);
+#endif
+
+   Swtimer_Init(Systime_Now());
+   Swtimer_Setup(&blink_timer, blink_expired, NULL);
+   Swtimer_Setup(&park_timer, park_expired, NULL);
+   Swtimer_Start(&blink_timer, 0, MS_TO_TICKS(BLINK_MS));
+   park_update();
+
+#if RTOS_ENABLE
+   /* The control loop stays in its interrupt, above what the kernel masks */
+   Rtos_Init();
+   Rtos_MutexInit(&link_mutex);
+   Rtos_QueueInit(&comms_wake, comms_wake_buf, 1, sizeof(comms_wake_buf));
+   Rtos_QueueInit(&log_wake, log_wake_buf, 1, sizeof(log_wake_buf));
+   Rtos_ThreadCreate(&comms_thread, "comms", comms_thread_fn, NULL, comms_stack,
+                     THREAD_STACK_WORDS, COMMS_THREAD_PRIO);
+   Rtos_ThreadCreate(&log_thread, "log", log_thread_fn, NULL, log_stack,
+                     THREAD_STACK_WORDS, LOG_THREAD_PRIO);
+   Rtos_Start();
+#else
    while (1) {
-       Board_LED_Toggle(LED_3);
-       delay(100);
-       printf("Hola mundo at %d\r\n", tick_ct);
+       /* Commands are dispatched as soon as the receive interrupt posts them */
+       Sched_Run();
+       Swtimer_Run(Systime_Now());
+
+       /* No periodic tick: sleep until the next software timer, any interrupt
+          wakes the loop. Events posted since Sched_Run() are handled first. */
+       wake = Swtimer_NextDeadline();
+       __disable_irq();
+       if (Sched_IsIdle()) {
+           Systime_Idle(wake);
+       }
+       __enable_irq();
    }
+#endif
 }
@@ -0,0 +1,125 @@
+/*
+ * @brief Flash versus SRAM execution benchmark
+ */
+
+#include "membench.h"
+#include "prof.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+#if PROF_ENABLE
+
+/* Biquad sections in the cascade, Q14 coefficients b0 b1 b2 a1 a2 */
+#define MEMBENCH_SECTIONS       4
+
+static const int16_t coeffs[MEMBENCH_SECTIONS][5] = {
+   {  4096,  8192,  4096, -14000,  6200 },
+   {  4096,  8192,  4096, -15200,  7400 },
+   { 16384, -32000, 16384, -31000, 14800 },
+   { 16384, -32200, 16384, -31600, 15400 },
+};
+
+static int16_t samples[MEMBENCH_BLOCK];
+static int32_t state[MEMBENCH_SECTIONS][2];
+
+#endif
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+#if PROF_ENABLE
+
+/* Filter the block in place, inlined into both variants so they run the same code */
+__attribute__ ((always_inline)) STATIC INLINE void MemBench_Kernel(void)
+{
+   uint32_t i, s;
+
+   for (i = 0; i < MEMBENCH_BLOCK; i++) {
+       int32_t x = samples[i];
+
+       for (s = 0; s < MEMBENCH_SECTIONS; s++) {
+           const int16_t *c = coeffs[s];
+           int32_t y = (c[0] * x + state[s][0]) >> 14;
+
+           state[s][0] = c[1] * x - c[3] * y + state[s][1];
+           state[s][1] = c[2] * x - c[4] * y;
+           x = __SSAT(y, 16);
+       }
+       samples[i] = (int16_t) x;
+   }
+}
+
+/* Kernel linked in flash */
+static __attribute__ ((noinline)) void MemBench_Flash(void)
+{
+   MemBench_Kernel();
+}
+
+/* Kernel copied to RamLoc40 */
+static __HOT_FUNC void MemBench_Ram(void)
+{
+   MemBench_Kernel();
+}
+
+/* Reload the input and clear the filter state, so both variants take the same path */
+static void MemBench_Reset(void)
+{
+   uint32_t i;
+
+   for (i = 0; i < MEMBENCH_BLOCK; i++) {
+       samples[i] = (int16_t) ((i & 8) ? 12000 : -12000);
+   }
+   for (i = 0; i < MEMBENCH_SECTIONS; i++) {
+       state[i][0] = state[i][1] = 0;
+   }
+}
+
+/* Run enough other flash code to leave none of the kernel in the accelerator */
+static void MemBench_Evict(void)
+{
+   char line[PROF_LINE_MAX];
+   uint32_t id;
+
+   for (id = 0; id < PROF_COUNT; id++) {
+       Prof_FormatLine((PROF_ID_T) id, line);
+   }
+   MemBench_Reset();
+}
+
+#endif
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Time the kernel from flash and from SRAM */
+void MemBench_Run(void)
+{
+#if PROF_ENABLE
+   uint32_t run;
+
+   for (run = 0; run < MEMBENCH_RUNS; run++) {
+       MemBench_Evict();
+       {
+           PROF_BEGIN(EXEC_FLASH);
+           MemBench_Flash();
+           PROF_END(EXEC_FLASH);
+       }
+
+       MemBench_Evict();
+       {
+           PROF_BEGIN(EXEC_RAM);
+           MemBench_Ram();
+           PROF_END(EXEC_RAM);
+       }
+   }
+#endif
+}
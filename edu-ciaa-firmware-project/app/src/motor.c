@@ -0,0 +1,379 @@
+/*
+ * @brief Dual H-bridge (L298N) motor driver
+ */
+
+#include "motor.h"
+#include "evtrace.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+#if MOTOR_BACKEND == MOTOR_BACKEND_MCPWM
+
+/* MCPWM channels of the two enable outputs, both run from channel 0 in AC mode */
+#define MOTOR_PWM_LEFT          0
+#define MOTOR_PWM_RIGHT         1
+#define MOTOR_PWM_MASK          ((1 << MOTOR_PWM_LEFT) | (1 << MOTOR_PWM_RIGHT))
+
+/* MCPWM channel raising the ADC start edge on MCOA2, also run from channel 0 */
+#define MOTOR_PWM_ADC           2
+
+static volatile bool aborted;
+static volatile uint32_t abortCount;
+
+#else
+
+/* SCT PWM indexes (match and event numbers) of the two enable outputs */
+#define MOTOR_PWM_LEFT          1
+#define MOTOR_PWM_RIGHT         2
+
+/* SCT PWM index and output of the ADC start edge, CTOUT_15 is routed to the ADCs only */
+#define MOTOR_PWM_ADC           3
+#define MOTOR_ADC_CTOUT         15
+
+#endif
+
+/* Match value for every speed magnitude */
+static uint32_t dutyTicks[MOTOR_SPEED_MAX + 1];
+static uint32_t periodTicks;
+
+/* ADC start point in thousandths of the period, 0 for none */
+static uint32_t adcTrigger;
+
+/* Set by Motor_Trip(), holds both wheels coasting until Motor_ClearTrip() */
+static volatile bool tripped;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Configure one direction pin as a low output */
+static void Motor_InitDirPin(uint8_t port, uint8_t pin, uint16_t func,
+                             uint8_t gpioPort, uint8_t gpioPin)
+{
+   Chip_SCU_PinMuxSet(port, pin, SCU_MODE_INACT | func);
+   Chip_GPIO_SetPinOutLow(LPC_GPIO_PORT, gpioPort, gpioPin);
+   Chip_GPIO_SetPinDIROutput(LPC_GPIO_PORT, gpioPort, gpioPin);
+}
+
+/* All four direction pins as outputs, low */
+static void Motor_InitDirPins(void)
+{
+   Motor_InitDirPin(MOTOR_IN1_PORT, MOTOR_IN1_PIN, MOTOR_IN1_FUNC,
+                    MOTOR_IN1_GPIO_PORT, MOTOR_IN1_GPIO_PIN);
+   Motor_InitDirPin(MOTOR_IN2_PORT, MOTOR_IN2_PIN, MOTOR_IN2_FUNC,
+                    MOTOR_IN2_GPIO_PORT, MOTOR_IN2_GPIO_PIN);
+   Motor_InitDirPin(MOTOR_IN3_PORT, MOTOR_IN3_PIN, MOTOR_IN3_FUNC,
+                    MOTOR_IN3_GPIO_PORT, MOTOR_IN3_GPIO_PIN);
+   Motor_InitDirPin(MOTOR_IN4_PORT, MOTOR_IN4_PIN, MOTOR_IN4_FUNC,
+                    MOTOR_IN4_GPIO_PORT, MOTOR_IN4_GPIO_PIN);
+}
+
+/* Drive the direction pins of both bridges */
+STATIC INLINE void Motor_SetDir(bool in1, bool in2, bool in3, bool in4)
+{
+   Chip_GPIO_SetPinState(LPC_GPIO_PORT, MOTOR_IN1_GPIO_PORT, MOTOR_IN1_GPIO_PIN, in1);
+   Chip_GPIO_SetPinState(LPC_GPIO_PORT, MOTOR_IN2_GPIO_PORT, MOTOR_IN2_GPIO_PIN, in2);
+   Chip_GPIO_SetPinState(LPC_GPIO_PORT, MOTOR_IN3_GPIO_PORT, MOTOR_IN3_GPIO_PIN, in3);
+   Chip_GPIO_SetPinState(LPC_GPIO_PORT, MOTOR_IN4_GPIO_PORT, MOTOR_IN4_GPIO_PIN, in4);
+}
+
+#if MOTOR_BACKEND == MOTOR_BACKEND_MCPWM
+
+/* Set up both MCPWM channels and the abort input, return the period in ticks */
+static uint32_t Motor_InitPWM(uint32_t freqHz)
+{
+   uint32_t mode = MOTOR_MCPWM_CENTER ? MCPWM_MODE_CENTER : MCPWM_MODE_EDGE;
+   uint32_t limit, dt;
+
+   Chip_MCPWM_Init(LPC_MCPWM);
+   Chip_SCU_PinMuxSet(MOTOR_ENA_PORT, MOTOR_ENA_PIN, SCU_MODE_INACT | MOTOR_ENA_FUNC);
+   Chip_SCU_PinMuxSet(MOTOR_ENB_PORT, MOTOR_ENB_PIN, SCU_MODE_INACT | MOTOR_ENB_FUNC);
+   Chip_SCU_PinMuxSet(MOTOR_ABORT_PORT, MOTOR_ABORT_PIN,
+                      SCU_MODE_PULLUP | SCU_MODE_INBUFF_EN | MOTOR_ABORT_FUNC);
+
+   if (MOTOR_MCPWM_DEADTIME_NS > 0) {
+       mode |= MCPWM_MODE_DEADTIME;
+       dt = (uint32_t) (((uint64_t) Chip_Clock_GetRate(CLK_APB1_MOTOCON) *
+                         MOTOR_MCPWM_DEADTIME_NS) / 1000000000);
+       Chip_MCPWM_SetDeadTime(LPC_MCPWM, MOTOR_PWM_LEFT, dt);
+       Chip_MCPWM_SetDeadTime(LPC_MCPWM, MOTOR_PWM_RIGHT, dt);
+   }
+
+   /* AC mode: the right channel follows the left channel's counter and limit */
+   Chip_MCPWM_ConfigChannel(LPC_MCPWM, MOTOR_PWM_LEFT, mode);
+   Chip_MCPWM_ConfigChannel(LPC_MCPWM, MOTOR_PWM_RIGHT, mode);
+   Chip_MCPWM_SetACMode(LPC_MCPWM, true);
+   limit = Chip_MCPWM_SetRate(LPC_MCPWM, MOTOR_PWM_LEFT, freqHz);
+   Chip_MCPWM_SetLimit(LPC_MCPWM, MOTOR_PWM_RIGHT, limit);
+
+   aborted = false;
+   abortCount = 0;
+   Chip_MCPWM_ClearIntStatus(LPC_MCPWM, MCPWM_INT_BITMASK);
+   Chip_MCPWM_IntEnable(LPC_MCPWM, MCPWM_INT_ABORT);
+   NVIC_SetPriority(MCPWM_IRQn, MOTOR_IRQ_PRIO);
+   NVIC_EnableIRQ(MCPWM_IRQn);
+
+   return limit;
+}
+
+/* MCOA is active while the counter is above the match value */
+STATIC INLINE uint32_t Motor_DutyToMatch(uint32_t ticks)
+{
+   return (ticks == 0) ? periodTicks + 1 : periodTicks - ticks;
+}
+
+/* Load both match values so they take effect at the same cycle end */
+__HOT_FUNC static void Motor_SetDuty(uint32_t left, uint32_t right)
+{
+   uint32_t primask = __get_PRIMASK();
+
+   __disable_irq();
+   Chip_MCPWM_HoldUpdate(LPC_MCPWM, MOTOR_PWM_MASK);
+   Chip_MCPWM_SetMatch(LPC_MCPWM, MOTOR_PWM_LEFT, left);
+   Chip_MCPWM_SetMatch(LPC_MCPWM, MOTOR_PWM_RIGHT, right);
+   Chip_MCPWM_ReleaseUpdate(LPC_MCPWM, MOTOR_PWM_MASK);
+   __set_PRIMASK(primask);
+}
+
+/* Start the PWM with both outputs passive, and the ADC start channel when asked */
+static void Motor_StartPWM(void)
+{
+   uint32_t mask = MOTOR_PWM_MASK;
+
+   Chip_MCPWM_SetMatch(LPC_MCPWM, MOTOR_PWM_LEFT, dutyTicks[0]);
+   Chip_MCPWM_SetMatch(LPC_MCPWM, MOTOR_PWM_RIGHT, dutyTicks[0]);
+
+   if (adcTrigger != 0) {
+       Chip_MCPWM_ConfigChannel(LPC_MCPWM, MOTOR_PWM_ADC,
+                                MOTOR_MCPWM_CENTER ? MCPWM_MODE_CENTER : MCPWM_MODE_EDGE);
+       Chip_MCPWM_SetLimit(LPC_MCPWM, MOTOR_PWM_ADC, periodTicks);
+       Chip_MCPWM_SetMatch(LPC_MCPWM, MOTOR_PWM_ADC,
+                           (uint32_t) (((uint64_t) periodTicks * adcTrigger) / 1000));
+       mask |= 1 << MOTOR_PWM_ADC;
+   }
+   Chip_MCPWM_Start(LPC_MCPWM, mask);
+}
+
+#else
+
+/* Set up the SCT as a two output PWM, return the period in ticks */
+static uint32_t Motor_InitPWM(uint32_t freqHz)
+{
+   /* Chip_SCTPWM_SetRate() halts the SCT, so this also works as a re-init */
+   Chip_SCTPWM_Init(LPC_SCT);
+   Chip_SCTPWM_SetRate(LPC_SCT, freqHz);
+   Chip_SCU_PinMuxSet(MOTOR_ENA_PORT, MOTOR_ENA_PIN, SCU_MODE_INACT | MOTOR_ENA_FUNC);
+   Chip_SCU_PinMuxSet(MOTOR_ENB_PORT, MOTOR_ENB_PIN, SCU_MODE_INACT | MOTOR_ENB_FUNC);
+   Chip_SCTPWM_SetOutPin(LPC_SCT, MOTOR_PWM_LEFT, MOTOR_ENA_CTOUT);
+   Chip_SCTPWM_SetOutPin(LPC_SCT, MOTOR_PWM_RIGHT, MOTOR_ENB_CTOUT);
+
+   return Chip_SCTPWM_GetTicksPerCycle(LPC_SCT);
+}
+
+/* The output is set at the period limit and cleared at the match */
+STATIC INLINE uint32_t Motor_DutyToMatch(uint32_t ticks)
+{
+   return ticks;
+}
+
+/* Load both duty cycles so they take effect at the same period limit */
+__HOT_FUNC static void Motor_SetDuty(uint32_t left, uint32_t right)
+{
+   uint32_t primask = __get_PRIMASK();
+
+   __disable_irq();
+   LPC_SCT->CONFIG |= SCT_CONFIG_NORELOADL_U;
+   Chip_SCTPWM_SetDutyCycle(LPC_SCT, MOTOR_PWM_LEFT, left);
+   Chip_SCTPWM_SetDutyCycle(LPC_SCT, MOTOR_PWM_RIGHT, right);
+   LPC_SCT->CONFIG &= ~SCT_CONFIG_NORELOADL_U;
+   __set_PRIMASK(primask);
+}
+
+/* Start the PWM with both outputs at zero duty, and the ADC start output when asked */
+static void Motor_StartPWM(void)
+{
+   uint32_t ticks;
+
+   if (adcTrigger != 0) {
+       ticks = (uint32_t) (((uint64_t) periodTicks * adcTrigger) / 1000);
+       Chip_SCTPWM_SetOutPin(LPC_SCT, MOTOR_PWM_ADC, MOTOR_ADC_CTOUT);
+       Chip_SCT_SetMatchCount(LPC_SCT, (CHIP_SCT_MATCH_REG_T) MOTOR_PWM_ADC, ticks);
+       Chip_SCTPWM_SetDutyCycle(LPC_SCT, MOTOR_PWM_ADC, ticks);
+   }
+
+   Chip_SCT_SetMatchCount(LPC_SCT, (CHIP_SCT_MATCH_REG_T) MOTOR_PWM_LEFT, dutyTicks[0]);
+   Chip_SCT_SetMatchCount(LPC_SCT, (CHIP_SCT_MATCH_REG_T) MOTOR_PWM_RIGHT, dutyTicks[0]);
+   Chip_SCTPWM_SetDutyCycle(LPC_SCT, MOTOR_PWM_LEFT, dutyTicks[0]);
+   Chip_SCTPWM_SetDutyCycle(LPC_SCT, MOTOR_PWM_RIGHT, dutyTicks[0]);
+   Chip_SCTPWM_Start(LPC_SCT);
+}
+
+#endif /* MOTOR_BACKEND */
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Hold both bridges off until Motor_Init() */
+void Motor_Safe(void)
+{
+   /* FUNC0 is the GPIO function of every enable pin option: left as inputs, the pull-downs hold them low */
+   Chip_SCU_PinMuxSet(MOTOR_ENA_PORT, MOTOR_ENA_PIN, SCU_MODE_PULLDOWN | SCU_MODE_FUNC0);
+   Chip_SCU_PinMuxSet(MOTOR_ENB_PORT, MOTOR_ENB_PIN, SCU_MODE_PULLDOWN | SCU_MODE_FUNC0);
+   Chip_GPIO_Init(LPC_GPIO_PORT);
+   Motor_InitDirPins();
+}
+
+/* Configure the PWM and the direction pins, motors stopped */
+Status Motor_Init(uint32_t freqHz)
+{
+   uint32_t i;
+
+   if (freqHz == 0 || freqHz > MOTOR_PWM_MAX_HZ) {
+       return ERROR;
+   }
+
+   Motor_InitDirPins();
+
+   periodTicks = Motor_InitPWM(freqHz);
+
+   /* All the division happens here, once per frequency change */
+   for (i = 0; i <= MOTOR_SPEED_MAX; i++) {
+       dutyTicks[i] = Motor_DutyToMatch((uint32_t) (((uint64_t) periodTicks * i) / MOTOR_SPEED_MAX));
+   }
+
+   Motor_StartPWM();
+
+   return SUCCESS;
+}
+
+/* Set both wheel speeds on the same PWM edge */
+__HOT_FUNC void Motor_Set(int32_t left, int32_t right)
+{
+   uint32_t magLeft, magRight;
+
+   if (tripped) {
+       left = 0;
+       right = 0;
+   }
+   magLeft = MIN((uint32_t) ((left < 0) ? -left : left), MOTOR_SPEED_MAX);
+   magRight = MIN((uint32_t) ((right < 0) ? -right : right), MOTOR_SPEED_MAX);
+
+   /* IN1/IN2 (IN3/IN4) both low with a zero duty cycle lets the wheel coast */
+   Motor_SetDir(left > 0, left < 0, right > 0, right < 0);
+   Motor_SetDuty(dutyTicks[magLeft], dutyTicks[magRight]);
+
+   /* A trip from a higher priority interrupt landed between the check and the writes */
+   if (tripped && (magLeft | magRight) != 0) {
+       Motor_SetDir(false, false, false, false);
+       Motor_SetDuty(dutyTicks[0], dutyTicks[0]);
+   }
+   EVTRACE(MOTOR_LEFT, (left < 0) ? -(int32_t) magLeft : (int32_t) magLeft);
+   EVTRACE(MOTOR_RIGHT, (right < 0) ? -(int32_t) magRight : (int32_t) magRight);
+}
+
+/* Let both wheels coast */
+__HOT_FUNC void Motor_Stop(void)
+{
+   Motor_Set(0, 0);
+}
+
+/* Let both wheels coast and ignore Motor_Set() until Motor_ClearTrip() */
+__HOT_FUNC void Motor_Trip(void)
+{
+   tripped = true;
+   Motor_Set(0, 0);
+}
+
+/* Accept Motor_Set() again after a trip, both wheels still coasting */
+void Motor_ClearTrip(void)
+{
+   tripped = false;
+}
+
+/* Return whether Motor_Trip() holds the motors off */
+bool Motor_IsTripped(void)
+{
+   return tripped;
+}
+
+/* Short both motors through the bridge to brake them */
+void Motor_Brake(void)
+{
+   if (tripped) {
+       return;
+   }
+
+   /* The L298N brakes with both direction inputs equal and the enable high */
+   Motor_SetDir(true, true, true, true);
+   Motor_SetDuty(dutyTicks[MOTOR_SPEED_MAX], dutyTicks[MOTOR_SPEED_MAX]);
+}
+
+/* Give the ADCs a start edge once per PWM period */
+void Motor_SetAdcTrigger(uint32_t permille)
+{
+   adcTrigger = MIN(permille, 999);
+}
+
+/* Return the PWM period in timer ticks */
+uint32_t Motor_GetTicksPerCycle(void)
+{
+   return periodTicks;
+}
+
+#if MOTOR_BACKEND == MOTOR_BACKEND_MCPWM
+
+/* MCPWM interrupt: the MCABORT input was asserted */
+__HOT_FUNC void MCPWM_IRQHandler(void)
+{
+   if (Chip_MCPWM_GetIntStatus(LPC_MCPWM) & MCPWM_INT_ABORT) {
+       /* The flag keeps the outputs passive, leave it set and stop listening
+          until Motor_ClearAbort() */
+       Chip_MCPWM_IntDisable(LPC_MCPWM, MCPWM_INT_ABORT);
+       Motor_SetDir(false, false, false, false);
+       aborted = true;
+       abortCount++;
+
+       /* Keep the events that led to the abort for a post-mortem dump */
+       EVTRACE(MOTOR_ABORT, abortCount);
+       EvTrace_Freeze();
+   }
+}
+
+/* Return whether the MCABORT input shut the motors off */
+bool Motor_IsAborted(void)
+{
+   return aborted;
+}
+
+/* Re-enable the motors after an abort, both wheels coasting */
+Status Motor_ClearAbort(void)
+{
+   Motor_Stop();
+   Chip_MCPWM_ClearIntStatus(LPC_MCPWM, MCPWM_INT_ABORT);
+
+   /* The flag sets again at once while the input is still low */
+   if (Chip_MCPWM_GetIntStatus(LPC_MCPWM) & MCPWM_INT_ABORT) {
+       return ERROR;
+   }
+
+   aborted = false;
+   NVIC_ClearPendingIRQ(MCPWM_IRQn);
+   Chip_MCPWM_IntEnable(LPC_MCPWM, MCPWM_INT_ABORT);
+   return SUCCESS;
+}
+
+/* Return the number of aborts since Motor_Init() */
+uint32_t Motor_GetAbortCount(void)
+{
+   return abortCount;
+}
+
+#endif
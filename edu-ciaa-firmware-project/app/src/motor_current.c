@@ -0,0 +1,182 @@
+/*
+ * @brief Motor current sampling in step with the PWM
+ */
+
+#include "motor_current.h"
+#include "motor.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Ping-pong blocks */
+#define MOTOR_CUR_NBLOCKS       2
+
+/* Per wheel state */
+typedef struct {
+   ADC_DMA_T adc;              /* Acquisition */
+   volatile uint16_t mean;     /* Mean of the last block */
+   volatile uint16_t peak;     /* Highest sample of the last block */
+   uint16_t stallLevel;        /* Stall level, 0 for none */
+   uint16_t tripLevel;         /* Trip level, 0 for none */
+   uint16_t overBlocks;        /* Blocks in a row over the stall level */
+   volatile bool stalled;      /* Stall reported and not cleared */
+   volatile bool tripped;      /* Tripped and not re-armed */
+   MOTOR_CUR_STATS_T stats;    /* Running statistics */
+} MOTOR_CUR_T;
+
+static MOTOR_CUR_T wheels[MOTOR_CUR_WHEELS];
+
+static uint32_t curBuf[MOTOR_CUR_WHEELS][ADC_DMA_BUF_WORDS(MOTOR_CUR_NBLOCKS, MOTOR_CUR_BLOCK, 1)] __DMA_BUF;
+static DMA_TransferDescriptor_t curDesc[MOTOR_CUR_WHEELS][MOTOR_CUR_NBLOCKS] __DMA_BUF;
+
+static SCHED_TASK_T *evtTask;
+static uint16_t evtSig;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Post a limit event */
+STATIC INLINE void MotorCur_Post(uint32_t wheel, MOTOR_CUR_EVT_T evt)
+{
+   if (evtTask != NULL) {
+       Sched_Post(evtTask, evtSig, (uint16_t) ((wheel << 8) | evt));
+   }
+}
+
+/* Block hook: mean, peak and limit checks of one wheel, from the DMA interrupt */
+__HOT_FUNC static void MotorCur_Block(ADC_DMA_T *pAdc, const uint32_t *block, void *ctx)
+{
+   uint32_t wheel = (uint32_t) ctx;
+   MOTOR_CUR_T *pCur = &wheels[wheel];
+   uint32_t i, v, sum = 0, peak = 0;
+
+   for (i = 0; i < MOTOR_CUR_BLOCK; i++) {
+       v = ADC_DR_RESULT(block[i]);
+       sum += v;
+       peak = MAX(peak, v);
+   }
+   pCur->mean = (uint16_t) (sum / MOTOR_CUR_BLOCK);
+   pCur->peak = (uint16_t) peak;
+   pCur->stats.blocks++;
+   pCur->stats.maxPeak = MAX(pCur->stats.maxPeak, peak);
+
+   if (pCur->tripLevel != 0 && peak >= pCur->tripLevel && !pCur->tripped) {
+       Motor_Trip();
+       pCur->tripped = true;
+       pCur->stats.trips++;
+       MotorCur_Post(wheel, MOTOR_CUR_EVT_TRIP);
+   }
+
+   if (pCur->stallLevel == 0) {
+       return;
+   }
+   if (pCur->mean >= pCur->stallLevel) {
+       if (pCur->overBlocks < MOTOR_CUR_STALL_BLOCKS && ++pCur->overBlocks == MOTOR_CUR_STALL_BLOCKS) {
+           pCur->stalled = true;
+           pCur->stats.stalls++;
+           MotorCur_Post(wheel, MOTOR_CUR_EVT_STALL);
+       }
+   }
+   else if (pCur->mean < pCur->stallLevel - pCur->stallLevel / 8) {
+       pCur->overBlocks = 0;
+       if (pCur->stalled) {
+           pCur->stalled = false;
+           MotorCur_Post(wheel, MOTOR_CUR_EVT_STALL_CLEAR);
+       }
+   }
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Start sampling both shunts */
+Status MotorCur_Init(void)
+{
+   static LPC_ADC_T *const adcs[MOTOR_CUR_WHEELS] = {LPC_ADC0, LPC_ADC1};
+   static const uint8_t chans[MOTOR_CUR_WHEELS] = {MOTOR_CUR_LEFT_CHAN, MOTOR_CUR_RIGHT_CHAN};
+   uint32_t i;
+
+   for (i = 0; i < MOTOR_CUR_WHEELS; i++) {
+       if (AdcDma_InitTriggered(&wheels[i].adc, adcs[i], chans[i], MOTOR_ADC_START, MOTOR_ADC_EDGE,
+                                curBuf[i], curDesc[i], MOTOR_CUR_NBLOCKS, MOTOR_CUR_BLOCK) != SUCCESS) {
+           return ERROR;
+       }
+       AdcDma_SetHook(&wheels[i].adc, MotorCur_Block, (void *) i);
+   }
+
+   Motor_SetAdcTrigger(MOTOR_CUR_TRIGGER_PERMILLE);
+
+   return SUCCESS;
+}
+
+/* Set the limits of a wheel */
+void MotorCur_SetLimits(MOTOR_CUR_WHEEL_T wheel, uint16_t stallLevel, uint16_t tripLevel)
+{
+   wheels[wheel].stallLevel = stallLevel;
+   wheels[wheel].tripLevel = tripLevel;
+}
+
+/* Post limit events to a task */
+void MotorCur_SetTask(SCHED_TASK_T *task, uint16_t sig)
+{
+   evtSig = sig;
+   evtTask = task;
+}
+
+/* Return the mean current of the last block */
+uint16_t MotorCur_Mean(MOTOR_CUR_WHEEL_T wheel)
+{
+   return wheels[wheel].mean;
+}
+
+/* Return the highest sample of the last block */
+uint16_t MotorCur_Peak(MOTOR_CUR_WHEEL_T wheel)
+{
+   return wheels[wheel].peak;
+}
+
+/* Return whether a wheel is stalled */
+bool MotorCur_IsStalled(MOTOR_CUR_WHEEL_T wheel)
+{
+   return wheels[wheel].stalled;
+}
+
+/* Return whether a wheel tripped */
+bool MotorCur_IsTripped(MOTOR_CUR_WHEEL_T wheel)
+{
+   return wheels[wheel].tripped;
+}
+
+/* Re-arm the trip of a wheel */
+void MotorCur_ClearTrip(MOTOR_CUR_WHEEL_T wheel)
+{
+   uint32_t i;
+
+   wheels[wheel].tripped = false;
+   for (i = 0; i < MOTOR_CUR_WHEELS; i++) {
+       if (wheels[i].tripped) {
+           return;
+       }
+   }
+   Motor_ClearTrip();
+}
+
+/* Return the acquisition of a wheel */
+ADC_DMA_T *MotorCur_GetAdc(MOTOR_CUR_WHEEL_T wheel)
+{
+   return &wheels[wheel].adc;
+}
+
+/* Return the statistics of a wheel */
+const MOTOR_CUR_STATS_T *MotorCur_GetStats(MOTOR_CUR_WHEEL_T wheel)
+{
+   return &wheels[wheel].stats;
+}
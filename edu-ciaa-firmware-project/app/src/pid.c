@@ -0,0 +1,243 @@
+/*
+ * @brief PID controller with feed-forward, float and Q15 versions
+ */
+
+#include "pid.h"
+#include "cr_section_macros.h"
+
+#if defined(CORE_M4)
+#include "chip.h"
+#endif
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+#define PID_PI                  3.14159265f
+
+#if defined(CORE_M4)
+
+/* Dual 16-bit multiply-accumulate: lo(x) * lo(y) + hi(x) * hi(y) + acc */
+#define PID_SMLAD(x, y, acc)    ((int32_t) __SMLAD((x), (y), (uint32_t) (acc)))
+
+/* Saturating 32-bit add */
+#define PID_QADD(a, b)          ((int32_t) __QADD((uint32_t) (a), (uint32_t) (b)))
+
+/* Saturate to int16_t */
+#define PID_SSAT16(v)           ((int16_t) __SSAT((v), 16))
+
+#else
+
+STATIC INLINE int32_t PID_SMLAD(uint32_t x, uint32_t y, int32_t acc)
+{
+   return (int32_t) ((uint32_t) acc +
+                     (uint32_t) ((int32_t) (int16_t) x * (int16_t) y) +
+                     (uint32_t) ((int32_t) (int16_t) (x >> 16) * (int16_t) (y >> 16)));
+}
+
+STATIC INLINE int32_t PID_QADD(int32_t a, int32_t b)
+{
+   int64_t sum = (int64_t) a + b;
+
+   return (sum > INT32_MAX) ? INT32_MAX : (sum < INT32_MIN) ? INT32_MIN : (int32_t) sum;
+}
+
+STATIC INLINE int16_t PID_SSAT16(int32_t v)
+{
+   return (v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : (int16_t) v;
+}
+
+#endif
+
+/* Two int16_t values in one word, a in the low half */
+#define PID_PACK(a, b)          (((uint32_t) (uint16_t) (a)) | ((uint32_t) (uint16_t) (b) << 16))
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Derivative filter coefficient for a cut-off frequency */
+static float Pid_FilterAlpha(const PID_CFG_T *pCfg)
+{
+   float w;
+
+   if (pCfg->dFilterHz <= 0.0f) {
+       return 1.0f;
+   }
+
+   w = 2.0f * PID_PI * pCfg->dFilterHz / pCfg->rateHz;
+   return w / (1.0f + w);
+}
+
+/* Absolute value of a float */
+STATIC INLINE float Pid_Abs(float v)
+{
+   return (v < 0.0f) ? -v : v;
+}
+
+/* Round a scaled gain to Q15 */
+static int16_t Pid_ToQ15(float gain, float scale)
+{
+   float v = gain * scale;
+
+   v += (v < 0.0f) ? -0.5f : 0.5f;
+   return PID_SSAT16((int32_t) v);
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Set up a float PID from its configuration */
+Status Pid_F32_Init(PID_F32_T *pPid, const PID_CFG_T *pCfg)
+{
+   if (pCfg->rateHz <= 0.0f || pCfg->outMin >= pCfg->outMax) {
+       return ERROR;
+   }
+
+   pPid->kp = pCfg->kp;
+   pPid->ki = pCfg->ki / pCfg->rateHz;
+   pPid->kd = pCfg->kd * pCfg->rateHz;
+   pPid->kff = pCfg->kff;
+   pPid->alpha = Pid_FilterAlpha(pCfg);
+   pPid->outMin = pCfg->outMin;
+   pPid->outMax = pCfg->outMax;
+   Pid_F32_Reset(pPid);
+
+   return SUCCESS;
+}
+
+/* Clear the integrator and the derivative history */
+void Pid_F32_Reset(PID_F32_T *pPid)
+{
+   pPid->integ = 0.0f;
+   pPid->dFilt = 0.0f;
+   pPid->prevMeas = 0.0f;
+   pPid->primed = false;
+}
+
+/* Run one update */
+__HOT_FUNC float Pid_F32_Update(PID_F32_T *pPid, float setpoint, float measured)
+{
+   float e = setpoint - measured;
+   float d = pPid->primed ? (pPid->prevMeas - measured) * pPid->kd : 0.0f;
+   float integ, out;
+
+   pPid->prevMeas = measured;
+   pPid->primed = true;
+   pPid->dFilt += pPid->alpha * (d - pPid->dFilt);
+
+   integ = pPid->integ + pPid->ki * e;
+   integ = (integ > pPid->outMax) ? pPid->outMax : (integ < pPid->outMin) ? pPid->outMin : integ;
+
+   out = pPid->kp * e + integ + pPid->dFilt + pPid->kff * setpoint;
+
+   /* Keep the old integral while the output is pinned in the error's direction */
+   if (out > pPid->outMax) {
+       out = pPid->outMax;
+       if (e > 0.0f) {
+           integ = pPid->integ;
+       }
+   }
+   else if (out < pPid->outMin) {
+       out = pPid->outMin;
+       if (e < 0.0f) {
+           integ = pPid->integ;
+       }
+   }
+   pPid->integ = integ;
+
+   return out;
+}
+
+/* Set up a Q15 PID from its configuration */
+Status Pid_Q15_Init(PID_Q15_T *pPid, const PID_CFG_T *pCfg)
+{
+   float ki, kd, maxGain, scale;
+   uint8_t shift = 0;
+
+   if (pCfg->rateHz <= 0.0f || pCfg->outMin >= pCfg->outMax ||
+       pCfg->outMin < INT16_MIN || pCfg->outMax > INT16_MAX) {
+       return ERROR;
+   }
+
+   ki = pCfg->ki / pCfg->rateHz;
+   kd = pCfg->kd * pCfg->rateHz;
+   maxGain = MAX(MAX(Pid_Abs(pCfg->kp), Pid_Abs(ki)), MAX(Pid_Abs(kd), Pid_Abs(pCfg->kff)));
+   if (maxGain > PID_Q15_MAX_GAIN) {
+       return ERROR;
+   }
+
+   /* Smallest power of two that brings every gain below 1.0 in Q15 */
+   while ((float) (1 << shift) <= maxGain) {
+       shift++;
+   }
+   scale = 32768.0f / (float) (1 << shift);
+
+   pPid->gainsPF = PID_PACK(Pid_ToQ15(pCfg->kp, scale), Pid_ToQ15(pCfg->kff, scale));
+   pPid->ki = Pid_ToQ15(ki, scale);
+   pPid->kd = Pid_ToQ15(kd, scale);
+   pPid->alpha = Pid_ToQ15(Pid_FilterAlpha(pCfg), 32768.0f);
+   pPid->shift = shift;
+   pPid->outMin = (int16_t) pCfg->outMin;
+   pPid->outMax = (int16_t) pCfg->outMax;
+   pPid->integMin = (int32_t) pPid->outMin << (15 - shift);
+   pPid->integMax = (int32_t) pPid->outMax << (15 - shift);
+   Pid_Q15_Reset(pPid);
+
+   return SUCCESS;
+}
+
+/* Clear the integrator and the derivative history */
+void Pid_Q15_Reset(PID_Q15_T *pPid)
+{
+   pPid->integ = 0;
+   pPid->dFilt = 0;
+   pPid->prevMeas = 0;
+   pPid->primed = false;
+}
+
+/* Run one update */
+__HOT_FUNC int16_t Pid_Q15_Update(PID_Q15_T *pPid, int16_t setpoint, int16_t measured)
+{
+   int16_t e = PID_SSAT16((int32_t) setpoint - measured);
+   int32_t d = 0, integ, acc, out;
+   uint8_t rsh = 15 - pPid->shift;
+
+   if (pPid->primed) {
+       d = (int32_t) pPid->kd * PID_SSAT16((int32_t) pPid->prevMeas - measured);
+   }
+   pPid->prevMeas = measured;
+   pPid->primed = true;
+   pPid->dFilt += (int32_t) (((int64_t) pPid->alpha * (d - pPid->dFilt)) >> 15);
+
+   integ = PID_QADD(pPid->integ, (int32_t) pPid->ki * e);
+   integ = (integ > pPid->integMax) ? pPid->integMax : (integ < pPid->integMin) ? pPid->integMin : integ;
+
+   /* kp * e + kff * setpoint in one instruction, each product is below 2^30 */
+   acc = PID_SMLAD(pPid->gainsPF, PID_PACK(e, setpoint), 0);
+   acc = PID_QADD(acc, integ);
+   acc = PID_QADD(acc, pPid->dFilt);
+   out = (acc >> rsh) + ((acc >> (rsh - 1)) & 1);
+
+   /* Keep the old integral while the output is pinned in the error's direction */
+   if (out > pPid->outMax) {
+       out = pPid->outMax;
+       if (e > 0) {
+           integ = pPid->integ;
+       }
+   }
+   else if (out < pPid->outMin) {
+       out = pPid->outMin;
+       if (e < 0) {
+           integ = pPid->integ;
+       }
+   }
+   pPid->integ = integ;
+
+   return (int16_t) out;
+}
@@ -0,0 +1,171 @@
+/*
+ * @brief Cycle counter profiling probes
+ */
+
+#include <string.h>
+#include "prof.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+static const char *const probeNames[PROF_COUNT] = {
+#define PROF_NAME(id, name) name,
+   PROF_PROBES(PROF_NAME)
+#undef PROF_NAME
+};
+
+#if PROF_ENABLE
+static PROF_STATS_T probes[PROF_COUNT];
+static uint32_t overhead;
+#endif
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+#if PROF_ENABLE
+
+/* Append an unsigned decimal number */
+static int Prof_FormatU32(char *out, uint32_t v)
+{
+   char tmp[10];
+   int n = 0, len = 0;
+
+   do {
+       tmp[n++] = (char) ('0' + (v % 10));
+       v /= 10;
+   } while (v != 0);
+   while (n > 0) {
+       out[len++] = tmp[--n];
+   }
+
+   return len;
+}
+
+#endif
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Start the cycle counter, measure the probe overhead and clear all probes */
+void Prof_Init(void)
+{
+#if PROF_ENABLE
+   uint32_t start;
+
+   Cycles_Init();
+   start = Cycles_Now();
+   overhead = Cycles_Now() - start;
+   Prof_Reset();
+#endif
+}
+
+/* Clear all probes */
+void Prof_Reset(void)
+{
+#if PROF_ENABLE
+   uint8_t i;
+
+   memset(probes, 0, sizeof(probes));
+   for (i = 0; i < PROF_COUNT; i++) {
+       probes[i].min = UINT32_MAX;
+   }
+#endif
+}
+
+/* Add one duration to a probe */
+__HOT_FUNC void Prof_Record(PROF_ID_T id, uint32_t cycles)
+{
+#if PROF_ENABLE
+   PROF_STATS_T *p = &probes[id];
+   uint32_t bin;
+
+   cycles = (cycles > overhead) ? cycles - overhead : 0;
+   bin = (cycles == 0) ? 0 : 32 - __builtin_clz(cycles);
+
+   p->count++;
+   p->sum += cycles;
+   if (cycles < p->min) {
+       p->min = cycles;
+   }
+   if (cycles > p->max) {
+       p->max = cycles;
+   }
+   p->hist[MIN(bin, PROF_HIST_BINS - 1)]++;
+#endif
+}
+
+/* Return the statistics of a probe */
+const PROF_STATS_T *Prof_Get(PROF_ID_T id)
+{
+#if PROF_ENABLE
+   return &probes[id];
+#else
+   return NULL;
+#endif
+}
+
+/* Return the name of a probe */
+const char *Prof_GetName(PROF_ID_T id)
+{
+   return probeNames[id];
+}
+
+/* Format the statistics of a probe as one text line */
+int Prof_FormatLine(PROF_ID_T id, char *buf)
+{
+#if PROF_ENABLE
+   PROF_STATS_T s;
+   uint32_t primask = __get_PRIMASK();
+   int len, first = -1, last = -1, i;
+
+   /* Copy first, the probe may be recorded from an interrupt */
+   __disable_irq();
+   s = probes[id];
+   __set_PRIMASK(primask);
+
+   for (i = 0; i < PROF_HIST_BINS; i++) {
+       if (s.hist[i] != 0) {
+           first = (first < 0) ? i : first;
+           last = i;
+       }
+   }
+
+   len = strlen(probeNames[id]);
+   memcpy(buf, "PF:", 3);
+   memcpy(&buf[3], probeNames[id], len);
+   len += 3;
+   buf[len++] = ',';
+   len += Prof_FormatU32(&buf[len], s.count);
+   buf[len++] = ',';
+   len += Prof_FormatU32(&buf[len], (s.count != 0) ? s.min : 0);
+   buf[len++] = ',';
+   len += Prof_FormatU32(&buf[len], (s.count != 0) ? (uint32_t) (s.sum / s.count) : 0);
+   buf[len++] = ',';
+   len += Prof_FormatU32(&buf[len], s.max);
+   buf[len++] = ',';
+   len += Prof_FormatU32(&buf[len], (first < 0) ? 0 : (uint32_t) first);
+   buf[len++] = ':';
+
+   /* Stop early rather than overflow, each bin takes up to 11 characters */
+   for (i = first; i >= 0 && i <= last && len <= PROF_LINE_MAX - 13; i++) {
+       if (i != first) {
+           buf[len++] = ',';
+       }
+       len += Prof_FormatU32(&buf[len], s.hist[i]);
+   }
+   buf[len++] = '\r';
+   buf[len++] = '\n';
+
+   return len;
+#else
+   return 0;
+#endif
+}
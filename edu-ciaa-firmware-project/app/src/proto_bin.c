@@ -0,0 +1,166 @@
+/*
+ * @brief Binary framing for the ESP32 link (COBS + CRC-16)
+ */
+
+#include "proto_bin.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Smallest raw frame: seq, type and CRC */
+#define PROTO_BIN_MIN_RAW   4
+
+/* CRC-16/CCITT-FALSE (poly 0x1021) nibble table */
+static const uint16_t crcNibble[16] = {
+   0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+   0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Store one decoded byte, flag the frame when it does not fit */
+static void ProtoBin_RxPut(PROTO_BIN_RX_T *pRx, uint8_t b)
+{
+   if (pRx->len >= PROTO_BIN_MAX_RAW) {
+       pRx->discard = true;
+       return;
+   }
+   pRx->buf[pRx->len++] = b;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Compute CRC-16/CCITT-FALSE */
+uint16_t ProtoBin_CRC16(uint16_t crc, const void *data, int len)
+{
+   const uint8_t *p = (const uint8_t *) data;
+
+   while (len-- > 0) {
+       crc ^= (uint16_t) (*p++ << 8);
+       crc = (uint16_t) ((crc << 4) ^ crcNibble[crc >> 12]);
+       crc = (uint16_t) ((crc << 4) ^ crcNibble[crc >> 12]);
+   }
+
+   return crc;
+}
+
+/* Build and COBS encode a frame */
+int ProtoBin_Encode(uint8_t seq, uint8_t type, const void *payload, int len,
+                   uint8_t *out, int outSize)
+{
+   uint8_t raw[PROTO_BIN_MAX_RAW];
+   const uint8_t *src = (const uint8_t *) payload;
+   int i, rawLen, o, codeIdx;
+   uint8_t code;
+   uint16_t crc;
+
+   if (len < 0 || len > PROTO_BIN_MAX_PAYLOAD || outSize < len + PROTO_BIN_MIN_RAW + 2) {
+       return 0;
+   }
+
+   raw[0] = seq;
+   raw[1] = type;
+   for (i = 0; i < len; i++) {
+       raw[2 + i] = src[i];
+   }
+   rawLen = 2 + len;
+   crc = ProtoBin_CRC16(0xFFFF, raw, rawLen);
+   raw[rawLen++] = (uint8_t) crc;
+   raw[rawLen++] = (uint8_t) (crc >> 8);
+
+   /* COBS: each block starts with the distance to the next zero */
+   codeIdx = 0;
+   o = 1;
+   code = 1;
+   for (i = 0; i < rawLen; i++) {
+       if (raw[i] == 0) {
+           out[codeIdx] = code;
+           codeIdx = o++;
+           code = 1;
+       }
+       else {
+           out[o++] = raw[i];
+           if (++code == 0xFF) {
+               out[codeIdx] = code;
+               codeIdx = o++;
+               code = 1;
+           }
+       }
+   }
+   out[codeIdx] = code;
+   out[o++] = 0;
+
+   return o;
+}
+
+/* Reset a streaming decoder */
+void ProtoBin_RxInit(PROTO_BIN_RX_T *pRx)
+{
+   pRx->len = 0;
+   pRx->code = 0;
+   pRx->zeroPending = false;
+   pRx->discard = false;
+}
+
+/* Feed one received byte to the decoder */
+PROTO_BIN_RES_T ProtoBin_DecodeByte(PROTO_BIN_RX_T *pRx, uint8_t ch, PROTO_BIN_FRAME_T *pFrame)
+{
+   PROTO_BIN_RES_T res;
+   uint16_t crc;
+
+   if (ch != 0) {
+       if (pRx->discard) {
+           return PROTO_BIN_NONE;
+       }
+
+       if (pRx->code == 0) {
+           /* Block header, the previous block ended in a zero unless it was full */
+           if (pRx->zeroPending) {
+               ProtoBin_RxPut(pRx, 0);
+           }
+           pRx->code = ch - 1;
+           pRx->zeroPending = (ch != 0xFF);
+       }
+       else {
+           ProtoBin_RxPut(pRx, ch);
+           pRx->code--;
+       }
+       return PROTO_BIN_NONE;
+   }
+
+   /* Delimiter: idle line or back-to-back delimiters are not errors */
+   if (!pRx->discard && pRx->len == 0 && pRx->code == 0 && !pRx->zeroPending) {
+       return PROTO_BIN_NONE;
+   }
+
+   if (pRx->discard || pRx->code != 0 || pRx->len < PROTO_BIN_MIN_RAW) {
+       res = PROTO_BIN_ERR_FRAME;
+   }
+   else {
+       pFrame->seq = pRx->buf[0];
+       pFrame->type = pRx->buf[1];
+       pFrame->len = pRx->len - PROTO_BIN_MIN_RAW;
+       pFrame->payload = &pRx->buf[2];
+
+       crc = ProtoBin_CRC16(0xFFFF, pRx->buf, pRx->len - 2);
+       if (pRx->buf[pRx->len - 2] == (uint8_t) crc &&
+           pRx->buf[pRx->len - 1] == (uint8_t) (crc >> 8)) {
+           res = PROTO_BIN_FRAME;
+       }
+       else {
+           res = PROTO_BIN_ERR_CRC;
+       }
+   }
+
+   ProtoBin_RxInit(pRx);
+   return res;
+}
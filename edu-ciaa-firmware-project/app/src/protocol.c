@@ -0,0 +1,329 @@
+/*
+ * @brief ESP32 command protocol parser (S<CMD>:<PARAMS>E framing)
+ */
+
+#include "protocol.h"
+#include "cycles.h"
+#include "evtrace.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Parser states */
+enum {
+   PS_WAIT_START = 0,      /* Waiting for 'S', everything else is ignored */
+   PS_CMD0,                /* First command letter */
+   PS_CMD1,                /* Second command letter */
+   PS_SEP,                 /* ':' before parameters or 'E' */
+   PS_PARAM_FIRST,         /* First character of a parameter */
+   PS_PARAM_SIGN,          /* Digit required after '-' */
+   PS_PARAM_DIGITS,        /* Digits, ',' or 'E' */
+   PS_SKIP,                /* Bad parameters, wait for 'E' to report them */
+};
+
+/* Largest number of digits accepted in a parameter */
+#define PROTO_MAX_DIGITS   5
+
+/* Command syntax table, indexed by PROTO_CMD_ID_T */
+typedef struct {
+   char code[2];
+   uint8_t nparams;
+   int16_t min;
+   int16_t max;
+} PROTO_CMD_DEF_T;
+
+static const PROTO_CMD_DEF_T cmdDefs[PROTO_CMD_COUNT] = {
+   [PROTO_CMD_MV] = {{'M', 'V'}, 2, -255, 255},
+   [PROTO_CMD_ST] = {{'S', 'T'}, 0, 0, 0},
+   [PROTO_CMD_GT] = {{'G', 'T'}, 0, 0, 0},
+   [PROTO_CMD_PF] = {{'P', 'F'}, 0, 0, 0},
+   [PROTO_CMD_IQ] = {{'I', 'Q'}, 0, 0, 0},
+   [PROTO_CMD_TR] = {{'T', 'R'}, 0, 0, 0},
+   [PROTO_CMD_TA] = {{'T', 'A'}, 0, 0, 0},
+   [PROTO_CMD_BT] = {{'B', 'T'}, 0, 0, 0},
+};
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Begin decoding a new frame */
+static void Proto_StartFrame(PROTO_PARSER_T *pParser)
+{
+   pParser->state = PS_CMD0;
+   pParser->len = 1;
+   pParser->cmdIdx = PROTO_CMD_COUNT;
+   pParser->badParams = false;
+   pParser->cmd.nparams = 0;
+}
+
+/* Discard a corrupted frame, a start character begins the next one */
+static void Proto_DropFrame(PROTO_PARSER_T *pParser, uint8_t ch)
+{
+   pParser->stats.dropped++;
+   if (ch == PROTO_CHAR_START) {
+       Proto_StartFrame(pParser);
+   }
+   else {
+       pParser->state = PS_WAIT_START;
+   }
+}
+
+/* Match the two command letters against the syntax table */
+static uint8_t Proto_LookupCmd(char c0, char c1)
+{
+   uint8_t idx;
+
+   for (idx = 0; idx < PROTO_CMD_COUNT; idx++) {
+       if (cmdDefs[idx].code[0] == c0 && cmdDefs[idx].code[1] == c1) {
+           return idx;
+       }
+   }
+
+   return PROTO_CMD_COUNT;
+}
+
+/* Store the accumulated parameter */
+static void Proto_PushParam(PROTO_PARSER_T *pParser)
+{
+   if (pParser->cmd.nparams >= PROTO_MAX_PARAMS || pParser->acc > 32767) {
+       pParser->badParams = true;
+       return;
+   }
+
+   pParser->cmd.params[pParser->cmd.nparams++] =
+       (int16_t) (pParser->neg ? -pParser->acc : pParser->acc);
+}
+
+/* Validate a complete frame and run its handler */
+static PROTO_STATUS_T Proto_EndFrame(PROTO_PARSER_T *pParser)
+{
+   pParser->state = PS_WAIT_START;
+
+   /* Unknown commands are reported as such by Proto_Dispatch() */
+   if (pParser->badParams && pParser->cmdIdx < PROTO_CMD_COUNT) {
+       pParser->stats.paramErrors++;
+       return PROTO_STATUS_ERR_PARAMS;
+   }
+
+   pParser->cmd.id = (PROTO_CMD_ID_T) pParser->cmdIdx;
+   return Proto_Dispatch(pParser, &pParser->cmd);
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Initialize a parser */
+void Proto_Init(PROTO_PARSER_T *pParser, const PROTO_HANDLER_T *handlers, void *ctx)
+{
+   PROTO_STATS_T zero = {0};
+
+   pParser->handlers = handlers;
+   pParser->ctx = ctx;
+   pParser->stats = zero;
+   Proto_Reset(pParser);
+
+   Cycles_Init();
+}
+
+/* Reset the parser to wait for a new frame */
+void Proto_Reset(PROTO_PARSER_T *pParser)
+{
+   pParser->state = PS_WAIT_START;
+   pParser->len = 0;
+}
+
+/* Feed a single byte to the parser */
+PROTO_STATUS_T Proto_ParseByte(PROTO_PARSER_T *pParser, uint8_t ch)
+{
+   if (pParser->state == PS_WAIT_START) {
+       if (ch == PROTO_CHAR_START) {
+           Proto_StartFrame(pParser);
+       }
+       return PROTO_STATUS_NONE;
+   }
+
+   /* A frame that never terminates is treated as corrupted */
+   if (++pParser->len > PROTO_MAX_FRAME_LEN) {
+       Proto_DropFrame(pParser, ch);
+       return PROTO_STATUS_NONE;
+   }
+
+   switch (pParser->state) {
+   case PS_CMD0:
+       if (ch >= 'A' && ch <= 'Z') {
+           pParser->code0 = (char) ch;
+           pParser->state = PS_CMD1;
+       }
+       else {
+           Proto_DropFrame(pParser, ch);
+       }
+       break;
+
+   case PS_CMD1:
+       if (ch >= 'A' && ch <= 'Z') {
+           pParser->cmdIdx = Proto_LookupCmd(pParser->code0, (char) ch);
+           pParser->state = PS_SEP;
+       }
+       else {
+           Proto_DropFrame(pParser, ch);
+       }
+       break;
+
+   case PS_SEP:
+       if (ch == PROTO_CHAR_SEP) {
+           pParser->state = PS_PARAM_FIRST;
+       }
+       else if (ch == PROTO_CHAR_END) {
+           return Proto_EndFrame(pParser);
+       }
+       else {
+           Proto_DropFrame(pParser, ch);
+       }
+       break;
+
+   case PS_PARAM_FIRST:
+   case PS_PARAM_SIGN:
+       if (ch >= '0' && ch <= '9') {
+           if (pParser->state == PS_PARAM_FIRST) {
+               pParser->neg = false;
+           }
+           pParser->acc = ch - '0';
+           pParser->ndigits = 1;
+           pParser->state = PS_PARAM_DIGITS;
+       }
+       else if (ch == '-' && pParser->state == PS_PARAM_FIRST) {
+           pParser->neg = true;
+           pParser->state = PS_PARAM_SIGN;
+       }
+       else if (ch == PROTO_CHAR_END) {
+           /* Empty or sign-only parameter */
+           pParser->badParams = true;
+           return Proto_EndFrame(pParser);
+       }
+       else if (ch == PROTO_CHAR_START) {
+           Proto_DropFrame(pParser, ch);
+       }
+       else {
+           pParser->badParams = true;
+           pParser->state = PS_SKIP;
+       }
+       break;
+
+   case PS_PARAM_DIGITS:
+       if (ch >= '0' && ch <= '9') {
+           if (++pParser->ndigits > PROTO_MAX_DIGITS) {
+               pParser->badParams = true;
+               pParser->state = PS_SKIP;
+           }
+           else {
+               pParser->acc = pParser->acc * 10 + (ch - '0');
+           }
+       }
+       else if (ch == PROTO_CHAR_PARAM_SEP) {
+           Proto_PushParam(pParser);
+           pParser->state = PS_PARAM_FIRST;
+       }
+       else if (ch == PROTO_CHAR_END) {
+           Proto_PushParam(pParser);
+           return Proto_EndFrame(pParser);
+       }
+       else if (ch == PROTO_CHAR_START) {
+           Proto_DropFrame(pParser, ch);
+       }
+       else {
+           pParser->badParams = true;
+           pParser->state = PS_SKIP;
+       }
+       break;
+
+   case PS_SKIP:
+       if (ch == PROTO_CHAR_END) {
+           return Proto_EndFrame(pParser);
+       }
+       if (ch == PROTO_CHAR_START) {
+           Proto_DropFrame(pParser, ch);
+       }
+       break;
+
+   default:
+       Proto_Reset(pParser);
+       break;
+   }
+
+   return PROTO_STATUS_NONE;
+}
+
+/* Validate a decoded command and run its handler */
+PROTO_STATUS_T Proto_Dispatch(PROTO_PARSER_T *pParser, const PROTO_CMD_T *cmd)
+{
+   const PROTO_CMD_DEF_T *def;
+   PROTO_STATUS_T status = PROTO_STATUS_OK;
+   uint32_t start;
+   int i;
+
+   if ((unsigned) cmd->id >= PROTO_CMD_COUNT) {
+       pParser->stats.cmdErrors++;
+       return PROTO_STATUS_ERR_CMD;
+   }
+
+   def = &cmdDefs[cmd->id];
+   if (cmd->nparams != def->nparams) {
+       pParser->stats.paramErrors++;
+       return PROTO_STATUS_ERR_PARAMS;
+   }
+   for (i = 0; i < cmd->nparams; i++) {
+       if (cmd->params[i] < def->min || cmd->params[i] > def->max) {
+           pParser->stats.paramErrors++;
+           return PROTO_STATUS_ERR_PARAMS;
+       }
+   }
+
+   EVTRACE(CMD, cmd->id);
+   start = Cycles_Now();
+   if (pParser->handlers != NULL && pParser->handlers[cmd->id] != NULL) {
+       status = pParser->handlers[cmd->id](cmd, pParser->ctx);
+   }
+   pParser->stats.lastCycles = Cycles_Now() - start;
+   if (pParser->stats.lastCycles > pParser->stats.maxCycles) {
+       pParser->stats.maxCycles = pParser->stats.lastCycles;
+   }
+
+   if (status == PROTO_STATUS_OK) {
+       pParser->stats.frames++;
+   }
+   else if (status == PROTO_STATUS_ERR_CMD) {
+       pParser->stats.cmdErrors++;
+   }
+   else {
+       pParser->stats.paramErrors++;
+   }
+
+   return status;
+}
+
+/* Consume bytes in place from a receive ring buffer */
+PROTO_STATUS_T Proto_ProcessRB(PROTO_PARSER_T *pParser, RINGBUFF_T *pRB)
+{
+   const uint8_t *data = (const uint8_t *) pRB->data;
+   uint32_t mask = (uint32_t) pRB->count - 1;
+   uint32_t head = RB_VHEAD(pRB);
+   uint32_t tail = pRB->tail;
+   PROTO_STATUS_T status = PROTO_STATUS_NONE;
+
+   while (tail != head && status == PROTO_STATUS_NONE) {
+       status = Proto_ParseByte(pParser, data[tail & mask]);
+       tail++;
+   }
+
+   /* Release the consumed bytes to the producer */
+   RB_VTAIL(pRB) = tail;
+
+   return status;
+}
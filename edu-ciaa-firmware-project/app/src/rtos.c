@@ -0,0 +1,606 @@
+/*
+ * @brief Minimal preemptive kernel
+ */
+
+#include <string.h>
+#include "rtos_port.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Longest chain of blocked owners followed by priority inheritance */
+#define RTOS_INHERIT_DEPTH      8
+
+/* Ready threads, one FIFO per priority, and a bit per non-empty FIFO */
+static RTOS_LIST_T readyList[RTOS_PRIOS];
+static uint32_t readyMask;
+
+/* Threads with a timeout, soonest first */
+static RTOS_THREAD_T *delayList;
+
+static volatile uint32_t tickCount;
+static bool started;
+
+static RTOS_THREAD_T idleThread;
+static uint32_t idleStack[RTOS_IDLE_STACK_WORDS] __attribute__((aligned(8)));
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+RTOS_THREAD_T *volatile rtosCurrent;
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Insert a thread before @a before, or at the tail when NULL */
+static void Rtos_ListInsert(RTOS_LIST_T *pList, RTOS_THREAD_T *t, RTOS_THREAD_T *before)
+{
+   RTOS_THREAD_T *at;
+
+   if (pList->head == NULL) {
+       t->next = t;
+       t->prev = t;
+       pList->head = t;
+   }
+   else {
+       at = (before != NULL) ? before : pList->head;
+       t->next = at;
+       t->prev = at->prev;
+       at->prev->next = t;
+       at->prev = t;
+       if (before == pList->head) {
+           pList->head = t;
+       }
+   }
+   t->list = pList;
+}
+
+/* Insert a thread behind those of the same or higher priority */
+static void Rtos_ListInsertPrio(RTOS_LIST_T *pList, RTOS_THREAD_T *t)
+{
+   RTOS_THREAD_T *n = pList->head;
+
+   if (n != NULL) {
+       do {
+           if (n->prio > t->prio) {
+               Rtos_ListInsert(pList, t, n);
+               return;
+           }
+           n = n->next;
+       } while (n != pList->head);
+   }
+   Rtos_ListInsert(pList, t, NULL);
+}
+
+/* Take a thread off its list */
+static void Rtos_ListRemove(RTOS_THREAD_T *t)
+{
+   RTOS_LIST_T *pList = t->list;
+
+   if (t->next == t) {
+       pList->head = NULL;
+   }
+   else {
+       t->prev->next = t->next;
+       t->next->prev = t->prev;
+       if (pList->head == t) {
+           pList->head = t->next;
+       }
+   }
+   t->list = NULL;
+}
+
+/* Make a thread ready, first of its priority after an inheritance boost */
+static void Rtos_ReadyAdd(RTOS_THREAD_T *t, bool first)
+{
+   RTOS_LIST_T *pList = &readyList[t->prio];
+
+   Rtos_ListInsert(pList, t, first ? pList->head : NULL);
+   readyMask |= 1UL << t->prio;
+}
+
+static void Rtos_ReadyRemove(RTOS_THREAD_T *t)
+{
+   Rtos_ListRemove(t);
+   if (readyList[t->prio].head == NULL) {
+       readyMask &= ~(1UL << t->prio);
+   }
+}
+
+/* Add a timeout, the list stays sorted across tick wrap */
+static void Rtos_DelayAdd(RTOS_THREAD_T *t, uint32_t ticks)
+{
+   RTOS_THREAD_T **pp = &delayList;
+
+   t->wake = tickCount + ticks;
+   while (*pp != NULL && (int32_t) ((*pp)->wake - t->wake) <= 0) {
+       pp = &(*pp)->delayNext;
+   }
+   t->delayNext = *pp;
+   *pp = t;
+   t->delayed = true;
+}
+
+static void Rtos_DelayRemove(RTOS_THREAD_T *t)
+{
+   RTOS_THREAD_T **pp = &delayList;
+
+   while (*pp != t) {
+       pp = &(*pp)->delayNext;
+   }
+   *pp = t->delayNext;
+   t->delayed = false;
+}
+
+/* Ask for a switch when the running thread is no longer the one to run */
+static void Rtos_Reschedule(void)
+{
+   if (started && (rtosCurrent->state != RTOS_STATE_READY ||
+                   (uint32_t) __builtin_ctz(readyMask) < rtosCurrent->prio)) {
+       Rtos_PortPendSwitch();
+   }
+}
+
+/* Block the running thread on a wait list, a timeout, or both */
+static void Rtos_Block(RTOS_LIST_T *pList, uint32_t timeout)
+{
+   RTOS_THREAD_T *self = rtosCurrent;
+
+   Rtos_ReadyRemove(self);
+   self->state = RTOS_STATE_BLOCKED;
+   self->result = RTOS_TIMEOUT;
+   if (pList != NULL) {
+       Rtos_ListInsertPrio(pList, self);
+   }
+   if (timeout != RTOS_FOREVER) {
+       Rtos_DelayAdd(self, timeout);
+   }
+   Rtos_PortPendSwitch();
+}
+
+/* End a wait, the switch is left to the caller */
+static void Rtos_Wake(RTOS_THREAD_T *t, RTOS_STATUS_T result)
+{
+   if (t->list != NULL) {
+       Rtos_ListRemove(t);
+   }
+   if (t->delayed) {
+       Rtos_DelayRemove(t);
+   }
+   t->result = (uint8_t) result;
+   t->state = RTOS_STATE_READY;
+   Rtos_ReadyAdd(t, false);
+}
+
+/* Move a thread to another priority, keeping its lists ordered */
+static void Rtos_SetPrio(RTOS_THREAD_T *t, uint8_t prio)
+{
+   RTOS_LIST_T *pList;
+   bool raise = (prio < t->prio);
+
+   if (t->state == RTOS_STATE_READY) {
+       Rtos_ReadyRemove(t);
+       t->prio = prio;
+       Rtos_ReadyAdd(t, raise);
+   }
+   else if (t->list != NULL) {
+       pList = t->list;
+       Rtos_ListRemove(t);
+       t->prio = prio;
+       Rtos_ListInsertPrio(pList, t);
+   }
+   else {
+       t->prio = prio;
+   }
+}
+
+/* Base priority, raised to the best waiter on any mutex the thread owns */
+static uint8_t Rtos_InheritedPrio(const RTOS_THREAD_T *t)
+{
+   const RTOS_MUTEX_T *m;
+   uint8_t prio = t->basePrio;
+
+   for (m = t->held; m != NULL; m = m->nextHeld) {
+       if (m->waiters.head != NULL && m->waiters.head->prio < prio) {
+           prio = m->waiters.head->prio;
+       }
+   }
+
+   return prio;
+}
+
+/* Recompute a thread's priority, then the owners it is waiting for */
+static void Rtos_UpdatePrio(RTOS_THREAD_T *t)
+{
+   uint32_t depth;
+   uint8_t prio;
+
+   for (depth = 0; t != NULL && depth < RTOS_INHERIT_DEPTH; depth++) {
+       prio = Rtos_InheritedPrio(t);
+       if (prio == t->prio) {
+           break;
+       }
+       Rtos_SetPrio(t, prio);
+       t = (t->blockedOn != NULL) ? t->blockedOn->owner : NULL;
+   }
+}
+
+/* Blocking calls need a thread to block */
+STATIC INLINE bool Rtos_CanBlock(void)
+{
+   return rtosCurrent != NULL && !Rtos_PortInIsr();
+}
+
+/* Append an item and hand it to the first waiting receiver */
+static void Rtos_QueuePut(RTOS_QUEUE_T *pQueue, const void *item)
+{
+   uint32_t idx = (pQueue->head + pQueue->count) % pQueue->len;
+
+   memcpy(&pQueue->data[idx * pQueue->itemSize], item, pQueue->itemSize);
+   pQueue->count++;
+   if (pQueue->recvWaiters.head != NULL) {
+       Rtos_Wake(pQueue->recvWaiters.head, RTOS_OK);
+   }
+}
+
+/* Remove the oldest item and wake the first waiting sender */
+static void Rtos_QueueGet(RTOS_QUEUE_T *pQueue, void *item)
+{
+   memcpy(item, &pQueue->data[pQueue->head * pQueue->itemSize], pQueue->itemSize);
+   pQueue->head = (pQueue->head + 1) % pQueue->len;
+   pQueue->count--;
+   if (pQueue->sendWaiters.head != NULL) {
+       Rtos_Wake(pQueue->sendWaiters.head, RTOS_OK);
+   }
+}
+
+/* Ticks left before a deadline, 0 once it passed */
+static uint32_t Rtos_TicksLeft(uint32_t timeout, uint32_t deadline)
+{
+   int32_t left = (int32_t) (deadline - tickCount);
+
+   if (timeout == RTOS_FOREVER) {
+       return RTOS_FOREVER;
+   }
+
+   return (left > 0) ? (uint32_t) left : 0;
+}
+
+static void Rtos_IdleThread(void *arg)
+{
+   while (1) {
+       Rtos_PortIdle();
+   }
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Pick the thread to run next */
+void Rtos_SwitchContext(void)
+{
+   rtosCurrent = readyList[__builtin_ctz(readyMask)].head;
+}
+
+/* End the running thread */
+void Rtos_ThreadExit(void)
+{
+   uint32_t key = Rtos_PortLock();
+
+   Rtos_ReadyRemove(rtosCurrent);
+   rtosCurrent->state = RTOS_STATE_DEAD;
+   Rtos_PortPendSwitch();
+   Rtos_PortUnlock(key);
+
+   while (1) {}
+}
+
+/* Reset the kernel and create the idle thread */
+void Rtos_Init(void)
+{
+   uint32_t i;
+
+   for (i = 0; i < RTOS_PRIOS; i++) {
+       readyList[i].head = NULL;
+   }
+   readyMask = 0;
+   delayList = NULL;
+   tickCount = 0;
+   started = false;
+   rtosCurrent = NULL;
+
+   Rtos_ThreadCreate(&idleThread, "idle", Rtos_IdleThread, NULL, idleStack,
+                     RTOS_IDLE_STACK_WORDS, RTOS_PRIOS - 1);
+}
+
+/* Create a thread, ready to run */
+void Rtos_ThreadCreate(RTOS_THREAD_T *pThread, const char *name, void (*fn)(void *), void *arg,
+                      uint32_t *stack, uint32_t stackWords, uint8_t prio)
+{
+   uint32_t key, i;
+
+   for (i = 0; i < stackWords; i++) {
+       stack[i] = RTOS_STACK_FILL;
+   }
+
+   memset(pThread, 0, sizeof(*pThread));
+   pThread->name = name;
+   pThread->stack = stack;
+   pThread->stackWords = stackWords;
+   pThread->prio = MIN(prio, RTOS_PRIOS - 1);
+   pThread->basePrio = pThread->prio;
+   pThread->state = RTOS_STATE_READY;
+   Rtos_PortInitThread(pThread, fn, arg);
+
+   key = Rtos_PortLock();
+   Rtos_ReadyAdd(pThread, false);
+   Rtos_Reschedule();
+   Rtos_PortUnlock(key);
+}
+
+/* Start the tick and run the highest priority thread */
+void Rtos_Start(void)
+{
+   started = true;
+   Rtos_SwitchContext();
+   Rtos_PortStart();
+}
+
+/* Return the number of ticks since Rtos_Start() */
+uint32_t Rtos_TickCount(void)
+{
+   return tickCount;
+}
+
+/* Let the other ready threads of the same priority run */
+void Rtos_Yield(void)
+{
+   uint32_t key = Rtos_PortLock();
+   RTOS_THREAD_T *self = rtosCurrent;
+
+   if (self->next != self) {
+       readyList[self->prio].head = self->next;
+       Rtos_PortPendSwitch();
+   }
+   Rtos_PortUnlock(key);
+}
+
+/* Block the running thread for a number of ticks */
+void Rtos_Sleep(uint32_t ticks)
+{
+   uint32_t key;
+
+   if (ticks == 0) {
+       Rtos_Yield();
+       return;
+   }
+
+   key = Rtos_PortLock();
+   Rtos_Block(NULL, ticks);
+   Rtos_PortUnlock(key);
+}
+
+/* Advance the tick: expire timeouts and rotate the running priority */
+void Rtos_Tick(void)
+{
+   uint32_t key = Rtos_PortLock();
+   RTOS_THREAD_T *self = rtosCurrent;
+
+   tickCount++;
+   while (delayList != NULL && (int32_t) (tickCount - delayList->wake) >= 0) {
+       Rtos_Wake(delayList, RTOS_TIMEOUT);
+   }
+
+   /* Time slice: the next thread of the running priority goes first */
+   if (self != NULL && self->state == RTOS_STATE_READY && readyList[self->prio].head == self &&
+       self->next != self) {
+       readyList[self->prio].head = self->next;
+       Rtos_PortPendSwitch();
+   }
+   Rtos_Reschedule();
+   Rtos_PortUnlock(key);
+}
+
+/* Set up a free mutex */
+void Rtos_MutexInit(RTOS_MUTEX_T *pMutex)
+{
+   pMutex->owner = NULL;
+   pMutex->waiters.head = NULL;
+   pMutex->count = 0;
+   pMutex->nextHeld = NULL;
+}
+
+/* Lock a mutex, waiting up to a timeout */
+RTOS_STATUS_T Rtos_MutexLock(RTOS_MUTEX_T *pMutex, uint32_t timeout)
+{
+   RTOS_THREAD_T *self;
+   RTOS_STATUS_T result = RTOS_OK;
+   uint32_t key;
+
+   if (!Rtos_CanBlock()) {
+       return RTOS_ERR_ISR;
+   }
+
+   key = Rtos_PortLock();
+   self = rtosCurrent;
+   if (pMutex->owner == NULL) {
+       pMutex->owner = self;
+       pMutex->count = 1;
+       pMutex->nextHeld = self->held;
+       self->held = pMutex;
+   }
+   else if (pMutex->owner == self) {
+       pMutex->count++;
+   }
+   else if (timeout == RTOS_NO_WAIT) {
+       result = RTOS_TIMEOUT;
+   }
+   else {
+       /* The owner, and whoever it waits for, run at our priority meanwhile */
+       self->blockedOn = pMutex;
+       Rtos_Block(&pMutex->waiters, timeout);
+       Rtos_UpdatePrio(pMutex->owner);
+       Rtos_PortUnlock(key);
+
+       /* Woken by Rtos_MutexUnlock() as the new owner, or by the timeout */
+       key = Rtos_PortLock();
+       result = (RTOS_STATUS_T) self->result;
+       if (result != RTOS_OK) {
+           self->blockedOn = NULL;
+           Rtos_UpdatePrio(pMutex->owner);
+           Rtos_Reschedule();
+       }
+   }
+   Rtos_PortUnlock(key);
+
+   return result;
+}
+
+/* Unlock a mutex, handing it to the highest priority waiter */
+RTOS_STATUS_T Rtos_MutexUnlock(RTOS_MUTEX_T *pMutex)
+{
+   RTOS_THREAD_T *self, *next;
+   RTOS_MUTEX_T **pp;
+   uint32_t key;
+
+   if (!Rtos_CanBlock()) {
+       return RTOS_ERR_ISR;
+   }
+
+   key = Rtos_PortLock();
+   self = rtosCurrent;
+   if (pMutex->owner != self) {
+       Rtos_PortUnlock(key);
+       return RTOS_ERR_OWNER;
+   }
+   if (--pMutex->count != 0) {
+       Rtos_PortUnlock(key);
+       return RTOS_OK;
+   }
+
+   for (pp = &self->held; *pp != pMutex; pp = &(*pp)->nextHeld) {}
+   *pp = pMutex->nextHeld;
+
+   next = pMutex->waiters.head;
+   if (next != NULL) {
+       next->blockedOn = NULL;
+       Rtos_Wake(next, RTOS_OK);
+       pMutex->owner = next;
+       pMutex->count = 1;
+       pMutex->nextHeld = next->held;
+       next->held = pMutex;
+
+       /* The new owner inherits from the waiters left behind it */
+       Rtos_UpdatePrio(next);
+   }
+   else {
+       pMutex->owner = NULL;
+   }
+
+   /* Drop what this mutex lent us */
+   Rtos_UpdatePrio(self);
+   Rtos_Reschedule();
+   Rtos_PortUnlock(key);
+
+   return RTOS_OK;
+}
+
+/* Set up an empty queue */
+void Rtos_QueueInit(RTOS_QUEUE_T *pQueue, void *buffer, uint32_t itemSize, uint32_t len)
+{
+   pQueue->data = buffer;
+   pQueue->itemSize = itemSize;
+   pQueue->len = len;
+   pQueue->head = 0;
+   pQueue->count = 0;
+   pQueue->recvWaiters.head = NULL;
+   pQueue->sendWaiters.head = NULL;
+}
+
+/* Copy an item in, waiting up to a timeout for room */
+RTOS_STATUS_T Rtos_QueueSend(RTOS_QUEUE_T *pQueue, const void *item, uint32_t timeout)
+{
+   uint32_t key, deadline, left;
+
+   if (!Rtos_CanBlock()) {
+       return RTOS_ERR_ISR;
+   }
+
+   key = Rtos_PortLock();
+   deadline = tickCount + timeout;
+   while (pQueue->count == pQueue->len) {
+       left = Rtos_TicksLeft(timeout, deadline);
+       if (left == 0) {
+           Rtos_PortUnlock(key);
+           return RTOS_TIMEOUT;
+       }
+       Rtos_Block(&pQueue->sendWaiters, left);
+       Rtos_PortUnlock(key);
+       key = Rtos_PortLock();
+   }
+   Rtos_QueuePut(pQueue, item);
+   Rtos_Reschedule();
+   Rtos_PortUnlock(key);
+
+   return RTOS_OK;
+}
+
+/* Copy an item out, waiting up to a timeout for one */
+RTOS_STATUS_T Rtos_QueueRecv(RTOS_QUEUE_T *pQueue, void *item, uint32_t timeout)
+{
+   uint32_t key, deadline, left;
+
+   if (!Rtos_CanBlock()) {
+       return RTOS_ERR_ISR;
+   }
+
+   key = Rtos_PortLock();
+   deadline = tickCount + timeout;
+   while (pQueue->count == 0) {
+       left = Rtos_TicksLeft(timeout, deadline);
+       if (left == 0) {
+           Rtos_PortUnlock(key);
+           return RTOS_TIMEOUT;
+       }
+       Rtos_Block(&pQueue->recvWaiters, left);
+       Rtos_PortUnlock(key);
+       key = Rtos_PortLock();
+   }
+   Rtos_QueueGet(pQueue, item);
+   Rtos_Reschedule();
+   Rtos_PortUnlock(key);
+
+   return RTOS_OK;
+}
+
+/* Copy an item in from an interrupt handler */
+bool Rtos_QueueSendFromIsr(RTOS_QUEUE_T *pQueue, const void *item)
+{
+   uint32_t key = Rtos_PortLock();
+   bool queued = false;
+
+   if (pQueue->count < pQueue->len) {
+       Rtos_QueuePut(pQueue, item);
+       Rtos_Reschedule();
+       queued = true;
+   }
+   Rtos_PortUnlock(key);
+
+   return queued;
+}
+
+/* Return the number of stack words a thread never used */
+uint32_t Rtos_StackFree(const RTOS_THREAD_T *pThread)
+{
+   uint32_t n = 0;
+
+   while (n < pThread->stackWords && pThread->stack[n] == RTOS_STACK_FILL) {
+       n++;
+   }
+
+   return n;
+}
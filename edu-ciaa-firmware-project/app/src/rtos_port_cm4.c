@@ -0,0 +1,201 @@
+/*
+ * @brief Minimal preemptive kernel, Cortex-M4 port
+ */
+
+#include "chip.h"
+#include "rtos_port.h"
+
+#if defined(CORE_M4) && RTOS_ENABLE
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* BASEPRI masking kernel interrupts, RTOS_SYSCALL_PRIO and below */
+#define RTOS_BASEPRI            (RTOS_SYSCALL_PRIO << (8 - __NVIC_PRIO_BITS))
+
+/* EXC_RETURN of a new thread: thread mode, process stack, no FPU frame */
+#define RTOS_EXC_RETURN_THREAD  0xFFFFFFFDUL
+
+/* Initial xPSR, Thumb state */
+#define RTOS_INITIAL_XPSR       0x01000000UL
+
+/* Words saved by hardware on exception entry, without the FPU part */
+#define RTOS_HW_FRAME_WORDS     8
+
+/* Words saved by PendSV: r4-r11 and EXC_RETURN */
+#define RTOS_SW_FRAME_WORDS     9
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Enter a kernel critical section */
+uint32_t Rtos_PortLock(void)
+{
+   uint32_t key = __get_BASEPRI();
+
+   if (key == 0 || key > RTOS_BASEPRI) {
+       __set_BASEPRI(RTOS_BASEPRI);
+       __DSB();
+       __ISB();
+   }
+
+   return key;
+}
+
+/* Leave a kernel critical section, a pending PendSV runs here */
+void Rtos_PortUnlock(uint32_t key)
+{
+   __set_BASEPRI(key);
+}
+
+/* Request a context switch */
+void Rtos_PortPendSwitch(void)
+{
+   SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/* Return whether the caller is an interrupt handler */
+bool Rtos_PortInIsr(void)
+{
+   return __get_IPSR() != 0;
+}
+
+/* Build the frame the first PendSV or SVC pops into the thread */
+void Rtos_PortInitThread(RTOS_THREAD_T *pThread, void (*fn)(void *), void *arg)
+{
+   uint32_t *sp = &pThread->stack[pThread->stackWords];
+
+   /* The hardware frame must be 8-byte aligned */
+   sp = (uint32_t *) ((uint32_t) sp & ~7UL);
+   sp -= RTOS_HW_FRAME_WORDS;
+   sp[7] = RTOS_INITIAL_XPSR;
+   sp[6] = (uint32_t) fn & ~1UL;            /* PC */
+   sp[5] = (uint32_t) Rtos_ThreadExit;      /* LR, reached when fn returns */
+   sp[4] = 0;                               /* R12 */
+   sp[3] = 0;                               /* R3 */
+   sp[2] = 0;                               /* R2 */
+   sp[1] = 0;                               /* R1 */
+   sp[0] = (uint32_t) arg;                  /* R0 */
+
+   sp -= RTOS_SW_FRAME_WORDS;
+   sp[8] = RTOS_EXC_RETURN_THREAD;          /* LR in PendSV */
+   /* R4-R11 left at zero below */
+   sp[0] = sp[1] = sp[2] = sp[3] = sp[4] = sp[5] = sp[6] = sp[7] = 0;
+
+   pThread->sp = sp;
+}
+
+/* Start the tick and switch to rtosCurrent through SVC */
+void Rtos_PortStart(void)
+{
+   NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+   SysTick_Config(SystemCoreClock / RTOS_TICK_HZ);
+
+#if (__FPU_USED == 1)
+   /* Automatic and lazy FPU state preservation, the reset default, made explicit */
+   FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+#endif
+
+   /* main() never returns: reload MSP from the vector table (VTOR at
+      0xE000ED08) to give the whole main stack to the handlers, clear
+      CONTROL.FPCA so no FPU frame is stacked for it, and start the first thread */
+   __asm volatile (
+       "   ldr     r0, =0xE000ED08         \n"
+       "   ldr     r0, [r0]                \n"
+       "   ldr     r0, [r0]                \n"
+       "   msr     msp, r0                 \n"
+       "   mov     r0, #0                  \n"
+       "   msr     control, r0             \n"
+       "   msr     basepri, r0             \n"
+       "   cpsie   i                       \n"
+       "   cpsie   f                       \n"
+       "   dsb                             \n"
+       "   isb                             \n"
+       "   svc     0                       \n"
+       "   nop                             \n"
+       "   .ltorg                          \n"
+       ::: "r0", "memory"
+   );
+
+   while (1) {}
+}
+
+/* Idle thread body: sleep until the next interrupt */
+void Rtos_PortIdle(void)
+{
+   __WFI();
+}
+
+/* Start the first thread: pop the frame built by Rtos_PortInitThread() */
+__attribute__((naked)) void SVC_Handler(void)
+{
+   __asm volatile (
+       "   ldr     r3, =rtosCurrent        \n"
+       "   ldr     r1, [r3]                \n"
+       "   ldr     r0, [r1]                \n"
+       "   ldmia   r0!, {r4-r11, lr}       \n"
+       "   msr     psp, r0                 \n"
+       "   isb                             \n"
+       "   bx      lr                      \n"
+       "   .ltorg                          \n"
+   );
+}
+
+/* Context switch, lowest priority so it only runs once no handler is active */
+__attribute__((naked)) void PendSV_Handler(void)
+{
+   __asm volatile (
+       "   mrs     r0, psp                 \n"
+       "   isb                             \n"
+       "   ldr     r3, =rtosCurrent        \n"
+       "   ldr     r2, [r3]                \n"
+#if (__FPU_USED == 1)
+       /* EXC_RETURN bit 4 clear: the thread used the FPU, save the callee saved
+          half, the hardware stacks (lazily) the caller saved half */
+       "   tst     lr, #0x10               \n"
+       "   it      eq                      \n"
+       "   vstmdbeq r0!, {s16-s31}         \n"
+#endif
+       "   stmdb   r0!, {r4-r11, lr}       \n"
+       "   str     r0, [r2]                \n"
+       "   mov     r0, %0                  \n"
+       "   msr     basepri, r0             \n"
+       "   dsb                             \n"
+       "   isb                             \n"
+       "   bl      Rtos_SwitchContext      \n"
+       "   mov     r0, #0                  \n"
+       "   msr     basepri, r0             \n"
+       "   ldr     r3, =rtosCurrent        \n"
+       "   ldr     r1, [r3]                \n"
+       "   ldr     r0, [r1]                \n"
+       "   ldmia   r0!, {r4-r11, lr}       \n"
+#if (__FPU_USED == 1)
+       "   tst     lr, #0x10               \n"
+       "   it      eq                      \n"
+       "   vldmiaeq r0!, {s16-s31}         \n"
+#endif
+       "   msr     psp, r0                 \n"
+       "   isb                             \n"
+       "   bx      lr                      \n"
+       "   .ltorg                          \n"
+       :: "i" (RTOS_BASEPRI)
+   );
+}
+
+/* Kernel tick */
+void SysTick_Handler(void)
+{
+   Rtos_Tick();
+}
+
+#endif /* defined(CORE_M4) && RTOS_ENABLE */
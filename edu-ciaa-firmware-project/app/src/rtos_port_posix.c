@@ -0,0 +1,142 @@
+/*
+ * @brief Minimal preemptive kernel, POSIX host port
+ *
+ * Every kernel thread runs on its own pthread, and a big lock plus one
+ * condition variable per thread make sure only rtosCurrent runs. Switches
+ * happen when a kernel thread leaves its outermost critical section, so a
+ * thread that never calls the kernel is never preempted. Threads that are
+ * not kernel threads, such as the one running Rtos_Start() and driving the
+ * tick, count as interrupt handlers: they may only use the FromIsr calls,
+ * and the switches they request are done by the running thread.
+ *
+ * Build it with -pthread, next to rtos.c.
+ */
+
+#include "rtos_port.h"
+
+#if !defined(CORE_M4)
+
+#include <unistd.h>
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+static pthread_mutex_t bigLock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool switchPending;
+
+/* Kernel thread run by this pthread, NULL for "interrupt" pthreads */
+static __thread RTOS_THREAD_T *hostSelf;
+static __thread uint32_t lockDepth;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Run the pending switches, then wait until this thread is current again */
+static void Rtos_HostSwitch(void)
+{
+   RTOS_THREAD_T *self = hostSelf;
+
+   while (switchPending) {
+       switchPending = false;
+       Rtos_SwitchContext();
+       if (rtosCurrent != self) {
+           pthread_cond_signal(&rtosCurrent->hostRun);
+           while (rtosCurrent != self) {
+               pthread_cond_wait(&self->hostRun, &bigLock);
+           }
+       }
+   }
+}
+
+/* pthread body: wait for the first switch to the thread, then run it */
+static void *Rtos_HostEntry(void *arg)
+{
+   RTOS_THREAD_T *t = arg;
+
+   hostSelf = t;
+   pthread_mutex_lock(&bigLock);
+   while (rtosCurrent != t) {
+       pthread_cond_wait(&t->hostRun, &bigLock);
+   }
+   pthread_mutex_unlock(&bigLock);
+
+   t->hostFn(t->hostArg);
+   Rtos_ThreadExit();
+
+   return NULL;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Enter a kernel critical section */
+uint32_t Rtos_PortLock(void)
+{
+   if (lockDepth++ == 0) {
+       pthread_mutex_lock(&bigLock);
+   }
+
+   return 0;
+}
+
+/* Leave a kernel critical section, switching if asked to */
+void Rtos_PortUnlock(uint32_t key)
+{
+   if (--lockDepth == 0) {
+       if (hostSelf != NULL) {
+           Rtos_HostSwitch();
+       }
+       pthread_mutex_unlock(&bigLock);
+   }
+}
+
+/* Request a context switch */
+void Rtos_PortPendSwitch(void)
+{
+   switchPending = true;
+}
+
+/* Return whether the caller is an interrupt handler */
+bool Rtos_PortInIsr(void)
+{
+   return hostSelf == NULL;
+}
+
+/* Start the pthread, it waits until the kernel switches to it */
+void Rtos_PortInitThread(RTOS_THREAD_T *pThread, void (*fn)(void *), void *arg)
+{
+   pThread->hostFn = fn;
+   pThread->hostArg = arg;
+   pthread_cond_init(&pThread->hostRun, NULL);
+   pthread_create(&pThread->hostThread, NULL, Rtos_HostEntry, pThread);
+}
+
+/* Run rtosCurrent, then act as the tick interrupt */
+void Rtos_PortStart(void)
+{
+   pthread_mutex_lock(&bigLock);
+   switchPending = false;
+   pthread_cond_signal(&rtosCurrent->hostRun);
+   pthread_mutex_unlock(&bigLock);
+
+   while (1) {
+       usleep(1000000 / RTOS_TICK_HZ);
+       Rtos_Tick();
+   }
+}
+
+/* Idle thread body: give pending switches a chance, then sleep a little */
+void Rtos_PortIdle(void)
+{
+   Rtos_PortUnlock(Rtos_PortLock());
+   usleep(100);
+}
+
+#endif /* !defined(CORE_M4) */
@@ -0,0 +1,262 @@
+/*
+ * @brief GPDMA backed SPI master transaction queue on SSP0/SSP1
+ */
+
+#include <string.h>
+#include "board.h"
+#include "spi_dma.h"
+#include "dma.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Transfer width fields of a channel control word */
+#define SPI_DMA_WIDTH_MASK      (GPDMA_DMACCxControl_SWidth(7) | GPDMA_DMACCxControl_DWidth(7))
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Mask interrupts, returns the previous mask for SpiDma_Unlock() */
+STATIC INLINE uint32_t SpiDma_Lock(void)
+{
+   uint32_t primask = __get_PRIMASK();
+
+   __disable_irq();
+
+   return primask;
+}
+
+/* Restore the interrupt mask saved by SpiDma_Lock() */
+STATIC INLINE void SpiDma_Unlock(uint32_t primask)
+{
+   __set_PRIMASK(primask);
+}
+
+/* Drive a chip select, true to assert it */
+STATIC INLINE void SpiDma_Select(const SPI_DMA_DEV_T *dev, bool on)
+{
+   Chip_GPIO_SetPinState(LPC_GPIO_PORT, dev->csGpioPort, dev->csGpioPin, !on);
+}
+
+/* Set the SSP up for a device, only while it is idle */
+static void SpiDma_Configure(SPI_DMA_BUS_T *pBus, const SPI_DMA_DEV_T *dev)
+{
+   Chip_SSP_Disable(pBus->pSSP);
+   Chip_SSP_SetFormat(pBus->pSSP, dev->bits - 1, SSP_FRAMEFORMAT_SPI, dev->mode);
+   Chip_SSP_SetBitRate(pBus->pSSP, dev->bitRate);
+   Chip_SSP_Enable(pBus->pSSP);
+
+   pBus->config = dev;
+   pBus->stats.reconfigs++;
+}
+
+/* Start the transfer at the head of the queue, called with interrupts masked */
+static void SpiDma_Start(SPI_DMA_BUS_T *pBus)
+{
+   SPI_DMA_XFER_T *pXfer = pBus->head;
+   DMA_TransferDescriptor_t rx, tx;
+   uint32_t width;
+
+   if (pBus->busy || pXfer == NULL) {
+       return;
+   }
+
+   if (pBus->config != pXfer->dev) {
+       SpiDma_Configure(pBus, pXfer->dev);
+   }
+   width = (pXfer->dev->bits > 8) ? GPDMA_WIDTH_HALFWORD : GPDMA_WIDTH_BYTE;
+
+   /* Frame width on both sides, the memory address stays on the dummy word without a buffer */
+   Chip_GPDMA_PrepareDescriptor(LPC_GPDMA, &rx, pBus->rxConn,
+                                (pXfer->rx != NULL) ? (uint32_t) pXfer->rx : (uint32_t) &pBus->sink,
+                                pXfer->frames, GPDMA_TRANSFERTYPE_P2M_CONTROLLER_DMA, NULL);
+   rx.ctrl &= ~(SPI_DMA_WIDTH_MASK | ((pXfer->rx != NULL) ? 0 : GPDMA_DMACCxControl_DI));
+   rx.ctrl |= GPDMA_DMACCxControl_SWidth(width) | GPDMA_DMACCxControl_DWidth(width);
+
+   /* Only the receive side interrupts: it finishes last */
+   Chip_GPDMA_PrepareDescriptor(LPC_GPDMA, &tx,
+                                (pXfer->tx != NULL) ? (uint32_t) pXfer->tx : (uint32_t) &pBus->fill,
+                                pBus->txConn, pXfer->frames, GPDMA_TRANSFERTYPE_M2P_CONTROLLER_DMA,
+                                NULL);
+   tx.ctrl &= ~(SPI_DMA_WIDTH_MASK | GPDMA_DMACCxControl_I |
+                ((pXfer->tx != NULL) ? 0 : GPDMA_DMACCxControl_SI));
+   tx.ctrl |= GPDMA_DMACCxControl_SWidth(width) | GPDMA_DMACCxControl_DWidth(width);
+
+   /* Chip_GPDMA_SGTransfer() takes the connection, not the peripheral
+      address, from the first descriptor */
+   rx.src = pBus->rxConn;
+   tx.dst = pBus->txConn;
+
+   pBus->busy = true;
+   pXfer->status = SPI_DMA_BUSY;
+
+   /* Receive first, so that no frame can overrun the receive FIFO */
+   Chip_GPDMA_SGTransfer(LPC_GPDMA, pBus->rxCh, &rx, GPDMA_TRANSFERTYPE_P2M_CONTROLLER_DMA);
+   SpiDma_Select(pXfer->dev, true);
+   Chip_GPDMA_SGTransfer(LPC_GPDMA, pBus->txCh, &tx, GPDMA_TRANSFERTYPE_M2P_CONTROLLER_DMA);
+}
+
+/* Retire the running transfer and start the next one, from the DMA interrupt */
+static void SpiDma_Finish(SPI_DMA_BUS_T *pBus, bool error)
+{
+   SPI_DMA_XFER_T *pXfer;
+   uint32_t primask = SpiDma_Lock();
+   bool hold;
+
+   pXfer = pBus->head;
+   if (!pBus->busy || pXfer == NULL) {
+       SpiDma_Unlock(primask);
+       return;
+   }
+
+   if (error) {
+       /* Stop both sides and drop whatever is left in the FIFOs */
+       Chip_GPDMA_Stop(LPC_GPDMA, pBus->txCh);
+       Chip_GPDMA_Stop(LPC_GPDMA, pBus->rxCh);
+       Chip_SSP_Disable(pBus->pSSP);
+       while (Chip_SSP_GetStatus(pBus->pSSP, SSP_STAT_RNE) == SET) {
+           Chip_SSP_ReceiveFrame(pBus->pSSP);
+       }
+       Chip_SSP_Enable(pBus->pSSP);
+       pBus->stats.dmaErrors++;
+   }
+   else {
+       pBus->stats.xfers++;
+       pBus->stats.frames += pXfer->frames;
+   }
+
+   pBus->head = pXfer->next;
+   if (pBus->head == NULL) {
+       pBus->tail = NULL;
+   }
+
+   /* A stale queue link would splice the rest of the queue into a resubmission */
+   pXfer->next = NULL;
+
+   hold = !error && (pXfer->flags & SPI_DMA_HOLD_CS) != 0 &&
+          pBus->head != NULL && pBus->head->dev == pXfer->dev;
+   if (!hold) {
+       SpiDma_Select(pXfer->dev, false);
+   }
+
+   /* Keep the bus going before running the callback */
+   pBus->busy = false;
+   SpiDma_Start(pBus);
+   SpiDma_Unlock(primask);
+
+   /* The transfer belongs to the caller again from here */
+   pXfer->status = error ? SPI_DMA_ERROR : SPI_DMA_DONE;
+   if (pXfer->cb != NULL) {
+       pXfer->cb(pXfer);
+   }
+   if (pXfer->task != NULL) {
+       Sched_Post(pXfer->task, pXfer->sig, pXfer->status);
+   }
+}
+
+/* Receive channel: terminal count ends the transfer */
+static void SpiDma_RxDMAHandler(uint8_t ch, bool error, void *ctx)
+{
+   SPI_DMA_BUS_T *pBus = (SPI_DMA_BUS_T *) ctx;
+
+   /* The channel stops by itself at the end, an enabled one already runs the next transfer */
+   if ((LPC_GPDMA->ENBLDCHNS & (1UL << ch)) != 0) {
+       return;
+   }
+   SpiDma_Finish(pBus, error);
+}
+
+/* Transmit channel: only errors interrupt */
+static void SpiDma_TxDMAHandler(uint8_t ch, bool error, void *ctx)
+{
+   SPI_DMA_BUS_T *pBus = (SPI_DMA_BUS_T *) ctx;
+
+   if (error && (LPC_GPDMA->ENBLDCHNS & (1UL << ch)) == 0) {
+       SpiDma_Finish(pBus, true);
+   }
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Set up an SSP as SPI master with its pins and two GPDMA channels */
+Status SpiDma_Init(SPI_DMA_BUS_T *pBus, LPC_SSP_T *pSSP)
+{
+   memset(pBus, 0, sizeof(*pBus));
+   pBus->pSSP = pSSP;
+   pBus->fill = 0xFFFF;
+   pBus->txConn = (pSSP == LPC_SSP0) ? GPDMA_CONN_SSP0_Tx : GPDMA_CONN_SSP1_Tx;
+   pBus->rxConn = (pSSP == LPC_SSP0) ? GPDMA_CONN_SSP0_Rx : GPDMA_CONN_SSP1_Rx;
+
+   Dma_Init();
+   pBus->rxCh = Dma_AllocChannel(pBus->rxConn, SpiDma_RxDMAHandler, pBus);
+   if (pBus->rxCh == DMA_CH_NONE) {
+       return ERROR;
+   }
+   pBus->txCh = Dma_AllocChannel(pBus->txConn, SpiDma_TxDMAHandler, pBus);
+   if (pBus->txCh == DMA_CH_NONE) {
+       Dma_FreeChannel(pBus->rxCh);
+       return ERROR;
+   }
+
+   Board_SSP_Init(pSSP);
+   Chip_SSP_Init(pSSP);
+   Chip_SSP_DMA_Enable(pSSP);
+   Chip_SSP_Enable(pSSP);
+
+   return SUCCESS;
+}
+
+/* Set up the chip select of a device, released */
+void SpiDma_InitDevice(const SPI_DMA_DEV_T *dev)
+{
+   Chip_SCU_PinMuxSet(dev->csPort, dev->csPin, SCU_MODE_INACT | dev->csFunc);
+   Chip_GPIO_SetPinOutHigh(LPC_GPIO_PORT, dev->csGpioPort, dev->csGpioPin);
+   Chip_GPIO_SetPinDIROutput(LPC_GPIO_PORT, dev->csGpioPort, dev->csGpioPin);
+}
+
+/* Queue a list of transfers */
+Status SpiDma_Submit(SPI_DMA_BUS_T *pBus, SPI_DMA_XFER_T *pXfer)
+{
+   SPI_DMA_XFER_T *last = NULL, *p;
+   uint32_t primask;
+
+   for (p = pXfer; p != NULL; p = p->next) {
+       if (p->dev == NULL || p->frames == 0 || p->frames > SPI_DMA_MAX_FRAMES ||
+           p->dev->bits < 4 || p->dev->bits > 16) {
+           pBus->stats.rejected++;
+           return ERROR;
+       }
+       p->status = SPI_DMA_QUEUED;
+       last = p;
+   }
+   if (last == NULL) {
+       return ERROR;
+   }
+
+   primask = SpiDma_Lock();
+   if (pBus->tail != NULL) {
+       pBus->tail->next = pXfer;
+   }
+   else {
+       pBus->head = pXfer;
+   }
+   pBus->tail = last;
+   SpiDma_Start(pBus);
+   SpiDma_Unlock(primask);
+
+   return SUCCESS;
+}
+
+/* Return whether the bus has nothing running or queued */
+bool SpiDma_IsIdle(SPI_DMA_BUS_T *pBus)
+{
+   return pBus->head == NULL;
+}
@@ -0,0 +1,103 @@
+/*
+ * @brief Lock-free single producer / single consumer ring buffer
+ */
+
+#include <string.h>
+#include "spsc_ring.h"
+#include "cr_section_macros.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Initialize an SPSC ring buffer */
+bool SpscRing_Init(SPSC_RING_T *pRing, void *buffer, uint32_t itemSize, uint32_t count)
+{
+   if (count < 2 || (count & (count - 1)) != 0) {
+       return false;
+   }
+
+   pRing->data = (uint8_t *) buffer;
+   pRing->count = count;
+   pRing->itemSz = itemSize;
+   pRing->head = 0;
+   pRing->tail = 0;
+
+   return true;
+}
+
+/* Producer: copy one item in */
+__HOT_FUNC int SpscRing_Insert(SPSC_RING_T *pRing, const void *data)
+{
+   void *span;
+
+   if (SpscRing_Reserve(pRing, &span) == 0) {
+       return 0;
+   }
+
+   memcpy(span, data, pRing->itemSz);
+   SpscRing_Commit(pRing, 1);
+
+   return 1;
+}
+
+/* Producer: copy several items in, at most two spans */
+__HOT_FUNC int SpscRing_InsertMult(SPSC_RING_T *pRing, const void *data, int num)
+{
+   const uint8_t *src = (const uint8_t *) data;
+   uint32_t len, done = 0;
+   void *span;
+
+   while (done < (uint32_t) num && (len = SpscRing_Reserve(pRing, &span)) != 0) {
+       len = MIN(len, (uint32_t) num - done);
+       memcpy(span, &src[done * pRing->itemSz], len * pRing->itemSz);
+       SpscRing_Commit(pRing, len);
+       done += len;
+   }
+
+   return (int) done;
+}
+
+/* Consumer: copy one item out */
+__HOT_FUNC int SpscRing_Pop(SPSC_RING_T *pRing, void *data)
+{
+   const void *span;
+
+   if (SpscRing_Peek(pRing, &span) == 0) {
+       return 0;
+   }
+
+   memcpy(data, span, pRing->itemSz);
+   SpscRing_Release(pRing, 1);
+
+   return 1;
+}
+
+/* Consumer: copy several items out, at most two spans */
+__HOT_FUNC int SpscRing_PopMult(SPSC_RING_T *pRing, void *data, int num)
+{
+   uint8_t *dst = (uint8_t *) data;
+   uint32_t len, done = 0;
+   const void *span;
+
+   while (done < (uint32_t) num && (len = SpscRing_Peek(pRing, &span)) != 0) {
+       len = MIN(len, (uint32_t) num - done);
+       memcpy(&dst[done * pRing->itemSz], span, len * pRing->itemSz);
+       SpscRing_Release(pRing, len);
+       done += len;
+   }
+
+   return (int) done;
+}
@@ -0,0 +1,219 @@
+/*
+ * @brief Software timers on a hierarchical timing wheel
+ */
+
+#include "swtimer.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+#define SWTIMER_SLOT_BITS       6
+#define SWTIMER_SLOTS           (1 << SWTIMER_SLOT_BITS)
+#define SWTIMER_SLOT_MASK       (SWTIMER_SLOTS - 1)
+
+/* Ticks covered by one slot of a level */
+#define SWTIMER_SLOT_TICKS(level) (1ULL << (SWTIMER_SLOT_BITS * (level)))
+
+/* Farthest expiry the wheel holds, later timers are parked at its end */
+#define SWTIMER_RANGE           SWTIMER_SLOT_TICKS(SWTIMER_LEVELS)
+
+static SWTIMER_T *wheel[SWTIMER_LEVELS][SWTIMER_SLOTS];
+static uint64_t occupied[SWTIMER_LEVELS];   /* Bit n set when slot n is not empty */
+static uint64_t tick;                       /* Next tick to process */
+static uint64_t target;                     /* Last tick asked for by Swtimer_Run() */
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Rotate a slot bitmap so that slot @a first becomes bit 0 */
+STATIC INLINE uint64_t Swtimer_Rotate(uint64_t bits, uint32_t first)
+{
+   return (first == 0) ? bits : (bits >> first) | (bits << (SWTIMER_SLOTS - first));
+}
+
+/* Put a timer in the slot for its expiry, relative to the current tick */
+static void Swtimer_Link(SWTIMER_T *t)
+{
+   uint64_t when = MAX(t->expires, tick);
+   uint64_t delta = when - tick;
+   uint32_t level = 0;
+   uint32_t slot;
+
+   if (delta >= SWTIMER_RANGE) {
+       when = tick + SWTIMER_RANGE - 1;
+       delta = SWTIMER_RANGE - 1;
+   }
+   while (delta >= SWTIMER_SLOT_TICKS(level + 1)) {
+       level++;
+   }
+   slot = (uint32_t) (when >> (SWTIMER_SLOT_BITS * level)) & SWTIMER_SLOT_MASK;
+
+   t->level = (uint8_t) level;
+   t->slot = (uint8_t) slot;
+   t->next = wheel[level][slot];
+   if (t->next != NULL) {
+       t->next->pprev = &t->next;
+   }
+   t->pprev = &wheel[level][slot];
+   wheel[level][slot] = t;
+   occupied[level] |= 1ULL << slot;
+}
+
+/* Take a timer off its list */
+static void Swtimer_Unlink(SWTIMER_T *t)
+{
+   *t->pprev = t->next;
+   if (t->next != NULL) {
+       t->next->pprev = t->pprev;
+   }
+   t->pprev = NULL;
+   if (wheel[t->level][t->slot] == NULL) {
+       occupied[t->level] &= ~(1ULL << t->slot);
+   }
+}
+
+/* Move the current slot of a level down the wheel */
+static void Swtimer_Cascade(uint32_t level)
+{
+   uint32_t slot = (uint32_t) (tick >> (SWTIMER_SLOT_BITS * level)) & SWTIMER_SLOT_MASK;
+   SWTIMER_T *t;
+
+   while ((t = wheel[level][slot]) != NULL) {
+       Swtimer_Unlink(t);
+       Swtimer_Link(t);
+   }
+}
+
+/* First tick from the current one with a slot to run or to cascade */
+static uint64_t Swtimer_NextTick(void)
+{
+   uint64_t next = UINT64_MAX;
+   uint64_t first, at;
+   uint32_t level;
+
+   if (occupied[0] != 0) {
+       next = tick + __builtin_ctzll(Swtimer_Rotate(occupied[0], (uint32_t) tick & SWTIMER_SLOT_MASK));
+   }
+
+   /* A slot of level n is cascaded when the tick reaches the start of its 64^n tick block */
+   for (level = 1; level < SWTIMER_LEVELS; level++) {
+       if (occupied[level] == 0) {
+           continue;
+       }
+       first = (tick + SWTIMER_SLOT_TICKS(level) - 1) >> (SWTIMER_SLOT_BITS * level);
+       at = first + __builtin_ctzll(Swtimer_Rotate(occupied[level], (uint32_t) first & SWTIMER_SLOT_MASK));
+       next = MIN(next, at << (SWTIMER_SLOT_BITS * level));
+   }
+
+   return next;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Empty the wheel and set its time */
+void Swtimer_Init(uint64_t nowUs)
+{
+   uint32_t level, slot;
+
+   for (level = 0; level < SWTIMER_LEVELS; level++) {
+       for (slot = 0; slot < SWTIMER_SLOTS; slot++) {
+           wheel[level][slot] = NULL;
+       }
+       occupied[level] = 0;
+   }
+   target = nowUs / SWTIMER_TICK_US;
+   tick = target + 1;
+}
+
+/* Prepare a timer, stopped */
+void Swtimer_Setup(SWTIMER_T *pTimer, SWTIMER_FN_T fn, void *ctx)
+{
+   pTimer->next = NULL;
+   pTimer->pprev = NULL;
+   pTimer->expires = 0;
+   pTimer->period = 0;
+   pTimer->fn = fn;
+   pTimer->ctx = ctx;
+}
+
+/* Start or restart a timer */
+void Swtimer_Start(SWTIMER_T *pTimer, uint64_t delayTicks, uint32_t periodTicks)
+{
+   if (pTimer->pprev != NULL) {
+       Swtimer_Unlink(pTimer);
+   }
+   pTimer->expires = tick - 1 + MAX(delayTicks, 1);
+   pTimer->period = periodTicks;
+   Swtimer_Link(pTimer);
+}
+
+/* Stop a timer */
+void Swtimer_Stop(SWTIMER_T *pTimer)
+{
+   if (pTimer->pprev != NULL) {
+       Swtimer_Unlink(pTimer);
+   }
+}
+
+/* Advance the wheel to the current time and run the due callbacks */
+uint32_t Swtimer_Run(uint64_t nowUs)
+{
+   SWTIMER_T *due, *t;
+   uint64_t next;
+   uint32_t count = 0;
+   uint32_t level, slot;
+
+   target = MAX(target, nowUs / SWTIMER_TICK_US);
+
+   while ((next = Swtimer_NextTick()) <= target) {
+       tick = next;
+       for (level = 1; level < SWTIMER_LEVELS; level++) {
+           if ((tick & (SWTIMER_SLOT_TICKS(level) - 1)) != 0) {
+               break;
+           }
+           Swtimer_Cascade(level);
+       }
+
+       /* Detach the slot: callbacks may start or stop any timer, these included */
+       slot = (uint32_t) tick & SWTIMER_SLOT_MASK;
+       due = wheel[0][slot];
+       wheel[0][slot] = NULL;
+       occupied[0] &= ~(1ULL << slot);
+       if (due != NULL) {
+           due->pprev = &due;
+       }
+       tick++;
+
+       while ((t = due) != NULL) {
+           Swtimer_Unlink(t);
+           if (t->period != 0) {
+               t->expires += t->period;
+               if (t->expires <= target) {
+                   t->expires += ((target - t->expires) / t->period + 1) * t->period;
+               }
+               Swtimer_Link(t);
+           }
+           t->fn(t->ctx);
+           count++;
+       }
+   }
+   tick = MAX(tick, target + 1);
+
+   return count;
+}
+
+/* Return when Swtimer_Run() next has work */
+uint64_t Swtimer_NextDeadline(void)
+{
+   uint64_t next = Swtimer_NextTick();
+
+   return (next == UINT64_MAX) ? SWTIMER_NEVER : next * SWTIMER_TICK_US;
+}
@@ -0,0 +1,229 @@
+/*
+ * @brief Tickless time base and idle
+ */
+
+#include "systime.h"
+#include "evtrace.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Alarm timer: 1 kHz output of the RTC oscillator, really 1024 Hz */
+#define SYSTIME_ATIMER_HZ       1024
+#define SYSTIME_ATIMER_MAX      0xFFFF
+
+static volatile uint32_t wraps;
+static uint64_t offset;         /* Time spent with the timer stopped, in deep sleep */
+static bool deepAllowed;
+static bool oscRunning;
+static SYSTIME_STATS_T stats;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Read the alarm timer, it counts in another clock domain */
+static uint32_t Systime_AtimerCount(void)
+{
+   uint32_t a, b = LPC_ATIMER->DOWNCOUNTER;
+
+   do {
+       a = b;
+       b = LPC_ATIMER->DOWNCOUNTER;
+   } while (a != b);
+
+   return a;
+}
+
+/* The alarm timer only counts once the RTC oscillator has started */
+static bool Systime_OscRunning(void)
+{
+   if (!oscRunning) {
+       oscRunning = (Systime_AtimerCount() != SYSTIME_ATIMER_MAX);
+   }
+
+   return oscRunning;
+}
+
+/* Deep sleep for about @a us, with the alarm timer as wake-up, returns the time slept */
+static uint64_t Systime_DeepSleep(uint64_t us)
+{
+   uint32_t ticks = (uint32_t) MIN(us * SYSTIME_ATIMER_HZ / 1000000, SYSTIME_ATIMER_MAX);
+   uint32_t left, elapsed;
+
+   /* The timer would count at the IRC rate while the PLL is off, hold it */
+   Chip_TIMER_Disable(SYSTIME_TIMER);
+
+   Chip_ATIMER_ClearIntStatus(LPC_ATIMER);
+   Chip_EVRT_ClrPendIntSrc(EVRT_SRC_ATIMER);
+   LPC_ATIMER->DOWNCOUNTER = ticks;
+   Chip_ATIMER_IntEnable(LPC_ATIMER);
+
+   Chip_Clock_SetBaseClock(CLK_BASE_MX, CLKIN_IRC, true, false);
+   Chip_Clock_DisableMainPLL();
+   Chip_PMC_Set_PwrState(PMC_DeepSleep);
+
+   /* Chip_PMC_Set_PwrState() leaves SLEEPDEEP set for every later WFI */
+   SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+   Chip_SetupCoreClock(CLKIN_CRYSTAL, MAX_CLOCK_FREQ, false);
+
+   /* Past zero the counter reloads from the preset and keeps counting */
+   left = Systime_AtimerCount();
+   if (LPC_ATIMER->STATUS & 1) {
+       elapsed = ticks + 1 + (SYSTIME_ATIMER_MAX - left);
+   }
+   else {
+       elapsed = ticks - left;
+   }
+   Chip_ATIMER_IntDisable(LPC_ATIMER);
+   Chip_ATIMER_ClearIntStatus(LPC_ATIMER);
+   Chip_EVRT_ClrPendIntSrc(EVRT_SRC_ATIMER);
+   NVIC_ClearPendingIRQ(EVENTROUTER_IRQn);
+
+   us = (uint64_t) elapsed * 1000000 / SYSTIME_ATIMER_HZ;
+   offset += us;
+   Chip_TIMER_Enable(SYSTIME_TIMER);
+
+   EVTRACE(DEEP_SLEEP, MIN(us / 1000, 0xFFFF));
+
+   return us;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Time base interrupt: counter wrap, or the Systime_Idle() deadline */
+void SYSTIME_IRQHandler(void)
+{
+   uint32_t primask = __get_PRIMASK();
+
+   /* Systime_Now() must never see the wrap count and the flag out of step */
+   __disable_irq();
+   if (Chip_TIMER_MatchPending(SYSTIME_TIMER, SYSTIME_WRAP_MATCH)) {
+       Chip_TIMER_ClearMatch(SYSTIME_TIMER, SYSTIME_WRAP_MATCH);
+       wraps++;
+   }
+   if (Chip_TIMER_MatchPending(SYSTIME_TIMER, SYSTIME_WAKE_MATCH)) {
+       Chip_TIMER_ClearMatch(SYSTIME_TIMER, SYSTIME_WAKE_MATCH);
+       Chip_TIMER_MatchDisableInt(SYSTIME_TIMER, SYSTIME_WAKE_MATCH);
+   }
+   __set_PRIMASK(primask);
+}
+
+/* Event router interrupt: only reached if interrupts are unmasked in deep sleep */
+void EVRT_IRQHandler(void)
+{
+   Chip_ATIMER_ClearIntStatus(LPC_ATIMER);
+   Chip_EVRT_ClrPendIntSrc(EVRT_SRC_ATIMER);
+}
+
+/* Start the time base at zero */
+void Systime_Init(void)
+{
+   wraps = 0;
+   offset = 0;
+   deepAllowed = false;
+   oscRunning = false;
+
+   Chip_TIMER_Init(SYSTIME_TIMER);
+   Chip_TIMER_Reset(SYSTIME_TIMER);
+   Chip_TIMER_PrescaleSet(SYSTIME_TIMER, Chip_Clock_GetRate(SYSTIME_CLK) / 1000000 - 1);
+   Chip_TIMER_SetMatch(SYSTIME_TIMER, SYSTIME_WRAP_MATCH, 0);
+   Chip_TIMER_MatchEnableInt(SYSTIME_TIMER, SYSTIME_WRAP_MATCH);
+   Chip_TIMER_Enable(SYSTIME_TIMER);
+
+   /* The counter starts on the wrap match, do not count that one */
+   while (Chip_TIMER_ReadCount(SYSTIME_TIMER) == 0) {}
+   Chip_TIMER_ClearMatch(SYSTIME_TIMER, SYSTIME_WRAP_MATCH);
+   NVIC_ClearPendingIRQ(SYSTIME_IRQn);
+   NVIC_SetPriority(SYSTIME_IRQn, SYSTIME_IRQ_PRIO);
+   NVIC_EnableIRQ(SYSTIME_IRQn);
+
+   /* Deep sleep wake-up: alarm timer through the event router */
+   Chip_Clock_RTCEnable();
+   Chip_ATIMER_Init(LPC_ATIMER, SYSTIME_ATIMER_MAX);
+   Chip_ATIMER_IntDisable(LPC_ATIMER);
+   LPC_ATIMER->DOWNCOUNTER = SYSTIME_ATIMER_MAX;
+   Chip_EVRT_Init();
+   Chip_EVRT_ConfigIntSrcActiveType(EVRT_SRC_ATIMER, EVRT_SRC_ACTIVE_HIGH_LEVEL);
+   Chip_EVRT_SetUpIntSrc(EVRT_SRC_ATIMER, ENABLE);
+   NVIC_ClearPendingIRQ(EVENTROUTER_IRQn);
+   NVIC_EnableIRQ(EVENTROUTER_IRQn);
+}
+
+/* Read the time base */
+uint64_t Systime_Now(void)
+{
+   uint32_t primask = __get_PRIMASK();
+   uint32_t hi, lo;
+   uint64_t now;
+
+   __disable_irq();
+   hi = wraps;
+   lo = Chip_TIMER_ReadCount(SYSTIME_TIMER);
+
+   /* Wrapped, but the interrupt has not run yet */
+   if (Chip_TIMER_MatchPending(SYSTIME_TIMER, SYSTIME_WRAP_MATCH) && lo < 0x80000000) {
+       hi++;
+   }
+   now = (((uint64_t) hi << 32) | lo) + offset;
+   __set_PRIMASK(primask);
+
+   return now;
+}
+
+/* Sleep until a deadline or the next interrupt */
+void Systime_Idle(uint64_t deadline)
+{
+   uint64_t now = Systime_Now();
+   uint64_t wait;
+
+   if (deadline <= now) {
+       return;
+   }
+   wait = deadline - now;
+
+   if (deepAllowed && wait >= SYSTIME_DEEP_SLEEP_MIN_US && Systime_OscRunning()) {
+       wait = Systime_DeepSleep(wait);
+       stats.sleeps++;
+       stats.deepSleeps++;
+       stats.sleepUs += wait;
+       stats.deepSleepUs += wait;
+       return;
+   }
+
+   /* Farther deadlines: the wrap interrupt wakes the caller first */
+   if (wait < 0x100000000ULL) {
+       Chip_TIMER_SetMatch(SYSTIME_TIMER, SYSTIME_WAKE_MATCH, (uint32_t) (deadline - offset));
+       Chip_TIMER_ClearMatch(SYSTIME_TIMER, SYSTIME_WAKE_MATCH);
+       Chip_TIMER_MatchEnableInt(SYSTIME_TIMER, SYSTIME_WAKE_MATCH);
+
+       /* The counter may have passed the match while it was being set */
+       if (Systime_Now() >= deadline) {
+           Chip_TIMER_MatchDisableInt(SYSTIME_TIMER, SYSTIME_WAKE_MATCH);
+           return;
+       }
+   }
+
+   Chip_PMC_Sleep();
+   stats.sleeps++;
+   stats.sleepUs += Systime_Now() - now;
+}
+
+/* Allow or forbid deep sleep in Systime_Idle() */
+void Systime_AllowDeepSleep(bool allow)
+{
+   deepAllowed = allow;
+}
+
+/* Return idle statistics */
+const SYSTIME_STATS_T *Systime_GetStats(void)
+{
+   return &stats;
+}
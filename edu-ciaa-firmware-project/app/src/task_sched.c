@@ -0,0 +1,144 @@
+/*
+ * @brief Cooperative run-to-completion task scheduler
+ */
+
+#include "task_sched.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Ready tasks, one FIFO per priority, and a bit per non-empty FIFO */
+static SCHED_TASK_T *readyHead[SCHED_PRIOS];
+static SCHED_TASK_T *readyTail[SCHED_PRIOS];
+static volatile uint32_t readyMask;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Append a task to its ready FIFO, interrupts masked */
+static void Sched_MakeReady(SCHED_TASK_T *pTask)
+{
+   pTask->next = NULL;
+   if (readyHead[pTask->prio] == NULL) {
+       readyHead[pTask->prio] = pTask;
+   }
+   else {
+       readyTail[pTask->prio]->next = pTask;
+   }
+   readyTail[pTask->prio] = pTask;
+   readyMask |= 1UL << pTask->prio;
+   pTask->ready = true;
+}
+
+/* Take the first task of a ready FIFO, interrupts masked */
+static SCHED_TASK_T *Sched_TakeReady(uint32_t prio)
+{
+   SCHED_TASK_T *pTask = readyHead[prio];
+
+   readyHead[prio] = pTask->next;
+   if (readyHead[prio] == NULL) {
+       readyMask &= ~(1UL << prio);
+   }
+   pTask->ready = false;
+
+   return pTask;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Reset the scheduler, no task ready */
+void Sched_Init(void)
+{
+   uint32_t i;
+
+   for (i = 0; i < SCHED_PRIOS; i++) {
+       readyHead[i] = NULL;
+       readyTail[i] = NULL;
+   }
+   readyMask = 0;
+}
+
+/* Set up a task, no event pending */
+void Sched_TaskInit(SCHED_TASK_T *pTask, SCHED_FN_T fn, void *ctx, uint8_t prio,
+                   SCHED_EVT_T *queue, uint32_t qsize)
+{
+   pTask->next = NULL;
+   pTask->fn = fn;
+   pTask->ctx = ctx;
+   pTask->queue = queue;
+   pTask->qmask = (uint8_t) (qsize - 1);
+   pTask->head = 0;
+   pTask->tail = 0;
+   pTask->prio = MIN(prio, SCHED_PRIOS - 1);
+   pTask->ready = false;
+   pTask->lc = 0;
+   pTask->dropped = 0;
+}
+
+/* Post an event to a task */
+bool Sched_Post(SCHED_TASK_T *pTask, uint16_t sig, uint16_t arg)
+{
+   uint32_t primask = __get_PRIMASK();
+   SCHED_EVT_T *pEvt;
+   bool queued = false;
+
+   __disable_irq();
+   if ((uint8_t) (pTask->head - pTask->tail) <= pTask->qmask) {
+       pEvt = &pTask->queue[pTask->head & pTask->qmask];
+       pEvt->sig = sig;
+       pEvt->arg = arg;
+       pTask->head++;
+       if (!pTask->ready) {
+           Sched_MakeReady(pTask);
+       }
+       queued = true;
+   }
+   else {
+       pTask->dropped++;
+   }
+   __set_PRIMASK(primask);
+
+   return queued;
+}
+
+/* Run pending events, highest priority first, until none is left */
+uint32_t Sched_Run(void)
+{
+   SCHED_TASK_T *pTask;
+   SCHED_EVT_T evt;
+   uint32_t count = 0;
+   uint32_t primask;
+
+   while (readyMask != 0) {
+       primask = __get_PRIMASK();
+       __disable_irq();
+       pTask = Sched_TakeReady(__builtin_ctz(readyMask));
+       evt = pTask->queue[pTask->tail & pTask->qmask];
+       pTask->tail++;
+
+       /* More events: behind the other ready tasks of the same priority */
+       if (pTask->head != pTask->tail) {
+           Sched_MakeReady(pTask);
+       }
+       __set_PRIMASK(primask);
+
+       pTask->fn(pTask, &evt);
+       count++;
+   }
+
+   return count;
+}
+
+/* Return whether no event is pending */
+bool Sched_IsIdle(void)
+{
+   return readyMask == 0;
+}
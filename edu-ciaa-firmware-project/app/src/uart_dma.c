@@ -0,0 +1,465 @@
+/*
+ * @brief GPDMA backed UART receive and transmit
+ */
+
+#include <string.h>
+#include "uart_dma.h"
+#include "dma.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Upper bound on the wait for the DMA to drain the FIFO */
+#define UART_DMA_DRAIN_SPIN     64
+
+/* FIFO setup shared by receive and transmit, so init order does not matter */
+#define UART_DMA_FCR            (UART_FCR_FIFO_EN | UART_FCR_DMAMODE_SEL | UART_FCR_TRG_LEV3)
+
+#define UART_DMA_TX_MASK        (UART_DMA_TX_SLOTS - 1)
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Free running count of bytes written by the DMA */
+static uint32_t UartDma_RxHead(UART_DMA_RX_T *pRx)
+{
+   uint32_t done, dst, off;
+
+   /* The block count and the channel address must come from the same block */
+   do {
+       done = pRx->doneBlocks;
+       dst = LPC_GPDMA->CH[pRx->ch].DESTADDR;
+   } while (done != pRx->doneBlocks);
+
+   /* Offset from the start of the block the DMA is known to be in. If a
+      block completed but its interrupt has not run yet the offset simply
+      extends into the next block. */
+   off = (dst - (uint32_t) pRx->buf - (done % pRx->nblocks) * pRx->blockSize) & (pRx->size - 1);
+
+   return done * pRx->blockSize + off;
+}
+
+/* Pending bytes, skipping data the DMA has already overwritten */
+static uint32_t UartDma_RxPending(UART_DMA_RX_T *pRx)
+{
+   uint32_t head = UartDma_RxHead(pRx);
+   uint32_t pending = head - pRx->tail;
+
+   /* Consumer lapped: keep the newest block free for the DMA and drop the rest */
+   if (pending > pRx->size - pRx->blockSize) {
+       uint32_t skip = pending - (pRx->size - pRx->blockSize);
+
+       pRx->stats.swOverruns++;
+       pRx->stats.lostBytes += skip;
+       pRx->tail += skip;
+       pending -= skip;
+   }
+
+   return pending;
+}
+
+/* GPDMA terminal count/error handler, one call per completed block */
+static void UartDma_RxDMAHandler(uint8_t ch, bool error, void *ctx)
+{
+   UART_DMA_RX_T *pRx = (UART_DMA_RX_T *) ctx;
+
+   if (error) {
+       pRx->stats.dmaErrors++;
+       return;
+   }
+
+   pRx->doneBlocks++;
+   pRx->stats.blocks++;
+
+   if (pRx->notify != NULL) {
+       pRx->notify();
+   }
+}
+
+/* Mask interrupts, returns the previous mask for UartDma_Unlock() */
+STATIC INLINE uint32_t UartDma_Lock(void)
+{
+   uint32_t primask = __get_PRIMASK();
+
+   __disable_irq();
+
+   return primask;
+}
+
+/* Restore the interrupt mask saved by UartDma_Lock() */
+STATIC INLINE void UartDma_Unlock(uint32_t primask)
+{
+   __set_PRIMASK(primask);
+}
+
+/* Start a descriptor chain with every ready request, called with interrupts masked */
+static void UartDma_TxKick(UART_DMA_TX_T *pTx)
+{
+   DMA_TransferDescriptor_t first;
+   uint32_t n = pTx->issued;
+   uint32_t i;
+
+   if (pTx->busy) {
+       return;
+   }
+
+   while (n != pTx->queued && pTx->req[n & UART_DMA_TX_MASK].ready) {
+       i = n & UART_DMA_TX_MASK;
+
+       /* No next descriptor keeps the interrupt bit set, so every buffer completes on its own */
+       Chip_GPDMA_PrepareDescriptor(LPC_GPDMA, &pTx->desc[i], (uint32_t) pTx->req[i].data,
+                                    pTx->conn, pTx->req[i].len,
+                                    GPDMA_TRANSFERTYPE_M2P_CONTROLLER_DMA, NULL);
+       if (n != pTx->issued) {
+           pTx->desc[(n - 1) & UART_DMA_TX_MASK].lli = (uint32_t) &pTx->desc[i];
+       }
+       n++;
+   }
+
+   if (n == pTx->issued) {
+       return;
+   }
+
+   /* Chip_GPDMA_SGTransfer() takes the connection, not the peripheral
+      address, from the first descriptor */
+   first = pTx->desc[pTx->issued & UART_DMA_TX_MASK];
+   first.dst = pTx->conn;
+
+   pTx->issued = n;
+   pTx->busy = true;
+   pTx->stats.chains++;
+
+   Chip_GPDMA_SGTransfer(LPC_GPDMA, pTx->ch, &first, GPDMA_TRANSFERTYPE_M2P_CONTROLLER_DMA);
+}
+
+/* Claim the next request slot, called with interrupts masked */
+static UART_DMA_TX_REQ_T *UartDma_TxClaim(UART_DMA_TX_T *pTx)
+{
+   UART_DMA_TX_REQ_T *pReq;
+   uint32_t depth = pTx->queued - pTx->done;
+
+   if (depth >= UART_DMA_TX_SLOTS) {
+       return NULL;
+   }
+
+   pReq = &pTx->req[pTx->queued & UART_DMA_TX_MASK];
+   pReq->ready = false;
+   pTx->queued++;
+
+   if (depth + 1 > pTx->stats.maxQueued) {
+       pTx->stats.maxQueued = depth + 1;
+   }
+
+   return pReq;
+}
+
+/* GPDMA terminal count/error handler, retires every finished request */
+static void UartDma_TxDMAHandler(uint8_t ch, bool error, void *ctx)
+{
+   UART_DMA_TX_T *pTx = (UART_DMA_TX_T *) ctx;
+   UART_DMA_TX_REQ_T *pReq;
+   UART_DMA_TX_CB_T cb;
+   void *cbCtx;
+   uint32_t end, lli, primask;
+   bool retired;
+
+   if (error) {
+       pTx->stats.dmaErrors++;
+   }
+
+   /* Interrupts can coalesce: the running descriptor is the one whose link
+      matches the channel LLI, everything before it has been sent */
+   if ((LPC_GPDMA->ENBLDCHNS & (1UL << ch)) == 0) {
+       end = pTx->issued;
+   }
+   else {
+       lli = LPC_GPDMA->CH[ch].LLI;
+       end = pTx->done;
+       while (end != pTx->issued && pTx->desc[end & UART_DMA_TX_MASK].lli != lli) {
+           end++;
+       }
+   }
+
+   retired = (pTx->done != end);
+   while (pTx->done != end) {
+       pReq = &pTx->req[pTx->done & UART_DMA_TX_MASK];
+       pTx->stats.frames++;
+       pTx->stats.bytes += pReq->len;
+       pTx->poolTail += pReq->poolLen;
+
+       /* The slot can be claimed again as soon as done moves past it */
+       cb = pReq->cb;
+       cbCtx = pReq->ctx;
+       pTx->done++;
+
+       if (cb != NULL) {
+           cb(cbCtx);
+       }
+   }
+
+   primask = UartDma_Lock();
+   if (pTx->done == pTx->issued) {
+       pTx->busy = false;
+       UartDma_TxKick(pTx);
+   }
+   UartDma_Unlock(primask);
+
+   /* Slots and pool space were freed */
+   if (retired && pTx->notify != NULL) {
+       pTx->notify();
+   }
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Start DMA reception on a UART */
+Status UartDma_RxInit(UART_DMA_RX_T *pRx, LPC_USART_T *pUART, uint32_t conn, uint8_t *buf,
+                     DMA_TransferDescriptor_t *desc, uint32_t nblocks, uint32_t blockSize)
+{
+   DMA_TransferDescriptor_t first;
+   uint32_t i;
+
+   memset(pRx, 0, sizeof(*pRx));
+   pRx->pUART = pUART;
+   pRx->buf = buf;
+   pRx->desc = desc;
+   pRx->nblocks = nblocks;
+   pRx->blockSize = blockSize;
+   pRx->size = nblocks * blockSize;
+
+   Dma_Init();
+   pRx->ch = Dma_AllocChannel(conn, UartDma_RxDMAHandler, pRx);
+   if (pRx->ch == DMA_CH_NONE) {
+       return ERROR;
+   }
+
+   /* Descriptor ring, each block interrupts and the last links back to the first */
+   for (i = 0; i < nblocks; i++) {
+       Chip_GPDMA_PrepareDescriptor(LPC_GPDMA, &desc[i], conn, (uint32_t) &buf[i * blockSize],
+                                    blockSize, GPDMA_TRANSFERTYPE_P2M_CONTROLLER_DMA,
+                                    &desc[(i + 1) % nblocks]);
+       desc[i].ctrl |= GPDMA_DMACCxControl_I;
+   }
+
+   /* Chip_GPDMA_SGTransfer() takes the connection, not the peripheral
+      address, from the first descriptor */
+   first = desc[0];
+   first.src = conn;
+
+   /* DMA requests are raised at the FIFO trigger level and on time-out */
+   Chip_UART_SetupFIFOS(pUART, UART_DMA_FCR | UART_FCR_RX_RS);
+
+   if (Chip_GPDMA_SGTransfer(LPC_GPDMA, pRx->ch, &first,
+                             GPDMA_TRANSFERTYPE_P2M_CONTROLLER_DMA) != SUCCESS) {
+       Dma_FreeChannel(pRx->ch);
+       pRx->ch = DMA_CH_NONE;
+       return ERROR;
+   }
+
+   Chip_UART_IntEnable(pUART, UART_IER_RBRINT | UART_IER_RLSINT);
+
+   return SUCCESS;
+}
+
+/* Set up DMA transmission on a UART */
+Status UartDma_TxInit(UART_DMA_TX_T *pTx, LPC_USART_T *pUART, uint32_t conn, uint8_t *pool,
+                     uint32_t poolSize)
+{
+   memset(pTx, 0, sizeof(*pTx));
+   pTx->pUART = pUART;
+   pTx->conn = conn;
+   pTx->pool = pool;
+   pTx->poolSize = poolSize;
+
+   Dma_Init();
+   pTx->ch = Dma_AllocChannel(conn, UartDma_TxDMAHandler, pTx);
+   if (pTx->ch == DMA_CH_NONE) {
+       return ERROR;
+   }
+
+   /* DMA requests are raised while the transmit FIFO has room */
+   Chip_UART_SetupFIFOS(pUART, UART_DMA_FCR | UART_FCR_TX_RS);
+
+   return SUCCESS;
+}
+
+/* Queue a buffer for transmission without copying it */
+Status UartDma_TxSend(UART_DMA_TX_T *pTx, const void *data, uint32_t len,
+                     UART_DMA_TX_CB_T cb, void *ctx)
+{
+   UART_DMA_TX_REQ_T *pReq = NULL;
+   uint32_t primask = UartDma_Lock();
+
+   if (len != 0 && len <= UART_DMA_TX_MAX_LEN) {
+       pReq = UartDma_TxClaim(pTx);
+   }
+   if (pReq == NULL) {
+       pTx->stats.rejected++;
+       UartDma_Unlock(primask);
+       return ERROR;
+   }
+
+   pReq->data = (const uint8_t *) data;
+   pReq->len = (uint16_t) len;
+   pReq->poolLen = 0;
+   pReq->cb = cb;
+   pReq->ctx = ctx;
+   pReq->ready = true;
+   UartDma_TxKick(pTx);
+
+   UartDma_Unlock(primask);
+
+   return SUCCESS;
+}
+
+/* Copy a buffer into the pool and queue it for transmission */
+uint32_t UartDma_TxWrite(UART_DMA_TX_T *pTx, const void *data, uint32_t len)
+{
+   UART_DMA_TX_REQ_T *pReq = NULL;
+   uint32_t idx, waste, primask;
+   uint8_t *dst;
+
+   if (pTx->pool == NULL || len == 0 || len > MIN(pTx->poolSize, UART_DMA_TX_MAX_LEN)) {
+       pTx->stats.rejected++;
+       return 0;
+   }
+
+   primask = UartDma_Lock();
+
+   /* Pool space must be contiguous, skip the tail end when it is too short */
+   idx = pTx->poolHead & (pTx->poolSize - 1);
+   waste = (pTx->poolSize - idx < len) ? pTx->poolSize - idx : 0;
+
+   if (pTx->poolHead + waste + len - pTx->poolTail <= pTx->poolSize) {
+       pReq = UartDma_TxClaim(pTx);
+   }
+   if (pReq == NULL) {
+       pTx->stats.rejected++;
+       UartDma_Unlock(primask);
+       return 0;
+   }
+
+   dst = &pTx->pool[(idx + waste) & (pTx->poolSize - 1)];
+   pTx->poolHead += waste + len;
+   pReq->data = dst;
+   pReq->len = (uint16_t) len;
+   pReq->poolLen = (uint16_t) (waste + len);
+   pReq->cb = NULL;
+   UartDma_Unlock(primask);
+
+   /* Copy with interrupts enabled, the slot is not handed out until ready */
+   memcpy(dst, data, len);
+
+   primask = UartDma_Lock();
+   pReq->ready = true;
+   UartDma_TxKick(pTx);
+   UartDma_Unlock(primask);
+
+   return len;
+}
+
+/* Return the number of pool bytes free for UartDma_TxWrite() */
+uint32_t UartDma_TxFree(UART_DMA_TX_T *pTx)
+{
+   if (pTx->queued - pTx->done >= UART_DMA_TX_SLOTS) {
+       return 0;
+   }
+
+   return pTx->poolSize - (pTx->poolHead - pTx->poolTail);
+}
+
+/* Receive part of a UART interrupt handler */
+void UartDma_RxUARTHandler(UART_DMA_RX_T *pRx)
+{
+   uint32_t iir, lsr, spin;
+
+   while (((iir = pRx->pUART->IIR) & UART_IIR_INTSTAT_PEND) == 0) {
+       switch (iir & UART_IIR_INTID_MASK) {
+       case UART_IIR_INTID_RLS:
+           lsr = Chip_UART_ReadLineStatus(pRx->pUART);
+           if (lsr & UART_LSR_OE) {
+               pRx->stats.hwOverruns++;
+           }
+           if (lsr & (UART_LSR_PE | UART_LSR_FE | UART_LSR_BI)) {
+               pRx->stats.lineErrors++;
+           }
+           break;
+
+       case UART_IIR_INTID_CTI:
+           /* Line went idle: let the DMA empty the FIFO, then publish the partial block */
+           spin = UART_DMA_DRAIN_SPIN;
+           while ((Chip_UART_ReadLineStatus(pRx->pUART) & UART_LSR_RDR) != 0 && --spin != 0) {}
+           pRx->stats.idleFlushes++;
+           if (pRx->notify != NULL) {
+               pRx->notify();
+           }
+           break;
+
+       case UART_IIR_INTID_RDA:
+           /* The DMA request fires at the same trigger level and drains the
+              FIFO below it, which clears RDA. Wait for that rather than
+              masking RBRINT, which would also mask the character time-out. */
+           spin = UART_DMA_DRAIN_SPIN;
+           while ((pRx->pUART->IIR & UART_IIR_INTID_MASK) == UART_IIR_INTID_RDA && --spin != 0) {}
+           if (spin == 0) {
+               /* DMA stalled, leave the interrupt pending rather than loop here */
+               pRx->stats.rdaStalls++;
+               return;
+           }
+           break;
+
+       default:
+           /* THRE is cleared by reading IIR, the caller refills from LSR */
+           break;
+       }
+   }
+}
+
+/* Return the number of bytes waiting for the consumer */
+uint32_t UartDma_RxAvailable(UART_DMA_RX_T *pRx)
+{
+   return UartDma_RxPending(pRx);
+}
+
+/* Get a contiguous span of received data, without copying */
+uint32_t UartDma_RxPeek(UART_DMA_RX_T *pRx, const uint8_t **data)
+{
+   uint32_t pending = UartDma_RxPending(pRx);
+   uint32_t idx = pRx->tail & (pRx->size - 1);
+
+   *data = &pRx->buf[idx];
+
+   return MIN(pending, pRx->size - idx);
+}
+
+/* Mark bytes returned by UartDma_RxPeek() as consumed */
+void UartDma_RxRelease(UART_DMA_RX_T *pRx, uint32_t bytes)
+{
+   pRx->tail += bytes;
+   pRx->stats.bytes += bytes;
+}
+
+/* Copy received data out of the circular buffer */
+uint32_t UartDma_RxRead(UART_DMA_RX_T *pRx, void *data, uint32_t bytes)
+{
+   uint8_t *out = (uint8_t *) data;
+   const uint8_t *span;
+   uint32_t len, copied = 0;
+
+   while (copied < bytes && (len = UartDma_RxPeek(pRx, &span)) != 0) {
+       len = MIN(len, bytes - copied);
+       memcpy(&out[copied], span, len);
+       UartDma_RxRelease(pRx, len);
+       copied += len;
+   }
+
+   return copied;
+}
@@ -69,6 +69,18 @@ extern "C" {
    Board_UARTPutSTR functions. */
 #define DEBUG_UART LPC_USART2
 
+/** Set to 1 to mux the RMII pins and clock the Ethernet MAC at boot. The
+    Ethernet PHY is not used by default: its pins stay GPIO and its base
+    clocks are powered down, which shortens the boot. */
+#ifndef BOARD_USE_ENET
+#define BOARD_USE_ENET 0
+#endif
+
+/** Set to 1 to set up the USB0 base clock at boot */
+#ifndef BOARD_USE_USB0
+#define BOARD_USE_USB0 0
+#endif
+
 /**
  * @}
  */
@@ -52,8 +52,13 @@ static uint32_t lcd_cfg_val;
 
 void Board_UART_Init(LPC_USART_T *pUART)
 {
-   Chip_SCU_PinMuxSet(0x6, 4, (SCU_MODE_INACT | SCU_MODE_FUNC2));                  /* P6,4 : UART0_TXD */
-   Chip_SCU_PinMuxSet(0x2, 1, (SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC1));/* P2.1 : UART0_RXD */
+   if (pUART == LPC_USART3) {
+       Chip_SCU_PinMuxSet(0x2, 3, (SCU_MODE_INACT | SCU_MODE_FUNC2));                  /* P2.3 : UART3_TXD (232_TX) */
+       Chip_SCU_PinMuxSet(0x2, 4, (SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC2));/* P2.4 : UART3_RXD (232_RX) */
+   } else {
+       Chip_SCU_PinMuxSet(0x6, 4, (SCU_MODE_INACT | SCU_MODE_FUNC2));                  /* P6,4 : UART0_TXD */
+       Chip_SCU_PinMuxSet(0x2, 1, (SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC1));/* P2.1 : UART0_RXD */
+   }
 }
 
 /* Initialize debug output via UART for board */
@@ -152,7 +157,9 @@ void Board_Init(void)
 
    /* Initialize LEDs */
    Board_LED_Init();
+#if BOARD_USE_ENET
    Chip_ENET_RMIIEnable(LPC_ETHERNET);
+#endif
 }
 
 void Board_I2C_Init(I2C_ID_T id)
@@ -185,6 +192,12 @@ void Board_SSP_Init(LPC_SSP_T *pSSP)
        Chip_SCU_PinMuxSet(0xF, 4, (SCU_PINIO_FAST | SCU_MODE_FUNC0));  /* PF.4 => SCK1 */
        Chip_SCU_PinMuxSet(0x1, 4, (SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC5)); /* P1.4 => MOSI1 */
        Chip_SCU_PinMuxSet(0x1, 3, (SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC5)); /* P1.3 => MISO1 */
+   } else if (pSSP == LPC_SSP0) {
+       /* The P1 SSP0 pins are taken by the buttons */
+       Chip_SCU_PinMuxSet(0x3, 6, (SCU_PINIO_FAST | SCU_MODE_FUNC2));  /* P3.6 => SSEL0 */
+       Chip_SCU_PinMuxSet(0x3, 3, (SCU_PINIO_FAST | SCU_MODE_FUNC2));  /* P3.3 => SCK0 */
+       Chip_SCU_PinMuxSet(0x3, 8, (SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC2)); /* P3.8 => MOSI0 */
+       Chip_SCU_PinMuxSet(0x3, 7, (SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC2)); /* P3.7 => MISO0 */
    } else {
        return;
    }
@@ -25,6 +25,7 @@
  */
 
 #include "board.h"
+#include "boottime.h"
 
 /* The System initialization code is called prior to the application and
    initializes the board for run-time operation. Board initialization
@@ -45,12 +46,20 @@ struct CLK_BASE_STATES {
 /* Initial base clock states are mostly on */
 STATIC const struct CLK_BASE_STATES InitClkStates[] = {
 
+#if BOARD_USE_ENET
    /* Ethernet Clock base */
    {CLK_BASE_PHY_TX, CLKIN_ENET_TX, true, false},
    {CLK_BASE_PHY_RX, CLKIN_ENET_TX, true, false},
+#else
+   /* Ethernet unused, its base clocks powered down */
+   {CLK_BASE_PHY_TX, CLKIN_IRC, true, true},
+   {CLK_BASE_PHY_RX, CLKIN_IRC, true, true},
+#endif
 
+#if BOARD_USE_USB0
    /* Clocks derived from dividers */
    {CLK_BASE_USB0, CLKIN_IDIVD, true, true}
+#endif
 };
 
 STATIC const PINMUX_GRP_T pinmuxing[] = {
@@ -77,6 +86,7 @@ STATIC const PINMUX_GRP_T pinmuxing[] = {
     {1, 2, (SCU_MODE_INBUFF_EN | SCU_MODE_INACT | SCU_MODE_FUNC0)},
     {1, 6, (SCU_MODE_INBUFF_EN | SCU_MODE_INACT | SCU_MODE_FUNC0)},
 
+#if BOARD_USE_ENET
    /* ENET Pin mux (RMII Pins) */
    {1, 15, (SCU_MODE_HIGHSPEEDSLEW_EN | SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC3)}, /* RXD0 */
    {1, 16, (SCU_MODE_HIGHSPEEDSLEW_EN | SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC7)}, /* CRS_DV */
@@ -87,6 +97,7 @@ STATIC const PINMUX_GRP_T pinmuxing[] = {
    {7,  7, (SCU_MODE_HIGHSPEEDSLEW_EN | SCU_MODE_INACT | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC6)}, /* MDC */
    {0,  0, (SCU_MODE_HIGHSPEEDSLEW_EN | SCU_MODE_INACT | SCU_MODE_INBUFF_EN | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC2)},  /* RXD1 */
    {0,  1, (SCU_MODE_HIGHSPEEDSLEW_EN | SCU_MODE_INACT | SCU_MODE_ZIF_DIS | SCU_MODE_FUNC6)}, /* TXEN */
+#endif
 };
 
 /*****************************************************************************
@@ -139,5 +150,7 @@ void Board_SystemInit(void)
       application and tools to clear memory and use scatter loading to
       external memory. */
    Board_SetupMuxing();
+   Boot_Mark(BOOT_MARK_MUX);
    Board_SetupClocking();
+   Boot_Mark(BOOT_MARK_CLOCK);
 }
@@ -58,6 +58,14 @@ extern "C" {
 extern void SystemInit(void);
 #endif
 
+#if defined (__USE_LPCOPEN)
+// Boot phase timestamps
+#include "boottime.h"
+#else
+#define Boot_Start()
+#define Boot_Mark(mark)
+#endif
+
 //*****************************************************************************
 //
 // Forward declaration of the default handlers. These are aliased.
@@ -263,22 +271,45 @@ void (* const g_pfnVectors[])(void) = {
 // are written as separate functions rather than being inlined within the
 // ResetISR() function in order to cope with MCUs with multiple banks of
 // memory.
+//
+// Both move four words per iteration, so that the compiler can use LDM/STM,
+// then finish word by word. Section lengths are multiples of 4.
 //*****************************************************************************
         __attribute__((section(".after_vectors"
 )))
 void data_init(unsigned int romstart, unsigned int start, unsigned int len) {
     unsigned int *pulDest = (unsigned int*) start;
     unsigned int *pulSrc = (unsigned int*) romstart;
-    unsigned int loop;
-    for (loop = 0; loop < len; loop = loop + 4)
+    unsigned int *pulEnd = pulDest + (len >> 2);
+    unsigned int w0, w1, w2, w3;
+    while (pulEnd - pulDest >= 4) {
+        w0 = pulSrc[0];
+        w1 = pulSrc[1];
+        w2 = pulSrc[2];
+        w3 = pulSrc[3];
+        pulDest[0] = w0;
+        pulDest[1] = w1;
+        pulDest[2] = w2;
+        pulDest[3] = w3;
+        pulDest += 4;
+        pulSrc += 4;
+    }
+    while (pulDest < pulEnd)
         *pulDest++ = *pulSrc++;
 }
 
 __attribute__ ((section(".after_vectors")))
 void bss_init(unsigned int start, unsigned int len) {
     unsigned int *pulDest = (unsigned int*) start;
-    unsigned int loop;
-    for (loop = 0; loop < len; loop = loop + 4)
+    unsigned int *pulEnd = pulDest + (len >> 2);
+    while (pulEnd - pulDest >= 4) {
+        pulDest[0] = 0;
+        pulDest[1] = 0;
+        pulDest[2] = 0;
+        pulDest[3] = 0;
+        pulDest += 4;
+    }
+    while (pulDest < pulEnd)
         *pulDest++ = 0;
 }
 
@@ -302,6 +333,9 @@ extern unsigned int __bss_section_table_end;
 //*****************************************************************************
 void ResetISR(void) {
 
+    // Count boot phases in cycles from here, see boottime.h
+    Boot_Start();
+
 // *************************************************************
 // The following conditional block of code manually resets as
 // much of the peripheral set of the LPC43 as possible. This is
@@ -372,6 +406,7 @@ void ResetISR(void) {
         SectionLen = *SectionTableAddr++;
         data_init(LoadAddr, ExeAddr, SectionLen);
     }
+    Boot_Mark(BOOT_MARK_DATA);
     // At this point, SectionTableAddr = &__bss_section_table;
     // Zero fill the bss segment
     while (SectionTableAddr < &__bss_section_table_end) {
@@ -379,6 +414,7 @@ void ResetISR(void) {
         SectionLen = *SectionTableAddr++;
         bss_init(ExeAddr, SectionLen);
     }
+    Boot_Mark(BOOT_MARK_BSS);
 
 #if !defined (__USE_LPCOPEN)
 // LPCOpen init code deals with FP and VTOR initialisation
@@ -69,6 +69,254 @@ typedef struct {                   /*!< MCPWM Structure        */
    __O  uint32_t  CAP_CLR;         /*!< Capture clear address  */
 } LPC_MCPWM_T;
 
+/*
+ * @brief MCPWM control register bit definitions, for CON/CON_SET/CON_CLR
+ */
+#define MCPWM_CON_RUN(ch)       ((uint32_t) (1 << ((ch) * 8)))       /*!< Channel counter runs */
+#define MCPWM_CON_CENTER(ch)    ((uint32_t) (1 << ((ch) * 8 + 1)))   /*!< Channel is center aligned */
+#define MCPWM_CON_POLA(ch)      ((uint32_t) (1 << ((ch) * 8 + 2)))   /*!< Channel passive state is high */
+#define MCPWM_CON_DTE(ch)       ((uint32_t) (1 << ((ch) * 8 + 3)))   /*!< Channel dead time enabled */
+#define MCPWM_CON_DISUP(ch)     ((uint32_t) (1 << ((ch) * 8 + 4)))   /*!< Channel LIM/MAT updates held off */
+#define MCPWM_CON_INVBDC        ((uint32_t) (1 << 29))  /*!< MCOB outputs not inverted in DC mode */
+#define MCPWM_CON_ACMODE        ((uint32_t) (1 << 30))  /*!< AC mode, all channels run from channel 0 */
+#define MCPWM_CON_DCMODE        ((uint32_t) (1 << 31))  /*!< DC mode, MCOA0 routed by the CCP register */
+
+/*
+ * @brief MCPWM channel mode flags for Chip_MCPWM_ConfigChannel()
+ */
+#define MCPWM_MODE_EDGE         ((uint32_t) 0)          /*!< Edge aligned, the counter resets at the limit */
+#define MCPWM_MODE_CENTER       MCPWM_CON_CENTER(0)     /*!< Center aligned, the counter counts up and down */
+#define MCPWM_MODE_POLA_HIGH    MCPWM_CON_POLA(0)       /*!< MCOA passive state is high */
+#define MCPWM_MODE_DEADTIME     MCPWM_CON_DTE(0)        /*!< Complementary MCOB with dead time */
+
+/*
+ * @brief MCPWM interrupt bit definitions, for INTEN/INTF and their set/clear addresses
+ */
+#define MCPWM_INT_ILIM(ch)      ((uint32_t) (1 << ((ch) * 4)))      /*!< Channel counter reached its limit */
+#define MCPWM_INT_IMAT(ch)      ((uint32_t) (1 << ((ch) * 4 + 1)))  /*!< Channel counter matched */
+#define MCPWM_INT_ICAP(ch)      ((uint32_t) (1 << ((ch) * 4 + 2)))  /*!< Channel capture */
+#define MCPWM_INT_ABORT         ((uint32_t) (1 << 15))              /*!< MCABORT input asserted */
+#define MCPWM_INT_BITMASK       ((uint32_t) 0x8777)
+
+/** Number of MCPWM channels */
+#define MCPWM_CHANNELS          3
+
+/** Largest dead time in MCPWM clock ticks */
+#define MCPWM_DT_MAX            0x3FF
+
+/**
+ * @brief  Initialize the MCPWM
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @return Nothing
+ * @note   Enables the MCPWM clock and resets the block. All channels are
+ *         stopped, edge aligned, with interrupts disabled.
+ */
+void Chip_MCPWM_Init(LPC_MCPWM_T *pMCPWM);
+
+/**
+ * @brief  De-initialize the MCPWM
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @return Nothing
+ */
+void Chip_MCPWM_DeInit(LPC_MCPWM_T *pMCPWM);
+
+/**
+ * @brief  Set the alignment, polarity and dead time mode of one channel
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  ch      : Channel, 0 to 2
+ * @param  mode    : Or'ed MCPWM_MODE_* values
+ * @return Nothing
+ * @note   The channel must be stopped.
+ */
+void Chip_MCPWM_ConfigChannel(LPC_MCPWM_T *pMCPWM, uint8_t ch, uint32_t mode);
+
+/**
+ * @brief  Set the PWM frequency of one channel
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  ch      : Channel, 0 to 2
+ * @param  freqHz  : PWM frequency in Hz
+ * @return The limit value written, the match value for 0% duty
+ * @note   Accounts for the up and down count of a center aligned channel,
+ *         so call it after Chip_MCPWM_ConfigChannel().
+ */
+uint32_t Chip_MCPWM_SetRate(LPC_MCPWM_T *pMCPWM, uint8_t ch, uint32_t freqHz);
+
+/**
+ * @brief  Set the dead time of one channel
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  ch      : Channel, 0 to 2
+ * @param  ticks   : Dead time in MCPWM clock ticks, 0 to MCPWM_DT_MAX
+ * @return Nothing
+ * @note   Only used when the channel has MCPWM_MODE_DEADTIME set.
+ */
+void Chip_MCPWM_SetDeadTime(LPC_MCPWM_T *pMCPWM, uint8_t ch, uint32_t ticks);
+
+/**
+ * @brief  Start channels
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  chMask  : Bit n set starts channel n
+ * @return Nothing
+ * @note   Channels started together run in phase.
+ */
+STATIC INLINE void Chip_MCPWM_Start(LPC_MCPWM_T *pMCPWM, uint8_t chMask)
+{
+   pMCPWM->CON_SET = ((chMask & 1) ? MCPWM_CON_RUN(0) : 0) |
+                     ((chMask & 2) ? MCPWM_CON_RUN(1) : 0) |
+                     ((chMask & 4) ? MCPWM_CON_RUN(2) : 0);
+}
+
+/**
+ * @brief  Stop channels
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  chMask  : Bit n set stops channel n
+ * @return Nothing
+ */
+STATIC INLINE void Chip_MCPWM_Stop(LPC_MCPWM_T *pMCPWM, uint8_t chMask)
+{
+   pMCPWM->CON_CLR = ((chMask & 1) ? MCPWM_CON_RUN(0) : 0) |
+                     ((chMask & 2) ? MCPWM_CON_RUN(1) : 0) |
+                     ((chMask & 4) ? MCPWM_CON_RUN(2) : 0);
+}
+
+/**
+ * @brief  Enable or disable AC mode
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  enable  : true to run all three channels from the channel 0 counter and limit
+ * @return Nothing
+ * @note   In AC mode only the match registers of channels 1 and 2 are used,
+ *         so the three outputs always share one period and one phase.
+ */
+STATIC INLINE void Chip_MCPWM_SetACMode(LPC_MCPWM_T *pMCPWM, bool enable)
+{
+   if (enable) {
+       pMCPWM->CON_SET = MCPWM_CON_ACMODE;
+   }
+   else {
+       pMCPWM->CON_CLR = MCPWM_CON_ACMODE;
+   }
+}
+
+/**
+ * @brief  Set the limit (period) of one channel
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  ch      : Channel, 0 to 2
+ * @param  limit   : Limit value
+ * @return Nothing
+ * @note   Takes effect at the end of the current PWM cycle.
+ */
+STATIC INLINE void Chip_MCPWM_SetLimit(LPC_MCPWM_T *pMCPWM, uint8_t ch, uint32_t limit)
+{
+   pMCPWM->LIM[ch] = limit;
+}
+
+/**
+ * @brief  Read the limit (period) of one channel
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  ch      : Channel, 0 to 2
+ * @return Limit value
+ */
+STATIC INLINE uint32_t Chip_MCPWM_GetLimit(LPC_MCPWM_T *pMCPWM, uint8_t ch)
+{
+   return pMCPWM->LIM[ch];
+}
+
+/**
+ * @brief  Set the match value of one channel
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  ch      : Channel, 0 to 2
+ * @param  match   : Match value, MCOA is active while the counter is above it
+ * @return Nothing
+ * @note   Takes effect at the end of the current PWM cycle.
+ */
+STATIC INLINE void Chip_MCPWM_SetMatch(LPC_MCPWM_T *pMCPWM, uint8_t ch, uint32_t match)
+{
+   pMCPWM->MAT[ch] = match;
+}
+
+/**
+ * @brief  Hold off the transfer of new limit and match values
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  chMask  : Bit n set holds channel n
+ * @return Nothing
+ * @note   Values written while held are transferred together at the first
+ *         cycle end after Chip_MCPWM_ReleaseUpdate().
+ */
+STATIC INLINE void Chip_MCPWM_HoldUpdate(LPC_MCPWM_T *pMCPWM, uint8_t chMask)
+{
+   pMCPWM->CON_SET = ((chMask & 1) ? MCPWM_CON_DISUP(0) : 0) |
+                     ((chMask & 2) ? MCPWM_CON_DISUP(1) : 0) |
+                     ((chMask & 4) ? MCPWM_CON_DISUP(2) : 0);
+}
+
+/**
+ * @brief  Release held limit and match updates
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  chMask  : Bit n set releases channel n
+ * @return Nothing
+ */
+STATIC INLINE void Chip_MCPWM_ReleaseUpdate(LPC_MCPWM_T *pMCPWM, uint8_t chMask)
+{
+   pMCPWM->CON_CLR = ((chMask & 1) ? MCPWM_CON_DISUP(0) : 0) |
+                     ((chMask & 2) ? MCPWM_CON_DISUP(1) : 0) |
+                     ((chMask & 4) ? MCPWM_CON_DISUP(2) : 0);
+}
+
+/**
+ * @brief  Read the counter of one channel
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  ch      : Channel, 0 to 2
+ * @return Counter value
+ */
+STATIC INLINE uint32_t Chip_MCPWM_GetCount(LPC_MCPWM_T *pMCPWM, uint8_t ch)
+{
+   return pMCPWM->TC[ch];
+}
+
+/**
+ * @brief  Enable interrupts
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  flags   : Or'ed MCPWM_INT_* values
+ * @return Nothing
+ */
+STATIC INLINE void Chip_MCPWM_IntEnable(LPC_MCPWM_T *pMCPWM, uint32_t flags)
+{
+   pMCPWM->INTEN_SET = flags;
+}
+
+/**
+ * @brief  Disable interrupts
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  flags   : Or'ed MCPWM_INT_* values
+ * @return Nothing
+ */
+STATIC INLINE void Chip_MCPWM_IntDisable(LPC_MCPWM_T *pMCPWM, uint32_t flags)
+{
+   pMCPWM->INTEN_CLR = flags;
+}
+
+/**
+ * @brief  Read the pending interrupt flags
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @return Or'ed MCPWM_INT_* values
+ */
+STATIC INLINE uint32_t Chip_MCPWM_GetIntStatus(LPC_MCPWM_T *pMCPWM)
+{
+   return pMCPWM->INTF;
+}
+
+/**
+ * @brief  Clear interrupt flags
+ * @param  pMCPWM  : The base of MCPWM peripheral on the chip
+ * @param  flags   : Or'ed MCPWM_INT_* values
+ * @return Nothing
+ * @note   Clearing MCPWM_INT_ABORT lets the outputs leave the passive
+ *         state, once the MCABORT input is no longer asserted.
+ */
+STATIC INLINE void Chip_MCPWM_ClearIntStatus(LPC_MCPWM_T *pMCPWM, uint32_t flags)
+{
+   pMCPWM->INTF_CLR = flags;
+}
+
 /**
  * @}
  */
@@ -75,6 +75,239 @@ typedef struct {               /*!< QEI Structure          */
    __O  uint32_t  SET;         /*!< Interrupt status set register */
 } LPC_QEI_T;
 
+/*
+ * @brief QEI control register bit definitions
+ */
+#define QEI_CON_RESP        ((uint32_t) (1 << 0))   /*!< Reset position counter */
+#define QEI_CON_RESPI       ((uint32_t) (1 << 1))   /*!< Reset position counter on index */
+#define QEI_CON_RESV        ((uint32_t) (1 << 2))   /*!< Reset velocity */
+#define QEI_CON_RESI        ((uint32_t) (1 << 3))   /*!< Reset index counter */
+
+/*
+ * @brief QEI configuration register bit definitions
+ */
+#define QEI_CONF_DIRINV     ((uint32_t) (1 << 0))   /*!< Invert direction */
+#define QEI_CONF_SIGMODE    ((uint32_t) (1 << 1))   /*!< PhA is clock, PhB is direction */
+#define QEI_CONF_CAPMODE    ((uint32_t) (1 << 2))   /*!< Count both edges of both phases (4x) */
+#define QEI_CONF_INVINX     ((uint32_t) (1 << 3))   /*!< Invert index */
+#define QEI_CONF_CRESPI     ((uint32_t) (1 << 4))   /*!< Continuous position reset on index */
+#define QEI_CONF_INXGATE(n) ((uint32_t) (((n) & 0xF) << 16))   /*!< Index gating, phase states accepted */
+
+/*
+ * @brief QEI status register bit definitions
+ */
+#define QEI_STAT_DIR        ((uint32_t) (1 << 0))   /*!< Direction bit */
+
+/*
+ * @brief QEI interrupt bit definitions, for IEC/IES/INTSTAT/IE/CLR/SET
+ */
+#define QEI_INT_INX         ((uint32_t) (1 << 0))   /*!< Index pulse detected */
+#define QEI_INT_TIM         ((uint32_t) (1 << 1))   /*!< Velocity timer overflow */
+#define QEI_INT_VELC        ((uint32_t) (1 << 2))   /*!< Captured velocity below the compare value */
+#define QEI_INT_DIR         ((uint32_t) (1 << 3))   /*!< Direction change */
+#define QEI_INT_ERR         ((uint32_t) (1 << 4))   /*!< Encoder phase error */
+#define QEI_INT_ENCLK       ((uint32_t) (1 << 5))   /*!< Encoder clock pulse */
+#define QEI_INT_POS0        ((uint32_t) (1 << 6))   /*!< Position 0 compare match */
+#define QEI_INT_POS1        ((uint32_t) (1 << 7))   /*!< Position 1 compare match */
+#define QEI_INT_POS2        ((uint32_t) (1 << 8))   /*!< Position 2 compare match */
+#define QEI_INT_REV0        ((uint32_t) (1 << 9))   /*!< Index count 0 compare match */
+#define QEI_INT_POS0REV     ((uint32_t) (1 << 10))  /*!< Position 0 and revolution count match */
+#define QEI_INT_POS1REV     ((uint32_t) (1 << 11))  /*!< Position 1 and revolution count match */
+#define QEI_INT_POS2REV     ((uint32_t) (1 << 12))  /*!< Position 2 and revolution count match */
+#define QEI_INT_REV1        ((uint32_t) (1 << 13))  /*!< Index count 1 compare match */
+#define QEI_INT_REV2        ((uint32_t) (1 << 14))  /*!< Index count 2 compare match */
+#define QEI_INT_MAXPOS      ((uint32_t) (1 << 15))  /*!< Position counter wrapped at MAXPOS */
+#define QEI_INT_BITMASK     ((uint32_t) 0xFFFF)
+
+/**
+ * @brief  Initialize the QEI
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @return Nothing
+ * @note   Enables the QEI clock, resets the counters and sets 4x
+ *         quadrature mode with all interrupts disabled.
+ */
+void Chip_QEI_Init(LPC_QEI_T *pQEI);
+
+/**
+ * @brief  De-initialize the QEI
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @return Nothing
+ */
+void Chip_QEI_DeInit(LPC_QEI_T *pQEI);
+
+/**
+ * @brief  Reset QEI counters
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  flags   : One or more QEI_CON_* values
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_Reset(LPC_QEI_T *pQEI, uint32_t flags)
+{
+   pQEI->CON = flags;
+}
+
+/**
+ * @brief  Set the QEI configuration
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  conf    : Or'ed QEI_CONF_* values
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_SetConfig(LPC_QEI_T *pQEI, uint32_t conf)
+{
+   pQEI->CONF = conf;
+}
+
+/**
+ * @brief  Read the current direction
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @return true when counting down (reverse), false when counting up
+ */
+STATIC INLINE bool Chip_QEI_GetDirection(LPC_QEI_T *pQEI)
+{
+   return (pQEI->STAT & QEI_STAT_DIR) != 0;
+}
+
+/**
+ * @brief  Read the position counter
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @return Position, 0 to MAXPOS
+ */
+STATIC INLINE uint32_t Chip_QEI_GetPosition(LPC_QEI_T *pQEI)
+{
+   return pQEI->POS;
+}
+
+/**
+ * @brief  Set the position counter wrap value
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  maxPos  : Largest position before the counter wraps to 0
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_SetMaxPosition(LPC_QEI_T *pQEI, uint32_t maxPos)
+{
+   pQEI->MAXPOS = maxPos;
+}
+
+/**
+ * @brief  Set a position compare value
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  n       : Compare register, 0 to 2
+ * @param  pos     : Position to compare against
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_SetPositionCompare(LPC_QEI_T *pQEI, uint8_t n, uint32_t pos)
+{
+   (&pQEI->CMPOS0)[n] = pos;
+}
+
+/**
+ * @brief  Read the index counter
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @return Number of index pulses seen
+ */
+STATIC INLINE uint32_t Chip_QEI_GetIndexCount(LPC_QEI_T *pQEI)
+{
+   return pQEI->INXCNT;
+}
+
+/**
+ * @brief  Set the velocity timer reload value
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  load    : Velocity period in QEI clock cycles, minus 1
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_SetVelocityReload(LPC_QEI_T *pQEI, uint32_t load)
+{
+   pQEI->LOAD = load;
+}
+
+/**
+ * @brief  Set the velocity timer period
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  periodUs: Velocity measurement period in microseconds
+ * @return Nothing
+ */
+void Chip_QEI_SetVelocityPeriod(LPC_QEI_T *pQEI, uint32_t periodUs);
+
+/**
+ * @brief  Read the velocity capture register
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @return Encoder pulses counted during the last velocity period
+ */
+STATIC INLINE uint32_t Chip_QEI_GetVelocityCapture(LPC_QEI_T *pQEI)
+{
+   return pQEI->CAP;
+}
+
+/**
+ * @brief  Set the velocity compare value used by QEI_INT_VELC
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  cmp     : Pulses per velocity period
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_SetVelocityCompare(LPC_QEI_T *pQEI, uint32_t cmp)
+{
+   pQEI->VELCOMP = cmp;
+}
+
+/**
+ * @brief  Set the digital input filters
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  phA     : Phase A filter, QEI clock cycles a level must be stable
+ * @param  phB     : Phase B filter
+ * @param  inx     : Index filter
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_SetFilters(LPC_QEI_T *pQEI, uint32_t phA, uint32_t phB, uint32_t inx)
+{
+   pQEI->FILTERPHA = phA;
+   pQEI->FILTERPHB = phB;
+   pQEI->FILTERINX = inx;
+}
+
+/**
+ * @brief  Enable QEI interrupts
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  flags   : Or'ed QEI_INT_* values
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_IntEnable(LPC_QEI_T *pQEI, uint32_t flags)
+{
+   pQEI->IES = flags;
+}
+
+/**
+ * @brief  Disable QEI interrupts
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  flags   : Or'ed QEI_INT_* values
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_IntDisable(LPC_QEI_T *pQEI, uint32_t flags)
+{
+   pQEI->IEC = flags;
+}
+
+/**
+ * @brief  Read the pending and enabled QEI interrupts
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @return Or'ed QEI_INT_* values
+ */
+STATIC INLINE uint32_t Chip_QEI_GetIntStatus(LPC_QEI_T *pQEI)
+{
+   return pQEI->INTSTAT & pQEI->IE;
+}
+
+/**
+ * @brief  Clear pending QEI interrupts
+ * @param  pQEI    : The base of QEI peripheral on the chip
+ * @param  flags   : Or'ed QEI_INT_* values
+ * @return Nothing
+ */
+STATIC INLINE void Chip_QEI_ClearIntStatus(LPC_QEI_T *pQEI, uint32_t flags)
+{
+   pQEI->CLR = flags;
+}
+
 /**
  * @}
  */
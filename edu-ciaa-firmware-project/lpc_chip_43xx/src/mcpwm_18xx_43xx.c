@@ -0,0 +1,81 @@
+/*
+ * @brief LPC18xx/43xx Motor Control PWM driver
+ */
+
+#include "chip.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Initialize the MCPWM */
+void Chip_MCPWM_Init(LPC_MCPWM_T *pMCPWM)
+{
+   uint8_t ch;
+
+   Chip_Clock_Enable(CLK_APB1_MOTOCON);
+   Chip_RGU_TriggerReset(RGU_MOTOCONPWM_RST);
+   while (Chip_RGU_InReset(RGU_MOTOCONPWM_RST)) {}
+
+   pMCPWM->INTEN_CLR = MCPWM_INT_BITMASK;
+   pMCPWM->INTF_CLR = MCPWM_INT_BITMASK;
+   pMCPWM->CON_CLR = 0xFFFFFFFF;
+   pMCPWM->CAPCON_CLR = 0xFFFFFFFF;
+   pMCPWM->CNTCON_CLR = 0xFFFFFFFF;
+   pMCPWM->DT = 0;
+   for (ch = 0; ch < MCPWM_CHANNELS; ch++) {
+       pMCPWM->TC[ch] = 0;
+   }
+}
+
+/* De-initialize the MCPWM */
+void Chip_MCPWM_DeInit(LPC_MCPWM_T *pMCPWM)
+{
+   pMCPWM->INTEN_CLR = MCPWM_INT_BITMASK;
+   pMCPWM->CON_CLR = MCPWM_CON_RUN(0) | MCPWM_CON_RUN(1) | MCPWM_CON_RUN(2);
+   Chip_Clock_Disable(CLK_APB1_MOTOCON);
+}
+
+/* Set the alignment, polarity and dead time mode of one channel */
+void Chip_MCPWM_ConfigChannel(LPC_MCPWM_T *pMCPWM, uint8_t ch, uint32_t mode)
+{
+   uint32_t mask = MCPWM_MODE_CENTER | MCPWM_MODE_POLA_HIGH | MCPWM_MODE_DEADTIME;
+
+   pMCPWM->CON_CLR = mask << (ch * 8);
+   pMCPWM->CON_SET = (mode & mask) << (ch * 8);
+}
+
+/* Set the PWM frequency of one channel */
+uint32_t Chip_MCPWM_SetRate(LPC_MCPWM_T *pMCPWM, uint8_t ch, uint32_t freqHz)
+{
+   uint32_t limit = Chip_Clock_GetRate(CLK_APB1_MOTOCON) / freqHz;
+
+   /* A center aligned period counts up to the limit and back down */
+   if (pMCPWM->CON & MCPWM_CON_CENTER(ch)) {
+       limit /= 2;
+   }
+
+   pMCPWM->LIM[ch] = limit;
+   return limit;
+}
+
+/* Set the dead time of one channel */
+void Chip_MCPWM_SetDeadTime(LPC_MCPWM_T *pMCPWM, uint8_t ch, uint32_t ticks)
+{
+   uint32_t shift = ch * 10;
+
+   ticks = MIN(ticks, MCPWM_DT_MAX);
+   pMCPWM->DT = (pMCPWM->DT & ~(MCPWM_DT_MAX << shift)) | (ticks << shift);
+}
@@ -0,0 +1,52 @@
+/*
+ * @brief LPC18xx/43xx QEI chip driver
+ */
+
+#include "chip.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Initialize the QEI */
+void Chip_QEI_Init(LPC_QEI_T *pQEI)
+{
+   Chip_Clock_Enable(CLK_MX_QEI);
+
+   pQEI->IEC = QEI_INT_BITMASK;
+   pQEI->CLR = QEI_INT_BITMASK;
+   pQEI->CONF = QEI_CONF_CAPMODE;
+   pQEI->MAXPOS = 0xFFFFFFFF;
+   pQEI->FILTERPHA = 0;
+   pQEI->FILTERPHB = 0;
+   pQEI->FILTERINX = 0;
+   pQEI->CON = QEI_CON_RESP | QEI_CON_RESV | QEI_CON_RESI;
+}
+
+/* De-initialize the QEI */
+void Chip_QEI_DeInit(LPC_QEI_T *pQEI)
+{
+   pQEI->IEC = QEI_INT_BITMASK;
+   Chip_Clock_Disable(CLK_MX_QEI);
+}
+
+/* Set the velocity timer period */
+void Chip_QEI_SetVelocityPeriod(LPC_QEI_T *pQEI, uint32_t periodUs)
+{
+   uint64_t cycles = ((uint64_t) Chip_Clock_GetRate(CLK_MX_QEI) * periodUs) / 1000000;
+
+   pQEI->LOAD = (cycles > 0) ? (uint32_t) cycles - 1 : 0;
+   pQEI->CON = QEI_CON_RESV;
+}
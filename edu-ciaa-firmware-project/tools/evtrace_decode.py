@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+Event trace decoder: "TR:" dump lines to a Chrome trace
+
+Reads a capture of the link that contains the reply to STRE (other lines
+are ignored) and writes a JSON timeline for chrome://tracing or
+ui.perfetto.dev. Event names and phases come from EVTRACE_EVENTS() in
+app/inc/evtrace.h, interrupt names from cmsis_43xx.h, so the decoder
+follows the firmware it was built with.
+
+    python3 tools/evtrace_decode.py capture.txt -o trace.json
+
+Each exception number becomes one track: thread mode, SysTick and one per
+interrupt. Cycle counts are unwrapped assuming consecutive records are
+less than 2^32 cycles apart (21 s at 204 MHz).
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+EVTRACE_H = os.path.join(ROOT, "app", "inc", "evtrace.h")
+CMSIS_H = os.path.join(ROOT, "lpc_chip_43xx", "inc", "cmsis_43xx.h")
+
+EVENT_RE = re.compile(r"X\(\s*(\w+)\s*,\s*\"([^\"]+)\"\s*,\s*'(\w)'\s*\)")
+IRQ_RE = re.compile(r"^\s*(\w+)_IRQn\s*=\s*(-?\d+)\s*,", re.MULTILINE)
+
+
+def load_events(path):
+    """Event table in enum order: list of (identifier, name, phase)"""
+    with open(path) as f:
+        text = f.read()
+    start = text.index("#define EVTRACE_EVENTS(X)")
+    end = text.index("\n\n", start)
+    return EVENT_RE.findall(text[start:end])
+
+
+def load_vectors(path):
+    """Exception number to interrupt name"""
+    names = {0: "thread"}
+    try:
+        with open(path) as f:
+            for name, irqn in IRQ_RE.findall(f.read()):
+                names[int(irqn) + 16] = name
+    except OSError:
+        pass
+    return names
+
+
+def parse_dump(lines):
+    """Header fields and records from the last complete dump in the capture"""
+    header = None
+    records = []
+    for line in lines:
+        pos = line.find("TR:")
+        if pos < 0:
+            continue
+        body = line[pos + 3:].strip()
+        if ":" not in body:
+            fields = [int(v) for v in body.split(",")]
+            header = dict(zip(("boots", "clock_hz", "total", "records", "flags"), fields))
+            records = []
+            continue
+        if header is None:
+            continue
+        first, recs = body.split(":", 1)
+        if int(first) != len(records):
+            sys.stderr.write("warning: records %d to %s missing\n" % (len(records), first))
+            continue
+        for rec in recs.split(","):
+            records.append((int(rec[0:8], 16), int(rec[8:10], 16),
+                            int(rec[10:12], 16), int(rec[12:16], 16)))
+    if header is None:
+        raise SystemExit("no TR: dump found")
+    return header, records
+
+
+def to_chrome(header, records, events, vectors):
+    """Chrome trace event list"""
+    us_per_cycle = 1e6 / header["clock_hz"]
+    out = []
+    open_spans = {}
+    tracks = set()
+    now = 0
+    prev = records[0][0] if records else 0
+
+    for cycles, ctx, evid, arg in records:
+        now += (cycles - prev) & 0xFFFFFFFF
+        prev = cycles
+        if evid >= len(events):
+            sys.stderr.write("warning: unknown event %d\n" % evid)
+            continue
+        ident, name, phase = events[evid]
+        ts = now * us_per_cycle
+        ev = {"name": name, "ph": phase, "ts": ts, "pid": 1, "tid": ctx}
+
+        if phase == "B":
+            open_spans[ctx] = open_spans.get(ctx, 0) + 1
+            ev["args"] = {"arg": arg}
+        elif phase == "E":
+            # The oldest records may end spans that began before the ring start
+            if open_spans.get(ctx, 0) == 0:
+                continue
+            open_spans[ctx] -= 1
+            ev["args"] = {"arg": arg}
+        elif phase == "C":
+            ev["args"] = {name: arg - 0x10000 if arg & 0x8000 else arg}
+            ev["tid"] = 0
+        else:
+            ev["s"] = "t"
+            ev["args"] = {"arg": arg, "event": ident}
+        tracks.add(ev["tid"])
+        out.append(ev)
+
+    meta = [{"name": "process_name", "ph": "M", "pid": 1,
+             "args": {"name": "edu-ciaa (boot %d)" % header["boots"]}}]
+    for tid in sorted(tracks):
+        meta.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid,
+                     "args": {"name": vectors.get(tid, "vector %d" % tid)}})
+        meta.append({"name": "thread_sort_index", "ph": "M", "pid": 1, "tid": tid,
+                     "args": {"sort_index": tid}})
+    return meta + out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("capture", nargs="?", help="link capture, stdin when omitted")
+    ap.add_argument("-o", "--output", help="JSON output, stdout when omitted")
+    ap.add_argument("--events", default=EVTRACE_H, help="evtrace.h with the event list")
+    ap.add_argument("--cmsis", default=CMSIS_H, help="cmsis_43xx.h with the IRQ numbers")
+    opts = ap.parse_args()
+
+    src = open(opts.capture, errors="replace") if opts.capture else sys.stdin
+    with src:
+        header, records = parse_dump(src)
+
+    expected = min(header["total"], header["records"])
+    if len(records) != expected:
+        sys.stderr.write("warning: %d of %d records\n" % (len(records), expected))
+
+    trace = {
+        "traceEvents": to_chrome(header, records, load_events(opts.events),
+                                 load_vectors(opts.cmsis)),
+        "displayTimeUnit": "ns",
+        "otherData": {k: str(v) for k, v in header.items()},
+    }
+
+    dst = open(opts.output, "w") if opts.output else sys.stdout
+    with dst:
+        json.dump(trace, dst, indent=1)
+        dst.write("\n")
+
+
+if __name__ == "__main__":
+    main()
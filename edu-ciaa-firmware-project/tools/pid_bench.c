@@ -0,0 +1,193 @@
+/*
+ * @brief Host check and benchmark for the float and Q15 PID controllers
+ *
+ * A double precision copy of the PID algorithm closes the loop around a
+ * first order motor model (output -255..255, speed in encoder counts per
+ * second) through a sequence of setpoint steps, including reversals that
+ * saturate the output. The measurements it produces are rounded to whole
+ * counts and replayed into Pid_F32_Update() and Pid_Q15_Update(). Each
+ * output is compared against the double precision output for the same
+ * inputs, and the program fails when the error goes above the tolerance
+ * of that version.
+ *
+ * It then times two wheel loops plus a heading loop per tick, the load of
+ * the drive control task, for both versions.
+ *
+ * Build and run from edu-ciaa-firmware-project:
+ *   gcc -O2 -Iapp/inc -Ilpc_chip_43xx/inc tools/pid_bench.c app/src/pid.c -lm -o pid_bench
+ *   ./pid_bench [ticks]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pid.h"
+
+#define RATE_HZ         1000.0
+#define PLANT_GAIN      16.0            /* Counts per second per output step */
+#define PLANT_TAU       0.08            /* Seconds */
+#define STEP_TICKS      1500
+#define TOL_F32         0.01
+#define TOL_Q15         1.0
+
+static const PID_CFG_T cfg = {
+   .kp = 0.12f, .ki = 2.5f, .kd = 0.0004f, .kff = 0.06f,
+   .dFilterHz = 100.0f, .outMin = -255.0f, .outMax = 255.0f, .rateHz = (float) RATE_HZ,
+};
+
+static const double steps[] = {0.0, 2000.0, 3500.0, -3000.0, 500.0, 0.0, 4800.0, -4800.0};
+
+#define NSTEPS          (sizeof(steps) / sizeof(steps[0]))
+#define NTICKS          (NSTEPS * STEP_TICKS)
+
+/* Double precision reference with the same structure as Pid_F32_Update() */
+typedef struct {
+   double kp, ki, kd, kff, alpha, outMin, outMax;
+   double integ, dFilt, prevMeas;
+   int primed;
+} REF_PID_T;
+
+static int16_t meas[NTICKS], setp[NTICKS];
+static double golden[NTICKS];
+
+static void refInit(REF_PID_T *p)
+{
+   double w = 2.0 * M_PI * cfg.dFilterHz / RATE_HZ;
+
+   p->kp = cfg.kp;
+   p->ki = cfg.ki / RATE_HZ;
+   p->kd = cfg.kd * RATE_HZ;
+   p->kff = cfg.kff;
+   p->alpha = w / (1.0 + w);
+   p->outMin = cfg.outMin;
+   p->outMax = cfg.outMax;
+   p->integ = p->dFilt = p->prevMeas = 0.0;
+   p->primed = 0;
+}
+
+static double refUpdate(REF_PID_T *p, double sp, double m)
+{
+   double e = sp - m;
+   double d = p->primed ? (p->prevMeas - m) * p->kd : 0.0;
+   double integ, out;
+
+   p->prevMeas = m;
+   p->primed = 1;
+   p->dFilt += p->alpha * (d - p->dFilt);
+   integ = fmin(fmax(p->integ + p->ki * e, p->outMin), p->outMax);
+   out = p->kp * e + integ + p->dFilt + p->kff * sp;
+   if (out > p->outMax) {
+       out = p->outMax;
+       if (e > 0.0) {
+           integ = p->integ;
+       }
+   }
+   else if (out < p->outMin) {
+       out = p->outMin;
+       if (e < 0.0) {
+           integ = p->integ;
+       }
+   }
+   p->integ = integ;
+   return out;
+}
+
+/* Close the loop with the reference and record its inputs and outputs */
+static void record(void)
+{
+   REF_PID_T ref;
+   double v = 0.0, u;
+   size_t i;
+
+   refInit(&ref);
+   for (i = 0; i < NTICKS; i++) {
+       setp[i] = (int16_t) steps[i / STEP_TICKS];
+       meas[i] = (int16_t) lrint(v);
+       u = refUpdate(&ref, setp[i], meas[i]);
+       golden[i] = u;
+       v += (PLANT_GAIN * u - v) / (PLANT_TAU * RATE_HZ);
+   }
+}
+
+/* Replay the recorded inputs through both versions */
+static int check(void)
+{
+   PID_F32_T pf;
+   PID_Q15_T pq;
+   double errF = 0.0, errQ = 0.0, sat = 0.0;
+   size_t i;
+
+   if (Pid_F32_Init(&pf, &cfg) != SUCCESS || Pid_Q15_Init(&pq, &cfg) != SUCCESS) {
+       printf("init failed\n");
+       return 1;
+   }
+
+   for (i = 0; i < NTICKS; i++) {
+       errF = fmax(errF, fabs(Pid_F32_Update(&pf, setp[i], meas[i]) - golden[i]));
+       errQ = fmax(errQ, fabs(Pid_Q15_Update(&pq, setp[i], meas[i]) - golden[i]));
+       sat += (fabs(golden[i]) >= cfg.outMax);
+   }
+
+   printf("%zu ticks, %.0f saturated, Q15 gain shift %u\n", (size_t) NTICKS, sat, pq.shift);
+   printf("float max error %.5f (limit %.2f) %s\n", errF, TOL_F32, errF <= TOL_F32 ? "ok" : "FAIL");
+   printf("Q15   max error %.5f (limit %.2f) %s\n", errQ, TOL_Q15, errQ <= TOL_Q15 ? "ok" : "FAIL");
+   return (errF > TOL_F32 || errQ > TOL_Q15);
+}
+
+static double nowSeconds(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Time three controller updates per tick */
+static void bench(size_t ticks)
+{
+   PID_F32_T pf[3];
+   PID_Q15_T pq[3];
+   volatile float sinkF = 0.0f;
+   volatile int32_t sinkQ = 0;
+   double t0, tf, tq;
+   size_t i, k;
+
+   for (k = 0; k < 3; k++) {
+       Pid_F32_Init(&pf[k], &cfg);
+       Pid_Q15_Init(&pq[k], &cfg);
+   }
+
+   t0 = nowSeconds();
+   for (i = 0; i < ticks; i++) {
+       k = i % NTICKS;
+       sinkF += Pid_F32_Update(&pf[0], setp[k], meas[k]);
+       sinkF += Pid_F32_Update(&pf[1], setp[k], meas[NTICKS - 1 - k]);
+       sinkF += Pid_F32_Update(&pf[2], 0.0f, (float) (meas[k] - meas[NTICKS - 1 - k]));
+   }
+   tf = nowSeconds() - t0;
+
+   t0 = nowSeconds();
+   for (i = 0; i < ticks; i++) {
+       k = i % NTICKS;
+       sinkQ += Pid_Q15_Update(&pq[0], setp[k], meas[k]);
+       sinkQ += Pid_Q15_Update(&pq[1], setp[k], meas[NTICKS - 1 - k]);
+       sinkQ += Pid_Q15_Update(&pq[2], 0, (int16_t) (meas[k] - meas[NTICKS - 1 - k]));
+   }
+   tq = nowSeconds() - t0;
+
+   printf("float %7.1f ns per tick (3 loops)\n", tf / ticks * 1e9);
+   printf("Q15   %7.1f ns per tick (3 loops)\n", tq / ticks * 1e9);
+}
+
+int main(int argc, char **argv)
+{
+   size_t ticks = (argc > 1) ? (size_t) atol(argv[1]) : 10000000;
+   int fail;
+
+   record();
+   fail = check();
+   bench(ticks);
+
+   return fail;
+}
@@ -0,0 +1,266 @@
+/*
+ * @brief Host check and benchmark for the S<CMD>:<PARAMS>E parser
+ *
+ * A set of captured byte streams is replayed through Proto_ParseByte():
+ * frames split across reads, corrupted frames (bad command letters, bad
+ * or out of range parameters, unterminated and over-long frames, a new
+ * start character in the middle of a frame) and back-to-back frames with
+ * and without noise between them. Every stream is fed once in a single
+ * pass and once through a ring buffer in reads of 1 to 7 bytes, the way
+ * the UART receive path hands them over. The commands that reach the
+ * handlers and the parser statistics must match the expected ones.
+ *
+ * It then times the parser over a stream of back-to-back valid frames
+ * with a corrupted frame mixed in every few frames.
+ *
+ * Build and run from edu-ciaa-firmware-project:
+ *   gcc -O2 -DEVTRACE_ENABLE=0 -Iapp/inc -Ilpc_chip_43xx/inc tools/proto_bench.c \
+ *       app/src/protocol.c lpc_chip_43xx/src/ring_buffer.c -o proto_bench
+ *   ./proto_bench [megabytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "protocol.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()  __rdtsc()
+#endif
+
+#define RING_SIZE       256             /* Same as the link buffers */
+#define MAX_CMDS        8               /* Commands expected per stream */
+#define NOMINAL_HZ      3.0e9           /* Cycle estimate without a TSC */
+
+/* Command as written in the expectation table */
+typedef struct {
+   PROTO_CMD_ID_T id;
+   uint8_t nparams;
+   int16_t p0, p1;
+} EXP_CMD_T;
+
+/* Captured stream and what the parser must make of it */
+typedef struct {
+   const char *name;
+   const char *stream;
+   uint32_t frames, cmdErrors, paramErrors, dropped;
+   uint8_t ncmds;
+   EXP_CMD_T cmds[MAX_CMDS];
+} CASE_T;
+
+static const CASE_T cases[] = {
+   {"single move", "SMV:255,-255E", 1, 0, 0, 0,
+    1, {{PROTO_CMD_MV, 2, 255, -255}}},
+   {"all commands", "SSTESGTESPFESIQESTRESTAESBTESMV:0,0E", 8, 0, 0, 0,
+    8, {{PROTO_CMD_ST}, {PROTO_CMD_GT}, {PROTO_CMD_PF}, {PROTO_CMD_IQ},
+        {PROTO_CMD_TR}, {PROTO_CMD_TA}, {PROTO_CMD_BT}, {PROTO_CMD_MV, 2, 0, 0}}},
+   {"noise between frames", "\r\nok\r\nSMV:12,34E\r\n\x7f\xffSSTE\n", 2, 0, 0, 0,
+    2, {{PROTO_CMD_MV, 2, 12, 34}, {PROTO_CMD_ST}}},
+   {"unknown command", "SXY:1,2ESZZESGTE", 1, 2, 0, 0,
+    1, {{PROTO_CMD_GT}}},
+   {"bad command letters", "Sm1ES1VESMV:1,1E", 1, 0, 0, 2,
+    1, {{PROTO_CMD_MV, 2, 1, 1}}},
+   {"missing separator", "SMV1,2ESSTE", 1, 0, 0, 1,
+    1, {{PROTO_CMD_ST}}},
+   {"parameter count", "SMV:1ESMV:1,2,3ESST:5E", 0, 0, 3, 0, 0},
+   {"parameter range", "SMV:256,0ESMV:0,-256ESMV:99999,0ESMV:123456,0E", 0, 0, 4, 0, 0},
+   {"parameter syntax", "SMV:-E SMV:1,E SMV:,1E SMV:1x,2E SMV:--1,2E SMV:+1,2E", 0, 0, 6, 0, 0},
+   {"restart inside frame", "SMV:100,SMV:-100,-100ESMV:5SGTE", 2, 0, 0, 2,
+    2, {{PROTO_CMD_MV, 2, -100, -100}, {PROTO_CMD_GT}}},
+   {"unterminated frame", "SMV:1,2SST", 0, 0, 0, 1, 0},
+   {"over-long frame", "SMV:1,2                                ESSTE", 1, 0, 0, 1,
+    1, {{PROTO_CMD_ST}}},
+   {"back-to-back moves", "SMV:255,255ESMV:-255,-255ESMV:7,-7ESMV:-0,00042E", 4, 0, 0, 0,
+    4, {{PROTO_CMD_MV, 2, 255, 255}, {PROTO_CMD_MV, 2, -255, -255},
+        {PROTO_CMD_MV, 2, 7, -7}, {PROTO_CMD_MV, 2, 0, 42}}},
+};
+
+#define NCASES          (sizeof(cases) / sizeof(cases[0]))
+
+/* Commands seen by the handlers */
+typedef struct {
+   uint32_t count;
+   PROTO_CMD_T cmds[MAX_CMDS];
+   uint32_t sum;
+} LOG_T;
+
+static PROTO_STATUS_T onCmd(const PROTO_CMD_T *cmd, void *ctx)
+{
+   LOG_T *log = (LOG_T *) ctx;
+
+   if (log->count < MAX_CMDS) {
+       log->cmds[log->count] = *cmd;
+   }
+   log->count++;
+   log->sum += cmd->id + (cmd->nparams ? (uint16_t) cmd->params[0] : 0);
+   return PROTO_STATUS_OK;
+}
+
+static const PROTO_HANDLER_T handlers[PROTO_CMD_COUNT] = {
+   onCmd, onCmd, onCmd, onCmd, onCmd, onCmd, onCmd, onCmd,
+};
+
+/* Compare what the parser produced with the expectation */
+static int verify(const CASE_T *c, const char *how, const PROTO_PARSER_T *pParser, const LOG_T *log)
+{
+   const PROTO_STATS_T *st = Proto_GetStats(pParser);
+   const EXP_CMD_T *e;
+   const PROTO_CMD_T *got;
+   uint32_t i;
+
+   if (st->frames != c->frames || st->cmdErrors != c->cmdErrors ||
+       st->paramErrors != c->paramErrors || st->dropped != c->dropped) {
+       printf("FAIL %s (%s): stats ok %u cmd %u params %u dropped %u, expected %u %u %u %u\n",
+              c->name, how, st->frames, st->cmdErrors, st->paramErrors, st->dropped,
+              c->frames, c->cmdErrors, c->paramErrors, c->dropped);
+       return 1;
+   }
+   if (log->count != c->ncmds) {
+       printf("FAIL %s (%s): %u commands, expected %u\n", c->name, how, log->count, c->ncmds);
+       return 1;
+   }
+   for (i = 0; i < c->ncmds; i++) {
+       e = &c->cmds[i];
+       got = &log->cmds[i];
+       if (got->id != e->id || got->nparams != e->nparams ||
+           (e->nparams > 0 && got->params[0] != e->p0) ||
+           (e->nparams > 1 && got->params[1] != e->p1)) {
+           printf("FAIL %s (%s): command %u is %d/%u (%d,%d), expected %d/%u (%d,%d)\n",
+                  c->name, how, i, got->id, got->nparams, got->params[0], got->params[1],
+                  e->id, e->nparams, e->p0, e->p1);
+           return 1;
+       }
+   }
+   return 0;
+}
+
+/* Feed a stream byte by byte in a single pass */
+static int runDirect(const CASE_T *c)
+{
+   PROTO_PARSER_T parser;
+   LOG_T log = {0};
+   size_t i, n = strlen(c->stream);
+
+   Proto_Init(&parser, handlers, &log);
+   for (i = 0; i < n; i++) {
+       Proto_ParseByte(&parser, (uint8_t) c->stream[i]);
+   }
+   return verify(c, "bytes", &parser, &log);
+}
+
+/* Feed a stream through a ring buffer in short, uneven reads */
+static int runSplit(const CASE_T *c)
+{
+   static uint8_t storage[RING_SIZE];
+   PROTO_PARSER_T parser;
+   RINGBUFF_T rb;
+   LOG_T log = {0};
+   size_t i = 0, n = strlen(c->stream), chunk = 1;
+
+   RingBuffer_Init(&rb, storage, 1, RING_SIZE);
+   Proto_Init(&parser, handlers, &log);
+   while (i < n) {
+       chunk = (chunk % 7) + 1;
+       if (chunk > n - i) {
+           chunk = n - i;
+       }
+       RingBuffer_InsertMult(&rb, &c->stream[i], (int) chunk);
+       i += chunk;
+       /* Proto_ProcessRB() returns after each completed frame */
+       while (!RingBuffer_IsEmpty(&rb)) {
+           Proto_ProcessRB(&parser, &rb);
+       }
+   }
+   return verify(c, "split", &parser, &log);
+}
+
+static int check(void)
+{
+   int fail = 0;
+   size_t i;
+
+   for (i = 0; i < NCASES; i++) {
+       fail |= runDirect(&cases[i]);
+       fail |= runSplit(&cases[i]);
+   }
+   printf("%zu streams, %s\n", (size_t) NCASES, fail ? "FAIL" : "ok");
+   return fail;
+}
+
+static double nowSeconds(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Time the parser over a long stream of mostly valid frames */
+static void bench(size_t megabytes)
+{
+   static const char *const frames[] = {
+       "SMV:255,-255E", "SMV:-17,120E", "SGTE", "SMV:0,0E", "SMV:42,-42E",
+       "SSTE", "SMV:-255,255E", "SMV:1,1", "SMV:-3,9E", "SXY:1E",
+   };
+   size_t size = megabytes << 20, len = 0, k = 0, fl, i;
+   uint8_t *buf = malloc(size);
+   PROTO_PARSER_T parser;
+   LOG_T log = {0};
+   const PROTO_STATS_T *st;
+   double t0, t;
+#ifdef BENCH_CYCLES
+   uint64_t c0, cycles;
+#endif
+
+   if (buf == NULL) {
+       printf("out of memory\n");
+       return;
+   }
+   for (;;) {
+       fl = strlen(frames[k]);
+       if (len + fl > size) {
+           break;
+       }
+       memcpy(&buf[len], frames[k], fl);
+       len += fl;
+       k = (k + 1) % (sizeof(frames) / sizeof(frames[0]));
+   }
+
+   Proto_Init(&parser, handlers, &log);
+   t0 = nowSeconds();
+#ifdef BENCH_CYCLES
+   c0 = BENCH_CYCLES();
+#endif
+   for (i = 0; i < len; i++) {
+       Proto_ParseByte(&parser, buf[i]);
+   }
+#ifdef BENCH_CYCLES
+   cycles = BENCH_CYCLES() - c0;
+#endif
+   t = nowSeconds() - t0;
+
+   st = Proto_GetStats(&parser);
+   printf("%zu bytes, %u frames, %u dropped, %u unknown (checksum %u)\n",
+          len, st->frames, st->dropped, st->cmdErrors, log.sum);
+   printf("%7.1f MB/s, %5.2f ns per byte, %6.1f ns per frame\n",
+          len / t / 1e6, t / len * 1e9, t / st->frames * 1e9);
+#ifdef BENCH_CYCLES
+   printf("%5.2f cycles per byte (TSC)\n", (double) cycles / len);
+#else
+   printf("%5.2f cycles per byte (at %.1f GHz)\n", t * NOMINAL_HZ / len, NOMINAL_HZ / 1e9);
+#endif
+   free(buf);
+}
+
+int main(int argc, char **argv)
+{
+   size_t megabytes = (argc > 1) ? (size_t) atol(argv[1]) : 64;
+   int fail;
+
+   fail = check();
+   bench(megabytes);
+
+   return fail;
+}
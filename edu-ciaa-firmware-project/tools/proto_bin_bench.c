@@ -0,0 +1,325 @@
+/*
+ * @brief Host check and benchmark: ASCII against binary link framing
+ *
+ * The command set both modes share (MV with every speed pair in a
+ * pseudo-random sequence, ST and GT) is encoded once as S<CMD>:<PARAMS>E
+ * text and once as COBS/CRC-16 frames with ProtoBin_Encode(), then
+ * decoded back through Proto_ParseByte() and ProtoBin_DecodeByte(). The
+ * binary frames are translated into commands the same way the link does
+ * and go through Proto_Dispatch(), so both modes must deliver exactly the
+ * commands that were sent.
+ *
+ * The binary decoder is also fed corrupted copies of an MV frame (every
+ * single bit flipped in turn) and truncated copies (every length from the
+ * first byte to one byte short of the delimiter). None of them may come
+ * out as a valid frame, and a valid frame sent right after each one must
+ * still decode.
+ *
+ * It then reports the bytes per command and the command rate each mode
+ * allows at the link baud rate, and the host time to encode and decode.
+ *
+ * Build and run from edu-ciaa-firmware-project:
+ *   gcc -O2 -DEVTRACE_ENABLE=0 -Iapp/inc -Ilpc_chip_43xx/inc tools/proto_bin_bench.c \
+ *       app/src/protocol.c app/src/proto_bin.c -o proto_bin_bench
+ *   ./proto_bin_bench [commands]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "protocol.h"
+#include "proto_bin.h"
+
+#define LINK_BAUD       115200          /* 10 bits per byte on the wire */
+#define MV_LIMIT        255
+
+/* Commands delivered by the parsers */
+typedef struct {
+   PROTO_CMD_T *cmds;
+   size_t count;
+   size_t size;
+} LOG_T;
+
+static PROTO_STATUS_T onCmd(const PROTO_CMD_T *cmd, void *ctx)
+{
+   LOG_T *log = (LOG_T *) ctx;
+
+   if (log->count < log->size) {
+       log->cmds[log->count] = *cmd;
+   }
+   log->count++;
+   return PROTO_STATUS_OK;
+}
+
+static const PROTO_HANDLER_T handlers[PROTO_CMD_COUNT] = {
+   onCmd, onCmd, onCmd, onCmd, onCmd, onCmd, onCmd, onCmd,
+};
+
+static uint32_t seed = 12345;
+
+static int16_t randSpeed(void)
+{
+   seed = seed * 1103515245u + 12345u;
+   return (int16_t) ((int32_t) ((seed >> 8) % (2 * MV_LIMIT + 1)) - MV_LIMIT);
+}
+
+/* Nine MV commands out of ten, the rest alternate ST and GT */
+static void makeCommands(PROTO_CMD_T *cmds, size_t n)
+{
+   size_t i;
+
+   for (i = 0; i < n; i++) {
+       memset(&cmds[i], 0, sizeof(cmds[i]));
+       if (i % 10 == 9) {
+           cmds[i].id = (i % 20 == 9) ? PROTO_CMD_ST : PROTO_CMD_GT;
+       }
+       else {
+           cmds[i].id = PROTO_CMD_MV;
+           cmds[i].nparams = 2;
+           cmds[i].params[0] = randSpeed();
+           cmds[i].params[1] = randSpeed();
+       }
+   }
+}
+
+static size_t encodeAscii(const PROTO_CMD_T *cmd, uint8_t *out)
+{
+   static const char codes[PROTO_CMD_COUNT][3] = {"MV", "ST", "GT", "PF", "IQ", "TR", "TA", "BT"};
+
+   if (cmd->nparams == 2) {
+       return (size_t) sprintf((char *) out, "S%s:%d,%dE", codes[cmd->id],
+                               cmd->params[0], cmd->params[1]);
+   }
+   return (size_t) sprintf((char *) out, "S%sE", codes[cmd->id]);
+}
+
+static size_t encodeBin(const PROTO_CMD_T *cmd, uint8_t seq, uint8_t *out)
+{
+   uint8_t payload[4];
+
+   switch (cmd->id) {
+   case PROTO_CMD_MV:
+       ProtoBin_PutI16(&payload[0], cmd->params[0]);
+       ProtoBin_PutI16(&payload[2], cmd->params[1]);
+       return (size_t) ProtoBin_Encode(seq, PROTO_BIN_MSG_MV, payload, 4, out, PROTO_BIN_MAX_ENCODED);
+   case PROTO_CMD_ST:
+       return (size_t) ProtoBin_Encode(seq, PROTO_BIN_MSG_ST, NULL, 0, out, PROTO_BIN_MAX_ENCODED);
+   default:
+       return (size_t) ProtoBin_Encode(seq, PROTO_BIN_MSG_GT, NULL, 0, out, PROTO_BIN_MAX_ENCODED);
+   }
+}
+
+/* Same translation as Link_DispatchBin() */
+static PROTO_STATUS_T dispatchBin(PROTO_PARSER_T *pParser, const PROTO_BIN_FRAME_T *pFrame)
+{
+   PROTO_CMD_T cmd;
+
+   cmd.nparams = 0;
+   switch (pFrame->type) {
+   case PROTO_BIN_MSG_MV:
+       if (pFrame->len != 4) {
+           return PROTO_STATUS_ERR_PARAMS;
+       }
+       cmd.id = PROTO_CMD_MV;
+       cmd.params[0] = ProtoBin_GetI16(&pFrame->payload[0]);
+       cmd.params[1] = ProtoBin_GetI16(&pFrame->payload[2]);
+       cmd.nparams = 2;
+       break;
+
+   case PROTO_BIN_MSG_ST:
+       cmd.id = PROTO_CMD_ST;
+       break;
+
+   case PROTO_BIN_MSG_GT:
+       cmd.id = PROTO_CMD_GT;
+       break;
+
+   default:
+       return PROTO_STATUS_ERR_CMD;
+   }
+
+   if (cmd.nparams == 0 && pFrame->len != 0) {
+       return PROTO_STATUS_ERR_PARAMS;
+   }
+   return Proto_Dispatch(pParser, &cmd);
+}
+
+/* Encode every command in one mode into a single stream */
+static size_t encodeStream(const PROTO_CMD_T *cmds, size_t n, int binary, uint8_t *out)
+{
+   size_t i, len = 0;
+
+   for (i = 0; i < n; i++) {
+       len += binary ? encodeBin(&cmds[i], (uint8_t) i, &out[len]) : encodeAscii(&cmds[i], &out[len]);
+   }
+   return len;
+}
+
+/* Decode a stream, returns the number of binary frames with a bad sequence number */
+static size_t decodeStream(const uint8_t *in, size_t len, int binary, LOG_T *log)
+{
+   PROTO_PARSER_T parser;
+   PROTO_BIN_RX_T rx;
+   PROTO_BIN_FRAME_T frame;
+   uint8_t seq = 0;
+   size_t i, badSeq = 0;
+
+   Proto_Init(&parser, handlers, log);
+   ProtoBin_RxInit(&rx);
+   for (i = 0; i < len; i++) {
+       if (!binary) {
+           Proto_ParseByte(&parser, in[i]);
+       }
+       else if (ProtoBin_DecodeByte(&rx, in[i], &frame) == PROTO_BIN_FRAME) {
+           badSeq += (frame.seq != seq++);
+           dispatchBin(&parser, &frame);
+       }
+   }
+   return badSeq;
+}
+
+static int sameCommands(const PROTO_CMD_T *a, const PROTO_CMD_T *b, size_t n)
+{
+   size_t i;
+
+   for (i = 0; i < n; i++) {
+       if (a[i].id != b[i].id || a[i].nparams != b[i].nparams ||
+           (a[i].nparams == 2 && (a[i].params[0] != b[i].params[0] ||
+                                  a[i].params[1] != b[i].params[1]))) {
+           return 0;
+       }
+   }
+   return 1;
+}
+
+/* Decode a damaged frame followed by a good one */
+static int checkDamaged(const uint8_t *bad, size_t badLen, const uint8_t *good, size_t goodLen,
+                        size_t *crcErrors, size_t *frameErrors)
+{
+   PROTO_BIN_RX_T rx;
+   PROTO_BIN_FRAME_T frame;
+   PROTO_BIN_RES_T res;
+   size_t i;
+   int frames = 0, resync = 0;
+
+   ProtoBin_RxInit(&rx);
+   for (i = 0; i < badLen; i++) {
+       res = ProtoBin_DecodeByte(&rx, bad[i], &frame);
+       frames += (res == PROTO_BIN_FRAME);
+       *crcErrors += (res == PROTO_BIN_ERR_CRC);
+       *frameErrors += (res == PROTO_BIN_ERR_FRAME);
+   }
+   for (i = 0; i < goodLen; i++) {
+       res = ProtoBin_DecodeByte(&rx, good[i], &frame);
+       if (res == PROTO_BIN_FRAME) {
+           resync = (frame.type == PROTO_BIN_MSG_ST && frame.seq == 0x5A);
+       }
+       else {
+           *crcErrors += (res == PROTO_BIN_ERR_CRC);
+           *frameErrors += (res == PROTO_BIN_ERR_FRAME);
+       }
+   }
+   return frames == 0 && resync;
+}
+
+static int checkCorrupted(void)
+{
+   uint8_t payload[4], good[PROTO_BIN_MAX_ENCODED], mv[PROTO_BIN_MAX_ENCODED];
+   uint8_t bad[PROTO_BIN_MAX_ENCODED + 1];
+   size_t goodLen, mvLen, i, bit, crcErrors = 0, frameErrors = 0, flips = 0, cuts = 0;
+   int fail = 0;
+
+   ProtoBin_PutI16(&payload[0], -200);
+   ProtoBin_PutI16(&payload[2], 0x0100);
+   mvLen = (size_t) ProtoBin_Encode(0x33, PROTO_BIN_MSG_MV, payload, 4, mv, sizeof(mv));
+   goodLen = (size_t) ProtoBin_Encode(0x5A, PROTO_BIN_MSG_ST, NULL, 0, good, sizeof(good));
+
+   /* Every single bit flip in front of the delimiter */
+   for (i = 0; i + 1 < mvLen; i++) {
+       for (bit = 0; bit < 8; bit++) {
+           memcpy(bad, mv, mvLen);
+           bad[i] ^= (uint8_t) (1 << bit);
+           flips++;
+           if (!checkDamaged(bad, mvLen, good, goodLen, &crcErrors, &frameErrors)) {
+               printf("FAIL bit %zu of byte %zu flipped\n", bit, i);
+               fail = 1;
+           }
+       }
+   }
+
+   /* Frame cut short, the receiver sees the delimiter of the next one early */
+   for (i = 1; i + 1 < mvLen; i++) {
+       memcpy(bad, mv, i);
+       bad[i] = 0;
+       cuts++;
+       if (!checkDamaged(bad, i + 1, good, goodLen, &crcErrors, &frameErrors)) {
+           printf("FAIL frame truncated to %zu bytes\n", i);
+           fail = 1;
+       }
+   }
+
+   printf("binary: %zu bit flips, %zu truncations rejected (%zu CRC, %zu framing) %s\n",
+          flips, cuts, crcErrors, frameErrors, fail ? "FAIL" : "ok");
+   return fail;
+}
+
+static double nowSeconds(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+   static const char *const names[2] = {"ASCII ", "binary"};
+   size_t n = (argc > 1) ? (size_t) atol(argv[1]) : 1000000;
+   PROTO_CMD_T *cmds = malloc(n * sizeof(*cmds));
+   PROTO_CMD_T *got = malloc(n * sizeof(*got));
+   uint8_t *stream = malloc(n * PROTO_MAX_FRAME_LEN);
+   double t0, tEnc, tDec, perCmd;
+   size_t len, badSeq;
+   LOG_T log;
+   int binary, fail = 0;
+
+   if (cmds == NULL || got == NULL || stream == NULL) {
+       printf("out of memory\n");
+       return 1;
+   }
+   makeCommands(cmds, n);
+
+   for (binary = 0; binary < 2; binary++) {
+       t0 = nowSeconds();
+       len = encodeStream(cmds, n, binary, stream);
+       tEnc = nowSeconds() - t0;
+
+       log.cmds = got;
+       log.count = 0;
+       log.size = n;
+       t0 = nowSeconds();
+       badSeq = decodeStream(stream, len, binary, &log);
+       tDec = nowSeconds() - t0;
+
+       if (log.count != n || badSeq != 0 || !sameCommands(cmds, got, n)) {
+           printf("%s: FAIL, %zu of %zu commands, %zu out of sequence\n",
+                  names[binary], log.count, n, badSeq);
+           fail = 1;
+           continue;
+       }
+
+       perCmd = (double) len / n;
+       printf("%s: %zu commands ok, %5.2f bytes per command, %6.0f commands/s at %d baud, "
+              "encode %5.1f ns, decode %5.1f ns per command\n",
+              names[binary], n, perCmd, LINK_BAUD / 10.0 / perCmd, LINK_BAUD,
+              tEnc / n * 1e9, tDec / n * 1e9);
+   }
+
+   fail |= checkCorrupted();
+
+   free(cmds);
+   free(got);
+   free(stream);
+   return fail;
+}
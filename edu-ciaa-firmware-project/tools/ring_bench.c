@@ -0,0 +1,247 @@
+/*
+ * @brief Host benchmark: SPSC_RING_T against RINGBUFF_T
+ *
+ * One producer thread and one consumer thread move the same number of
+ * bytes through each ring buffer, which keeps both indexes contended. As
+ * in the firmware, RINGBUFF_T is guarded by a lock around every call
+ * (Chip_UART_SendRB() masks the UART interrupt for the same reason).
+ * SPSC_RING_T is used without any lock. Each case reports bytes per CPU
+ * cycle, measured with the time stamp counter on x86 and estimated from
+ * the wall clock at the nominal frequency elsewhere.
+ *
+ * Build and run from edu-ciaa-firmware-project:
+ *   gcc -O2 -pthread -Iapp/inc -Ilpc_chip_43xx/inc tools/ring_bench.c \
+ *       app/src/spsc_ring.c lpc_chip_43xx/src/ring_buffer.c -o ring_bench
+ *   ./ring_bench [megabytes]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ring_buffer.h"
+#include "spsc_ring.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()  __rdtsc()
+#endif
+
+#define RING_SIZE       256             /* Same as the link buffers */
+#define CHUNK           16              /* Bytes per multi-item call */
+#define NOMINAL_HZ      3.0e9           /* Cycle estimate without a TSC */
+
+typedef enum {
+   CASE_RB_BYTE,                       /* RINGBUFF_T, RingBuffer_Insert/Pop */
+   CASE_RB_MULT,                       /* RINGBUFF_T, RingBuffer_InsertMult/PopMult */
+   CASE_SPSC_BYTE,                     /* SPSC_RING_T, SpscRing_Insert8/Pop8 */
+   CASE_SPSC_MULT,                     /* SPSC_RING_T, SpscRing_InsertMult/PopMult */
+   CASE_SPSC_SPAN,                     /* SPSC_RING_T, Reserve/Commit and Peek/Release */
+   CASE_COUNT
+} BENCH_CASE_T;
+
+static const char *const caseNames[CASE_COUNT] = {
+   "RINGBUFF_T  Insert/Pop (locked)",
+   "RINGBUFF_T  InsertMult/PopMult (locked)",
+   "SPSC_RING_T Insert8/Pop8",
+   "SPSC_RING_T InsertMult/PopMult",
+   "SPSC_RING_T Reserve/Commit, Peek/Release",
+};
+
+static uint8_t storage[RING_SIZE];
+static RINGBUFF_T rb;
+static SPSC_RING_T spsc;
+static pthread_spinlock_t rbLock;
+static BENCH_CASE_T benchCase;
+static size_t totalBytes;
+static volatile uint32_t checksum;
+
+static double nowSeconds(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *producer(void *arg)
+{
+   uint8_t chunk[CHUNK];
+   size_t sent = 0;
+   uint32_t i, n;
+   void *span;
+   int ok;
+
+   (void) arg;
+   for (i = 0; i < CHUNK; i++) {
+       chunk[i] = (uint8_t) i;
+   }
+
+   while (sent < totalBytes) {
+       size_t before = sent;
+
+       switch (benchCase) {
+       case CASE_RB_BYTE:
+           pthread_spin_lock(&rbLock);
+           ok = RingBuffer_Insert(&rb, &chunk[sent % CHUNK]);
+           pthread_spin_unlock(&rbLock);
+           sent += ok;
+           break;
+
+       case CASE_RB_MULT:
+           pthread_spin_lock(&rbLock);
+           ok = RingBuffer_InsertMult(&rb, chunk, CHUNK);
+           pthread_spin_unlock(&rbLock);
+           sent += ok;
+           break;
+
+       case CASE_SPSC_BYTE:
+           sent += SpscRing_Insert8(&spsc, (uint8_t) sent);
+           break;
+
+       case CASE_SPSC_MULT:
+           sent += SpscRing_InsertMult(&spsc, chunk, CHUNK);
+           break;
+
+       case CASE_SPSC_SPAN:
+           n = SpscRing_Reserve(&spsc, &span);
+           if (n != 0) {
+               memset(span, (int) sent, n);
+               SpscRing_Commit(&spsc, n);
+               sent += n;
+           }
+           break;
+
+       default:
+           return NULL;
+       }
+
+       /* Full: give the consumer the CPU on hosts with few cores */
+       if (sent == before) {
+           sched_yield();
+       }
+   }
+
+   return NULL;
+}
+
+static void *consumer(void *arg)
+{
+   uint8_t chunk[CHUNK], v;
+   size_t recv = 0;
+   uint32_t sum = 0, i, n;
+   const void *span;
+   int got;
+
+   (void) arg;
+   while (recv < totalBytes) {
+       size_t before = recv;
+
+       switch (benchCase) {
+       case CASE_RB_BYTE:
+           pthread_spin_lock(&rbLock);
+           got = RingBuffer_Pop(&rb, &v);
+           pthread_spin_unlock(&rbLock);
+           sum += got ? v : 0;
+           recv += got;
+           break;
+
+       case CASE_RB_MULT:
+           pthread_spin_lock(&rbLock);
+           got = RingBuffer_PopMult(&rb, chunk, CHUNK);
+           pthread_spin_unlock(&rbLock);
+           for (i = 0; i < (uint32_t) got; i++) {
+               sum += chunk[i];
+           }
+           recv += got;
+           break;
+
+       case CASE_SPSC_BYTE:
+           if (SpscRing_Pop8(&spsc, &v)) {
+               sum += v;
+               recv++;
+           }
+           break;
+
+       case CASE_SPSC_MULT:
+           got = SpscRing_PopMult(&spsc, chunk, CHUNK);
+           for (i = 0; i < (uint32_t) got; i++) {
+               sum += chunk[i];
+           }
+           recv += got;
+           break;
+
+       case CASE_SPSC_SPAN:
+           n = SpscRing_Peek(&spsc, &span);
+           for (i = 0; i < n; i++) {
+               sum += ((const uint8_t *) span)[i];
+           }
+           SpscRing_Release(&spsc, n);
+           recv += n;
+           break;
+
+       default:
+           return NULL;
+       }
+
+       /* Empty: give the producer the CPU on hosts with few cores */
+       if (recv == before) {
+           sched_yield();
+       }
+   }
+
+   checksum = sum;
+   return NULL;
+}
+
+static void runCase(BENCH_CASE_T c)
+{
+   pthread_t prod, cons;
+   double t0, t1, cycles;
+#ifdef BENCH_CYCLES
+   uint64_t c0, c1;
+#endif
+
+   benchCase = c;
+   RingBuffer_Init(&rb, storage, 1, RING_SIZE);
+   SpscRing_Init(&spsc, storage, 1, RING_SIZE);
+
+   t0 = nowSeconds();
+#ifdef BENCH_CYCLES
+   c0 = BENCH_CYCLES();
+#endif
+   pthread_create(&cons, NULL, consumer, NULL);
+   pthread_create(&prod, NULL, producer, NULL);
+   pthread_join(prod, NULL);
+   pthread_join(cons, NULL);
+#ifdef BENCH_CYCLES
+   c1 = BENCH_CYCLES();
+   cycles = (double) (c1 - c0);
+#endif
+   t1 = nowSeconds();
+#ifndef BENCH_CYCLES
+   cycles = (t1 - t0) * NOMINAL_HZ;
+#endif
+
+   printf("%-42s %8.1f MB/s  %7.4f bytes/cycle\n", caseNames[c],
+          totalBytes / (t1 - t0) / 1e6, totalBytes / cycles);
+}
+
+int main(int argc, char **argv)
+{
+   int c;
+
+   totalBytes = (size_t) ((argc > 1) ? atoi(argv[1]) : 64) << 20;
+   pthread_spin_init(&rbLock, PTHREAD_PROCESS_PRIVATE);
+   setvbuf(stdout, NULL, _IOLBF, 0);
+
+   printf("%zu MB through a %d byte ring, producer and consumer on separate threads\n",
+          totalBytes >> 20, RING_SIZE);
+   for (c = 0; c < CASE_COUNT; c++) {
+       runCase((BENCH_CASE_T) c);
+   }
+
+   return 0;
+}
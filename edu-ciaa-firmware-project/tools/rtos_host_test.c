@@ -0,0 +1,176 @@
+/*
+ * @brief Host check for the preemptive kernel
+ *
+ * Runs the kernel on the POSIX port and checks, from a test thread:
+ * - a thread created at a higher priority runs before ThreadCreate returns
+ * - the owner of a mutex inherits the priority of its best waiter, through
+ *   a queue wait, and drops back to its own once it unlocks
+ * - unlock hands the mutex to the highest priority waiter
+ * - a mutex lock timing out gives the owner its priority back
+ * - queue timeouts last at least the given number of ticks
+ * - a pthread outside the kernel feeds a queue with the FromIsr call, and
+ *   gets RTOS_ERR_ISR from the blocking ones
+ *
+ * Build and run from edu-ciaa-firmware-project:
+ *   gcc -O2 -pthread -Iapp/inc -Ilpc_chip_43xx/inc tools/rtos_host_test.c app/src/rtos.c app/src/rtos_port_posix.c -o rtos_host_test
+ *   ./rtos_host_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "rtos.h"
+
+#define STACK_WORDS     256
+
+#define CHECK(c)        check((c), #c, __LINE__)
+
+typedef struct {
+   RTOS_THREAD_T t;
+   uint32_t stack[STACK_WORDS] __attribute__((aligned(8)));
+} TEST_THREAD_T;
+
+static TEST_THREAD_T testThread, hiThread, lowThread, lowAgain, waitA, waitB;
+static RTOS_MUTEX_T mutex;
+static RTOS_QUEUE_T gate, isrQueue;
+static uint32_t gateBuf[1], isrBuf[4];
+
+static char trace[16];
+static uint32_t traceLen;
+static uint8_t lowPrioAfter;
+static uint32_t isrErr;
+static uint32_t errors;
+
+static void check(bool ok, const char *what, int line)
+{
+   if (!ok) {
+       printf("line %d: %s\n", line, what);
+       errors++;
+   }
+}
+
+static void mark(char c)
+{
+   if (traceLen < sizeof(trace) - 1) {
+       trace[traceLen++] = c;
+   }
+}
+
+static void hiFn(void *arg)
+{
+   mark('H');
+}
+
+/* Lock the mutex, then hold it across a wait on the gate */
+static void lowFn(void *arg)
+{
+   uint32_t v;
+
+   Rtos_MutexLock(&mutex, RTOS_FOREVER);
+   Rtos_QueueRecv(&gate, &v, RTOS_FOREVER);
+   Rtos_MutexUnlock(&mutex);
+   lowPrioAfter = Rtos_Self()->prio;
+   mark('L');
+}
+
+static void waiterFn(void *arg)
+{
+   if (Rtos_MutexLock(&mutex, RTOS_FOREVER) == RTOS_OK) {
+       mark(*(const char *) arg);
+       Rtos_MutexUnlock(&mutex);
+   }
+}
+
+/* Interrupt stand-in: blocking calls must fail, FromIsr must queue */
+static void *isrFn(void *arg)
+{
+   uint32_t v = 0x1234;
+
+   usleep(3000);
+   if (Rtos_QueueRecv(&isrQueue, &v, RTOS_FOREVER) == RTOS_ERR_ISR &&
+       Rtos_MutexLock(&mutex, RTOS_NO_WAIT) == RTOS_ERR_ISR) {
+       isrErr = 0;
+   }
+   Rtos_QueueSendFromIsr(&isrQueue, &v);
+
+   return NULL;
+}
+
+static void testFn(void *arg)
+{
+   uint32_t v, t0;
+   pthread_t isr;
+
+   /* Preemption on creation */
+   Rtos_ThreadCreate(&hiThread.t, "hi", hiFn, NULL, hiThread.stack, STACK_WORDS, 5);
+   mark('T');
+   CHECK(strcmp(trace, "HT") == 0);
+
+   /* Inheritance through a blocked owner, then handoff by priority */
+   traceLen = 0;
+   memset(trace, 0, sizeof(trace));
+   Rtos_ThreadCreate(&lowThread.t, "low", lowFn, NULL, lowThread.stack, STACK_WORDS, 20);
+   Rtos_Sleep(2);
+   CHECK(mutex.owner == &lowThread.t);
+   Rtos_ThreadCreate(&waitA.t, "a", waiterFn, "a", waitA.stack, STACK_WORDS, 8);
+   CHECK(lowThread.t.prio == 8);
+   Rtos_ThreadCreate(&waitB.t, "b", waiterFn, "b", waitB.stack, STACK_WORDS, 6);
+   CHECK(lowThread.t.prio == 6);
+
+   /* An owner gives back what a timed out waiter lent it */
+   CHECK(Rtos_MutexLock(&mutex, RTOS_NO_WAIT) == RTOS_TIMEOUT);
+   t0 = Rtos_TickCount();
+   CHECK(Rtos_MutexLock(&mutex, 3) == RTOS_TIMEOUT);
+   CHECK((uint32_t) (Rtos_TickCount() - t0) >= 3);
+   CHECK(lowThread.t.prio == 6);
+
+   v = 1;
+   Rtos_QueueSend(&gate, &v, RTOS_FOREVER);
+   Rtos_Sleep(2);
+   CHECK(strcmp(trace, "baL") == 0);
+   CHECK(lowPrioAfter == 20);
+   CHECK(lowThread.t.prio == 20 && lowThread.t.state == RTOS_STATE_DEAD);
+   CHECK(mutex.owner == NULL && testThread.t.held == NULL);
+
+   /* Owner back to its base priority after a lone waiter times out */
+   Rtos_ThreadCreate(&lowAgain.t, "low", lowFn, NULL, lowAgain.stack, STACK_WORDS, 20);
+   Rtos_Sleep(2);
+   CHECK(mutex.owner == &lowAgain.t);
+   CHECK(Rtos_MutexLock(&mutex, 2) == RTOS_TIMEOUT);
+   CHECK(lowAgain.t.prio == 20);
+   Rtos_QueueSend(&gate, &v, RTOS_FOREVER);
+   Rtos_Sleep(2);
+   CHECK(mutex.owner == NULL);
+
+   /* Queue timeout */
+   t0 = Rtos_TickCount();
+   CHECK(Rtos_QueueRecv(&isrQueue, &v, 5) == RTOS_TIMEOUT);
+   CHECK((uint32_t) (Rtos_TickCount() - t0) >= 5);
+
+   /* Interrupt feeding a queue */
+   isrErr = 1;
+   pthread_create(&isr, NULL, isrFn, NULL);
+   v = 0;
+   CHECK(Rtos_QueueRecv(&isrQueue, &v, 1000) == RTOS_OK);
+   CHECK(v == 0x1234);
+   pthread_join(isr, NULL);
+   CHECK(isrErr == 0);
+
+   CHECK(Rtos_StackFree(&testThread.t) > 0);
+
+   printf("check: %u errors\n", errors);
+   exit(errors ? 1 : 0);
+}
+
+int main(void)
+{
+   Rtos_Init();
+   Rtos_MutexInit(&mutex);
+   Rtos_QueueInit(&gate, gateBuf, sizeof(gateBuf[0]), 1);
+   Rtos_QueueInit(&isrQueue, isrBuf, sizeof(isrBuf[0]), 4);
+   Rtos_ThreadCreate(&testThread.t, "test", testFn, NULL, testThread.stack, STACK_WORDS, 10);
+   Rtos_Start();
+
+   return 1;
+}
@@ -0,0 +1,276 @@
+/*
+ * @brief Host check and benchmark for the software timer wheel
+ *
+ * Runs a few hundred timers with random delays, from one tick to beyond
+ * the wheel range, one-shot and periodic, and keeps restarting and
+ * stopping them from the callbacks and between runs. A shadow copy of
+ * every timer's next expiry is kept here, and the program fails when a
+ * callback runs in a Swtimer_Run() that did not reach its expiry, or in a
+ * later one than the first that did, when a stopped timer runs, or when
+ * Swtimer_NextDeadline() is later than the earliest shadow expiry. Time
+ * advances in steps from one tick to long jumps, as the main loop does
+ * after sleeping until the next deadline.
+ *
+ * It then times Swtimer_Start(), Swtimer_Stop() and a run of expiries.
+ *
+ * Build and run from edu-ciaa-firmware-project:
+ *   gcc -O2 -Iapp/inc -Ilpc_chip_43xx/inc tools/swtimer_bench.c app/src/swtimer.c -o swtimer_bench
+ *   ./swtimer_bench [steps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "swtimer.h"
+
+#define NTIMERS         500
+#define TICK            SWTIMER_TICK_US
+
+typedef struct {
+   SWTIMER_T t;
+   uint64_t due;                       /* Shadow expiry, in ticks, 0 when stopped */
+   uint32_t period;
+   uint32_t runs;
+} BENCH_TIMER_T;
+
+static BENCH_TIMER_T timers[NTIMERS];
+static uint64_t prevTick, nowTick;
+static uint64_t baseTick;              /* Tick delays count from: the run's, or the expiry in a callback */
+static uint32_t errors, fired;
+
+/* xorshift64*, reproducible across hosts */
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rnd(void)
+{
+   rng ^= rng >> 12;
+   rng ^= rng << 25;
+   rng ^= rng >> 27;
+   return rng * 0x2545F4914F6CDD1DULL;
+}
+
+/* Mostly short delays, some up to the top level and some past the range */
+static uint64_t rndDelay(void)
+{
+   switch (rnd() % 8) {
+   case 0:
+       return rnd() % 4;
+   case 1: case 2: case 3:
+       return 1 + rnd() % 64;
+   case 4: case 5:
+       return 1 + rnd() % 5000;
+   case 6:
+       return 1 + rnd() % 2000000;
+   default:
+       return 1 + rnd() % (3ULL << 30);
+   }
+}
+
+static void start(BENCH_TIMER_T *b)
+{
+   uint64_t delay = rndDelay();
+
+   b->period = (rnd() % 3 == 0) ? (uint32_t) (1 + rnd() % 3000) : 0;
+   Swtimer_Start(&b->t, delay, b->period);
+   b->due = baseTick + (delay ? delay : 1);
+}
+
+static void stop(BENCH_TIMER_T *b)
+{
+   Swtimer_Stop(&b->t);
+   b->due = 0;
+}
+
+static void expired(void *ctx)
+{
+   BENCH_TIMER_T *b = ctx;
+
+   fired++;
+   b->runs++;
+   baseTick = b->due;
+   if (b->due == 0 || b->due > nowTick || b->due <= prevTick) {
+       printf("timer %d: due %llu, ran in run (%llu, %llu]\n", (int) (b - timers),
+              (unsigned long long) b->due, (unsigned long long) prevTick,
+              (unsigned long long) nowTick);
+       errors++;
+   }
+   if (b->period != 0) {
+       b->due += b->period;
+       if (b->due <= nowTick) {
+           b->due += ((nowTick - b->due) / b->period + 1) * b->period;
+       }
+   }
+   else {
+       b->due = 0;
+   }
+
+   /* Shake the wheel from inside the callbacks too */
+   switch (rnd() % 16) {
+   case 0:
+       start(b);
+       break;
+   case 1:
+       stop(b);
+       break;
+   case 2:
+       stop(&timers[rnd() % NTIMERS]);
+       break;
+   case 3:
+       b = &timers[rnd() % NTIMERS];
+       start(b);
+       break;
+   default:
+       break;
+   }
+}
+
+/* Earliest shadow expiry, in ticks */
+static uint64_t earliest(void)
+{
+   uint64_t e = UINT64_MAX;
+   int i;
+
+   for (i = 0; i < NTIMERS; i++) {
+       if (timers[i].due != 0 && timers[i].due < e) {
+           e = timers[i].due;
+       }
+   }
+   return e;
+}
+
+static double seconds(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void check(long steps)
+{
+   uint64_t deadline, e;
+   long s;
+   int i;
+
+   Swtimer_Init(0);
+   for (i = 0; i < NTIMERS; i++) {
+       Swtimer_Setup(&timers[i].t, expired, &timers[i]);
+       timers[i].due = 0;
+       start(&timers[i]);
+   }
+
+   for (s = 0; s < steps; s++) {
+       deadline = Swtimer_NextDeadline();
+       e = earliest();
+       if ((e == UINT64_MAX) != (deadline == SWTIMER_NEVER) ||
+           (e != UINT64_MAX && deadline > e * TICK)) {
+           printf("step %ld: deadline %llu us, earliest expiry at tick %llu\n", s,
+                  (unsigned long long) deadline, (unsigned long long) e);
+           errors++;
+       }
+
+       /* Wake at the deadline like the main loop, or early or late */
+       prevTick = nowTick;
+       switch (rnd() % 4) {
+       case 0:
+           nowTick += 1;
+           break;
+       case 1:
+           nowTick += rnd() % 200;
+           break;
+       case 2:
+           if (deadline != SWTIMER_NEVER) {
+               nowTick = MAX(nowTick, deadline / TICK);
+           }
+           break;
+       default:
+           nowTick += rnd() % 100000;
+           break;
+       }
+       Swtimer_Run(nowTick * TICK + rnd() % TICK);
+       baseTick = nowTick;
+
+       for (i = rnd() % 4; i > 0; i--) {
+           BENCH_TIMER_T *b = &timers[rnd() % NTIMERS];
+
+           if (rnd() % 3 == 0) {
+               stop(b);
+           }
+           else {
+               start(b);
+           }
+       }
+
+       /* Every due expiry must have run */
+       e = earliest();
+       if (e <= nowTick) {
+           printf("step %ld: tick %llu, expiry at tick %llu did not run\n", s,
+                  (unsigned long long) nowTick, (unsigned long long) e);
+           errors++;
+       }
+       if (errors > 20) {
+           break;
+       }
+   }
+
+   for (i = 0; i < NTIMERS; i++) {
+       if (Swtimer_IsActive(&timers[i].t) != (timers[i].due != 0)) {
+           printf("timer %d: active %d, shadow due %llu\n", i, Swtimer_IsActive(&timers[i].t),
+                  (unsigned long long) timers[i].due);
+           errors++;
+       }
+   }
+   printf("check: %ld steps, %u expiries, %u errors\n", s, fired, errors);
+}
+
+static void count(void *ctx)
+{
+   (*(uint32_t *) ctx)++;
+}
+
+static void bench(void)
+{
+   static SWTIMER_T t[NTIMERS];
+   uint32_t runs = 0;
+   double t0, t1, t2, t3;
+   int rep, i;
+
+   Swtimer_Init(0);
+   for (i = 0; i < NTIMERS; i++) {
+       Swtimer_Setup(&t[i], count, &runs);
+   }
+
+   t0 = seconds();
+   for (rep = 0; rep < 1000; rep++) {
+       for (i = 0; i < NTIMERS; i++) {
+           Swtimer_Start(&t[i], 1 + (i * 7919) % 100000, 0);
+       }
+       for (i = 0; i < NTIMERS; i++) {
+           Swtimer_Stop(&t[i]);
+       }
+   }
+   t1 = seconds();
+
+   for (rep = 0; rep < 1000; rep++) {
+       for (i = 0; i < NTIMERS; i++) {
+           Swtimer_Start(&t[i], 1 + (i * 7919) % 100000, 0);
+       }
+   }
+   t2 = seconds();
+   Swtimer_Run(200000ULL * TICK);
+   t3 = seconds();
+
+   printf("start+stop: %.1f ns\n", (t1 - t0) * 1e9 / (1000.0 * NTIMERS));
+   printf("start (restart): %.1f ns\n", (t2 - t1) * 1e9 / (1000.0 * NTIMERS));
+   printf("run: %u expiries over 200000 ticks, %.1f us\n", runs, (t3 - t2) * 1e6);
+}
+
+int main(int argc, char **argv)
+{
+   long steps = (argc > 1) ? atol(argv[1]) : 200000;
+
+   check(steps);
+   bench();
+
+   return errors ? 1 : 0;
+}
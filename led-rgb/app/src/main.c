@@ -93,8 +93,9 @@ void SysTick_Handler(void)
 
 void delay(uint32_t tk)
 {
-   uint32_t end = tick_ct + tk;
-   while (tick_ct < end)
+   uint32_t start = tick_ct;
+   /* Elapsed ticks by unsigned difference, correct across the 32-bit wrap */
+   while ((uint32_t) (tick_ct - start) < tk)
       __WFI();
 }
 